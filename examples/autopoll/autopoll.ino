@@ -0,0 +1,96 @@
+#include <PN532Extended.h>
+#include <PN532_HSU.h>
+
+// Use Serial2 of ESP32
+HardwareSerial PN532Serial(2);
+
+// Serial interface
+PN532_HSU pn532hsu(PN532Serial);
+
+// Extended library which allows card extensions
+PN532Extended nfc(pn532hsu);
+
+// Target types polled by PN532 (up to 15)
+const BinaryData pollTypes = {
+  AUTOPOLL_GENERIC_106KBPS,
+  AUTOPOLL_TYPE_B_106KBPS,
+  AUTOPOLL_FELICA_212KBPS,
+  AUTOPOLL_FELICA_424KBPS,
+  AUTOPOLL_JEWEL_106KBPS
+};
+
+// Helper function to print hex array
+void PrintBin(const uint8_t* data, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    Serial.print(data[i], HEX);
+    Serial.print(' ');
+  }
+  Serial.print('\n');
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Hello!");
+
+  pn532hsu.begin();
+  nfc.begin();
+
+  GetFirmwareVersionResponse version;
+  if (!nfc.GetFirmwareVersion(version)) {
+    Serial.print("Didn't find PN53x board");
+    while (1); // halt
+  }
+
+  // configure board to read RFID tags
+  nfc.SAMConfig();
+
+  Serial.println("Waiting for a card");
+}
+
+void loop() {
+  // PN532 polls all types by itself, host only waits for the response
+  InAutoPollResponse resp;
+  Result result = nfc.InAutoPoll(resp, pollTypes, PN532_AUTOPOLL_ENDLESS, 0x01);
+  if (!result)
+  {
+    Serial.print("InAutoPoll failed: ");
+    Serial.println(result.Message());
+    return;
+  }
+
+  for (int i = 0; i < resp.NbTg; ++i)
+  {
+    const AutoPollTarget& target = resp.Targets[i];
+
+    Serial.print("Type: ");
+    Serial.println(target.Type, HEX);
+
+    switch (target.BrTy)
+    {
+      case BRTY_106KBPS_TYPE_A:
+        Serial.print("ISO14443A UID: ");
+        PrintBin(target.TypeA.UID.data(), target.TypeA.UID.size());
+        break;
+      case BRTY_106KBPS_TYPE_B:
+        Serial.print("ISO14443B ATQB: ");
+        PrintBin(target.TypeB.ATQB, sizeof(target.TypeB.ATQB));
+        break;
+      case BRTY_212KBPS:
+      case BRTY_424KBPS:
+        Serial.print("FeliCa NFCID2: ");
+        PrintBin(target.FeliCa.NFCID2, sizeof(target.FeliCa.NFCID2));
+        break;
+      case BRTY_106KBPS_JEWEL:
+        Serial.print("Jewel ID: ");
+        PrintBin(target.Jewel.JewelID, sizeof(target.Jewel.JewelID));
+        break;
+      default:
+        Serial.println("DEP target");
+        break;
+    }
+
+    nfc.InRelease(target.Tg);
+  }
+}
@@ -1,6 +1,7 @@
 #include <PN532Extended.h>
 #include <PN532_HSU.h>
 #include <Desfire.h>
+#include <Random.h>
 
 // Use Serial2 of ESP32
 HardwareSerial PN532Serial(2);
@@ -17,6 +18,10 @@ PN532Extended nfc(pn532hsu);
 // Desfire key for authentication
 const DesfireKey key = CreateDesfireKeyAES({ 0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90, 0xA0, 0xB0, 0xB0, 0xA0, 0x90, 0x80 });
 
+// Set to 1, to authenticate with per card keys diversified from the key above (NXP AN10922)
+#define DIVERSIFY_KEY 0
+const DesfireKeyDiversifier diversifier(key);
+
 // Set to 1, to change key after authentication
 #define CHANGE_KEY 0
 DesfireKey key_new = CreateDesfireKeyAES({ 0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90, 0xA0, 0xB0, 0xB0, 0xA0, 0x90, 0x80 });
@@ -65,9 +70,12 @@ void PrintBin(const BinaryData& in)
 }
 
 void loop() {
+  // Authentication challenges come from this pool, fill it before the card arrives
+  GetRandomPool().Refill();
+
   // Finds nearby ISO14443 Type A tags
   InListPassiveTargetResponse resp;
-  nfc.InListPassiveTarget(resp, 1, BRTY_106KBPS_TYPE_A);
+  nfc.InListPassiveTarget(resp, MAX_RFID_TARGETS, BRTY_106KBPS_TYPE_A);
 
   // For parsing response data
   ByteBuffer buf(resp.TgData);
@@ -118,10 +126,19 @@ void loop() {
         Serial.println("Desfire connect successful!");
 
       // Authenticates key 0 (master key)
-      if (desfire.Authenticate(0, key))
+      Result result;
+      if (DIVERSIFY_KEY)
+        result = desfire.Authenticate(0, diversifier, tgdata.UID);
+      else
+        result = desfire.Authenticate(0, key);
+
+      if (result)
         Serial.println("Desfire Auth SUCCESS!");
       else
-        Serial.println("Desfire Auth FAILED!");
+      {
+        Serial.print("Desfire Auth FAILED: ");
+        Serial.println(result.Message());
+      }
 
       if (CHANGE_KEY)
       {
@@ -130,10 +147,16 @@ void loop() {
         else
           Serial.println("ChangeKey FAILED!");
       }
+
+      // Keep the session until the card is removed. Presence check is a single
+      // short RF exchange, no anticollision and RATS as with polling again.
+      while (nfc.CheckPresence())
+        delay(50);
+      Serial.println("Card removed");
     }
 
-    uint8_t status = nfc.InRelease(i);
+    Result status = nfc.InRelease(tgdata.Tg);
     Serial.print("Release status: ");
-    Serial.println(status);
+    Serial.println(status.Message());
   }
 }
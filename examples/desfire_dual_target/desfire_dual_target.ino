@@ -0,0 +1,72 @@
+#include <PN532Extended.h>
+#include <PN532_HSU.h>
+#include <Desfire.h>
+#include <TagScheduler.h>
+
+// Use Serial2 of ESP32
+HardwareSerial PN532Serial(2);
+
+// Serial interface
+PN532_HSU pn532hsu(PN532Serial);
+
+// Extended library which allows card extensions
+PN532Extended nfc(pn532hsu);
+
+// Desfire key for authentication
+const DesfireKey key = CreateDesfireKeyAES({ 0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90, 0xA0, 0xB0, 0xB0, 0xA0, 0x90, 0x80 });
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Hello!");
+
+  pn532hsu.begin();
+  nfc.begin();
+
+  GetFirmwareVersionResponse version;
+  if (!nfc.GetFirmwareVersion(version)) {
+    Serial.print("Didn't find PN53x board");
+    while (1); // halt
+  }
+
+  nfc.SetPassiveActivationRetries(0xFF);
+  nfc.SAMConfig();
+
+  Serial.println("Waiting for up to two ISO14443A cards");
+}
+
+void loop() {
+  // Activates up to 2 targets (PN532 limit). Zeroed, so Tg of a missing
+  // second target is defined, its interface is just never used
+  TargetListTypeA list = {};
+  if (!nfc.InListPassiveTarget(list, 2) || list.NbTg == 0)
+    return;
+
+  // Every target gets its own tag interface, Desfire session and job.
+  // Storage is sized for the maximum of two targets.
+  TagInterface tifs[2] = { nfc.CreateTagInterface(list.Targets[0].Tg), nfc.CreateTagInterface(list.Targets[1].Tg) };
+  Desfire desfires[2] = { Desfire(tifs[0]), Desfire(tifs[1]) };
+  DesfireAuthenticateJob jobs[2] = { DesfireAuthenticateJob(desfires[0], 0, key), DesfireAuthenticateJob(desfires[1], 0, key) };
+
+  // Scheduler interleaves both authentications: while one card answers
+  // over RF, host decrypts the response of the other one.
+  TagScheduler scheduler;
+  bool isDesfire[2] = { false, false };
+  for (int i = 0; i < list.NbTg; ++i)
+  {
+    isDesfire[i] = PN532Extended::IdentifyTypeACard(list.Targets[i]) == CARD_TYPE_MIFARE_DESFIRE;
+    if (isDesfire[i])
+      scheduler.Add(tifs[i], jobs[i]);
+  }
+
+  scheduler.Run();
+
+  for (int i = 0; i < list.NbTg; ++i)
+  {
+    Serial.print("Target ");
+    Serial.print(list.Targets[i].Tg);
+    Serial.print(": ");
+    Serial.println(isDesfire[i] ? jobs[i].GetResult().Message() : "not a Desfire card");
+
+    nfc.InRelease(list.Targets[i].Tg);
+  }
+}
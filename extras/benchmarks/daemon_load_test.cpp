@@ -0,0 +1,234 @@
+// Load test of ReaderDaemon. Every reader is a pseudo terminal served by a
+// PN532Simulator with a Desfire card, which is authenticated on each tap.
+// Events are received over the daemon socket like any other local consumer.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src daemon_load_test.cpp ../../src/*.cpp -lcrypto -lpthread -o daemon_load_test
+// Add -DPN532_METRICS=1 to print per layer latency histograms at the end.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Desfire.h"
+#include "PN532Frame.h"
+#include "PN532Simulator.h"
+#include "Metrics.h"
+#include "Platform.h"
+#include "ReaderDaemon.h"
+
+#define LOAD_TEST_DURATION_MS 3000
+#define LOAD_TEST_SOCKET "/tmp/pn532d_load_test.sock"
+
+static const DesfireKey masterKey({
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+}, DF_KEY_AES);
+
+class AuthenticateHandler : public TapHandler
+{
+public:
+    TagJob* CreateJob(uint8_t reader, TagInterface& tag, const TargetDataTypeA& /* target */)
+    {
+        _desfire[reader].reset(new Desfire(tag));
+        _jobs[reader].reset(new DesfireAuthenticateJob(*_desfire[reader], 0, masterKey));
+
+        return _jobs[reader].get();
+    }
+
+    Result FinishJob(uint8_t /* reader */, TagJob* job)
+    {
+        return static_cast<DesfireAuthenticateJob*>(job)->GetResult();
+    }
+
+private:
+    std::unique_ptr<Desfire> _desfire[READER_DAEMON_MAX_READERS];
+    std::unique_ptr<DesfireAuthenticateJob> _jobs[READER_DAEMON_MAX_READERS];
+};
+
+// PN532 side of a pseudo terminal
+static void RunDevice(int master, PN532Simulator& sim, std::atomic<bool>& running)
+{
+    const uint8_t ack[] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+    const uint8_t error[] = {0x00, 0x00, 0xFF, 0x01, 0xFF, 0x7F, 0x81, 0x00};
+
+    PN532FrameDecoder decoder(PN532_FRAME_DIR_TO_PN532);
+    uint8_t frame[PN532_FRAME_HEADROOM + PN532_MAX_EXTENDED_PACKET_SIZE + PN532_FRAME_TAILROOM];
+    uint8_t chunk[64];
+
+    while (running)
+    {
+        struct pollfd pfd = {master, POLLIN, 0};
+        if (poll(&pfd, 1, 50) <= 0)
+            continue;
+
+        ssize_t n = read(master, chunk, sizeof(chunk));
+        if (n <= 0)
+        {
+            // Slave side is not open yet
+            usleep(1000);
+            continue;
+        }
+
+        for (ssize_t i = 0; i < n; ++i)
+        {
+            if (decoder.Feed(chunk[i]) != PN532FrameDecoder::EVENT_FRAME)
+                continue;
+
+            (void)!write(master, ack, sizeof(ack));
+
+            BinaryView cmd = decoder.Frame();
+            uint8_t *data = frame + PN532_FRAME_HEADROOM;
+
+            sim.writeCommand(cmd.Data, cmd.Size);
+            int16_t len = sim.readResponse(data + 1, PN532_MAX_EXTENDED_PACKET_SIZE - 1);
+
+            if (len < 0)
+            {
+                (void)!write(master, error, sizeof(error));
+                continue;
+            }
+
+            data[0] = cmd[0] + 1;
+
+            uint16_t size;
+            uint8_t *start = PN532EncodeFrame(frame, len + 1, size, PN532_FRAME_DIR_TO_HOST);
+            (void)!write(master, start, size);
+        }
+    }
+}
+
+static uint32_t Percentile(const std::vector<uint32_t>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+
+    return sorted[(size_t)(p * (sorted.size() - 1))];
+}
+
+static void RunLoadTest(uint8_t readers)
+{
+    std::atomic<bool> running(true);
+    std::vector<std::unique_ptr<SimulatedDesfireCard>> cards;
+    std::vector<std::unique_ptr<PN532Simulator>> simulators;
+    std::vector<std::thread> devices;
+    std::vector<int> masters;
+
+    AuthenticateHandler handler;
+    ReaderDaemon daemon(handler);
+    daemon.PollIntervalMillis = 0;
+
+    if (!daemon.Listen(LOAD_TEST_SOCKET))
+    {
+        perror("Listen");
+        exit(1);
+    }
+
+    for (uint8_t i = 0; i < readers; ++i)
+    {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) || unlockpt(master))
+        {
+            perror("posix_openpt");
+            exit(1);
+        }
+
+        cards.emplace_back(new SimulatedDesfireCard({0x04, 0x11, 0x22, 0x33, 0x44, 0x55, i}, masterKey));
+        simulators.emplace_back(new PN532Simulator());
+        simulators[i]->RealTime = true;
+        simulators[i]->SetCard(0, cards[i].get());
+
+        masters.push_back(master);
+        devices.push_back(std::thread(RunDevice, master, std::ref(*simulators[i]), std::ref(running)));
+
+        if (daemon.AddReader(ptsname(master)) < 0)
+        {
+            fprintf(stderr, "Failed to add reader %u\n", i);
+            exit(1);
+        }
+    }
+
+    // Local consumer
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", LOAD_TEST_SOCKET);
+
+    std::thread loop(&ReaderDaemon::Run, &daemon);
+
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+
+    std::vector<uint32_t> latency;
+    latency.reserve(100000);
+    uint32_t failed = 0;
+    uint32_t start = PlatformMillis();
+
+    while (PlatformMillis() - start < LOAD_TEST_DURATION_MS)
+    {
+        struct pollfd pfd = {sock, POLLIN, 0};
+        if (poll(&pfd, 1, 10) <= 0)
+            continue;
+
+        ByteBuffer buf;
+        buf.Data().resize(TAP_EVENT_WIRE_SIZE);
+        if (recv(sock, buf.Data().data(), TAP_EVENT_WIRE_SIZE, 0) != TAP_EVENT_WIRE_SIZE)
+            continue;
+
+        TapEvent event;
+        buf >> event;
+        latency.push_back(event.DurationMicros);
+        if (!event.Status)
+            failed++;
+    }
+
+    double seconds = (PlatformMillis() - start) / 1000.0;
+
+    daemon.Stop();
+    loop.join();
+    close(sock);
+
+    running = false;
+    for (std::thread& device : devices)
+        device.join();
+    for (int master : masters)
+        close(master);
+
+    std::sort(latency.begin(), latency.end());
+
+    printf("%7u %10.1f %9.2f %9.2f %9.2f %9.2f %8u %8u\n", readers, latency.size() / seconds,
+        Percentile(latency, 0.50) / 1000.0, Percentile(latency, 0.99) / 1000.0,
+        Percentile(latency, 0.999) / 1000.0, latency.empty() ? 0.0 : latency.back() / 1000.0,
+        failed, daemon.DroppedEvents());
+}
+
+int main()
+{
+    printf("%u ms per run, latency is poll start to release in ms\n", LOAD_TEST_DURATION_MS);
+    printf("%7s %10s %9s %9s %9s %9s %8s %8s\n", "readers", "events/s", "p50", "p99", "p99.9", "max", "failed", "dropped");
+
+    for (uint8_t readers = 1; readers <= READER_DAEMON_MAX_READERS; readers *= 2)
+        RunLoadTest(readers);
+
+    unlink(LOAD_TEST_SOCKET);
+
+#if PN532_METRICS
+    char metrics[4096];
+    GetMetrics().Format(metrics, sizeof(metrics));
+    printf("\n%s", metrics);
+#endif
+
+    return 0;
+}
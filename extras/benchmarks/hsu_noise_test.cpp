@@ -0,0 +1,233 @@
+// Injects bit errors on a simulated HSU link and measures how PN532_Stream
+// recovers with NACK, command resend and resynchronization, compared to
+// failing the exchange on the first corrupted frame. Exits with 1 if an
+// exchange fails although retries are enabled. Runs in about a second,
+// pass the number of exchanges per run for a longer measurement.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src hsu_noise_test.cpp ../../src/*.cpp -lcrypto -lpthread -o hsu_noise_test
+
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Desfire.h"
+#include "PN532Extended.h"
+#include "PN532Frame.h"
+#include "PN532Simulator.h"
+#include "PN532_Stream.h"
+#include "Platform.h"
+
+#define NOISE_TEST_EXCHANGES 200
+
+static uint32_t exchanges = NOISE_TEST_EXCHANGES;
+
+static const DesfireKey masterKey({
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+}, DF_KEY_AES);
+
+// PN532 side of the link. Bytes in both directions pass through a channel with given bit error rate
+class NoisyDevice
+{
+public:
+    NoisyDevice(int master, PN532Simulator& sim, double ber) :
+        Nacks(0), Lost(0), _master(master), _sim(sim), _random(1234), _running(true)
+    {
+        // Probability that a byte (8 bits) is hit
+        _byteError = 1.0 - pow(1.0 - ber, 8);
+        _thread = std::thread(&NoisyDevice::Run, this);
+    }
+
+    ~NoisyDevice()
+    {
+        _running = false;
+        _thread.join();
+    }
+
+    // Number of NACKs answered and corrupted commands ignored so far
+    std::atomic<uint32_t> Nacks;
+    std::atomic<uint32_t> Lost;
+
+private:
+    void Corrupt(uint8_t *data, size_t len)
+    {
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        std::uniform_int_distribution<int> bit(0, 7);
+
+        for (size_t i = 0; i < len; ++i)
+        {
+            if (chance(_random) < _byteError)
+                data[i] ^= 1 << bit(_random);
+        }
+    }
+
+    void Send(const uint8_t *data, size_t len)
+    {
+        std::vector<uint8_t> noisy(data, data + len);
+        Corrupt(noisy.data(), noisy.size());
+        (void)!write(_master, noisy.data(), noisy.size());
+    }
+
+    void Run()
+    {
+        const uint8_t ack[] = PN532_ACK_FRAME;
+        PN532FrameDecoder decoder(PN532_FRAME_DIR_TO_PN532);
+        uint8_t frame[PN532_FRAME_HEADROOM + PN532_MAX_EXTENDED_PACKET_SIZE + PN532_FRAME_TAILROOM];
+        std::vector<uint8_t> last;
+        uint8_t chunk[64];
+
+        while (_running)
+        {
+            struct pollfd pfd = {_master, POLLIN, 0};
+            if (poll(&pfd, 1, 20) <= 0)
+                continue;
+
+            ssize_t n = read(_master, chunk, sizeof(chunk));
+            if (n <= 0)
+            {
+                usleep(1000);
+                continue;
+            }
+
+            // Noise on host to PN532 direction
+            Corrupt(chunk, n);
+
+            for (ssize_t i = 0; i < n; ++i)
+            {
+                PN532FrameDecoder::Event_t event = decoder.Feed(chunk[i]);
+
+                if (event == PN532FrameDecoder::EVENT_NACK)
+                {
+                    Nacks++;
+                    Send(last.data(), last.size());
+                }
+                else if (event == PN532FrameDecoder::EVENT_INVALID)
+                    Lost++; // PN532 ignores the frame, host resends after ACK timeout
+                else if (event == PN532FrameDecoder::EVENT_FRAME)
+                {
+                    Send(ack, sizeof(ack));
+
+                    BinaryView cmd = decoder.Frame();
+                    uint8_t *data = frame + PN532_FRAME_HEADROOM;
+
+                    _sim.writeCommand(cmd.Data, cmd.Size);
+                    int16_t len = _sim.readResponse(data + 1, PN532_MAX_EXTENDED_PACKET_SIZE - 1);
+                    if (len < 0)
+                        continue;
+
+                    data[0] = cmd[0] + 1;
+
+                    uint16_t size;
+                    uint8_t *start = PN532EncodeFrame(frame, len + 1, size, PN532_FRAME_DIR_TO_HOST);
+                    last.assign(start, start + size);
+                    Send(start, size);
+                }
+            }
+        }
+    }
+
+    int _master;
+    PN532Simulator& _sim;
+    std::mt19937 _random;
+    double _byteError;
+    std::atomic<bool> _running;
+    std::thread _thread;
+};
+
+static uint32_t Median(std::vector<uint32_t>& samples)
+{
+    if (samples.empty())
+        return 0;
+
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Returns number of failed exchanges
+static uint32_t RunTest(double ber, uint8_t retries)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master))
+    {
+        perror("posix_openpt");
+        exit(1);
+    }
+
+    SimulatedDesfireCard card({0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66}, masterKey);
+    card.CommandMicros = 0;
+    PN532Simulator sim;
+    sim.SetCard(0, &card);
+
+    NoisyDevice device(master, sim, ber);
+
+    PN532_Stream stream(PN532_Stream::Open(ptsname(master)));
+    stream.MaxRetries = retries;
+    PN532Extended nfc(stream);
+
+    // Activate card with retries, setup itself is not measured
+    TargetListTypeA list;
+    list.NbTg = 0;
+    for (uint8_t i = 0; i < 100 && !list.NbTg; ++i)
+        nfc.InListPassiveTarget(list, 1);
+
+    TagInterface tag = nfc.CreateTagInterface(list.NbTg ? list.Targets[0].Tg : 1);
+    Desfire desfire(tag);
+
+    std::vector<uint32_t> clean, nacked, resent;
+    uint32_t failed = 0;
+
+    for (uint32_t i = 0; i < exchanges; ++i)
+    {
+        uint32_t nacks = device.Nacks;
+        uint32_t lost = device.Lost;
+        uint32_t start = PlatformMicros();
+
+        Result result = desfire.SelectApplication(i & 0xFFFFFF);
+
+        uint32_t elapsed = PlatformMicros() - start;
+
+        if (!result)
+            failed++;
+        else if (device.Lost != lost)
+            resent.push_back(elapsed);
+        else if (device.Nacks != nacks)
+            nacked.push_back(elapsed);
+        else
+            clean.push_back(elapsed);
+    }
+
+    close(master);
+
+    printf("%8.0e %7u %7.2f%% %10u %6u %10u %7u %10u\n", ber, retries, 100.0 * failed / exchanges,
+        Median(clean), (unsigned)nacked.size(), Median(nacked), (unsigned)resent.size(), Median(resent));
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        exchanges = atoi(argv[1]);
+
+    printf("%u exchanges per run, latency in us\n", exchanges);
+    printf("%8s %7s %8s %10s %6s %10s %7s %10s\n", "BER", "retries", "failed", "clean p50", "nacked", "nack p50", "resent", "resend p50");
+
+    const double rates[] = {0, 1e-5, 1e-4, 1e-3};
+    uint32_t failed = 0;
+
+    for (double ber : rates)
+    {
+        RunTest(ber, 0);
+        failed += RunTest(ber, PN532_MAX_RETRIES);
+    }
+
+    return failed ? 1 : 0;
+}
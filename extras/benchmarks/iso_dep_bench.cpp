@@ -0,0 +1,147 @@
+// Compares large DESFire reads through InDataExchange, where the PN532
+// firmware runs the ISO14443-4 block protocol, with InCommunicateThru and the
+// host side IsoDep. Native ReadData answers in 59 byte frames which fit a
+// single block, ISO READ BINARY of 256 bytes is chained over several blocks.
+// Time is simulated link and RF time of PN532Simulator (115200 baud HSU), so
+// results do not depend on the host.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src iso_dep_bench.cpp ../../src/*.cpp -lcrypto -lpthread -o iso_dep_bench
+
+#include <cstdio>
+#include "Desfire.h"
+#include "IsoDep.h"
+#include "PN532Extended.h"
+#include "PN532Simulator.h"
+
+#define BENCH_ROUNDS 50
+// Every n-th card answer is lost in the lossy InCommunicateThru run
+#define BENCH_DROP_INTERVAL 25
+
+static const DesfireKey masterKey({
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+}, DF_KEY_AES);
+
+enum Transport_t
+{
+    TRANSPORT_DATA_EXCHANGE,
+    TRANSPORT_COMMUNICATE_THRU,
+    TRANSPORT_COMMUNICATE_THRU_LOSSY
+};
+
+struct BenchResult
+{
+    double Millis;          // Simulated time per read
+    double Blocks;          // IsoDep blocks per read
+    uint32_t Retransmissions;
+    BinaryData Data;
+};
+
+// ISO READ BINARY in chunks of 256 bytes
+static Result ReadBinary(TagInterface& tif, uint16_t size, BinaryData& out)
+{
+    out.clear();
+
+    for (uint16_t offset = 0; offset < size; offset += 256)
+    {
+        tif.BeginWrite() << (uint8_t)0x00 << (uint8_t)0xB0 << (uint8_t)(offset >> 8) << (uint8_t)offset << (uint8_t)0x00;
+
+        Result result = tif.EndWrite();
+        if (!result)
+            return result;
+
+        BinaryView rapdu;
+        result = tif.Read(rapdu);
+        if (!result)
+            return result;
+
+        if (rapdu.Size < 2)
+            return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+        result = Result::ISO7816(rapdu[rapdu.Size-2], rapdu[rapdu.Size-1]);
+        if (!result)
+            return result;
+
+        out.insert(out.end(), rapdu.Data, rapdu.Data + rapdu.Size - 2);
+    }
+
+    return Result();
+}
+
+static BenchResult Run(Transport_t transport, bool iso, uint16_t size)
+{
+    SimulatedDesfireCard card({0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66}, masterKey);
+    PN532Simulator sim;
+    sim.SetCard(0, &card);
+
+    PN532Extended nfc(sim);
+    IsoDep isoDep(nfc);
+    TagInterface tif = transport == TRANSPORT_DATA_EXCHANGE ? nfc.CreateTagInterface(1) : TagInterface(isoDep);
+    Desfire desfire(tif);
+
+    BenchResult res = {0, 0, 0, BinaryData()};
+
+    TargetListTypeA list;
+    if (!nfc.InListPassiveTarget(list, 1) || !list.NbTg)
+    {
+        printf("Activation failed\n");
+        return res;
+    }
+
+    if (transport != TRANSPORT_DATA_EXCHANGE && !isoDep.Begin(list.Targets[0].ATS))
+    {
+        printf("IsoDep failed\n");
+        return res;
+    }
+
+    if (transport == TRANSPORT_COMMUNICATE_THRU_LOSSY)
+        sim.DropInterval = BENCH_DROP_INTERVAL;
+
+    uint64_t start = sim.Elapsed();
+    uint32_t blocks = isoDep.Blocks();
+
+    for (uint32_t i = 0; i < BENCH_ROUNDS; ++i)
+    {
+        Result result = iso ? ReadBinary(tif, size, res.Data) : desfire.ReadData(0x01, 0, size, res.Data);
+        if (!result)
+        {
+            printf("Read failed: %s\n", result.Message());
+            break;
+        }
+    }
+
+    res.Millis = (sim.Elapsed() - start) / 1000.0 / BENCH_ROUNDS;
+    res.Blocks = (double)(isoDep.Blocks() - blocks) / BENCH_ROUNDS;
+    res.Retransmissions = isoDep.Retransmissions();
+
+    return res;
+}
+
+int main()
+{
+    const struct { const char *Name; bool ISO; uint16_t Size; } reads[] = {
+        { "ReadData", false, 256 },
+        { "ReadData", false, 1024 },
+        { "READ BINARY", true, 256 },
+        { "READ BINARY", true, 1024 }
+    };
+
+    printf("Simulated time per read, %u rounds, lossy run drops every %u. card answer\n", BENCH_ROUNDS, BENCH_DROP_INTERVAL);
+    printf("%-12s %6s %14s %14s %8s %12s %8s\n", "Command", "Bytes", "DataExchange", "CommThru ms", "blocks", "lossy ms", "resent");
+
+    for (auto& read : reads)
+    {
+        BenchResult exchange = Run(TRANSPORT_DATA_EXCHANGE, read.ISO, read.Size);
+        BenchResult thru = Run(TRANSPORT_COMMUNICATE_THRU, read.ISO, read.Size);
+        BenchResult lossy = Run(TRANSPORT_COMMUNICATE_THRU_LOSSY, read.ISO, read.Size);
+
+        if (exchange.Data != thru.Data || exchange.Data != lossy.Data || exchange.Data.size() != read.Size)
+            printf("%-12s data mismatch\n", read.Name);
+
+        printf("%-12s %6u %11.2f ms %14.2f %8.1f %12.2f %8u\n", read.Name, read.Size,
+            exchange.Millis, thru.Millis, thru.Blocks, lossy.Millis, lossy.Retransmissions);
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Dumps a simulated Mifare Classic 4K with three strategies: blocks in random
+// order with authentication cache, planned ReadBlocks (sector order) and
+// authenticating before every block. Time is simulated link and RF time of
+// PN532Simulator (115200 baud HSU).
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src mifare_classic_dump_bench.cpp ../../src/*.cpp -lcrypto -lpthread -o mifare_classic_dump_bench
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include "MifareClassic.h"
+#include "PN532Extended.h"
+#include "PN532Simulator.h"
+
+enum Strategy_t
+{
+    STRATEGY_PLANNED,
+    STRATEGY_RANDOM_ORDER,
+    STRATEGY_AUTH_EVERY_BLOCK
+};
+
+static void Run(const char *name, Strategy_t strategy)
+{
+    SimulatedClassicCard card({0x04, 0x33, 0x21, 0x8A, 0x52, 0x19, 0x80}, CARD_TYPE_MIFARE_CLASSIC_4K);
+    PN532Simulator sim;
+    sim.SetCard(0, &card);
+
+    PN532Extended nfc(sim);
+    TargetListTypeA list;
+    if (!nfc.InListPassiveTarget(list, 1) || !list.NbTg)
+    {
+        printf("Activation failed\n");
+        return;
+    }
+
+    const TargetDataTypeA& target = list.Targets[0];
+    TagInterface tif = nfc.CreateTagInterface(target.Tg);
+    MifareClassic classic(tif, target.UID, PN532Extended::IdentifyTypeACard(target));
+
+    BinaryData blocks(MIFARE_MAX_BLOCKS);
+    for (uint16_t i = 0; i < MIFARE_MAX_BLOCKS; ++i)
+        blocks[i] = i;
+
+    std::mt19937 random(42);
+    std::shuffle(blocks.begin(), blocks.end(), random);
+
+    uint64_t start = sim.Elapsed();
+    BinaryData data(MIFARE_MAX_BLOCKS * MIFARE_BLOCK_SIZE);
+    Result result;
+
+    if (strategy == STRATEGY_PLANNED)
+    {
+        data.clear();
+        result = classic.ReadBlocks(blocks, data);
+    }
+    else
+    {
+        for (uint16_t i = 0; i < MIFARE_MAX_BLOCKS && result; ++i)
+        {
+            if (strategy == STRATEGY_AUTH_EVERY_BLOCK)
+                classic.ClearAuthentication();
+
+            result = classic.ReadBlock(blocks[i], data.data() + i * MIFARE_BLOCK_SIZE);
+        }
+    }
+
+    if (!result)
+    {
+        printf("%-20s failed: %s\n", name, result.Message());
+        return;
+    }
+
+    uint32_t auths = classic.Authentications();
+
+    printf("%-20s %6u %6u %10.1f\n", name, (unsigned)auths, (unsigned)(auths + MIFARE_MAX_BLOCKS),
+        (sim.Elapsed() - start) / 1000.0);
+}
+
+int main()
+{
+    printf("Mifare Classic 4K dump (%u blocks, 40 sectors), blocks requested in random order\n", MIFARE_MAX_BLOCKS);
+    printf("%-20s %6s %6s %10s\n", "Strategy", "Auths", "Frames", "Time ms");
+
+    Run("planned", STRATEGY_PLANNED);
+    Run("cache, random order", STRATEGY_RANDOM_ORDER);
+    Run("auth every block", STRATEGY_AUTH_EVERY_BLOCK);
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Idle current against detection latency of LowPowerPoller. The PN532 sleeps
+// in PowerDown between polls, the host wakes it up every interval. Time is
+// simulated link and RF time of PN532Simulator (115200 baud HSU), currents
+// are typical PN532 datasheet values and only scale the result.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src power_down_bench.cpp ../../src/*.cpp -lcrypto -lpthread -o power_down_bench
+
+#include <cstdio>
+#include "LowPowerPoller.h"
+#include "PN532Extended.h"
+#include "PN532Simulator.h"
+
+#define BENCH_ROUNDS 100
+// Supply current of PN532 while polling with field on and in PowerDown
+#define ACTIVE_MA 100.0
+#define POWER_DOWN_MA 0.01
+
+struct BenchResult
+{
+    double EmptyMillis;     // Awake time of a poll without card
+    double WakeMillis;      // Wake-up to first response with card in field
+    uint32_t Restores;
+};
+
+// Simulated time of one Poll
+static double TimePoll(PN532Simulator& sim, LowPowerPoller& poller, bool& found)
+{
+    InAutoPollResponse resp;
+    uint64_t start = sim.Elapsed();
+
+    found = poller.Poll(resp) && resp.NbTg;
+
+    return (sim.Elapsed() - start) / 1000.0;
+}
+
+static BenchResult Run(bool powerCycle)
+{
+    SimulatedNtagCard card({0x04, 0x51, 0x2A, 0x7B, 0x1C, 0x3D, 0x80}, 0x11);
+    PN532Simulator sim;
+    PN532Extended nfc(sim);
+    LowPowerPoller poller(nfc, &RF_PROFILE_FAST_TURNSTILE);
+
+    BenchResult res = {0, 0, 0};
+
+    if (!poller.Begin())
+    {
+        printf("Begin failed\n");
+        return res;
+    }
+
+    for (uint32_t i = 0; i < BENCH_ROUNDS; ++i)
+    {
+        bool found = false;
+
+        sim.SetCard(0, nullptr);
+        res.EmptyMillis += TimePoll(sim, poller, found);
+
+        // Brown-out while sleeping, settings have to be restored
+        if (powerCycle)
+            sim.PowerCycle();
+
+        sim.SetCard(0, &card);
+        res.WakeMillis += TimePoll(sim, poller, found);
+
+        if (!found || !poller.Sleep())
+        {
+            printf("Poll failed\n");
+            return res;
+        }
+    }
+
+    res.EmptyMillis /= BENCH_ROUNDS;
+    res.WakeMillis /= BENCH_ROUNDS;
+    res.Restores = poller.Restores();
+
+    return res;
+}
+
+int main()
+{
+    BenchResult warm = Run(false);
+    BenchResult cold = Run(true);
+
+    printf("Simulated wake-to-first-response, %u rounds\n", BENCH_ROUNDS);
+    printf("%-28s %10s %10s %10s\n", "", "empty ms", "card ms", "restores");
+    printf("%-28s %10.2f %10.2f %10u\n", "wake from PowerDown", warm.EmptyMillis, warm.WakeMillis, warm.Restores);
+    printf("%-28s %10.2f %10.2f %10u\n", "wake after brown-out", cold.EmptyMillis, cold.WakeMillis, cold.Restores);
+
+    // Awake only for empty polls, mean latency is half an interval plus wake-up
+    const uint32_t intervals[] = {50, 100, 200, 500, 1000};
+
+    printf("\n%-12s %12s %16s\n", "interval ms", "avg mA", "mean latency ms");
+
+    for (uint32_t interval : intervals)
+    {
+        double awake = warm.EmptyMillis < interval ? warm.EmptyMillis : interval;
+        double current = (awake * ACTIVE_MA + (interval - awake) * POWER_DOWN_MA) / interval;
+
+        printf("%-12u %12.2f %16.2f\n", interval, current, interval / 2.0 + warm.WakeMillis);
+    }
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Scaling benchmark of ReaderPool with 1 to 16 simulated readers.
+// Every reader has a Desfire card in the field which is authenticated on each tap.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src reader_pool_bench.cpp ../../src/*.cpp -lcrypto -lpthread -o reader_pool_bench
+// Add -DPN532_METRICS=1 to print per layer latency histograms at the end.
+
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Desfire.h"
+#include "PN532Simulator.h"
+#include "Metrics.h"
+#include "Platform.h"
+#include "ReaderPool.h"
+
+#define BENCH_DURATION_MS 2000
+
+static const DesfireKey masterKey({
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+}, DF_KEY_AES);
+
+class AuthenticateHandler : public TapHandler
+{
+public:
+    AuthenticateHandler(uint8_t readers) : _desfire(readers), _jobs(readers) {}
+
+    TagJob* CreateJob(uint8_t reader, TagInterface& tag, const TargetDataTypeA& /* target */)
+    {
+        _desfire[reader].reset(new Desfire(tag));
+        _jobs[reader].reset(new DesfireAuthenticateJob(*_desfire[reader], 0, masterKey));
+
+        return _jobs[reader].get();
+    }
+
+    Result FinishJob(uint8_t /* reader */, TagJob* job)
+    {
+        return static_cast<DesfireAuthenticateJob*>(job)->GetResult();
+    }
+
+private:
+    std::vector<std::unique_ptr<Desfire>> _desfire;
+    std::vector<std::unique_ptr<DesfireAuthenticateJob>> _jobs;
+};
+
+static void RunBenchmark(uint8_t readers)
+{
+    std::vector<std::unique_ptr<SimulatedDesfireCard>> cards;
+    std::vector<std::unique_ptr<PN532Simulator>> simulators;
+    std::vector<std::unique_ptr<PN532Extended>> nfc;
+
+    AuthenticateHandler handler(readers);
+    ReaderPool pool(handler);
+
+    for (uint8_t i = 0; i < readers; ++i)
+    {
+        cards.emplace_back(new SimulatedDesfireCard({0x04, 0x11, 0x22, 0x33, 0x44, 0x55, i}, masterKey));
+        simulators.emplace_back(new PN532Simulator());
+        simulators[i]->RealTime = true;
+        simulators[i]->SetCard(0, cards[i].get());
+        nfc.emplace_back(new PN532Extended(*simulators[i]));
+        pool.AddReader(*nfc[i]);
+    }
+
+    uint32_t taps = 0, failed = 0;
+    uint64_t latency = 0;
+    std::clock_t cpuStart = std::clock();
+    uint32_t start = PlatformMillis();
+
+    pool.Start();
+
+    while (PlatformMillis() - start < BENCH_DURATION_MS)
+    {
+        TapEvent event;
+        while (pool.PopEvent(event))
+        {
+            taps++;
+            latency += event.DurationMicros;
+            if (!event.Status)
+                failed++;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    pool.Stop();
+
+    double seconds = (PlatformMillis() - start) / 1000.0;
+    double cpu = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    double rate = taps / seconds;
+
+    printf("%7u %10.1f %12.1f %10.3f %14.1f %8u %8u\n",
+        readers, rate, taps ? (double)latency / taps / 1000.0 : 0.0, cpu / seconds,
+        cpu > 0 ? taps / cpu : 0.0, failed, pool.DroppedEvents());
+}
+
+int main()
+{
+    printf("Hardware threads: %u, duration %u ms per run\n", std::thread::hardware_concurrency(), BENCH_DURATION_MS);
+    printf("%7s %10s %12s %10s %14s %8s %8s\n", "readers", "taps/s", "latency ms", "cores", "taps/core-s", "failed", "dropped");
+
+    for (uint8_t readers = 1; readers <= READER_POOL_MAX_READERS; readers *= 2)
+        RunBenchmark(readers);
+
+#if PN532_METRICS
+    char metrics[4096];
+    GetMetrics().Format(metrics, sizeof(metrics));
+    printf("\n%s", metrics);
+#endif
+
+    return 0;
+}
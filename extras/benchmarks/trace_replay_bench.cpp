@@ -0,0 +1,153 @@
+// Records a PN532 session into a WireTrace (or loads one captured in the field)
+// and replays it through PN532Replay at full speed.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src trace_replay_bench.cpp ../../src/*.cpp -lcrypto -lpthread -o trace_replay_bench
+// Usage:
+//   trace_replay_bench [trace file]
+// Existing trace file is replayed, otherwise a simulated session is recorded and saved into it.
+
+#include <cstdio>
+#include <map>
+#include "Desfire.h"
+#include "PN532Extended.h"
+#include "PN532Replay.h"
+#include "PN532Simulator.h"
+#include "Platform.h"
+
+#define BENCH_TAPS 20
+#define BENCH_REPLAYS 1000
+#define BENCH_TRACE_SIZE 32768
+
+static const DesfireKey masterKey({
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+}, DF_KEY_AES);
+
+static void Record(BinaryData& data)
+{
+    SimulatedDesfireCard card({0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66}, masterKey);
+    PN532Simulator sim;
+    sim.RealTime = true;
+    sim.SetCard(0, &card);
+
+    WireTrace trace(BENCH_TRACE_SIZE);
+    sim.setTrace(&trace);
+
+    PN532Extended nfc(sim);
+    nfc.SAMConfig();
+
+    for (uint8_t i = 0; i < BENCH_TAPS; ++i)
+    {
+        TargetListTypeA list;
+        if (!nfc.InListPassiveTarget(list, 1) || !list.NbTg)
+            continue;
+
+        TagInterface tag = nfc.CreateTagInterface(list.Targets[0].Tg);
+        Desfire desfire(tag);
+        desfire.Authenticate(0, masterKey);
+
+        nfc.InRelease(list.Targets[0].Tg);
+    }
+
+    trace.Export(data);
+    printf("Recorded %u taps, %u bytes, %u records dropped\n", BENCH_TAPS, (unsigned)data.size(), trace.Dropped());
+}
+
+// Recorded latency of every command code
+static void Summarize(const BinaryData& data)
+{
+    std::map<uint8_t, std::pair<uint32_t, uint64_t>> commands;
+    WireTraceRecord record, command;
+    size_t offset = 0;
+    bool pending = false;
+
+    while (WireTrace::Next(data, offset, record))
+    {
+        if (record.Type == TRACE_COMMAND && record.Data.Size)
+        {
+            command = record;
+            pending = true;
+        }
+        else if (pending)
+        {
+            std::pair<uint32_t, uint64_t>& entry = commands[command.Data[0]];
+            entry.first++;
+            entry.second += record.Timestamp - command.Timestamp;
+            pending = false;
+        }
+    }
+
+    printf("%8s %8s %12s\n", "command", "count", "recorded us");
+    for (auto& entry : commands)
+        printf("    0x%02X %8u %12u\n", entry.first, entry.second.first, (unsigned)(entry.second.second / entry.second.first));
+}
+
+int main(int argc, char **argv)
+{
+    BinaryData data;
+    FILE *file = argc > 1 ? fopen(argv[1], "rb") : nullptr;
+
+    if (file)
+    {
+        uint8_t chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            data.insert(data.end(), chunk, chunk + n);
+        fclose(file);
+        printf("Loaded %u bytes from %s\n", (unsigned)data.size(), argv[1]);
+    }
+    else
+    {
+        Record(data);
+
+        if (argc > 1 && (file = fopen(argv[1], "wb")))
+        {
+            fwrite(data.data(), 1, data.size(), file);
+            fclose(file);
+        }
+    }
+
+    Summarize(data);
+
+    // Recorded commands are sent as they are, so any session can be replayed
+    std::vector<BinaryData> commands;
+    WireTraceRecord record;
+    size_t offset = 0;
+    uint32_t first = 0, last = 0;
+
+    while (WireTrace::Next(data, offset, record))
+    {
+        if (!first)
+            first = record.Timestamp;
+        last = record.Timestamp;
+
+        if (record.Type == TRACE_COMMAND)
+            commands.push_back(record.Data.ToBinary());
+    }
+
+    PN532Replay replay(data);
+    PN532Extended nfc(replay);
+    uint32_t failed = 0;
+    uint32_t start = PlatformMicros();
+
+    for (uint16_t i = 0; i < BENCH_REPLAYS; ++i)
+    {
+        replay.Rewind();
+
+        for (const BinaryData& command : commands)
+        {
+            if (!nfc.WriteCommand(command))
+                failed++;
+            else
+                nfc.ReadResponse();
+        }
+    }
+
+    uint32_t elapsed = PlatformMicros() - start;
+
+    printf("Session: %u commands, recorded %.1f ms, replayed in %.1f us (%u replays, %u failed)\n",
+        (unsigned)commands.size(), (last - first) / 1000.0, (double)elapsed / BENCH_REPLAYS, BENCH_REPLAYS, failed);
+
+    return 0;
+}
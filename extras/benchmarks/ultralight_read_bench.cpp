@@ -0,0 +1,119 @@
+// Compares reading whole NTAG21x user memory with FAST_READ against a loop of
+// 4 page READ commands. Time is simulated link and RF time of PN532Simulator
+// (115200 baud HSU), so results do not depend on the host.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src ultralight_read_bench.cpp ../../src/*.cpp -lcrypto -lpthread -o ultralight_read_bench
+
+#include <cstdio>
+#include "PN532Extended.h"
+#include "PN532Simulator.h"
+#include "Ultralight.h"
+
+#define BENCH_ROUNDS 100
+
+struct BenchResult
+{
+    double Millis;      // Simulated time per read of user memory
+    uint32_t Frames;    // Commands per read of user memory
+    BinaryData Data;
+};
+
+static bool Activate(PN532Extended& nfc)
+{
+    TargetListTypeA list;
+    return nfc.InListPassiveTarget(list, 1) && list.NbTg;
+}
+
+static bool ReadLoop(Ultralight& tag, BinaryData& out, uint32_t& frames)
+{
+    uint16_t end = ULTRALIGHT_USER_PAGE + tag.UserPages();
+
+    for (uint16_t page = ULTRALIGHT_USER_PAGE; page < end; page += ULTRALIGHT_READ_PAGES)
+    {
+        if (!tag.Read(page, out))
+            return false;
+        frames++;
+    }
+
+    // READ returns whole 4 page blocks
+    out.resize(tag.UserPages() * ULTRALIGHT_PAGE_SIZE);
+
+    return true;
+}
+
+static BenchResult Run(uint8_t storageSize, bool fast)
+{
+    SimulatedNtagCard card({0x04, 0x51, 0x2A, 0x7B, 0x1C, 0x3D, 0x80}, storageSize);
+    PN532Simulator sim;
+    sim.SetCard(0, &card);
+
+    PN532Extended nfc(sim);
+    TagInterface tif = nfc.CreateTagInterface(1);
+    Ultralight tag(tif);
+
+    BenchResult res;
+    res.Frames = 0;
+
+    if (!Activate(nfc) || !tag.Identify())
+    {
+        printf("Identification failed\n");
+        return res;
+    }
+
+    uint64_t start = sim.Elapsed();
+
+    for (uint32_t i = 0; i < BENCH_ROUNDS; ++i)
+    {
+        BinaryData data;
+        uint32_t frames = 0;
+        bool ok;
+
+        if (fast)
+        {
+            ok = (bool)tag.ReadUserMemory(data);
+            frames = (tag.UserPages() + ULTRALIGHT_FAST_READ_MAX_PAGES - 1) / ULTRALIGHT_FAST_READ_MAX_PAGES;
+        }
+        else
+            ok = ReadLoop(tag, data, frames);
+
+        if (!ok)
+        {
+            printf("Read failed\n");
+            break;
+        }
+
+        res.Frames = frames;
+        res.Data = data;
+    }
+
+    res.Millis = (sim.Elapsed() - start) / 1000.0 / BENCH_ROUNDS;
+
+    return res;
+}
+
+int main()
+{
+    const struct { const char *Name; uint8_t StorageSize; } types[] = {
+        { "NTAG213", 0x0F },
+        { "NTAG215", 0x11 },
+        { "NTAG216", 0x13 }
+    };
+
+    printf("Simulated time to read user memory, %u rounds\n", BENCH_ROUNDS);
+    printf("%-8s %6s %12s %8s %12s %8s %8s\n", "Type", "Bytes", "READ ms", "frames", "FAST_READ ms", "frames", "Speedup");
+
+    for (auto& type : types)
+    {
+        BenchResult slow = Run(type.StorageSize, false);
+        BenchResult fast = Run(type.StorageSize, true);
+
+        if (slow.Data != fast.Data)
+            printf("%-8s data mismatch\n", type.Name);
+
+        printf("%-8s %6u %12.2f %8u %12.2f %8u %7.1fx\n", type.Name, (unsigned)fast.Data.size(),
+            slow.Millis, slow.Frames, fast.Millis, fast.Frames, fast.Millis > 0 ? slow.Millis / fast.Millis : 0.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Flash (text + rodata) and static RAM (data + bss) of the library per
+# PN532Config.h feature set. Every source is compiled to an object file with
+# function sections and the sizes are summed, an upper bound of what a linker
+# with --gc-sections keeps.
+#
+# Host (Linux) build:
+#   ./footprint.sh
+# ESP32 build with the Arduino core toolchain, includes of the core in CXXFLAGS:
+#   CXX=xtensa-esp32-elf-g++ SIZE=xtensa-esp32-elf-size \
+#   CXXFLAGS="-DARDUINO -DESP32 -mlongcalls -I<core>/cores/esp32 ..." ./footprint.sh
+
+CXX=${CXX:-g++}
+SIZE=${SIZE:-size}
+SRC=$(cd "$(dirname "$0")/../../src" && pwd)
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+TOOLS_OFF="-DPN532_CONFIG_SIMULATOR=0 -DPN532_CONFIG_TRACE=0"
+
+# Flags disabling all card drivers except the given ones
+drivers()
+{
+    for d in DESFIRE MIFARE_CLASSIC ULTRALIGHT FELICA TYPE_B NDEF ISO_DEP; do
+        case " $* " in
+            *" $d "*) ;;
+            *) printf -- "-DPN532_CONFIG_%s=0 " $d ;;
+        esac
+    done
+}
+
+# Name and flags of each configuration
+run()
+{
+    name=$1
+    shift
+
+    rm -f "$OUT"/*.o
+    for f in "$SRC"/*.cpp; do
+        $CXX -std=gnu++11 -Os -ffunction-sections -fdata-sections $CXXFLAGS "$@" -I"$SRC" \
+            -c "$f" -o "$OUT/$(basename "$f" .cpp).o" || exit 1
+    done
+
+    # Berkeley format: text data bss dec hex filename
+    $SIZE "$OUT"/*.o | awk -v name="$name" '
+        NR > 1 { text += $1; data += $2; bss += $3 }
+        END { printf "%-28s %10d %10d %10d\n", name, text + data, data, data + bss }'
+}
+
+printf "%-28s %10s %10s %10s\n" "configuration" "flash" "data" "static RAM"
+
+run "all features"
+run "no simulator and trace" $TOOLS_OFF
+run "Desfire EV2 (AES only)" $TOOLS_OFF $(drivers DESFIRE) -DPN532_CONFIG_LEGACY_KEYS=0
+run "Desfire EV1 (AES only)" $TOOLS_OFF $(drivers DESFIRE) -DPN532_CONFIG_DESFIRE_EV2=0 -DPN532_CONFIG_LEGACY_KEYS=0
+run "Ultralight and NDEF" $TOOLS_OFF $(drivers ULTRALIGHT NDEF)
+run "UID reader" $TOOLS_OFF $(drivers) -DPN532_CONFIG_STREAM=0 -DPN532_CONFIG_TAG_ADAPTER=0
+run "UID reader, no messages" $TOOLS_OFF $(drivers) -DPN532_CONFIG_STREAM=0 -DPN532_CONFIG_TAG_ADAPTER=0 -DPN532_CONFIG_RESULT_MESSAGES=0
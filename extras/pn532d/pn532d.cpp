@@ -0,0 +1,155 @@
+// Linux daemon serving PN532 readers on serial ports. Publishes TapEvent
+// records (TAP_EVENT_WIRE_SIZE bytes each) on a Unix SOCK_SEQPACKET socket.
+//
+// Build:
+//   g++ -std=gnu++11 -O2 -I../../src pn532d.cpp ../../src/*.cpp -lcrypto -lpthread -o pn532d
+// Usage:
+//   pn532d [-k <AES key hex>] [-p default|fast|long] [-d <ms>] <socket path> <device> [device...]
+// With -k every Desfire card is authenticated with key 0 of the PICC.
+// With -p readers are configured with the given RF profile (see RFProfile.h).
+// With -d a card resting on a reader is reported once until it has been
+// absent for the given time.
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "Desfire.h"
+#include "ReaderDaemon.h"
+
+class AuthenticateHandler : public TapHandler
+{
+public:
+    AuthenticateHandler(const DesfireKey& key) : _key(key) {}
+
+    TagJob* CreateJob(uint8_t reader, TagInterface& tag, const TargetDataTypeA& target)
+    {
+        if (_key.Type == DF_KEY_NONE || PN532Extended::IdentifyTypeACard(target) != CARD_TYPE_MIFARE_DESFIRE)
+            return nullptr;
+
+        _desfire[reader].reset(new Desfire(tag));
+        _jobs[reader].reset(new DesfireAuthenticateJob(*_desfire[reader], 0, _key));
+
+        return _jobs[reader].get();
+    }
+
+    Result FinishJob(uint8_t /* reader */, TagJob* job)
+    {
+        return static_cast<DesfireAuthenticateJob*>(job)->GetResult();
+    }
+
+private:
+    DesfireKey _key;
+    std::unique_ptr<Desfire> _desfire[READER_DAEMON_MAX_READERS];
+    std::unique_ptr<DesfireAuthenticateJob> _jobs[READER_DAEMON_MAX_READERS];
+};
+
+static ReaderDaemon* daemonInstance = nullptr;
+
+static void HandleSignal(int)
+{
+    if (daemonInstance)
+        daemonInstance->Stop();
+}
+
+static bool ParseHex(const char *str, BinaryData& out)
+{
+    size_t len = strlen(str);
+    if (len % 2)
+        return false;
+
+    for (size_t i = 0; i < len; i += 2)
+    {
+        char byte[3] = {str[i], str[i+1], 0};
+        char *end;
+        out.push_back(strtoul(byte, &end, 16));
+        if (*end)
+            return false;
+    }
+
+    return true;
+}
+
+static const RFProfile* ParseProfile(const char *name)
+{
+    if (!strcmp(name, "default"))
+        return &RF_PROFILE_DEFAULT;
+    if (!strcmp(name, "fast"))
+        return &RF_PROFILE_FAST_TURNSTILE;
+    if (!strcmp(name, "long"))
+        return &RF_PROFILE_LONG_RANGE;
+
+    return nullptr;
+}
+
+int main(int argc, char **argv)
+{
+    DesfireKey key;
+    const RFProfile* profile = nullptr;
+    uint32_t debounce = 0;
+    int arg = 1;
+
+    while (argc - arg > 1 && argv[arg][0] == '-')
+    {
+        if (!strcmp(argv[arg], "-k"))
+        {
+            BinaryData keyData;
+            if (!ParseHex(argv[arg + 1], keyData) || keyData.size() != 16)
+            {
+                fprintf(stderr, "Key must be 16 bytes in hex\n");
+                return 1;
+            }
+
+            key = DesfireKey(keyData, DF_KEY_AES);
+        }
+        else if (!strcmp(argv[arg], "-p"))
+        {
+            profile = ParseProfile(argv[arg + 1]);
+            if (!profile)
+            {
+                fprintf(stderr, "Unknown RF profile %s\n", argv[arg + 1]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[arg], "-d"))
+            debounce = strtoul(argv[arg + 1], nullptr, 10);
+        else
+            break;
+
+        arg += 2;
+    }
+
+    if (argc - arg < 2)
+    {
+        fprintf(stderr, "Usage: %s [-k <AES key hex>] [-p default|fast|long] [-d <ms>] <socket path> <device> [device...]\n", argv[0]);
+        return 1;
+    }
+
+    AuthenticateHandler handler(key);
+    ReaderDaemon daemon(handler);
+    daemon.Profile = profile;
+    daemon.DebounceMillis = debounce;
+
+    if (!daemon.Listen(argv[arg]))
+    {
+        perror("Listen");
+        return 1;
+    }
+
+    for (int i = arg + 1; i < argc; ++i)
+    {
+        if (daemon.AddReader(argv[i]) < 0)
+            fprintf(stderr, "Failed to initialize reader %s\n", argv[i]);
+    }
+
+    daemonInstance = &daemon;
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    daemon.Run();
+
+    printf("Published %u events, dropped %u\n", daemon.PublishedEvents(), daemon.DroppedEvents());
+
+    return 0;
+}
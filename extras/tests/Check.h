@@ -0,0 +1,21 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+// Checks shared by the standalone tests. A failed check is reported and
+// counted, the test continues with the next one.
+
+#include <cstdio>
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+// Prints the summary and returns the exit code of the test
+static inline int CheckResult()
+{
+    printf(failures ? "%d failures\n" : "OK\n", failures);
+
+    return failures ? 1 : 0;
+}
+
+#endif
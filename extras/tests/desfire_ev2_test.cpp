@@ -0,0 +1,77 @@
+// DESFire EV2 authentication: session key derivation against the SV1/SV2
+// example of NXP AN12343, and session state after failed AuthenticateEV2First
+// and AuthenticateEV2NonFirst on PN532Simulator.
+//
+// Build and run on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src desfire_ev2_test.cpp ../../src/*.cpp -lcrypto -lpthread -o desfire_ev2_test && ./desfire_ev2_test
+
+#include <cstdio>
+#include "Check.h"
+#include "Desfire.h"
+#include "PN532Extended.h"
+#include "PN532Simulator.h"
+
+static const DesfireKey masterKey({
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+}, DF_KEY_AES);
+
+static const DesfireKey wrongKey(BinaryData(16, 0x42), DF_KEY_AES);
+
+static void TestKeyDerivation()
+{
+    const DesfireKey key(BinaryData(16, 0x00), DF_KEY_AES);
+    const BinaryData RndA = { 0xB0, 0x4D, 0x07, 0x87, 0xC9, 0x3E, 0xE0, 0xCC, 0x8C, 0xAC, 0xC8, 0xE8, 0x6F, 0x16, 0xC6, 0xFE };
+    const BinaryData RndB = { 0xFA, 0x65, 0x9A, 0xD0, 0xDC, 0xA7, 0x38, 0xDD, 0x65, 0xDC, 0x7D, 0xC3, 0x86, 0x12, 0xAD, 0x81 };
+    const BinaryData encKey = { 0x63, 0xDC, 0x07, 0x28, 0x62, 0x89, 0xA7, 0xA6, 0xC0, 0x33, 0x4C, 0xA3, 0x1C, 0x31, 0x4A, 0x04 };
+    const BinaryData macKey = { 0x77, 0x4F, 0x26, 0x74, 0x3E, 0xCE, 0x6A, 0xF5, 0x03, 0x3B, 0x6A, 0xE8, 0x52, 0x29, 0x46, 0xF6 };
+
+    CHECK(DesfireEV2Session::DeriveKey(key, RndA, RndB, false).Key == encKey);
+    CHECK(DesfireEV2Session::DeriveKey(key, RndA, RndB, true).Key == macKey);
+}
+
+// GetCardUID in full mode needs an active session
+static Result GetCardUID(Desfire& desfire)
+{
+    BinaryData uid;
+    return desfire.TransceiveEV2(DFEV1_INS_GET_CARD_UID, BinaryData(), BinaryData(), uid, DF_COMM_FULL);
+}
+
+static void TestFailedAuthentication(bool first)
+{
+    SimulatedDesfireCard card({0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66}, masterKey);
+    PN532Simulator sim;
+    sim.SetCard(0, &card);
+    PN532Extended nfc(sim);
+
+    TargetListTypeA list;
+    CHECK(nfc.InListPassiveTarget(list, 1) && list.NbTg == 1);
+
+    TagInterface tif = nfc.CreateTagInterface(1);
+    Desfire desfire(tif);
+
+    CHECK(desfire.AuthenticateEV2First(0, masterKey));
+    CHECK(GetCardUID(desfire));
+
+    if (first)
+        CHECK(!desfire.AuthenticateEV2First(0, wrongKey));
+    else
+        CHECK(!desfire.AuthenticateEV2NonFirst(0, wrongKey));
+
+    // Session of the previous authentication must not be used any more
+    CHECK(GetCardUID(desfire) == Result::Library(RESULT_ERROR_NOT_AUTHENTICATED));
+    CHECK(!desfire.AuthenticateEV2NonFirst(0, masterKey));
+
+    // Card can be authenticated again
+    CHECK(desfire.AuthenticateEV2First(0, masterKey));
+    CHECK(GetCardUID(desfire));
+}
+
+int main()
+{
+    TestKeyDerivation();
+    TestFailedAuthentication(true);
+    TestFailedAuthentication(false);
+
+    return CheckResult();
+}
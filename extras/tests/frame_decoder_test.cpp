@@ -0,0 +1,76 @@
+// Encodes frames of every length class with PN532EncodeFrame and checks that
+// PN532FrameDecoder returns the same data: normal frames, the normal frame
+// with LEN 0xFF (LCS 0x01, shares its first byte with NACK and extended
+// frames) and extended frames. ACK and NACK frames are decoded as well.
+//
+// Build and run on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src frame_decoder_test.cpp ../../src/PN532Frame.cpp -o frame_decoder_test && ./frame_decoder_test
+
+#include <cstdio>
+#include "Check.h"
+#include "PN532Frame.h"
+
+// Feeds bytes and returns the last event which is not EVENT_NONE
+static PN532FrameDecoder::Event_t FeedAll(PN532FrameDecoder& decoder, const uint8_t* data, uint16_t size)
+{
+    PN532FrameDecoder::Event_t last = PN532FrameDecoder::EVENT_NONE;
+
+    for (uint16_t i = 0; i < size; ++i)
+    {
+        PN532FrameDecoder::Event_t event = decoder.Feed(data[i]);
+        if (event != PN532FrameDecoder::EVENT_NONE)
+            last = event;
+    }
+
+    return last;
+}
+
+static void RoundTrip(uint16_t len)
+{
+    uint8_t buf[PN532_FRAME_HEADROOM + PN532_MAX_EXTENDED_PACKET_SIZE + PN532_FRAME_TAILROOM];
+    for (uint16_t i = 0; i < len; ++i)
+        buf[PN532_FRAME_HEADROOM + i] = i * 13 + 1;
+
+    uint16_t size;
+    uint8_t* frame = PN532EncodeFrame(buf, len, size, PN532_FRAME_DIR_TO_HOST);
+
+    PN532FrameDecoder decoder;
+    PN532FrameDecoder::Event_t event = FeedAll(decoder, frame, size);
+
+    if (event != PN532FrameDecoder::EVENT_FRAME || decoder.Frame().Size != len)
+    {
+        printf("FAIL round trip of %u bytes: event %u, size %u\n", len, event, (unsigned)decoder.Frame().Size);
+        failures++;
+        return;
+    }
+
+    for (uint16_t i = 0; i < len; ++i)
+    {
+        if (decoder.Frame()[i] != (uint8_t)(i * 13 + 1))
+        {
+            printf("FAIL round trip of %u bytes: data differs at %u\n", len, i);
+            failures++;
+            return;
+        }
+    }
+}
+
+int main()
+{
+    // 254 data bytes give LEN 0xFF and LCS 0x01
+    const uint16_t lengths[] = { 1, 2, 100, 253, 254, 255, 256, PN532_MAX_EXTENDED_PACKET_SIZE - 1 };
+    for (uint16_t len : lengths)
+        RoundTrip(len);
+
+    const uint8_t ack[] = PN532_ACK_FRAME;
+    const uint8_t nack[] = PN532_NACK_FRAME;
+    PN532FrameDecoder decoder;
+    CHECK(FeedAll(decoder, ack, sizeof(ack)) == PN532FrameDecoder::EVENT_ACK);
+    CHECK(FeedAll(decoder, nack, sizeof(nack)) == PN532FrameDecoder::EVENT_NACK);
+
+    // Broken LCS after LEN 0xFF is still rejected
+    const uint8_t broken[] = { 0x00, 0x00, 0xFF, 0xFF, 0x02, 0xD5 };
+    CHECK(FeedAll(decoder, broken, sizeof(broken)) == PN532FrameDecoder::EVENT_INVALID);
+
+    return CheckResult();
+}
@@ -0,0 +1,53 @@
+// Feeds NdefParser with valid and malformed messages. A record claiming a
+// payload of 0xFFFFFFFF bytes in a short buffer must be rejected (or wait
+// for more data when the message end is unknown) and never wrap around, also
+// with a 32-bit size_t (build with -m32 to check).
+//
+// Build and run on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src ndef_parser_test.cpp ../../src/Ndef.cpp -o ndef_parser_test && ./ndef_parser_test
+
+#include <cstdio>
+#include "Check.h"
+#include "Ndef.h"
+
+static NdefStatus_t Parse(const BinaryData& data, NdefContainer_t container, NdefRecord& record)
+{
+    NdefParser parser(container);
+    parser.Update(BinaryView(data));
+
+    return parser.Next(record);
+}
+
+int main()
+{
+    NdefRecord record;
+
+    // Short record: well known type "U", payload 0x04 "ab"
+    const BinaryData uri = { 0xD1, 0x01, 0x03, 'U', 0x04, 'a', 'b' };
+    CHECK(Parse(uri, NDEF_CONTAINER_NONE, record) == NDEF_OK);
+    CHECK(record.Payload.Size == 3 && record.Type.Size == 1 && record.Type[0] == 'U');
+
+    // Long record header with payload length 0xFFFFFFFF and a few bytes only
+    const BinaryData huge = { 0xC1, 0x01, 0xFF, 0xFF, 0xFF, 0xFF, 'U', 0x04, 'a' };
+
+    // Message end is known from the container, so the record is invalid
+    BinaryData nlen = { 0x00, (uint8_t)huge.size() };
+    nlen.insert(nlen.end(), huge.begin(), huge.end());
+    CHECK(Parse(nlen, NDEF_CONTAINER_NLEN, record) == NDEF_INVALID);
+
+    BinaryData tlv = { 0x03, (uint8_t)huge.size() };
+    tlv.insert(tlv.end(), huge.begin(), huge.end());
+    tlv.push_back(0xFE);
+    CHECK(Parse(tlv, NDEF_CONTAINER_TLV, record) == NDEF_INVALID);
+
+    // Raw message has no known end. It can never be complete, but must not be returned
+    NdefStatus_t status = Parse(huge, NDEF_CONTAINER_NONE, record);
+    CHECK(status == NDEF_INVALID || status == NDEF_NEED_MORE);
+
+    // Same with type and ID lengths adding up beyond 32 bits
+    const BinaryData withId = { 0xC9, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 'U' };
+    status = Parse(withId, NDEF_CONTAINER_NONE, record);
+    CHECK(status == NDEF_INVALID || status == NDEF_NEED_MORE);
+
+    return CheckResult();
+}
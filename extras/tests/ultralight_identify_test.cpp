@@ -0,0 +1,92 @@
+// Identifies plain Ultralight and NTAG215 on PN532Simulator. A plain
+// Ultralight answers GET_VERSION with NAK and falls back to idle state, so
+// the tag is only usable afterwards if it was activated again. Checks
+// Ultralight::Identify, ReadUserMemory without prior Identify and
+// CardIdentifier::Identify.
+//
+// Build and run on Linux:
+//   g++ -std=gnu++11 -O2 -I../../src ultralight_identify_test.cpp ../../src/*.cpp -lcrypto -lpthread -o ultralight_identify_test && ./ultralight_identify_test
+
+#include <cstdio>
+#include "Check.h"
+#include "CardIdentifier.h"
+#include "PN532Extended.h"
+#include "PN532Simulator.h"
+#include "Ultralight.h"
+
+static const BinaryData uid = {0x04, 0x51, 0x2A, 0x7B, 0x1C, 0x3D, 0x80};
+
+static bool Activate(PN532Extended& nfc, TargetListTypeA& list)
+{
+    return nfc.InListPassiveTarget(list, 1) && list.NbTg == 1;
+}
+
+static void TestUltralight(uint8_t storageSize, UltralightType_t type, uint16_t userPages)
+{
+    SimulatedNtagCard card(uid, storageSize);
+    PN532Simulator sim;
+    sim.SetCard(0, &card);
+    PN532Extended nfc(sim);
+
+    TargetListTypeA list;
+    CHECK(Activate(nfc, list));
+
+    // UID is read from page 0
+    TagInterface tif = nfc.CreateTagInterface(list.Targets[0].Tg);
+    Ultralight tag(tif);
+    CHECK(tag.Identify());
+    CHECK(tag.Type() == type);
+    CHECK(tag.UserPages() == userPages);
+
+    BinaryData data;
+    CHECK(tag.Read(ULTRALIGHT_USER_PAGE, data));
+
+    // ReadUserMemory identifies the tag itself
+    CHECK(Activate(nfc, list));
+    TagInterface tif2 = nfc.CreateTagInterface(list.Targets[0].Tg);
+    Ultralight tag2(tif2);
+    data.clear();
+    CHECK(tag2.ReadUserMemory(data));
+    CHECK(data.size() >= (size_t)userPages * ULTRALIGHT_PAGE_SIZE);
+    if (data.size() >= ULTRALIGHT_PAGE_SIZE)
+        CHECK(data[0] == card.Memory[ULTRALIGHT_USER_PAGE * ULTRALIGHT_PAGE_SIZE]);
+
+    // Card which has left the field is reported
+    CHECK(Activate(nfc, list));
+    TagInterface tif3 = nfc.CreateTagInterface(list.Targets[0].Tg);
+    Ultralight tag3(tif3);
+    sim.SetCard(0, nullptr);
+    CHECK(!tag3.Identify(uid));
+}
+
+static void TestCardIdentifier(uint8_t storageSize, CardType_t type)
+{
+    SimulatedNtagCard card(uid, storageSize);
+    PN532Simulator sim;
+    sim.SetCard(0, &card);
+    PN532Extended nfc(sim);
+
+    TargetListTypeA list;
+    CHECK(Activate(nfc, list));
+
+    CardIdentifier identifier;
+    TagInterface tif = nfc.CreateTagInterface(list.Targets[0].Tg);
+    CardType_t identified;
+    CHECK(identifier.Identify(list.Targets[0], tif, identified));
+    CHECK(identified == type);
+
+    // Tag still answers after identification
+    Ultralight tag(tif);
+    BinaryData data;
+    CHECK(tag.Read(ULTRALIGHT_USER_PAGE, data));
+}
+
+int main()
+{
+    TestUltralight(0, ULTRALIGHT_TYPE_ULTRALIGHT, 12);
+    TestUltralight(0x11, ULTRALIGHT_TYPE_NTAG215, 126);
+    TestCardIdentifier(0, CARD_TYPE_MIFARE_ULTRALIGHT);
+    TestCardIdentifier(0x11, CARD_TYPE_NTAG215);
+
+    return CheckResult();
+}
@@ -7,6 +7,54 @@
 
 typedef std::vector<uint8_t> BinaryData;
 
+// Non-owning view into binary data. Used to pass received payloads without copying
+struct BinaryView
+{
+    BinaryView(): Data(nullptr), Size(0) {}
+    BinaryView(const uint8_t* data, size_t size): Data(data), Size(size) {}
+    BinaryView(const BinaryData& data): Data(data.data()), Size(data.size()) {}
+
+    const uint8_t& operator[](size_t i) const
+    {
+        return Data[i];
+    }
+
+    const uint8_t* begin() const
+    {
+        return Data;
+    }
+
+    const uint8_t* end() const
+    {
+        return Data + Size;
+    }
+
+    bool Empty() const
+    {
+        return Size == 0;
+    }
+
+    // Returns view of [offset, offset+size), clamped to available data
+    BinaryView Sub(size_t offset, size_t size = SIZE_MAX) const
+    {
+        if (offset > Size)
+            return BinaryView();
+
+        if (size > Size - offset)
+            size = Size - offset;
+
+        return BinaryView(Data + offset, size);
+    }
+
+    BinaryData ToBinary() const
+    {
+        return BinaryData(begin(), end());
+    }
+
+    const uint8_t* Data;
+    size_t Size;
+};
+
 class ByteBuffer
 {
 public:
@@ -108,9 +156,17 @@ public:
         return vec.size()-pointer;
     }
 
+    // Keeps allocated capacity, so cleared buffers can be reused without allocations
     void Clear()
     {
         vec.clear();
+        pointer = 0;
+    }
+
+    // Restarts reading from the beginning
+    void Rewind()
+    {
+        pointer = 0;
     }
     
     size_t pointer;
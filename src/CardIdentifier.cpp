@@ -0,0 +1,388 @@
+#include "CardIdentifier.h"
+#include "Desfire.h"
+#include "Ultralight.h"
+#include "Utils.h"
+#include <cstring>
+
+// Activation data of a card family. ATQA is SENS_RES as sent by PN532
+// (ATQA[0] << 8 | ATQA[1]), the mask drops UID size bits where a family
+// exists with 4 and 7 byte UIDs.
+struct CardSignature
+{
+    uint8_t SAK;
+    uint16_t ATQA;
+    uint16_t ATQAMask;
+    CardType_t Type;
+    uint8_t Refine;
+};
+
+// Sorted by SAK, first match wins within a SAK
+static constexpr CardSignature signatures[] = {
+    { 0x00, 0x0044, 0xFFFF, CARD_TYPE_MIFARE_ULTRALIGHT,      CARD_REFINE_UL_VERSION },
+    { 0x01, 0x0004, 0xFF3F, CARD_TYPE_MIFARE_CLASSIC_1K,      CARD_REFINE_NONE },    // Infineon
+    { 0x08, 0x0004, 0xFF3F, CARD_TYPE_MIFARE_CLASSIC_1K,      CARD_REFINE_NONE },    // Also Plus 2K in SL1
+    { 0x09, 0x0004, 0xFF3F, CARD_TYPE_MIFARE_MINI,            CARD_REFINE_NONE },
+    { 0x10, 0x0004, 0xFF3F, CARD_TYPE_MIFARE_PLUS_2K_SL2,     CARD_REFINE_NONE },
+    { 0x11, 0x0002, 0xFF3F, CARD_TYPE_MIFARE_PLUS_4K_SL2,     CARD_REFINE_NONE },
+    { 0x18, 0x0002, 0xFF3F, CARD_TYPE_MIFARE_CLASSIC_4K,      CARD_REFINE_NONE },    // Also Plus 4K in SL1
+    { 0x19, 0x0004, 0xFF3F, CARD_TYPE_MIFARE_CLASSIC_2K,      CARD_REFINE_NONE },
+    { 0x20, 0x0344, 0xFFFF, CARD_TYPE_MIFARE_DESFIRE,         CARD_REFINE_ATS | CARD_REFINE_VERSION },
+    { 0x20, 0x0304, 0xFFFF, CARD_TYPE_MIFARE_DESFIRE,         CARD_REFINE_ATS | CARD_REFINE_VERSION },
+    { 0x20, 0x0004, 0xFF3F, CARD_TYPE_MIFARE_PLUS_SL3,        CARD_REFINE_ATS },
+    { 0x20, 0x0002, 0xFF3F, CARD_TYPE_MIFARE_PLUS_SL3,        CARD_REFINE_ATS },
+    { 0x20, 0x0000, 0x0000, CARD_TYPE_ISO14443_4,             CARD_REFINE_ATS },
+    { 0x28, 0x0000, 0x0000, CARD_TYPE_SMARTMX_CLASSIC_1K,     CARD_REFINE_NONE },
+    { 0x38, 0x0000, 0x0000, CARD_TYPE_SMARTMX_CLASSIC_4K,     CARD_REFINE_NONE },
+    { 0x88, 0x0004, 0xFF3F, CARD_TYPE_MIFARE_CLASSIC_1K,      CARD_REFINE_NONE }     // Infineon
+};
+
+#define SIGNATURE_COUNT (sizeof(signatures) / sizeof(signatures[0]))
+
+constexpr bool SignaturesSorted(uint8_t i = 1)
+{
+    return i >= SIGNATURE_COUNT || (signatures[i - 1].SAK <= signatures[i].SAK && SignaturesSorted(i + 1));
+}
+
+static_assert(SignaturesSorted(), "Card signatures must be sorted by SAK");
+
+// Index of first signature with SAK >= sak
+constexpr uint8_t FirstSignature(uint16_t sak, uint8_t i = 0)
+{
+    return i < SIGNATURE_COUNT && signatures[i].SAK < sak ? FirstSignature(sak, i + 1) : i;
+}
+
+// Signatures of SAK s are First[s] to First[s + 1] - 1, built at compile time
+template<uint16_t... I> struct SakIndex
+{
+    static constexpr uint8_t First[sizeof...(I)] = { FirstSignature(I)... };
+};
+
+template<uint16_t... I> constexpr uint8_t SakIndex<I...>::First[sizeof...(I)];
+
+template<uint16_t N, uint16_t... I> struct MakeSakIndex : MakeSakIndex<N - 1, N - 1, I...> {};
+template<uint16_t... I> struct MakeSakIndex<0, I...>
+{
+    typedef SakIndex<I...> Type;
+};
+
+typedef MakeSakIndex<257>::Type sakIndex;
+
+enum HistoricalMatch_t : uint8_t
+{
+    HISTORICAL_EXACT,
+    HISTORICAL_PREFIX,
+    HISTORICAL_CONTAINS
+};
+
+struct HistoricalSignature
+{
+    HistoricalMatch_t Match;
+    uint8_t Length;
+    uint8_t Bytes[4];
+    CardType_t Type;
+    uint8_t Refine;
+};
+
+static constexpr HistoricalSignature historicalSignatures[] = {
+    { HISTORICAL_EXACT,     1, { 0x80 },                    CARD_TYPE_MIFARE_DESFIRE,   CARD_REFINE_VERSION },
+    { HISTORICAL_PREFIX,    2, { 0xC1, 0x05 },              CARD_TYPE_MIFARE_PLUS_SL3,  CARD_REFINE_VERSION },
+    { HISTORICAL_CONTAINS,  4, { 'J', 'C', 'O', 'P' },      CARD_TYPE_JCOP,             CARD_REFINE_NONE }
+};
+
+// GetVersion answers. Value is the hardware major version for ISO14443-4
+// cards and the storage size for Type 2 tags.
+struct VersionSignature
+{
+    uint8_t Refine;
+    uint8_t ProductType;
+    uint8_t Value;
+    uint8_t Mask;
+    CardType_t Type;
+};
+
+static constexpr VersionSignature versionSignatures[] = {
+    { CARD_REFINE_VERSION,      0x01, 0x00, 0xF0, CARD_TYPE_MIFARE_DESFIRE },       // EV0 and EV1
+    { CARD_REFINE_VERSION,      0x01, 0x12, 0xFF, CARD_TYPE_MIFARE_DESFIRE_EV2 },
+    { CARD_REFINE_VERSION,      0x01, 0x22, 0xFF, CARD_TYPE_MIFARE_DESFIRE_EV2 },   // EV2 XL
+    { CARD_REFINE_VERSION,      0x01, 0x33, 0xFF, CARD_TYPE_MIFARE_DESFIRE_EV3 },
+    { CARD_REFINE_VERSION,      0x08, 0x00, 0x00, CARD_TYPE_MIFARE_DESFIRE_LIGHT },
+    { CARD_REFINE_VERSION,      0x02, 0x11, 0xFF, CARD_TYPE_MIFARE_PLUS_EV1 },
+    { CARD_REFINE_VERSION,      0x02, 0x22, 0xFF, CARD_TYPE_MIFARE_PLUS_EV2 },
+    { CARD_REFINE_VERSION,      0x04, 0x00, 0x00, CARD_TYPE_NTAG424_DNA },
+    { CARD_REFINE_UL_VERSION,   0x03, 0x00, 0x00, CARD_TYPE_MIFARE_ULTRALIGHT_EV1 },
+    { CARD_REFINE_UL_VERSION,   0x04, 0x0F, 0xFF, CARD_TYPE_NTAG213 },
+    { CARD_REFINE_UL_VERSION,   0x04, 0x11, 0xFF, CARD_TYPE_NTAG215 },
+    { CARD_REFINE_UL_VERSION,   0x04, 0x13, 0xFF, CARD_TYPE_NTAG216 },
+    { CARD_REFINE_UL_VERSION,   0x04, 0x00, 0x00, CARD_TYPE_NTAG }
+};
+
+static const char* const names[] = {
+    "MIFARE Mini",
+    "MIFARE Classic 1K",
+    "MIFARE Classic 4K",
+    "MIFARE Ultralight",
+    "MIFARE DESFire",
+    "MIFARE Classic 2K",
+    "MIFARE Plus 2K SL2",
+    "MIFARE Plus 4K SL2",
+    "MIFARE Plus SL3",
+    "MIFARE Plus EV1",
+    "MIFARE Plus EV2",
+    "MIFARE Ultralight EV1",
+    "NTAG213",
+    "NTAG215",
+    "NTAG216",
+    "NTAG",
+    "NTAG 424 DNA",
+    "MIFARE DESFire EV2",
+    "MIFARE DESFire EV3",
+    "MIFARE DESFire Light",
+    "SmartMX Classic 1K",
+    "SmartMX Classic 4K",
+    "JCOP",
+    "ISO14443-4"
+};
+
+static_assert(sizeof(names) / sizeof(names[0]) == CARD_TYPE_MAX, "Card type names out of sync");
+
+static bool MatchHistorical(const HistoricalSignature& sig, const BinaryView& historical)
+{
+    if (historical.Size < sig.Length)
+        return false;
+
+    switch (sig.Match)
+    {
+    case HISTORICAL_EXACT:
+        return historical.Size == sig.Length && !memcmp(historical.Data, sig.Bytes, sig.Length);
+    case HISTORICAL_PREFIX:
+        return !memcmp(historical.Data, sig.Bytes, sig.Length);
+    case HISTORICAL_CONTAINS:
+        for (size_t i = 0; i + sig.Length <= historical.Size; ++i)
+        {
+            if (!memcmp(historical.Data + i, sig.Bytes, sig.Length))
+                return true;
+        }
+        return false;
+    }
+
+    return false;
+}
+
+CardIdentifier::CardIdentifier()
+{
+    Clear();
+}
+
+void CardIdentifier::Clear()
+{
+    for (uint16_t i = 0; i < CARD_IDENTIFIER_CACHE_SIZE; ++i)
+        _entries[i] = Entry();
+
+    _hits = 0;
+    _exchanges = 0;
+}
+
+bool CardIdentifier::DecodeATS(const BinaryData& ats, ATSParameters& params)
+{
+    params.MaxFrameSize = 32;
+    params.DataRates = 0x80;
+    params.FWI = 4;
+    params.SFGI = 0;
+    params.NAD = false;
+    params.CID = true;
+    params.Historical = BinaryView();
+
+    if (ats.empty())
+        return false;
+
+    uint8_t t0 = ats[0];
+    params.MaxFrameSize = FrameSizeFromIndex(t0 & 0x0F);
+
+    // Interface bytes TA(1), TB(1) and TC(1) are announced by T0
+    size_t i = 1;
+    if (t0 & 0x10)
+    {
+        if (i >= ats.size())
+            return false;
+        params.DataRates = ats[i++];
+    }
+    if (t0 & 0x20)
+    {
+        if (i >= ats.size())
+            return false;
+        params.FWI = ats[i] >> 4;
+        params.SFGI = ats[i++] & 0x0F;
+    }
+    if (t0 & 0x40)
+    {
+        if (i >= ats.size())
+            return false;
+        params.NAD = ats[i] & 0x01;
+        params.CID = ats[i++] & 0x02;
+    }
+
+    params.Historical = BinaryView(ats).Sub(i);
+
+    return true;
+}
+
+CardType_t CardIdentifier::Identify(const TargetDataTypeA& target, uint8_t* refine)
+{
+    uint16_t atqa = (target.ATQA[0] << 8) | target.ATQA[1];
+    const CardSignature* match = nullptr;
+
+    for (uint8_t i = sakIndex::First[target.SAK]; i < sakIndex::First[target.SAK + 1]; ++i)
+    {
+        if ((atqa & signatures[i].ATQAMask) == signatures[i].ATQA)
+        {
+            match = &signatures[i];
+            break;
+        }
+    }
+
+    if (refine)
+        *refine = CARD_REFINE_NONE;
+
+    if (!match)
+        return CARD_TYPE_MAX;
+
+    CardType_t type = match->Type;
+    uint8_t next = match->Refine & ~CARD_REFINE_ATS;
+
+    ATSParameters ats;
+    if ((match->Refine & CARD_REFINE_ATS) && DecodeATS(target.ATS, ats))
+    {
+        for (const HistoricalSignature& sig : historicalSignatures)
+        {
+            if (MatchHistorical(sig, ats.Historical))
+            {
+                type = sig.Type;
+                next = sig.Refine;
+                break;
+            }
+        }
+    }
+
+    if (refine)
+        *refine = next;
+
+    return type;
+}
+
+uint32_t CardIdentifier::Hash(const BinaryData& uid)
+{
+    return Fnv1a(uid.data(), uid.size());
+}
+
+CardIdentifier::Entry* CardIdentifier::Find(const TargetDataTypeA& target, bool store)
+{
+    uint32_t slot = Hash(target.UID);
+
+    // Entries are never removed, so an unused slot ends the chain
+    Entry* found = ProbeSlots(_entries, slot, CARD_IDENTIFIER_MAX_PROBE, [&](const Entry& entry) {
+        return !entry.UIDLength || (entry.UIDLength == target.UID.size() && entry.SAK == target.SAK &&
+            !memcmp(entry.UID, target.UID.data(), entry.UIDLength));
+    });
+
+    if (found)
+        return found->UIDLength || store ? found : nullptr;
+
+    // Probe range is full, replace home slot
+    return store ? &_entries[slot & (CARD_IDENTIFIER_CACHE_SIZE - 1)] : nullptr;
+}
+
+Result CardIdentifier::GetVersion(const TargetDataTypeA& target, TagInterface& tag, uint8_t refine, CardType_t& type)
+{
+    uint8_t productType = 0, value = 0;
+
+    _exchanges++;
+
+    if (refine & CARD_REFINE_VERSION)
+    {
+        // Native GetVersion wrapped in ISO7816-4. First frame holds hardware
+        // information, the pending chain is aborted by the next command.
+        tag.BeginWrite() << (uint8_t)0x90 << DF_INS_GET_VERSION << (uint8_t)0x00 << (uint8_t)0x00 << (uint8_t)0x00;
+
+        Result result = tag.EndWrite();
+        if (!result)
+            return result;
+
+        BinaryView response;
+        result = tag.Read(response);
+        if (!result)
+            return result;
+
+        // Vendor, type, subtype, major, minor, storage size, protocol and status word 91 AF
+        if (response.Size != 9 || response[7] != 0x91 || response[8] != DF_STATUS_ADDITIONAL_FRAME)
+            return Result();
+
+        productType = response[1];
+        value = response[3];
+    }
+    else
+    {
+        UltralightVersion version;
+        bool supported;
+        Result result = GetUltralightVersion(tag, target.UID, version, supported);
+        if (!result || !supported)
+            return result;
+
+        productType = version.ProductType;
+        value = version.StorageSize;
+    }
+
+    for (const VersionSignature& sig : versionSignatures)
+    {
+        if (sig.Refine == refine && sig.ProductType == productType && (value & sig.Mask) == sig.Value)
+        {
+            type = sig.Type;
+            break;
+        }
+    }
+
+    return Result();
+}
+
+Result CardIdentifier::Identify(const TargetDataTypeA& target, TagInterface& tag, CardType_t& type)
+{
+    uint8_t refine = CARD_REFINE_NONE;
+    type = Identify(target, &refine);
+
+    if (refine == CARD_REFINE_NONE)
+        return Result();
+
+    // Random single size UIDs start with 0x08 and change on every activation
+    bool cacheable = !target.UID.empty() && target.UID.size() <= CARD_IDENTIFIER_MAX_UID &&
+        !(target.UID.size() == 4 && target.UID[0] == 0x08);
+
+    if (cacheable)
+    {
+        Entry* entry = Find(target, false);
+        if (entry)
+        {
+            type = entry->Type;
+            _hits++;
+            return Result();
+        }
+    }
+
+    Result result = GetVersion(target, tag, refine, type);
+    if (!result)
+        return result;
+
+    if (cacheable)
+    {
+        Entry* entry = Find(target, true);
+        entry->UIDLength = target.UID.size();
+        memcpy(entry->UID, target.UID.data(), entry->UIDLength);
+        entry->SAK = target.SAK;
+        entry->Type = type;
+    }
+
+    return Result();
+}
+
+const char* CardIdentifier::Name(CardType_t type)
+{
+    return type < CARD_TYPE_MAX ? names[type] : "Unknown";
+}
@@ -0,0 +1,93 @@
+#ifndef __CARDIDENTIFIER_H__
+#define __CARDIDENTIFIER_H__
+
+#include <cstdint>
+#include "PN532Extended.h"
+#include "TagInterface.h"
+#include "Result.h"
+
+// Number of cached UIDs, must be a power of two
+#define CARD_IDENTIFIER_CACHE_SIZE 32
+// Slots searched from the home slot
+#define CARD_IDENTIFIER_MAX_PROBE 4
+#define CARD_IDENTIFIER_MAX_UID 10
+
+// Steps which can narrow down a table match
+enum CardRefinement_t : uint8_t
+{
+    CARD_REFINE_NONE        = 0x00,
+    CARD_REFINE_ATS         = 0x01, // Historical bytes of ATS select family
+    CARD_REFINE_VERSION     = 0x02, // ISO14443-4 GetVersion (DESFire, Plus, NTAG 424)
+    CARD_REFINE_UL_VERSION  = 0x04  // Type 2 GET_VERSION (Ultralight EV1, NTAG21x)
+};
+
+// Decoded ATS (ISO14443-4 5.2)
+struct ATSParameters
+{
+    uint16_t MaxFrameSize;          // From FSCI
+    uint8_t DataRates;              // TA(1), 0x80 if not present
+    uint8_t FWI;                    // Frame waiting time integer, TB(1)
+    uint8_t SFGI;                   // Start-up frame guard time integer, TB(1)
+    bool NAD;                       // TC(1) bit 0
+    bool CID;                       // TC(1) bit 1
+    BinaryView Historical;          // Historical bytes, points into ATS
+};
+
+// Type A card identification. Activation data is looked up in a compile time
+// table indexed by SAK, ATQA and ATS historical bytes select the candidate.
+// Only families that share activation data (DESFire generations, NTAG sizes)
+// need a GetVersion exchange, which is cached per UID.
+class CardIdentifier
+{
+public:
+    CardIdentifier();
+
+    // Identifies card from activation data only, never touches RF. Sets
+    // refine to the CardRefinement_t step that could narrow down the result.
+    static CardType_t Identify(const TargetDataTypeA& target, uint8_t* refine = nullptr);
+
+    // Identifies card and refines ambiguous results with GetVersion on tag.
+    // A card which does not answer GET_VERSION (plain Ultralight, Ultralight C)
+    // falls back to idle state and is activated again with its UID (see
+    // TagInterface::Reactivate). Results are cached per UID, random UIDs are
+    // never cached.
+    Result Identify(const TargetDataTypeA& target, TagInterface& tag, CardType_t& type);
+
+    // Splits ATS (without length byte) into interface and historical bytes
+    static bool DecodeATS(const BinaryData& ats, ATSParameters& params);
+
+    // Static name of card type
+    static const char* Name(CardType_t type);
+
+    void Clear();
+
+    uint32_t Hits() const
+    {
+        return _hits;
+    }
+
+    // Number of GetVersion exchanges
+    uint32_t Exchanges() const
+    {
+        return _exchanges;
+    }
+
+private:
+    struct Entry
+    {
+        uint8_t UIDLength;  // 0 - slot never used
+        uint8_t UID[CARD_IDENTIFIER_MAX_UID];
+        uint8_t SAK;
+        CardType_t Type;
+    };
+
+    static uint32_t Hash(const BinaryData& uid);
+    Entry* Find(const TargetDataTypeA& target, bool store);
+    Result GetVersion(const TargetDataTypeA& target, TagInterface& tag, uint8_t refine, CardType_t& type);
+
+    Entry _entries[CARD_IDENTIFIER_CACHE_SIZE];
+    uint32_t _hits;
+    uint32_t _exchanges;
+};
+
+#endif
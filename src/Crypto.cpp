@@ -1,63 +1,314 @@
 #include "Crypto.h"
+#include "Utils.h"
+#include <cstring>
 
-#ifdef ESP32
+#if PN532_CONFIG_CRYPTO == PN532_CRYPTO_ESP_AES
 
-#include "esp_system.h"
+bool AESContext::Init()
+{
+    esp_aes_init(&_ctx);
+    return esp_aes_setkey(&_ctx, _key, _keySize*8) == 0;
+}
+
+void AESContext::Release()
+{
+    esp_aes_free(&_ctx);
+}
+
+void AESContext::Crypt(const uint8_t* in, uint8_t* out, size_t len, uint8_t* iv, bool encrypt)
+{
+    esp_aes_crypt_cbc(&_ctx, encrypt ? ESP_AES_ENCRYPT : ESP_AES_DECRYPT, len, iv, in, out);
+}
+
+#elif PN532_CONFIG_CRYPTO == PN532_CRYPTO_MBEDTLS
+
+bool AESContext::Init()
+{
+    mbedtls_aes_init(&_enc);
+    mbedtls_aes_init(&_dec);
+    _encReady = false;
+    _decReady = false;
+
+    return true;
+}
+
+void AESContext::Release()
+{
+    mbedtls_aes_free(&_enc);
+    mbedtls_aes_free(&_dec);
+}
+
+// Encryption and decryption use different round keys, CMAC only needs encryption
+void AESContext::Crypt(const uint8_t* in, uint8_t* out, size_t len, uint8_t* iv, bool encrypt)
+{
+    if (encrypt && !_encReady)
+        _encReady = mbedtls_aes_setkey_enc(&_enc, _key, _keySize*8) == 0;
+    else if (!encrypt && !_decReady)
+        _decReady = mbedtls_aes_setkey_dec(&_dec, _key, _keySize*8) == 0;
+
+    mbedtls_aes_crypt_cbc(encrypt ? &_enc : &_dec, encrypt ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, len, iv, in, out);
+}
+
+#elif PN532_CONFIG_CRYPTO == PN532_CRYPTO_OPENSSL
+
+// Host builds (i.e. gateways) use OpenSSL libcrypto. Link with -lcrypto
+#include <openssl/evp.h>
+
+static const EVP_CIPHER* AES_ECB_Cipher(size_t keySize)
+{
+    switch (keySize)
+    {
+        case 16: return EVP_aes_128_ecb();
+        case 24: return EVP_aes_192_ecb();
+        case 32: return EVP_aes_256_ecb();
+        default: return nullptr;
+    }
+}
+
+static EVP_CIPHER_CTX* AES_ECB_Context(const uint8_t* key, size_t keySize, bool encrypt)
+{
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (ctx && EVP_CipherInit_ex(ctx, AES_ECB_Cipher(keySize), nullptr, key, nullptr, encrypt) == 1)
+    {
+        EVP_CIPHER_CTX_set_padding(ctx, 0);
+        return ctx;
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+    return nullptr;
+}
+
+bool AESContext::Init()
+{
+    return AES_ECB_Cipher(_keySize) != nullptr;
+}
+
+void AESContext::Release()
+{
+    EVP_CIPHER_CTX_free(_enc);
+    EVP_CIPHER_CTX_free(_dec);
+    _enc = nullptr;
+    _dec = nullptr;
+}
+
+// CBC is chained manually over ECB, so IV is updated in place like esp_aes_crypt_cbc does.
+// ECB without padding outputs every block at once and keeps no state between calls.
+void AESContext::Crypt(const uint8_t* in, uint8_t* out, size_t len, uint8_t* iv, bool encrypt)
+{
+    EVP_CIPHER_CTX*& ctx = encrypt ? _enc : _dec;
+    if (!ctx)
+        ctx = AES_ECB_Context(_key, _keySize, encrypt);
+    if (!ctx)
+        return;
+
+    uint8_t block[16];
+    int outLen;
+
+    for (size_t i = 0; i < len; i += 16)
+    {
+        if (encrypt)
+        {
+            for (uint8_t j = 0; j < 16; ++j)
+                block[j] = in[i+j] ^ iv[j];
+
+            EVP_CipherUpdate(ctx, out + i, &outLen, block, 16);
+            memcpy(iv, out + i, 16);
+        }
+        else
+        {
+            // Input block is the next IV, it is saved first as in and out may overlap
+            memcpy(block, in + i, 16);
+            EVP_CipherUpdate(ctx, out + i, &outLen, block, 16);
+
+            for (uint8_t j = 0; j < 16; ++j)
+                out[i+j] ^= iv[j];
+
+            memcpy(iv, block, 16);
+        }
+    }
+}
 
-#if ESP_IDF_VERSION_MAJOR >= 4
-#include <esp32/aes.h>
-#else
-#include <hwcrypto/aes.h>
 #endif
 
-BinaryData AES_CBC_Decrypt(const BinaryData& data, const BinaryData& key, BinaryData& iv)
+#if PN532_CONFIG_CRYPTO != PN532_CRYPTO_NONE
+
+AESContext::AESContext() : _keySize(0)
+{
+#if PN532_CONFIG_CRYPTO == PN532_CRYPTO_OPENSSL
+    _enc = nullptr;
+    _dec = nullptr;
+#endif
+}
+
+AESContext::AESContext(const AESContext& other) : AESContext()
+{
+    *this = other;
+}
+
+// Schedules may point into their own context, so copies are expanded again
+AESContext& AESContext::operator=(const AESContext& other)
 {
-    esp_aes_context ctx;
-    esp_aes_init(&ctx);
-    esp_aes_setkey(&ctx, key.data(), key.size()*8);
+    if (this == &other)
+        return *this;
+
+    if (other.IsValid())
+        SetKey(BinaryData(other._key, other._key + other._keySize));
+    else
+        Clear();
+
+    return *this;
+}
+
+AESContext::~AESContext()
+{
+    Clear();
+}
+
+bool AESContext::SetKey(const BinaryData& key)
+{
+    Clear();
+
+    if (key.size() != 16 && key.size() != 24 && key.size() != 32)
+        return false;
+
+    memcpy(_key, key.data(), key.size());
+    _keySize = key.size();
+
+    if (!Init())
+    {
+        Clear();
+        return false;
+    }
+
+    return true;
+}
+
+void AESContext::Clear()
+{
+    if (_keySize)
+        Release();
+
+    memset(_key, 0, sizeof(_key));
+    _keySize = 0;
+}
+
+BinaryData AESContext::CBC(const BinaryData& data, BinaryData& iv, bool encrypt)
+{
+    if (!IsValid() || iv.size() != 16 || data.size() % 16)
+        return BinaryData();
 
     // Output size is the same as input size
     BinaryData out(data.size());
+    Crypt(data.data(), out.data(), data.size(), iv.data(), encrypt);
 
-    esp_aes_crypt_cbc(
-        &ctx,
-        ESP_AES_DECRYPT,
-        data.size(),
-        iv.data(),
-        data.data(),
-        out.data()
-    );
+    return out;
+}
 
-    esp_aes_free(&ctx);
+BinaryData AES_CBC_Decrypt(const BinaryData& data, AESContext& ctx, BinaryData& iv)
+{
+    return ctx.CBC(data, iv, false);
+}
 
-    return out;
+BinaryData AES_CBC_Encrypt(const BinaryData& data, AESContext& ctx, BinaryData& iv)
+{
+    return ctx.CBC(data, iv, true);
+}
+
+// Plain key variants expand the key for a single call
+BinaryData AES_CBC_Decrypt(const BinaryData& data, const BinaryData& key, BinaryData& iv)
+{
+    AESContext ctx;
+    ctx.SetKey(key);
+    return ctx.CBC(data, iv, false);
 }
 
 BinaryData AES_CBC_Encrypt(const BinaryData& data, const BinaryData& key, BinaryData& iv)
 {
-    esp_aes_context ctx;
-    esp_aes_init(&ctx);
-    esp_aes_setkey(&ctx, key.data(), key.size()*8);
+    AESContext ctx;
+    ctx.SetKey(key);
+    return ctx.CBC(data, iv, true);
+}
 
-    // Output size is the same as input size
-    BinaryData out(data.size());
+// Left shift of 128 bit block by one bit. Used for CMAC subkey generation
+static BinaryData CMAC_ShiftLeft(const BinaryData& in)
+{
+    BinaryData out(in.size());
 
-    esp_aes_crypt_cbc(
-        &ctx,
-        ESP_AES_ENCRYPT,
-        data.size(),
-        iv.data(),
-        data.data(),
-        out.data()
-    );
+    for (size_t i = 0; i < in.size(); ++i)
+    {
+        out[i] = in[i] << 1;
+        if (i+1 < in.size())
+            out[i] |= in[i+1] >> 7;
+    }
 
-    esp_aes_free(&ctx);
+    // Rb constant for 128 bit block size
+    if (in[0] & 0x80)
+        out[in.size()-1] ^= 0x87;
 
     return out;
 }
 
-#else
+void AES_CMAC_Subkeys(AESContext& ctx, BinaryData& K1, BinaryData& K2)
+{
+    BinaryData IV(16, 0x00);
+
+    // L = AES(K, 0^128)
+    BinaryData L = AES_CBC_Encrypt(BinaryData(16, 0x00), ctx, IV);
+    if (L.empty())
+    {
+        K1.clear();
+        K2.clear();
+        return;
+    }
+
+    K1 = CMAC_ShiftLeft(L);
+    K2 = CMAC_ShiftLeft(K1);
+}
+
+BinaryData AES_CMAC(const BinaryData& data, AESContext& ctx, const BinaryData& K1, const BinaryData& K2)
+{
+    if (K1.size() != 16 || K2.size() != 16)
+        return BinaryData();
+
+    BinaryData buf(data);
+
+    // Complete last block is XORed with K1, padded one with K2
+    const BinaryData* subkey = &K1;
+    if (buf.empty() || buf.size() % 16)
+    {
+        buf.push_back(0x80);
+        PadToBlocksize(buf, 16);
+        subkey = &K2;
+    }
+
+    for (size_t i = 0; i < 16; ++i)
+        buf[buf.size()-16+i] ^= (*subkey)[i];
+
+    BinaryData IV(16, 0x00);
+    BinaryData enc = AES_CBC_Encrypt(buf, ctx, IV);
+    if (enc.empty())
+        return BinaryData();
+
+    // MAC is the last cipher block
+    return BinaryData(enc.end()-16, enc.end());
+}
+
+void AES_CMAC_Subkeys(const BinaryData& key, BinaryData& K1, BinaryData& K2)
+{
+    AESContext ctx;
+    ctx.SetKey(key);
+    AES_CMAC_Subkeys(ctx, K1, K2);
+}
+
+BinaryData AES_CMAC(const BinaryData& data, const BinaryData& key, const BinaryData& K1, const BinaryData& K2)
+{
+    AESContext ctx;
+    ctx.SetKey(key);
+    return AES_CMAC(data, ctx, K1, K2);
+}
+
+#elif PN532_CONFIG_DESFIRE
 
-#warning "Crypto functions only implemented for ESP32"
+#warning "Crypto functions only implemented for ESP32 and Linux, select a backend with PN532_CONFIG_CRYPTO"
 
 #endif
@@ -2,8 +2,76 @@
 #define __CRYPTO_H__
 
 #include "ByteBuffer.h"
+#include "PN532Config.h"
+
+#if PN532_CONFIG_CRYPTO == PN532_CRYPTO_ESP_AES
+#include "esp_system.h"
+#if ESP_IDF_VERSION_MAJOR >= 4
+#include <esp32/aes.h>
+#else
+#include <hwcrypto/aes.h>
+#endif
+#elif PN532_CONFIG_CRYPTO == PN532_CRYPTO_MBEDTLS
+#include "mbedtls/aes.h"
+#elif PN532_CONFIG_CRYPTO == PN532_CRYPTO_OPENSSL
+struct evp_cipher_ctx_st;
+#endif
+
+// AES key expanded once for any number of CBC and CMAC calls. mbedTLS and
+// OpenSSL run the key schedule on every call with a plain key, ESP32 hardware
+// AES only copies the key. Not thread safe, schedules are set up on first use.
+class AESContext
+{
+public:
+    AESContext();
+    AESContext(const AESContext& other);
+    AESContext& operator=(const AESContext& other);
+    ~AESContext();
+
+    // Sets key of 16, 24 or 32 bytes. Fails for other sizes
+    bool SetKey(const BinaryData& key);
+    // Wipes key and schedule
+    void Clear();
+
+    bool IsValid() const
+    {
+        return _keySize != 0;
+    }
+
+    // CBC over whole blocks. IV is updated in place for chaining. Returns empty data on invalid input
+    BinaryData CBC(const BinaryData& data, BinaryData& iv, bool encrypt);
+
+private:
+    // Backend specific parts. mbedTLS and OpenSSL expand each direction on first use
+    bool Init();
+    void Release();
+    void Crypt(const uint8_t* in, uint8_t* out, size_t len, uint8_t* iv, bool encrypt);
+
+    uint8_t _key[32];       // Kept to copy the context
+    uint8_t _keySize;
+#if PN532_CONFIG_CRYPTO == PN532_CRYPTO_ESP_AES
+    esp_aes_context _ctx;   // Used for both directions
+#elif PN532_CONFIG_CRYPTO == PN532_CRYPTO_MBEDTLS
+    mbedtls_aes_context _enc;
+    mbedtls_aes_context _dec;
+    bool _encReady;
+    bool _decReady;
+#elif PN532_CONFIG_CRYPTO == PN532_CRYPTO_OPENSSL
+    evp_cipher_ctx_st* _enc;
+    evp_cipher_ctx_st* _dec;
+#endif
+};
 
 BinaryData AES_CBC_Decrypt(const BinaryData& data, const BinaryData& key, BinaryData& iv);
 BinaryData AES_CBC_Encrypt(const BinaryData& data, const BinaryData& key, BinaryData& iv);
+BinaryData AES_CBC_Decrypt(const BinaryData& data, AESContext& ctx, BinaryData& iv);
+BinaryData AES_CBC_Encrypt(const BinaryData& data, AESContext& ctx, BinaryData& iv);
+
+// NIST SP 800-38B CMAC subkeys. Can be precomputed once per key
+void AES_CMAC_Subkeys(const BinaryData& key, BinaryData& K1, BinaryData& K2);
+void AES_CMAC_Subkeys(AESContext& ctx, BinaryData& K1, BinaryData& K2);
+// CMAC with precomputed subkeys
+BinaryData AES_CMAC(const BinaryData& data, const BinaryData& key, const BinaryData& K1, const BinaryData& K2);
+BinaryData AES_CMAC(const BinaryData& data, AESContext& ctx, const BinaryData& K1, const BinaryData& K2);
 
 #endif
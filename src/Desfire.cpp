@@ -1,7 +1,13 @@
 #include "Desfire.h"
-#include "Exception.h"
+
+#if PN532_CONFIG_DESFIRE
+
 #include "Crypto.h"
 #include "Utils.h"
+#include "Metrics.h"
+#include "Random.h"
+#include <algorithm>
+#include <cstring>
 
 ByteBuffer& operator<<(ByteBuffer& a, const ISO7816_4_CAPDU& b)
 {
@@ -30,7 +36,31 @@ Desfire::Desfire(TagInterface& interface) : _selectedApplication(0), _authentica
 
 }
 
-bool Desfire::Connect()
+Result Desfire::Exchange(BinaryView& data, uint8_t& SW1, uint8_t& SW2)
+{
+    // Send command built with BeginWrite
+    Result result = _interface.EndWrite();
+    if (!result)
+        return result;
+
+    // Receive
+    BinaryView rapdu;
+    result = _interface.Read(rapdu);
+    if (!result)
+        return result;
+
+    // Response must contain status word
+    if (rapdu.Size < 2)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    data = rapdu.Sub(0, rapdu.Size-2);
+    SW1 = rapdu[rapdu.Size-2];
+    SW2 = rapdu[rapdu.Size-1];
+
+    return Result();
+}
+
+Result Desfire::Connect()
 {
     ISO7816_4_CAPDU capdu;
 
@@ -43,80 +73,152 @@ bool Desfire::Connect()
     capdu.Lc = capdu.Data.size();
     capdu.Le = 0x00;
 
-    ByteBuffer buf;
-    buf << capdu;
+    _interface.BeginWrite() << capdu;
 
-    // Send
-    if (_interface.Write(buf.Data()))
-        return false;
+    BinaryView data;
+    uint8_t SW1, SW2;
+    Result result = Exchange(data, SW1, SW2);
+    if (!result)
+        return result;
 
-    // Reuse buffer
-    buf.Clear();
+    return Result::ISO7816(SW1, SW2);
+}
 
-    // Receive
-    if (_interface.Read(buf.Data()) < 0)
-        return false;
+void Desfire::SerializeCommand(ByteBuffer& buf, const DesfireInstruction_t ins, const BinaryData& in)
+{
+    // Desfire instructions are wrapped in custom ISO7816-4 command class
+    buf << (uint8_t)0x90;       // CLA
+    buf << ins;                 // INS
+    buf << (uint8_t)0x00;       // P1
+    buf << (uint8_t)0x00;       // P2
+    buf << (uint8_t)in.size();  // Lc
+    buf << in;                  // Data
+    buf << (uint8_t)0x00;       // Le
+}
 
-    ISO7816_4_RAPDU rapdu;
-    buf >> rapdu;
+Result Desfire::ParseResponse(const BinaryView& rapdu, BinaryView& data)
+{
+    // Response must contain status word
+    if (rapdu.Size < 2)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
 
-    if (rapdu.SW1 == 0x90 && rapdu.SW2 == 0x00)
-        return true;
-    
-    return false;
+    data = rapdu.Sub(0, rapdu.Size-2);
+
+    // Desfire error codes (DesfireStatus_t) are sent in SW2 variable
+    DesfireStatus_t status = (DesfireStatus_t)rapdu[rapdu.Size-1];
+
+    if (status == DF_STATUS_OPERATION_OK || status == DF_STATUS_ADDITIONAL_FRAME)
+        return Result();
+
+    return Result(RESULT_ORIGIN_DESFIRE, status);
 }
 
-bool Desfire::Transceive(const DesfireInstruction_t ins, const BinaryData& in, BinaryData& out)
+Result Desfire::Transceive(const DesfireInstruction_t ins, const BinaryData& in, BinaryData& out)
 {
-    ISO7816_4_CAPDU capdu;
+    METRICS_SCOPE_KEYED(Instructions, ins);
 
-    // Desfire instructions are wrapped in custom ISO7816-4 command class
-    capdu.CLA = 0x90;
-    capdu.INS = ins;
-    capdu.P1 = 0x00;
-    capdu.P2 = 0x00;
-    capdu.Data = in;
-    capdu.Lc = capdu.Data.size();
-    capdu.Le = 0x00;
-
-    ByteBuffer buf;
-    buf << capdu;
+    // APDU is serialized directly into transmit buffer to avoid copying data
+    SerializeCommand(_interface.BeginWrite(), ins, in);
 
     // Send
-    if (_interface.Write(buf.Data()))
-        return false;
-
-    // Reuse buffer
-    buf.Clear();
+    Result result = _interface.EndWrite();
+    if (!result)
+        return result;
 
     // Receive
-    if (_interface.Read(buf.Data()) < 0)
-        return false;
+    BinaryView rapdu;
+    result = _interface.Read(rapdu);
+    if (!result)
+        return result;
 
-    // Deserialize received packet
-    ISO7816_4_RAPDU rapdu;
-    buf >> rapdu;
+    if (rapdu.Size >= 2)
+        METRICS_COUNT(DesfireStatus[rapdu[rapdu.Size-1]], 1);
 
-    // Desfire error codes (DesfireStatus_t) are sent in SW2 variable
-    _lastError = (DesfireStatus_t)rapdu.SW2;
+    BinaryView data;
+    result = ParseResponse(rapdu, data);
+    if (!result)
+        return result;
+
+    out.assign(data.begin(), data.end());
+
+    return Result();
+}
+
+Result Desfire::SelectApplication(uint32_t aid)
+{
+    // AID is sent LSB first
+    ByteBuffer args;
+    args.Append<uint8_t>(aid);
+    args.Append<uint8_t>(aid >> 8);
+    args.Append<uint8_t>(aid >> 16);
 
-    if (_lastError == DF_STATUS_OPERATION_OK || _lastError == DF_STATUS_ADDITIONAL_FRAME)
+    BinaryData resp;
+    Result result = Transceive(DF_INS_SELECT_APPLICATION, args.Data(), resp);
+    if (!result)
+        return result;
+
+    // Selecting application drops authentication
+    _selectedApplication = aid & 0xFFFFFF;
+    _authenticatedKeyNo = -1;
+#if PN532_CONFIG_DESFIRE_EV2
+    _ev2.Clear();
+#endif
+
+    return Result();
+}
+
+Result Desfire::ReadData(uint8_t fileNo, uint32_t offset, uint32_t length, BinaryData& out)
+{
+    METRICS_SCOPE_KEYED(Instructions, DF_INS_READ_DATA);
+
+    // Offset and length are sent LSB first
+    ByteBuffer args;
+    args << fileNo;
+    args.Append<uint8_t>(offset);
+    args.Append<uint8_t>(offset >> 8);
+    args.Append<uint8_t>(offset >> 16);
+    args.Append<uint8_t>(length);
+    args.Append<uint8_t>(length >> 8);
+    args.Append<uint8_t>(length >> 16);
+
+    out.clear();
+    out.reserve(length);
+
+    SerializeCommand(_interface.BeginWrite(), DF_INS_READ_DATA, args.Data());
+
+    for (;;)
     {
-        out = rapdu.Data;
-        return true;
-    }
+        BinaryView data;
+        uint8_t SW1, SW2;
+        Result result = Exchange(data, SW1, SW2);
+        if (!result)
+            return result;
 
-    return false;
+        if (SW1 != 0x91)
+            return Result::ISO7816(SW1, SW2);
+
+        if (SW2 != DF_STATUS_OPERATION_OK && SW2 != DF_STATUS_ADDITIONAL_FRAME)
+            return Result(RESULT_ORIGIN_DESFIRE, SW2);
+
+        out.insert(out.end(), data.begin(), data.end());
+
+        if (SW2 == DF_STATUS_OPERATION_OK)
+            return Result();
+
+        SerializeCommand(_interface.BeginWrite(), DF_INS_ADDITIONAL_FRAME, BinaryData());
+    }
 }
 
 DesfireInstruction_t Desfire::GetAuthCmd(const DesfireKeyType_t& type)
 {
     switch (type) {
+#if PN532_CONFIG_LEGACY_KEYS
         case DF_KEY_DES:
         case DF_KEY_3DES:
             return DF_INS_AUTHENTICATE_LEGACY;
         case DF_KEY_3K3DES:
             return DFEV1_INS_AUTHENTICATE_ISO;
+#endif
         case DF_KEY_AES:
             return DFEV1_INS_AUTHENTICATE_AES;
         default:
@@ -124,11 +226,18 @@ DesfireInstruction_t Desfire::GetAuthCmd(const DesfireKeyType_t& type)
     }
 }
 
-bool Desfire::Authenticate(const uint8_t keyno, const DesfireKey& key)
+Result Desfire::Authenticate(const uint8_t keyno, const DesfireKey& key)
+{
+    return Authenticate(keyno, key, nullptr);
+}
+
+Result Desfire::Authenticate(const uint8_t keyno, const DesfireKey& key, AESContext* context)
 {
     // Currently only AES is supported
     if (key.Type != DF_KEY_AES)
-        return false;
+        return Result::Library(RESULT_ERROR_UNSUPPORTED);
+
+    DesfireAESAuthentication auth(keyno, key, context);
 
     // Get Desfire instruction based on key type
     DesfireInstruction_t cmd = GetAuthCmd(key.Type);
@@ -137,82 +246,253 @@ bool Desfire::Authenticate(const uint8_t keyno, const DesfireKey& key)
 
     // Transceive data. Card returns encrypted RndB value (randomly generated)
     BinaryData RndBEnc;
-    if (!Transceive(cmd, args.Data(), RndBEnc))
-        return false;
+    Result result = Transceive(cmd, args.Data(), RndBEnc);
+    if (!result)
+        return result;
 
-    // Size should be 16 bytes
-    if (RndBEnc.size() != 16)
-        return false;
+    BinaryData token;
+    result = auth.Challenge(RndBEnc, token);
+    if (!result)
+        return result;
 
-    // Start off with zero IV. RndB is always a random value so this shouldn't be a security problem
-    BinaryData IV(16, 0x00);
+    BinaryData RndARotEnc;
+    result = Transceive(DF_INS_ADDITIONAL_FRAME, token, RndARotEnc);
+    if (!result)
+        return result;
 
-    // Decrypt RndB
-    BinaryData RndB = AES_CBC_Decrypt(RndBEnc, key.Key, IV);
+    result = auth.Verify(RndARotEnc);
+    if (!result)
+        return result;
 
-    // Rotate RndB
-    BinaryData RndBRot;
-    RndBRot.assign(RndB.begin()+1, RndB.end());
-    RndBRot.push_back(RndB[0]);
+    SetSession(keyno, auth.SessionKey);
 
-    // Generate a random 16 byte value RndA
-    BinaryData RndA;
-    for (int i = 0; i < 16; ++i)
-        RndA.push_back(rand() % 0xFF);
+    return Result();
+}
 
-    // Build authentication token
-    ByteBuffer Token;
-    Token << RndA;
-    Token << RndBRot;
-    
-    // Encrypt token and use RndBEnc as IV
-    BinaryData TokenEnc = AES_CBC_Encrypt(Token.Data(), key.Key, IV);
-    
-    BinaryData RndARotEnc;
-    if (!Transceive(DF_INS_ADDITIONAL_FRAME, TokenEnc, RndARotEnc))
-        return false;
+void Desfire::SetSession(const uint8_t keyno, const DesfireKey& sessionKey)
+{
+    _authenticatedKeyNo = keyno;
+    _sessionKey = sessionKey;
+    _sessionKeyIV = BinaryData(_sessionKey.Key.size(), 0x00);
+#if PN532_CONFIG_DESFIRE_EV2
+    _ev2.Clear();
+#endif
+}
 
-    // Decrypt RndARot
-    BinaryData RndARot = AES_CBC_Decrypt(RndARotEnc, key.Key, IV);
+#if PN532_CONFIG_DESFIRE_EV2
+Result Desfire::AuthenticateEV2First(const uint8_t keyno, const DesfireKey& key)
+{
+    if (key.Type != DF_KEY_AES)
+        return Result::Library(RESULT_ERROR_UNSUPPORTED);
 
-    // Calculate a local RndARot value
-    BinaryData RndARotLocal;
-    RndARotLocal.assign(RndA.begin()+1, RndA.end());
-    RndARotLocal.push_back(RndA[0]);
+    DesfireEV2Authentication auth(keyno, key, true);
 
-    // Check if final values match
-    if (RndARotLocal == RndARot)
+    // Card drops the previous authentication with the first frame, even if
+    // the new one fails
+    _authenticatedKeyNo = -1;
+    _ev2.Clear();
+
+    // Key number and no PCD capabilities
+    BinaryData args = { keyno, 0x00 };
+
+    BinaryData RndBEnc;
+    Result result = Transceive(DFEV2_INS_AUTHENTICATE_EV2_FIRST, args, RndBEnc);
+    if (!result)
+        return result;
+
+    BinaryData token;
+    result = auth.Challenge(RndBEnc, token);
+    if (!result)
+        return result;
+
+    BinaryData response;
+    result = Transceive(DF_INS_ADDITIONAL_FRAME, token, response);
+    if (!result)
+        return result;
+
+    result = auth.Verify(response, _ev2);
+    if (!result)
+        return result;
+
+    _authenticatedKeyNo = keyno;
+    _sessionKey = _ev2.EncKey;
+
+    return Result();
+}
+
+Result Desfire::AuthenticateEV2NonFirst(const uint8_t keyno, const DesfireKey& key)
+{
+    if (key.Type != DF_KEY_AES)
+        return Result::Library(RESULT_ERROR_UNSUPPORTED);
+
+    if (!_ev2.Active())
+        return Result::Library(RESULT_ERROR_NOT_AUTHENTICATED);
+
+    DesfireEV2Authentication auth(keyno, key, false);
+
+    // Session (TI and counter) is needed by Verify, so it is only dropped on failure
+    _authenticatedKeyNo = -1;
+
+    BinaryData args(1, keyno);
+    BinaryData RndBEnc, token, response;
+
+    Result result = Transceive(DFEV2_INS_AUTHENTICATE_EV2_NONFIRST, args, RndBEnc);
+    if (result)
+        result = auth.Challenge(RndBEnc, token);
+    if (result)
+        result = Transceive(DF_INS_ADDITIONAL_FRAME, token, response);
+    if (result)
+        result = auth.Verify(response, _ev2);
+
+    // Card drops the session on any failure
+    if (!result)
+    {
+        _ev2.Clear();
+        return result;
+    }
+
+    _authenticatedKeyNo = keyno;
+    _sessionKey = _ev2.EncKey;
+
+    return Result();
+}
+
+Result Desfire::TransceiveEV2(const DesfireInstruction_t ins, const BinaryData& header, const BinaryData& in, BinaryData& out, DesfireCommMode_t mode)
+{
+    if (!_ev2.Active())
+        return Result::Library(RESULT_ERROR_NOT_AUTHENTICATED);
+
+    ByteBuffer cmd;
+    cmd << header;
+
+    if (mode == DF_COMM_FULL && !in.empty())
+        cmd << _ev2.Encrypt(in, false);
+    else
+        cmd << in;
+
+    if (mode != DF_COMM_PLAIN)
+        cmd << _ev2.MAC(ins, BinaryView(cmd.Data()).Sub(0, header.size()), BinaryView(cmd.Data()).Sub(header.size()), false);
+
+    BinaryData resp;
+    Result result = Transceive(ins, cmd.Data(), resp);
+    if (!result)
     {
-        _authenticatedKeyNo = keyno;
-        _sessionKey = CreateSessionKey(RndA, RndB, key);
-        _sessionKeyIV = BinaryData(_sessionKey.Key.size(), 0x00);
+        // Card drops authentication on errors, counter can not be kept in sync
+        if (result.Origin == RESULT_ORIGIN_DESFIRE)
+        {
+            _authenticatedKeyNo = -1;
+            _ev2.Clear();
+        }
+        return result;
+    }
+
+    // Response is protected with the incremented counter
+    if (mode == DF_COMM_PLAIN)
+    {
+        _ev2.Advance();
+        out = resp;
+        return Result();
+    }
+
+    if (resp.size() < DESFIRE_EV2_MAC_SIZE)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    BinaryView data = BinaryView(resp).Sub(0, resp.size() - DESFIRE_EV2_MAC_SIZE);
+    BinaryData mac = _ev2.MAC(DF_STATUS_OPERATION_OK, BinaryView(), data, true);
 
-        return true;
+    if (!std::equal(mac.begin(), mac.end(), resp.end() - DESFIRE_EV2_MAC_SIZE))
+    {
+        _authenticatedKeyNo = -1;
+        _ev2.Clear();
+        return Result::Library(RESULT_ERROR_AUTHENTICATION);
+    }
+
+    if (mode == DF_COMM_FULL && data.Size)
+    {
+        result = _ev2.Decrypt(data, true, out);
+        if (!result)
+            return result;
     }
     else
-        return false;
+    {
+        out.assign(data.begin(), data.end());
+    }
+
+    _ev2.Advance();
+
+    return Result();
 }
+#endif
 
-bool Desfire::ChangeKey(uint8_t keyno, const DesfireKey& key)
+Result Desfire::Authenticate(const uint8_t keyno, const DesfireKeyDiversifier& diversifier, const BinaryData& uid)
+{
+    DesfireKey key = diversifier.Diversify(uid, _selectedApplication);
+
+    // Diversifier failed (unsupported master key or input too long)
+    if (key.Type == DF_KEY_NONE)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    return Authenticate(keyno, key);
+}
+
+Result Desfire::Authenticate(const uint8_t keyno, DesfireKeyStore& store, const BinaryData& uid, const uint8_t version)
+{
+    AESContext* context;
+    const DesfireKey* key = store.Get(_selectedApplication, keyno, version, uid, &context);
+    if (!key)
+        return Result::Library(RESULT_ERROR_KEY_NOT_FOUND);
+
+    return Authenticate(keyno, *key, context);
+}
+
+Result Desfire::ChangeKey(uint8_t keyno, const DesfireKey& key)
 {
     // Maximum keyno is 0x0F
     keyno &= 0x0F;
 
     // Can only change authenticated key
     if (_authenticatedKeyNo != keyno)
-        return false;
+        return Result::Library(RESULT_ERROR_NOT_AUTHENTICATED);
+
+#if PN532_CONFIG_DESFIRE_EV2
+    if (_ev2.Active())
+    {
+        // EV2 only supports AES application keys here, key version is kept at 0
+        if (key.Type != DF_KEY_AES || _selectedApplication == 0)
+            return Result::Library(RESULT_ERROR_UNSUPPORTED);
+
+        BinaryData data(key.Key);
+        data.push_back(0x00);
+
+        ByteBuffer cmd;
+        cmd << keyno << _ev2.Encrypt(data, false);
+        cmd << _ev2.MAC(DF_INS_CHANGE_KEY, BinaryView(cmd.Data()).Sub(0, 1), BinaryView(cmd.Data()).Sub(1), false);
+
+        // Card answers without MAC, as the key of the session changed
+        BinaryData resp;
+        Result result = Transceive(DF_INS_CHANGE_KEY, cmd.Data(), resp);
+
+        // Changing the authenticated key ends the session
+        _authenticatedKeyNo = -1;
+        _ev2.Clear();
+
+        return result;
+    }
+#endif
 
     // Key type is encoded in keyno and can only be changed on master key
     if (_selectedApplication == 0)
     {
         switch (key.Type)
         {
+#if PN532_CONFIG_LEGACY_KEYS
             case DF_KEY_DES:
             case DF_KEY_3DES:
                 break;
             case DF_KEY_3K3DES:
                 keyno |= 0x40;
                 break;
+#endif
             case DF_KEY_AES:
                 keyno |= 0x80;
                 break;
@@ -225,15 +505,18 @@ bool Desfire::ChangeKey(uint8_t keyno, const DesfireKey& key)
     ByteBuffer cryptogram;
 
     // Serialize key (8 byte keys are repeated)
+#if PN532_CONFIG_LEGACY_KEYS
     if (key.Type == DF_KEY_DES || key.Type == DF_KEY_3DES)
         cryptogram << key.Key << key.Key;
     else
+#endif
         cryptogram << key.Key;
     
     // AES key has version. Just keep 0 ?
     if (key.Type == DF_KEY_AES)
         cryptogram.Append<uint8_t>(0x00);
 
+#if PN532_CONFIG_LEGACY_KEYS
     // Legacy authentication keys use ISO14443A CRC
     if (key.Type == DF_KEY_DES || key.Type == DF_KEY_3DES)
     {
@@ -242,6 +525,7 @@ bool Desfire::ChangeKey(uint8_t keyno, const DesfireKey& key)
         cryptogram << crc;
     }
     else
+#endif
     {
         // Desfire calculates crc also over command byte which is in completely different place
         uint32_t crc = 0xFFFFFFFF;
@@ -264,7 +548,7 @@ bool Desfire::ChangeKey(uint8_t keyno, const DesfireKey& key)
     if (key.Type == DF_KEY_AES)
         cryptogramEnc = AES_CBC_Encrypt(cryptogram.Data(), _sessionKey.Key, _sessionKeyIV);
     else
-        return false;
+        return Result::Library(RESULT_ERROR_UNSUPPORTED);
     
     // Build packet
     ByteBuffer packet;
@@ -272,10 +556,7 @@ bool Desfire::ChangeKey(uint8_t keyno, const DesfireKey& key)
     packet << cryptogramEnc;
 
     BinaryData resp;
-    if (!Transceive(DF_INS_CHANGE_KEY, packet.Data(), resp))
-        return false;
-    else
-        return true;
+    return Transceive(DF_INS_CHANGE_KEY, packet.Data(), resp);
 }
 
 DesfireKey Desfire::CreateSessionKey(const BinaryData& RndA, const BinaryData& RndB, const DesfireKey& key)
@@ -284,6 +565,7 @@ DesfireKey Desfire::CreateSessionKey(const BinaryData& RndA, const BinaryData& R
 
     switch(key.Type)
     {
+#if PN532_CONFIG_LEGACY_KEYS
         case DF_KEY_DES:
             buf.Append(RndA.data(), 4);
             buf.Append(RndB.data(), 4);
@@ -302,6 +584,7 @@ DesfireKey Desfire::CreateSessionKey(const BinaryData& RndA, const BinaryData& R
             buf.Append(RndA.data()+12, 4);
             buf.Append(RndB.data()+12, 4);
             return CreateDesfireKey3K3DES(buf.Data());
+#endif
         case DF_KEY_AES:
             buf.Append(RndA.data(), 4);
             buf.Append(RndB.data(), 4);
@@ -313,3 +596,377 @@ DesfireKey Desfire::CreateSessionKey(const BinaryData& RndA, const BinaryData& R
             return DesfireKey();
     }
 }
+
+DesfireAESAuthentication::DesfireAESAuthentication(const uint8_t keyno, const DesfireKey& key, AESContext* context) :
+    KeyNo(keyno), _key(key), _context(context)
+{
+    if (!_context)
+        _keyContext.SetKey(_key.Key);
+}
+
+Result DesfireAESAuthentication::Challenge(const BinaryView& RndBEnc, BinaryData& token)
+{
+    // Size should be 16 bytes
+    if (RndBEnc.Size != 16)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    // Start off with zero IV. RndB is always a random value so this shouldn't be a security problem
+    _IV.assign(16, 0x00);
+
+    // Decrypt RndB
+    _RndB = AES_CBC_Decrypt(RndBEnc.ToBinary(), Context(), _IV);
+    if (_RndB.size() != 16)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    // Rotate RndB
+    BinaryData RndBRot;
+    RndBRot.assign(_RndB.begin()+1, _RndB.end());
+    RndBRot.push_back(_RndB[0]);
+
+    // Generate a random 16 byte value RndA
+    _RndA.resize(16);
+    if (!GetRandomPool().Take(_RndA.data(), _RndA.size()))
+        return Result::Library(RESULT_ERROR_RANDOM_SOURCE);
+
+    // Build authentication token
+    ByteBuffer Token;
+    Token << _RndA;
+    Token << RndBRot;
+
+    // Encrypt token and use RndBEnc as IV
+    token = AES_CBC_Encrypt(Token.Data(), Context(), _IV);
+
+    return Result();
+}
+
+Result DesfireAESAuthentication::Verify(const BinaryView& RndARotEnc)
+{
+    if (RndARotEnc.Size != 16 || _RndA.empty())
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    // Decrypt RndARot
+    BinaryData RndARot = AES_CBC_Decrypt(RndARotEnc.ToBinary(), Context(), _IV);
+
+    // Calculate a local RndARot value
+    BinaryData RndARotLocal;
+    RndARotLocal.assign(_RndA.begin()+1, _RndA.end());
+    RndARotLocal.push_back(_RndA[0]);
+
+    // Check if final values match
+    if (RndARotLocal != RndARot)
+        return Result::Library(RESULT_ERROR_AUTHENTICATION);
+
+    SessionKey = Desfire::CreateSessionKey(_RndA, _RndB, _key);
+
+    return Result();
+}
+
+#if PN532_CONFIG_DESFIRE_EV2
+DesfireEV2Session::DesfireEV2Session() : CmdCtr(0), _active(false)
+{
+    memset(TI, 0, sizeof(TI));
+}
+
+void DesfireEV2Session::Clear()
+{
+    _active = false;
+    CmdCtr = 0;
+    EncKey = DesfireKey();
+    MacKey = DesfireKey();
+    _enc.Clear();
+    _mac.Clear();
+}
+
+DesfireKey DesfireEV2Session::DeriveKey(const DesfireKey& key, const BinaryData& RndA, const BinaryData& RndB, bool mac)
+{
+    AESContext ctx;
+    ctx.SetKey(key.Key);
+
+    return DeriveKey(ctx, RndA, RndB, mac);
+}
+
+DesfireKey DesfireEV2Session::DeriveKey(AESContext& key, const BinaryData& RndA, const BinaryData& RndB, bool mac)
+{
+    // SV = label || 00 01 00 80 || RndA[15..14] || (RndA[13..8] ^ RndB[15..10]) || RndB[9..0] || RndA[7..0]
+    BinaryData sv;
+    sv.reserve(32);
+
+    sv.push_back(mac ? 0x5A : 0xA5);
+    sv.push_back(mac ? 0xA5 : 0x5A);
+    sv.push_back(0x00);
+    sv.push_back(0x01);
+    sv.push_back(0x00);
+    sv.push_back(0x80);
+    sv.insert(sv.end(), RndA.begin(), RndA.begin() + 2);
+    for (uint8_t i = 0; i < 6; ++i)
+        sv.push_back(RndA[2 + i] ^ RndB[i]);
+    sv.insert(sv.end(), RndB.begin() + 6, RndB.end());
+    sv.insert(sv.end(), RndA.begin() + 8, RndA.end());
+
+    BinaryData K1, K2;
+    AES_CMAC_Subkeys(key, K1, K2);
+
+    return CreateDesfireKeyAES(AES_CMAC(sv, key, K1, K2));
+}
+
+void DesfireEV2Session::Begin(const DesfireKey& key, const BinaryData& RndA, const BinaryData& RndB, const uint8_t ti[DESFIRE_EV2_TI_SIZE])
+{
+    AESContext ctx;
+    ctx.SetKey(key.Key);
+
+    Begin(ctx, RndA, RndB, ti);
+}
+
+void DesfireEV2Session::Begin(AESContext& key, const BinaryData& RndA, const BinaryData& RndB, const uint8_t ti[DESFIRE_EV2_TI_SIZE])
+{
+    memcpy(TI, ti, DESFIRE_EV2_TI_SIZE);
+    CmdCtr = 0;
+
+    // TI is fixed for the whole transaction
+    _ivInput.assign(16, 0x00);
+    memcpy(_ivInput.data() + 2, TI, DESFIRE_EV2_TI_SIZE);
+
+    Rekey(key, RndA, RndB);
+}
+
+void DesfireEV2Session::Rekey(const DesfireKey& key, const BinaryData& RndA, const BinaryData& RndB)
+{
+    AESContext ctx;
+    ctx.SetKey(key.Key);
+
+    Rekey(ctx, RndA, RndB);
+}
+
+void DesfireEV2Session::Rekey(AESContext& key, const BinaryData& RndA, const BinaryData& RndB)
+{
+    EncKey = DeriveKey(key, RndA, RndB, false);
+    MacKey = DeriveKey(key, RndA, RndB, true);
+
+    // Schedules and subkeys are reused by every IV, cryptogram and MAC of the session
+    _enc.SetKey(EncKey.Key);
+    _mac.SetKey(MacKey.Key);
+    AES_CMAC_Subkeys(_mac, _K1, _K2);
+
+    _active = true;
+}
+
+BinaryData DesfireEV2Session::IV(bool response)
+{
+    // IV = E(SesAuthENCKey, label || TI || CmdCtr || 0^64)
+    uint16_t ctr = response ? CmdCtr + 1 : CmdCtr;
+
+    _ivInput[0] = response ? 0x5A : 0xA5;
+    _ivInput[1] = response ? 0xA5 : 0x5A;
+    _ivInput[6] = ctr;
+    _ivInput[7] = ctr >> 8;
+
+    BinaryData zero(16, 0x00);
+    return AES_CBC_Encrypt(_ivInput, _enc, zero);
+}
+
+BinaryData DesfireEV2Session::Encrypt(const BinaryData& data, bool response)
+{
+    // ISO/IEC 9797-1 padding method 2, always added
+    BinaryData padded(data);
+    padded.push_back(0x80);
+    PadToBlocksize(padded, 16);
+
+    BinaryData iv = IV(response);
+    return AES_CBC_Encrypt(padded, _enc, iv);
+}
+
+Result DesfireEV2Session::Decrypt(const BinaryView& data, bool response, BinaryData& out)
+{
+    if (!data.Size || data.Size % 16)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    BinaryData iv = IV(response);
+    out = AES_CBC_Decrypt(data.ToBinary(), _enc, iv);
+
+    // Strip padding
+    while (!out.empty() && out.back() == 0x00)
+        out.pop_back();
+
+    if (out.empty() || out.back() != 0x80)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    out.pop_back();
+
+    return Result();
+}
+
+BinaryData DesfireEV2Session::MAC(uint8_t code, const BinaryView& header, const BinaryView& data, bool response)
+{
+    uint16_t ctr = response ? CmdCtr + 1 : CmdCtr;
+
+    BinaryData input;
+    input.reserve(1 + 2 + DESFIRE_EV2_TI_SIZE + header.Size + data.Size);
+    input.push_back(code);
+    input.push_back(ctr);
+    input.push_back(ctr >> 8);
+    input.insert(input.end(), TI, TI + DESFIRE_EV2_TI_SIZE);
+    input.insert(input.end(), header.begin(), header.end());
+    input.insert(input.end(), data.begin(), data.end());
+
+    BinaryData mac = AES_CMAC(input, _mac, _K1, _K2);
+
+    // Truncated to the odd bytes S1, S3, ... S15
+    BinaryData truncated(DESFIRE_EV2_MAC_SIZE);
+    for (uint8_t i = 0; i < DESFIRE_EV2_MAC_SIZE; ++i)
+        truncated[i] = mac[2 * i + 1];
+
+    return truncated;
+}
+
+DesfireEV2Authentication::DesfireEV2Authentication(const uint8_t keyno, const DesfireKey& key, bool first) :
+    KeyNo(keyno), First(first)
+{
+    _keyContext.SetKey(key.Key);
+}
+
+Result DesfireEV2Authentication::Challenge(const BinaryView& RndBEnc, BinaryData& token)
+{
+    if (RndBEnc.Size != 16)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    BinaryData IV(16, 0x00);
+    _RndB = AES_CBC_Decrypt(RndBEnc.ToBinary(), _keyContext, IV);
+    if (_RndB.size() != 16)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    BinaryData RndBRot(_RndB.begin() + 1, _RndB.end());
+    RndBRot.push_back(_RndB[0]);
+
+    _RndA.resize(16);
+    if (!GetRandomPool().Take(_RndA.data(), _RndA.size()))
+        return Result::Library(RESULT_ERROR_RANDOM_SOURCE);
+
+    ByteBuffer Token;
+    Token << _RndA;
+    Token << RndBRot;
+
+    IV.assign(16, 0x00);
+    token = AES_CBC_Encrypt(Token.Data(), _keyContext, IV);
+
+    return Result();
+}
+
+Result DesfireEV2Authentication::Verify(const BinaryView& response, DesfireEV2Session& session)
+{
+    // First: TI || RndA' || PDcap2 || PCDcap2, NonFirst: RndA'
+    if (response.Size != (First ? 32u : 16u) || _RndA.empty())
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    BinaryData IV(16, 0x00);
+    BinaryData plain = AES_CBC_Decrypt(response.ToBinary(), _keyContext, IV);
+
+    const uint8_t* RndARot = plain.data() + (First ? DESFIRE_EV2_TI_SIZE : 0);
+
+    for (uint8_t i = 0; i < 16; ++i)
+    {
+        if (RndARot[i] != _RndA[(i + 1) % 16])
+            return Result::Library(RESULT_ERROR_AUTHENTICATION);
+    }
+
+    if (First)
+        session.Begin(_keyContext, _RndA, _RndB, plain.data());
+    else
+        session.Rekey(_keyContext, _RndA, _RndB);
+
+    return Result();
+}
+#endif
+
+DesfireAuthenticateJob::DesfireAuthenticateJob(Desfire& desfire, const uint8_t keyno, const DesfireKey& key) :
+    _desfire(desfire), _auth(keyno, key), _step(0), _result(Result::Library(RESULT_ERROR_INVALID_RESPONSE))
+{
+    // Currently only AES is supported
+    if (key.Type != DF_KEY_AES)
+    {
+        _result = Result::Library(RESULT_ERROR_UNSUPPORTED);
+        _step = DONE;
+    }
+}
+
+void DesfireAuthenticateJob::StartMetrics(uint8_t ins)
+{
+#if PN532_METRICS
+    _ins = ins;
+    _sentMicros = PlatformMicros();
+#else
+    (void)ins;
+#endif
+}
+
+// Same metrics as Desfire::Transceive. Latency includes time the scheduler
+// spends on commands of other jobs in between.
+void DesfireAuthenticateJob::RecordMetrics(const Result& result, const BinaryView& response)
+{
+#if PN532_METRICS
+    METRICS_RECORD_KEYED(Instructions, _ins, _sentMicros);
+
+    if (result && response.Size >= 2)
+        METRICS_COUNT(DesfireStatus[response[response.Size-1]], 1);
+#else
+    (void)result;
+    (void)response;
+#endif
+}
+
+bool DesfireAuthenticateJob::NextCommand(ByteBuffer& buf)
+{
+    switch (_step)
+    {
+        case SEND_AUTH:
+        {
+            BinaryData args(1, _auth.KeyNo);
+            Desfire::SerializeCommand(buf, DFEV1_INS_AUTHENTICATE_AES, args);
+            StartMetrics(DFEV1_INS_AUTHENTICATE_AES);
+            _step = RECEIVE_CHALLENGE;
+            return true;
+        }
+        case SEND_TOKEN:
+            Desfire::SerializeCommand(buf, DF_INS_ADDITIONAL_FRAME, _token);
+            StartMetrics(DF_INS_ADDITIONAL_FRAME);
+            _step = RECEIVE_VERIFY;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void DesfireAuthenticateJob::HandleResponse(const Result& result, const BinaryView& response)
+{
+    BinaryView data;
+    _result = result;
+
+    RecordMetrics(result, response);
+
+    if (_result)
+        _result = Desfire::ParseResponse(response, data);
+
+    if (!_result)
+    {
+        _step = DONE;
+        return;
+    }
+
+    switch (_step)
+    {
+        case RECEIVE_CHALLENGE:
+            _result = _auth.Challenge(data, _token);
+            _step = _result ? SEND_TOKEN : DONE;
+            break;
+        case RECEIVE_VERIFY:
+            _result = _auth.Verify(data);
+            if (_result)
+                _desfire.SetSession(_auth.KeyNo, _auth.SessionKey);
+            _step = DONE;
+            break;
+        default:
+            _step = DONE;
+            break;
+    }
+}
+
+#endif
@@ -2,8 +2,14 @@
 #define __DESFIRE_H__
 
 #include "TagInterface.h"
+#include "TagScheduler.h"
 #include "ByteBuffer.h"
+#include "Crypto.h"
+#include "Result.h"
 #include "DesfireKey.h"
+#include "DesfireKeyDiversifier.h"
+#include "DesfireKeyStore.h"
+#include "PN532Config.h"
 
 enum ISO7816_4_CLA_t : uint8_t
 {
@@ -81,6 +87,9 @@ enum DesfireInstruction_t : uint8_t
     DFEV1_INS_GET_CARD_UID            = 0x51,
     DFEV1_INS_GET_ISO_FILE_IDS        = 0x61,
     DFEV1_INS_SET_CONFIGURATION       = 0x5C,
+    // Desfire EV2 instructions
+    DFEV2_INS_AUTHENTICATE_EV2_FIRST  = 0x71,
+    DFEV2_INS_AUTHENTICATE_EV2_NONFIRST = 0x77,
     DF_INS_MAX                        = 0xFF
 };
 
@@ -110,6 +119,17 @@ enum DesfireStatus_t : uint8_t
     DF_STATUS_FILE_INTEGRITY_ERROR      = 0xF1
 };
 
+// Communication mode of a command after EV2 authentication
+enum DesfireCommMode_t : uint8_t
+{
+    DF_COMM_PLAIN,      // No protection, command counter still advances
+    DF_COMM_MAC,        // Command and response carry truncated CMAC
+    DF_COMM_FULL        // Data is encrypted with session key, then MACed
+};
+
+#define DESFIRE_EV2_TI_SIZE 4
+#define DESFIRE_EV2_MAC_SIZE 8
+
 inline void desfire_crc32_byte(uint32_t *crc, const uint8_t value)
 {
     /* x32 + x26 + x23 + x22 + x16 + x12 + x11 + x10 + x8 + x7 + x5 + x4 + x2 + x + 1 */
@@ -124,33 +144,220 @@ inline void desfire_crc32_byte(uint32_t *crc, const uint8_t value)
     }
 }
 
+#if PN532_CONFIG_DESFIRE
+
+#if PN532_CONFIG_DESFIRE_EV2
+// EV2 secure messaging state shared by reader and card side. Session keys are
+// derived with the CMAC KDF of AuthenticateEV2First. Command counter and
+// transaction identifier enter MACs and IVs. IV input block is kept between
+// commands, only its label and counter bytes are updated.
+class DesfireEV2Session
+{
+public:
+    DesfireEV2Session();
+
+    // Starts session after AuthenticateEV2First. Counter is reset
+    void Begin(const DesfireKey& key, const BinaryData& RndA, const BinaryData& RndB, const uint8_t TI[DESFIRE_EV2_TI_SIZE]);
+    void Begin(AESContext& key, const BinaryData& RndA, const BinaryData& RndB, const uint8_t TI[DESFIRE_EV2_TI_SIZE]);
+    // New session keys after AuthenticateEV2NonFirst. Counter and TI are kept
+    void Rekey(const DesfireKey& key, const BinaryData& RndA, const BinaryData& RndB);
+    void Rekey(AESContext& key, const BinaryData& RndA, const BinaryData& RndB);
+    void Clear();
+
+    bool Active() const
+    {
+        return _active;
+    }
+
+    // Encrypts data of command (or response) with padding, IV depends on counter
+    BinaryData Encrypt(const BinaryData& data, bool response);
+    // Decrypts and removes padding
+    Result Decrypt(const BinaryView& data, bool response, BinaryData& out);
+    // Truncated CMAC over code, counter, TI, header and data. Code is instruction
+    // for commands and status for responses
+    BinaryData MAC(uint8_t code, const BinaryView& header, const BinaryView& data, bool response);
+    // Called once per command/response pair
+    void Advance()
+    {
+        CmdCtr++;
+    }
+
+    // Derives session key from SV1 (encryption) or SV2 (MAC) vector
+    static DesfireKey DeriveKey(const DesfireKey& key, const BinaryData& RndA, const BinaryData& RndB, bool mac);
+    static DesfireKey DeriveKey(AESContext& key, const BinaryData& RndA, const BinaryData& RndB, bool mac);
+
+    uint8_t TI[DESFIRE_EV2_TI_SIZE];
+    uint16_t CmdCtr;
+    DesfireKey EncKey;
+    DesfireKey MacKey;
+
+private:
+    BinaryData IV(bool response);
+
+    bool _active;
+    AESContext _enc;        // Schedules of EncKey and MacKey, used by every command
+    AESContext _mac;
+    BinaryData _K1;         // CMAC subkeys of MacKey
+    BinaryData _K2;
+    BinaryData _ivInput;    // Label, TI, counter and zero padding
+};
+#endif
+
 class Desfire
 {
+    friend class DesfireAuthenticateJob;
+
 public:
     Desfire(TagInterface& interface);
 
-    bool Connect();
-    bool Transceive(const DesfireInstruction_t ins, const BinaryData& in, BinaryData& out);
+    Result Connect();
+    Result Transceive(const DesfireInstruction_t ins, const BinaryData& in, BinaryData& out);
+
+    Result SelectApplication(uint32_t aid);
+    // Reads a data file in plain communication mode. Length 0 reads up to
+    // the end of the file. Card answers in frames of up to 59 bytes, which
+    // are requested with additional frame commands.
+    Result ReadData(uint8_t fileNo, uint32_t offset, uint32_t length, BinaryData& out);
 
     DesfireInstruction_t GetAuthCmd(const DesfireKeyType_t& type);
-    bool Authenticate(const uint8_t keyno, const DesfireKey& key);
+    Result Authenticate(const uint8_t keyno, const DesfireKey& key);
+    // Authenticates with a key diversified from card UID and selected application
+    Result Authenticate(const uint8_t keyno, const DesfireKeyDiversifier& diversifier, const BinaryData& uid);
+    // Authenticates with a key looked up in the store for the selected application
+    Result Authenticate(const uint8_t keyno, DesfireKeyStore& store, const BinaryData& uid, const uint8_t version = 0);
+
+#if PN532_CONFIG_DESFIRE_EV2
+    // EV2 authentication, starts secure messaging with new TI and counter (AES only)
+    Result AuthenticateEV2First(const uint8_t keyno, const DesfireKey& key);
+    // Switches to another key of the selected application without a new transaction
+    Result AuthenticateEV2NonFirst(const uint8_t keyno, const DesfireKey& key);
+    // Native command with EV2 secure messaging. Header is sent in plain and
+    // covered by MAC, data is encrypted in DF_COMM_FULL. Response data is
+    // verified and decrypted according to the same mode. Session is dropped
+    // when card reports an error.
+    Result TransceiveEV2(const DesfireInstruction_t ins, const BinaryData& header, const BinaryData& in, BinaryData& out, DesfireCommMode_t mode);
+#endif
 
-    bool ChangeKey(uint8_t keyno, const DesfireKey& key);
+    // Changes the authenticated key. Uses EV2 secure messaging after AuthenticateEV2First
+    Result ChangeKey(uint8_t keyno, const DesfireKey& key);
 
     static DesfireKey CreateSessionKey(const BinaryData& RndA, const BinaryData& RndB, const DesfireKey& key);
 
-    DesfireStatus_t GetLastError() const
-    {
-        return _lastError;
-    }
+    // Serializes native Desfire command wrapped in ISO7816-4 APDU
+    static void SerializeCommand(ByteBuffer& buf, const DesfireInstruction_t ins, const BinaryData& in);
+    // Splits response APDU into data and Desfire status
+    static Result ParseResponse(const BinaryView& rapdu, BinaryView& data);
 
 private:
-    uint8_t _selectedApplication;
+    // Authenticate with an optional expanded key (cached by DesfireKeyStore)
+    Result Authenticate(const uint8_t keyno, const DesfireKey& key, AESContext* context);
+    void SetSession(const uint8_t keyno, const DesfireKey& sessionKey);
+
+    // Sends command APDU built with TagInterface::BeginWrite and returns view of response data and status word
+    Result Exchange(BinaryView& data, uint8_t& SW1, uint8_t& SW2);
+
+    uint32_t _selectedApplication;
     int8_t _authenticatedKeyNo;
     DesfireKey _sessionKey; // Gets assigned after successful authentication
     BinaryData _sessionKeyIV;
-    DesfireStatus_t _lastError;
+#if PN532_CONFIG_DESFIRE_EV2
+    DesfireEV2Session _ev2;
+#endif
     TagInterface& _interface;
 };
 
+// EV1 AES mutual authentication split into steps. Used synchronously by
+// Desfire::Authenticate and interleaved by DesfireAuthenticateJob.
+// Key and context must outlive the authentication object. Without context
+// the key is expanded once for all steps.
+class DesfireAESAuthentication
+{
+public:
+    DesfireAESAuthentication(const uint8_t keyno, const DesfireKey& key, AESContext* context = nullptr);
+
+    // Decrypts card challenge (encrypted RndB) and builds encrypted token
+    Result Challenge(const BinaryView& RndBEnc, BinaryData& token);
+    // Checks card response (encrypted rotated RndA) and creates session key
+    Result Verify(const BinaryView& RndARotEnc);
+
+    uint8_t KeyNo;
+    DesfireKey SessionKey; // Valid after successful Verify
+
+private:
+    AESContext& Context()
+    {
+        return _context ? *_context : _keyContext;
+    }
+
+    const DesfireKey& _key;
+    AESContext* _context;
+    AESContext _keyContext;
+    BinaryData _IV;
+    BinaryData _RndA;
+    BinaryData _RndB;
+};
+
+#if PN532_CONFIG_DESFIRE_EV2
+// EV2 mutual authentication steps (AuthenticateEV2First and NonFirst).
+// All cryptograms use zero IV. Key is expanded once by the constructor.
+class DesfireEV2Authentication
+{
+public:
+    DesfireEV2Authentication(const uint8_t keyno, const DesfireKey& key, bool first);
+
+    // Decrypts card challenge and builds encrypted RndA || RndB' token
+    Result Challenge(const BinaryView& RndBEnc, BinaryData& token);
+    // Checks card response and starts (First) or rekeys (NonFirst) session
+    Result Verify(const BinaryView& response, DesfireEV2Session& session);
+
+    uint8_t KeyNo;
+    bool First;
+
+private:
+    AESContext _keyContext; // Expanded once for all steps and the session key derivation
+    BinaryData _RndA;
+    BinaryData _RndB;
+};
+#endif
+
+// Authentication as a TagScheduler job, so two cards can be authenticated concurrently
+class DesfireAuthenticateJob : public TagJob
+{
+public:
+    DesfireAuthenticateJob(Desfire& desfire, const uint8_t keyno, const DesfireKey& key);
+
+    bool NextCommand(ByteBuffer& buf);
+    void HandleResponse(const Result& result, const BinaryView& response);
+
+    Result GetResult() const
+    {
+        return _result;
+    }
+
+private:
+    void StartMetrics(uint8_t ins);
+    void RecordMetrics(const Result& result, const BinaryView& response);
+
+    enum Step_t : uint8_t
+    {
+        SEND_AUTH,
+        RECEIVE_CHALLENGE,
+        SEND_TOKEN,
+        RECEIVE_VERIFY,
+        DONE
+    };
+
+    Desfire& _desfire;
+    DesfireAESAuthentication _auth;
+    uint8_t _step;
+    BinaryData _token;
+    Result _result;
+#if PN532_METRICS
+    uint8_t _ins;           // Instruction of the command in flight
+    uint32_t _sentMicros;
+#endif
+};
+
+#endif
+
 #endif
@@ -10,27 +10,28 @@ enum DesfireKeyType_t
     DF_KEY_AES
 }; 
 
+inline size_t DesfireKeyLength(const DesfireKeyType_t type)
+{
+    switch (type)
+    {
+        case DF_KEY_DES:
+        case DF_KEY_3DES:
+            return 8;
+        case DF_KEY_AES:
+            return 16;
+        case DF_KEY_3K3DES:
+            return 24;
+        default:
+            return 0;
+    }
+}
+
 struct DesfireKey
 {
     DesfireKey(const BinaryData& key = BinaryData(), const DesfireKeyType_t type = DF_KEY_NONE) : Key(key), Type(type)
     {
         // Enforce key length
-        switch (type)
-        {
-            case DF_KEY_DES:
-            case DF_KEY_3DES:
-                Key.resize(8);
-                break;
-            case DF_KEY_AES:
-                Key.resize(16);
-                break;
-            case DF_KEY_3K3DES:
-                Key.resize(24);
-                break;
-            default:
-                Key.resize(0);
-                break;
-        }
+        Key.resize(DesfireKeyLength(type));
     }
 
     BinaryData Key;
@@ -0,0 +1,56 @@
+#include "DesfireKeyDiversifier.h"
+
+#if PN532_CONFIG_DESFIRE
+
+#include "Crypto.h"
+
+DesfireKeyDiversifier::DesfireKeyDiversifier(const DesfireKey& masterKey, const BinaryData& systemIdentifier) :
+    _masterKey(masterKey), _systemIdentifier(systemIdentifier)
+{
+    if (IsValid())
+        AES_CMAC_Subkeys(_masterKey.Key, _K1, _K2);
+}
+
+DesfireKey DesfireKeyDiversifier::Diversify(const BinaryData& uid, uint32_t aid) const
+{
+    ByteBuffer input;
+    input << uid;
+    input.Append<uint8_t>(aid);
+    input.Append<uint8_t>(aid >> 8);
+    input.Append<uint8_t>(aid >> 16);
+    input << _systemIdentifier;
+
+    return Diversify(input.Data());
+}
+
+DesfireKey DesfireKeyDiversifier::Diversify(const BinaryData& input) const
+{
+    if (!IsValid() || input.size() > AN10922_MAX_INPUT_SIZE)
+        return DesfireKey();
+
+    // D = 0x01 || M
+    BinaryData D;
+    D.reserve(32);
+    D.push_back(AN10922_AES128_DIV_CONSTANT);
+    D.insert(D.end(), input.begin(), input.end());
+
+    // AN10922 always pads to two blocks. Complete input uses K1, padded K2
+    const BinaryData* subkey = &_K1;
+    if (D.size() < 32)
+    {
+        D.push_back(0x80);
+        D.resize(32, 0x00);
+        subkey = &_K2;
+    }
+
+    for (size_t i = 0; i < 16; ++i)
+        D[16+i] ^= (*subkey)[i];
+
+    BinaryData IV(16, 0x00);
+    BinaryData enc = AES_CBC_Encrypt(D, _masterKey.Key, IV);
+
+    // Diversified key is the last cipher block
+    return CreateDesfireKeyAES(BinaryData(enc.begin()+16, enc.end()));
+}
+
+#endif
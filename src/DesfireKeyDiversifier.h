@@ -0,0 +1,45 @@
+#ifndef __DESFIRE_KEY_DIVERSIFIER_H__
+#define __DESFIRE_KEY_DIVERSIFIER_H__
+
+#include <cstdint>
+#include "ByteBuffer.h"
+#include "DesfireKey.h"
+#include "PN532Config.h"
+
+// AN10922 diversification input constant for AES-128 keys
+#define AN10922_AES128_DIV_CONSTANT 0x01
+// Maximum length of diversification input M (UID + AID + system identifier)
+#define AN10922_MAX_INPUT_SIZE 31
+
+#if PN532_CONFIG_DESFIRE
+
+// Derives per card keys from a master key as described in NXP AN10922.
+// CMAC subkeys of the master key are computed once in constructor, so
+// each derivation costs a single two block CMAC.
+class DesfireKeyDiversifier
+{
+public:
+    DesfireKeyDiversifier(const DesfireKey& masterKey, const BinaryData& systemIdentifier = BinaryData());
+
+    // Diversification input is UID || AID (LSB first) || system identifier
+    DesfireKey Diversify(const BinaryData& uid, uint32_t aid) const;
+
+    // Diversify with raw diversification input M
+    DesfireKey Diversify(const BinaryData& input) const;
+
+    // Only AES-128 master keys are supported
+    bool IsValid() const
+    {
+        return _masterKey.Type == DF_KEY_AES;
+    }
+
+private:
+    DesfireKey _masterKey;
+    BinaryData _systemIdentifier;
+    BinaryData _K1; // CMAC subkeys of master key
+    BinaryData _K2;
+};
+
+#endif
+
+#endif
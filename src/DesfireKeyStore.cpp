@@ -0,0 +1,158 @@
+#include "DesfireKeyStore.h"
+
+#if PN532_CONFIG_DESFIRE
+
+#include <algorithm>
+#include <cstring>
+
+DesfireKeyStore::DesfireKeyStore(size_t cacheSize) : _cache(cacheSize), _useCounter(0)
+{
+    // Preallocate key storage of cache entries, so materializing keys does not allocate
+    for (CacheEntry& entry : _cache)
+    {
+        entry.LastUse = 0;
+        entry.Key.Key.reserve(24);
+    }
+}
+
+DesfireKeyStore::Entry* DesfireKeyStore::Find(uint64_t id)
+{
+    auto it = std::lower_bound(_entries.begin(), _entries.end(), id,
+        [](const Entry& entry, uint64_t id) { return entry.Id < id; });
+
+    if (it == _entries.end() || it->Id != id)
+        return nullptr;
+
+    return &*it;
+}
+
+DesfireKeyStore::Entry& DesfireKeyStore::Insert(uint64_t id, DesfireKeyType_t type)
+{
+    // Replaced keys invalidate cached copies
+    ClearCache();
+
+    Entry* existing = Find(id);
+    if (existing)
+    {
+        existing->Type = type;
+        existing->Diversifier = -1;
+        return *existing;
+    }
+
+    auto it = std::lower_bound(_entries.begin(), _entries.end(), id,
+        [](const Entry& entry, uint64_t id) { return entry.Id < id; });
+
+    Entry entry;
+    entry.Id = id;
+    entry.Type = type;
+    entry.Offset = 0;
+    entry.Diversifier = -1;
+
+    return *_entries.insert(it, entry);
+}
+
+bool DesfireKeyStore::Add(uint32_t aid, uint8_t keyno, uint8_t version, const DesfireKey& key)
+{
+    if (key.Type == DF_KEY_NONE || _material.size() + key.Key.size() > UINT16_MAX)
+        return false;
+
+    Entry& entry = Insert(PackId(aid, keyno, version), key.Type);
+
+    // Old material of replaced key is left unused
+    entry.Offset = _material.size();
+    _material.insert(_material.end(), key.Key.begin(), key.Key.end());
+
+    return true;
+}
+
+bool DesfireKeyStore::AddDiversified(uint32_t aid, uint8_t keyno, uint8_t version, const DesfireKey& masterKey, const BinaryData& systemIdentifier)
+{
+    DesfireKeyDiversifier diversifier(masterKey, systemIdentifier);
+    if (!diversifier.IsValid() || _diversifiers.size() >= INT16_MAX)
+        return false;
+
+    Entry& entry = Insert(PackId(aid, keyno, version), masterKey.Type);
+    entry.Diversifier = _diversifiers.size();
+    _diversifiers.push_back(diversifier);
+
+    return true;
+}
+
+const DesfireKey* DesfireKeyStore::Get(uint32_t aid, uint8_t keyno, uint8_t version, const BinaryData& uid, AESContext** context)
+{
+    if (uid.size() > DESFIRE_KEY_STORE_MAX_UID || _cache.empty())
+        return nullptr;
+
+    uint64_t id = PackId(aid, keyno, version);
+
+    Entry* entry = Find(id);
+    if (!entry)
+        return nullptr;
+
+    // Static keys do not depend on card, so they are cached only once
+    bool diversified = entry->Diversifier >= 0;
+    size_t uidLen = diversified ? uid.size() : 0;
+
+    if (diversified && uid.empty())
+        return nullptr;
+
+    // Look for a cached key and the least recently used slot at the same time
+    CacheEntry* lru = &_cache[0];
+    for (CacheEntry& cached : _cache)
+    {
+        if (cached.LastUse && cached.Id == id && cached.UIDLen == uidLen &&
+            !memcmp(cached.UID, uid.data(), uidLen))
+        {
+            cached.LastUse = ++_useCounter;
+            if (context)
+                *context = cached.Context.IsValid() ? &cached.Context : nullptr;
+            return &cached.Key;
+        }
+
+        if (cached.LastUse < lru->LastUse)
+            lru = &cached;
+    }
+
+    // Materialize key into the evicted slot
+    if (diversified)
+    {
+        DesfireKey key = _diversifiers[entry->Diversifier].Diversify(uid, aid);
+        if (key.Type == DF_KEY_NONE)
+            return nullptr;
+
+        lru->Key.Key.assign(key.Key.begin(), key.Key.end());
+    }
+    else
+    {
+        auto material = _material.begin() + entry->Offset;
+        lru->Key.Key.assign(material, material + DesfireKeyLength(entry->Type));
+    }
+
+    lru->Key.Type = entry->Type;
+    lru->Id = id;
+    lru->UIDLen = uidLen;
+    memcpy(lru->UID, uid.data(), uidLen);
+    lru->LastUse = ++_useCounter;
+
+    // Key schedule is expanded once per materialized key, not per AES call
+    if (lru->Key.Type == DF_KEY_AES)
+        lru->Context.SetKey(lru->Key.Key);
+    else
+        lru->Context.Clear();
+
+    if (context)
+        *context = lru->Context.IsValid() ? &lru->Context : nullptr;
+
+    return &lru->Key;
+}
+
+void DesfireKeyStore::ClearCache()
+{
+    for (CacheEntry& cached : _cache)
+    {
+        cached.LastUse = 0;
+        cached.Context.Clear();
+    }
+}
+
+#endif
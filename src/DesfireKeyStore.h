@@ -0,0 +1,85 @@
+#ifndef __DESFIRE_KEY_STORE_H__
+#define __DESFIRE_KEY_STORE_H__
+
+#include <cstdint>
+#include <vector>
+#include "ByteBuffer.h"
+#include "Crypto.h"
+#include "DesfireKey.h"
+#include "DesfireKeyDiversifier.h"
+#include "PN532Config.h"
+
+// Number of materialized keys kept for recently seen cards
+#define DESFIRE_KEY_STORE_CACHE_SIZE 16
+// Longest (double size) ISO14443A UID
+#define DESFIRE_KEY_STORE_MAX_UID 10
+
+#if PN532_CONFIG_DESFIRE
+
+// Key store indexed by (AID, key number, key version).
+// Key material is kept in a single contiguous buffer. Keys handed out to
+// Desfire::Authenticate are materialized in a bounded LRU cache together
+// with the card UID, so a returning card reuses its diversified keys
+// without deriving them again and without heap allocations. AES keys are
+// cached with their expanded key schedule.
+class DesfireKeyStore
+{
+public:
+    DesfireKeyStore(size_t cacheSize = DESFIRE_KEY_STORE_CACHE_SIZE);
+
+    // Adds a static key. Replaces existing key with the same index
+    bool Add(uint32_t aid, uint8_t keyno, uint8_t version, const DesfireKey& key);
+
+    // Adds a master key which is diversified (AN10922) with card UID and AID on lookup
+    bool AddDiversified(uint32_t aid, uint8_t keyno, uint8_t version, const DesfireKey& masterKey, const BinaryData& systemIdentifier = BinaryData());
+
+    // Returns key for the given card or nullptr if not found. AES keys also
+    // return their cached schedule in context, nullptr for other key types.
+    // Pointers stay valid until the next call to Get.
+    const DesfireKey* Get(uint32_t aid, uint8_t keyno, uint8_t version, const BinaryData& uid = BinaryData(), AESContext** context = nullptr);
+
+    // Drops all cached keys (i.e. after master keys are rotated)
+    void ClearCache();
+
+    size_t Size() const
+    {
+        return _entries.size();
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t Id;            // Packed (AID, keyno, version)
+        DesfireKeyType_t Type;
+        uint16_t Offset;        // Offset of key material in _material
+        int16_t Diversifier;    // Index in _diversifiers or -1 for static keys
+    };
+
+    struct CacheEntry
+    {
+        uint64_t Id;
+        uint8_t UID[DESFIRE_KEY_STORE_MAX_UID];
+        uint8_t UIDLen;
+        uint32_t LastUse;       // 0 marks unused entry
+        DesfireKey Key;
+        AESContext Context;     // Schedule of AES keys, expanded when materialized
+    };
+
+    static uint64_t PackId(uint32_t aid, uint8_t keyno, uint8_t version)
+    {
+        return ((uint64_t)(aid & 0xFFFFFF) << 16) | ((uint16_t)keyno << 8) | version;
+    }
+
+    Entry* Find(uint64_t id);
+    Entry& Insert(uint64_t id, DesfireKeyType_t type);
+
+    std::vector<Entry> _entries; // Sorted by Id
+    BinaryData _material;
+    std::vector<DesfireKeyDiversifier> _diversifiers;
+    std::vector<CacheEntry> _cache;
+    uint32_t _useCounter;
+};
+
+#endif
+
+#endif
@@ -3,51 +3,38 @@
 
 #include <stdarg.h>  // For va_start, etc.
 #include <cstdio>
-#include <memory>    // For std::unique_ptr
-#include <cstring>
-#include <string>
+#include <exception>
+#include "Result.h"
 
+// Maximum formatted message length (longer messages are truncated)
+#define EXCEPTION_MAX_MESSAGE_SIZE 128
+
+// Library reports errors with Result. Exception is only meant for the edges
+// of an application which prefer throwing a formatted message.
 class Exception: public std::exception
 {
 public:
-    Exception(const char *text)
+    Exception(const char *fmt, ...)
     {
-        _msg.assign(text);
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(_msg, sizeof(_msg), fmt, ap);
+        va_end(ap);
     }
-    
-    Exception(std::string text)
+
+    Exception(const Result& result)
     {
-        _msg.assign(text);
+        snprintf(_msg, sizeof(_msg), "%s (origin %u, code 0x%X)", result.Message(), result.Origin, result.Code);
     }
-    
-    Exception(const std::string fmt_str, ...) {
-        int final_n, n = ((int)fmt_str.size()) * 2; /* Reserve two times as much as the length of the fmt_str */
-        
-        std::unique_ptr<char[]> formatted;
-        va_list ap;
-        while(1) {
-            formatted.reset(new char[n]); /* Wrap the plain char array into the unique_ptr */
-            strcpy(&formatted[0], fmt_str.c_str());
-            va_start(ap, fmt_str);
-            final_n = vsnprintf(&formatted[0], n, fmt_str.c_str(), ap);
-            va_end(ap);
-            if (final_n < 0 || final_n >= n)
-                n += abs(final_n - n + 1);
-            else
-                break;
-        }
-        
-        _msg = formatted.get();
-    }
-    
+
     virtual ~Exception() throw () {}
-    
+
     virtual const char* what() const throw () {
-       return _msg.c_str();
+       return _msg;
     }
 
 protected:
-    std::string _msg;
+    char _msg[EXCEPTION_MAX_MESSAGE_SIZE];
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,205 @@
+#include "FeliCa.h"
+
+#if PN532_CONFIG_FELICA
+
+#include <cstring>
+
+using namespace PN532Packets;
+
+// Block list element is 2 bytes for block numbers below 256, 3 bytes otherwise
+static uint8_t BlockListSize(const uint16_t* blocks, uint8_t count)
+{
+    uint8_t size = 0;
+    for (uint8_t i = 0; i < count; ++i)
+        size += blocks[i] > 0xFF ? 3 : 2;
+
+    return size;
+}
+
+FeliCa::FeliCa(TagInterface& interface, const TargetDataFeliCa& target) :
+    ReadBlocks(FELICA_DEFAULT_READ_BLOCKS), WriteBlocks(FELICA_DEFAULT_WRITE_BLOCKS),
+    _interface(interface), _systemCode(target.SystemCode)
+{
+    memcpy(_idm, target.NFCID2, FELICA_IDM_SIZE);
+    memcpy(_pmm, target.Pad, FELICA_PMM_SIZE);
+}
+
+ByteBuffer& FeliCa::BeginCommand(FeliCaCommand_t cmd, uint8_t len)
+{
+    ByteBuffer& buf = _interface.BeginWrite();
+    buf << len << cmd;
+    buf.Append(_idm, FELICA_IDM_SIZE);
+
+    return buf;
+}
+
+ByteBuffer& FeliCa::AppendBlockList(ByteBuffer& buf, uint16_t serviceCode, const uint16_t* blocks, uint8_t count)
+{
+    // Single service, code is sent LSB first
+    buf << (uint8_t)1 << (uint8_t)(serviceCode & 0xFF) << (uint8_t)(serviceCode >> 8);
+    buf << count;
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (blocks[i] > 0xFF)
+            buf << (uint8_t)0x00 << (uint8_t)(blocks[i] & 0xFF) << (uint8_t)(blocks[i] >> 8);
+        else
+            buf << (uint8_t)0x80 << (uint8_t)blocks[i];
+    }
+
+    return buf;
+}
+
+Result FeliCa::Exchange(FeliCaCommand_t cmd, BinaryView& response)
+{
+    Result result = _interface.EndWrite();
+    if (!result)
+        return result;
+
+    result = _interface.Read(response);
+    if (!result)
+        return result;
+
+    // Length byte includes itself
+    if (response.Size < 2 + FELICA_IDM_SIZE || response[0] != response.Size || response[1] != cmd + 1)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    if (cmd != FELICA_CMD_POLLING && memcmp(response.Data + 2, _idm, FELICA_IDM_SIZE))
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    return Result();
+}
+
+Result FeliCa::Polling(uint16_t systemCode)
+{
+    // Request system code, single time slot
+    _interface.BeginWrite() << (uint8_t)6 << FELICA_CMD_POLLING
+        << (uint8_t)(systemCode >> 8) << (uint8_t)(systemCode & 0xFF) << (uint8_t)0x01 << (uint8_t)0x00;
+
+    BinaryView response;
+    Result result = Exchange(FELICA_CMD_POLLING, response);
+    if (!result)
+        return result;
+
+    if (response.Size < 2 + FELICA_IDM_SIZE + FELICA_PMM_SIZE)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    memcpy(_idm, response.Data + 2, FELICA_IDM_SIZE);
+    memcpy(_pmm, response.Data + 2 + FELICA_IDM_SIZE, FELICA_PMM_SIZE);
+
+    _systemCode = 0xFFFF;
+    if (response.Size >= 20)
+        _systemCode = (response[18] << 8) | response[19];
+
+    return Result();
+}
+
+Result FeliCa::ReadWithoutEncryption(uint16_t serviceCode, const uint16_t* blocks, uint8_t count, BinaryData& out)
+{
+    if (count == 0 || count > FELICA_MAX_BLOCKS)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    // Length, command, IDm, service list and block count
+    uint8_t len = 14 + BlockListSize(blocks, count);
+    AppendBlockList(BeginCommand(FELICA_CMD_READ_WITHOUT_ENCRYPTION, len), serviceCode, blocks, count);
+
+    BinaryView response;
+    Result result = Exchange(FELICA_CMD_READ_WITHOUT_ENCRYPTION, response);
+    if (!result)
+        return result;
+
+    // Status flags follow IDm, block data is only present on success
+    if (response.Size < 12)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    result = Result::FeliCa(response[10], response[11]);
+    if (!result)
+        return result;
+
+    if (response.Size != 13U + count * FELICA_BLOCK_SIZE || response[12] != count)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    out.insert(out.end(), response.begin() + 13, response.end());
+
+    return Result();
+}
+
+Result FeliCa::WriteWithoutEncryption(uint16_t serviceCode, const uint16_t* blocks, uint8_t count, const uint8_t* data)
+{
+    if (count == 0 || count > FELICA_MAX_BLOCKS)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    uint16_t len = 14 + BlockListSize(blocks, count) + count * FELICA_BLOCK_SIZE;
+    if (len > 0xFF)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    ByteBuffer& buf = AppendBlockList(BeginCommand(FELICA_CMD_WRITE_WITHOUT_ENCRYPTION, len), serviceCode, blocks, count);
+    buf.Append(data, count * FELICA_BLOCK_SIZE);
+
+    BinaryView response;
+    Result result = Exchange(FELICA_CMD_WRITE_WITHOUT_ENCRYPTION, response);
+    if (!result)
+        return result;
+
+    if (response.Size != 12)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    return Result::FeliCa(response[10], response[11]);
+}
+
+Result FeliCa::Read(uint16_t serviceCode, uint16_t block, uint16_t count, BinaryData& out)
+{
+    if (ReadBlocks == 0 || ReadBlocks > FELICA_MAX_BLOCKS || (uint32_t)block + count > 0x10000)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    out.reserve(out.size() + count * FELICA_BLOCK_SIZE);
+
+    uint16_t blocks[FELICA_MAX_BLOCKS];
+
+    while (count)
+    {
+        uint8_t n = count < ReadBlocks ? count : ReadBlocks;
+        for (uint8_t i = 0; i < n; ++i)
+            blocks[i] = block + i;
+
+        Result result = ReadWithoutEncryption(serviceCode, blocks, n, out);
+        if (!result)
+            return result;
+
+        block += n;
+        count -= n;
+    }
+
+    return Result();
+}
+
+Result FeliCa::Write(uint16_t serviceCode, uint16_t block, const BinaryData& data)
+{
+    uint16_t count = data.size() / FELICA_BLOCK_SIZE;
+
+    if (WriteBlocks == 0 || WriteBlocks > FELICA_MAX_BLOCKS || data.size() % FELICA_BLOCK_SIZE ||
+        (uint32_t)block + count > 0x10000)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    uint16_t blocks[FELICA_MAX_BLOCKS];
+    const uint8_t* p = data.data();
+
+    while (count)
+    {
+        uint8_t n = count < WriteBlocks ? count : WriteBlocks;
+        for (uint8_t i = 0; i < n; ++i)
+            blocks[i] = block + i;
+
+        Result result = WriteWithoutEncryption(serviceCode, blocks, n, p);
+        if (!result)
+            return result;
+
+        block += n;
+        count -= n;
+        p += n * FELICA_BLOCK_SIZE;
+    }
+
+    return Result();
+}
+
+#endif
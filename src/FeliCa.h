@@ -0,0 +1,83 @@
+#ifndef __FELICA_H__
+#define __FELICA_H__
+
+#include "TagInterface.h"
+#include "PN532Packets.h"
+#include "Result.h"
+#include "PN532Config.h"
+
+#define FELICA_IDM_SIZE 8
+#define FELICA_PMM_SIZE 8
+#define FELICA_BLOCK_SIZE 16
+// Blocks per command so that response fits the single byte frame length
+#define FELICA_MAX_BLOCKS 15
+// Conservative limits accepted by all cards, larger cards take more
+#define FELICA_DEFAULT_READ_BLOCKS 4
+#define FELICA_DEFAULT_WRITE_BLOCKS 1
+
+enum FeliCaCommand_t : uint8_t
+{
+    FELICA_CMD_POLLING                  = 0x00,
+    FELICA_CMD_READ_WITHOUT_ENCRYPTION  = 0x06,
+    FELICA_CMD_WRITE_WITHOUT_ENCRYPTION = 0x08
+};
+
+#if PN532_CONFIG_FELICA
+
+// FeliCa driver for services without authentication. Commands are sent with
+// InDataExchange, PN532 only adds the CRC. Multi-block reads and writes are
+// split into commands of at most ReadBlocks and WriteBlocks blocks.
+class FeliCa
+{
+public:
+    FeliCa(TagInterface& interface, const PN532Packets::TargetDataFeliCa& target);
+
+    // Polls card again and updates IDm, PMm and system code. Selects the
+    // system of a card with multiple systems.
+    Result Polling(uint16_t systemCode = 0xFFFF);
+
+    // Single Read Without Encryption command for blocks of one service
+    Result ReadWithoutEncryption(uint16_t serviceCode, const uint16_t* blocks, uint8_t count, BinaryData& out);
+    // Single Write Without Encryption command, data holds 16 bytes per block
+    Result WriteWithoutEncryption(uint16_t serviceCode, const uint16_t* blocks, uint8_t count, const uint8_t* data);
+
+    // Reads count consecutive blocks starting at block
+    Result Read(uint16_t serviceCode, uint16_t block, uint16_t count, BinaryData& out);
+    // Writes data (multiple of 16 bytes) to consecutive blocks starting at block
+    Result Write(uint16_t serviceCode, uint16_t block, const BinaryData& data);
+
+    const uint8_t* IDm() const
+    {
+        return _idm;
+    }
+
+    const uint8_t* PMm() const
+    {
+        return _pmm;
+    }
+
+    // 0xFFFF if card did not report it
+    uint16_t SystemCode() const
+    {
+        return _systemCode;
+    }
+
+    uint8_t ReadBlocks;     // Blocks per read command (1 - FELICA_MAX_BLOCKS)
+    uint8_t WriteBlocks;    // Blocks per write command (1 - FELICA_MAX_BLOCKS)
+
+private:
+    // Starts frame with length byte, command code and IDm
+    ByteBuffer& BeginCommand(FeliCaCommand_t cmd, uint8_t len);
+    ByteBuffer& AppendBlockList(ByteBuffer& buf, uint16_t serviceCode, const uint16_t* blocks, uint8_t count);
+    // Sends frame and checks length byte, response code and IDm
+    Result Exchange(FeliCaCommand_t cmd, BinaryView& response);
+
+    TagInterface& _interface;
+    uint8_t _idm[FELICA_IDM_SIZE];
+    uint8_t _pmm[FELICA_PMM_SIZE];
+    uint16_t _systemCode;
+};
+
+#endif
+
+#endif
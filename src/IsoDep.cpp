@@ -0,0 +1,340 @@
+#include "IsoDep.h"
+
+#if PN532_CONFIG_ISO_DEP
+
+#include "CardIdentifier.h"
+#include "PN532Extended.h"
+
+// Largest WTXM a card may request
+#define ISO_DEP_MAX_WTXM 59
+
+// RF timeout in microseconds, each code doubles 100 us
+static uint32_t TimeoutMicros(RFTimeout_t code)
+{
+    return code == RF_TIMEOUT_NONE ? 0 : (uint32_t)100 << (code - 1);
+}
+
+// Shortest RF timeout covering the given time
+static RFTimeout_t TimeoutCode(uint32_t micros)
+{
+    uint8_t code = RF_TIMEOUT_100US;
+    while (code < RF_TIMEOUT_3_28S && TimeoutMicros((RFTimeout_t)code) < micros)
+        code++;
+
+    return (RFTimeout_t)code;
+}
+
+// Errors after which the card is asked to send its answer again
+static bool Recoverable(const Result& result)
+{
+    if (result.Origin != RESULT_ORIGIN_PN532)
+        return false;
+
+    switch (result.Code)
+    {
+    case PN532_STATUS_TIMEOUT:
+    case PN532_STATUS_CRC_ERROR:
+    case PN532_STATUS_PARITY_ERROR:
+    case PN532_STATUS_FRAMING_ERROR:
+    case PN532_STATUS_BIT_COLLISION:
+        return true;
+    default:
+        return false;
+    }
+}
+
+IsoDep::IsoDep(PN532Extended& reader) : MaxFrameSize(256), MaxRetries(ISO_DEP_MAX_RETRIES), _reader(reader),
+    _fsc(32), _fwt(ISO_DEP_FWT_MICROS(4)), _timeout(RF_TIMEOUT_51_2MS), _baseTimeout(RF_TIMEOUT_51_2MS), _block(0),
+    _lastOffset(0), _lastSize(0), _lastPCB(0), _pending(false), _blocks(0), _retransmissions(0), _extensions(0)
+{
+    _tx.Data().reserve(PN532_RX_BUFFER_SIZE);
+    _rx.Data().reserve(PN532_RX_BUFFER_SIZE);
+}
+
+Result IsoDep::Begin(const BinaryData& ats)
+{
+    ATSParameters params;
+    if (!CardIdentifier::DecodeATS(ats, params))
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    // FWI 15 is reserved and means default
+    _fsc = params.MaxFrameSize;
+    _fwt = ISO_DEP_FWT_MICROS(params.FWI < 15 ? params.FWI : 4);
+
+    // Block number of PCD starts with 0 after RATS
+    _block = 0;
+    _pending = false;
+    _rx.Clear();
+
+    // Timeout left by previous sessions is unknown, always configure it
+    _timeout = RF_TIMEOUT_NONE;
+    _baseTimeout = TimeoutCode(_fwt);
+
+    return SetTimeout(_baseTimeout);
+}
+
+Result IsoDep::SetTimeout(RFTimeout_t timeout)
+{
+    if (timeout == _timeout)
+        return Result();
+
+    // ATR_RES timeout of an applied RFProfile is kept
+    Result result = _reader.SetRetryTimeout(timeout);
+    if (result)
+        _timeout = timeout;
+
+    return result;
+}
+
+Result IsoDep::SendBlock(uint8_t pcb, const uint8_t* inf, size_t len)
+{
+    ByteBuffer& buf = _reader.BeginCommand(COMMAND_INCOMMUNICATETHRU);
+    buf << pcb;
+    buf.Append(inf, len);
+
+    _blocks++;
+
+    return _reader.WriteCommand();
+}
+
+Result IsoDep::ReceiveBlock(uint8_t& pcb, BinaryView& inf)
+{
+    // PN532 answers with timeout status once the RF timeout has passed
+    Result result = _reader.ReadResponse(PN532_DEFAULT_TIMEOUT + TimeoutMicros(_timeout) / 1000);
+    if (!result)
+        return result;
+
+    const BinaryData& response = _reader.Response().Data();
+    if (response.empty())
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    result = Result::PN532(response[0]);
+    if (!result)
+        return result;
+
+    // PCD never sends CID or NAD, so card must not use them either
+    if (response.size() < 2 || (response[1] & (ISO_DEP_PCB_CID | ISO_DEP_PCB_NAD)))
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    pcb = response[1];
+    inf = BinaryView(response).Sub(2);
+
+    return Result();
+}
+
+Result IsoDep::Recover(Result error, uint8_t& retries, bool chaining)
+{
+    if (!Recoverable(error) || retries >= MaxRetries)
+        return error;
+
+    retries++;
+    _retransmissions++;
+
+    // R(ACK) continues chaining of the card, R(NAK) asks for the answer again
+    return SendBlock((chaining ? ISO_DEP_PCB_R_ACK : ISO_DEP_PCB_R_NAK) | _block, nullptr, 0);
+}
+
+Result IsoDep::ExtendWaitingTime(const BinaryView& inf)
+{
+    if (inf.Size < 1)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    uint8_t wtxm = inf[0] & 0x3F;
+    if (!wtxm || wtxm > ISO_DEP_MAX_WTXM)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    _extensions++;
+
+    // Timeout is raised before acknowledging, it is lowered again with the next command
+    RFTimeout_t timeout = TimeoutCode(_fwt * wtxm);
+    if (timeout > _timeout)
+    {
+        Result result = SetTimeout(timeout);
+        if (!result)
+            return result;
+    }
+
+    return SendBlock(ISO_DEP_PCB_S_WTX, &wtxm, 1);
+}
+
+Result IsoDep::Receive(uint8_t& pcb, BinaryView& inf, bool chaining)
+{
+    uint8_t retries = 0;
+
+    for (;;)
+    {
+        Result result = ReceiveBlock(pcb, inf);
+        if (!result)
+        {
+            result = Recover(result, retries, chaining);
+            if (!result)
+                return result;
+            continue;
+        }
+
+        if (ISO_DEP_IS_S_BLOCK(pcb) && (pcb & ISO_DEP_PCB_WTX) == ISO_DEP_PCB_WTX)
+        {
+            result = ExtendWaitingTime(inf);
+            if (!result)
+                return result;
+            continue;
+        }
+
+        // R(ACK) with the other block number: card has missed the last I-block
+        if (!chaining && ISO_DEP_IS_R_BLOCK(pcb) && !(pcb & ISO_DEP_PCB_NAK) && (pcb & ISO_DEP_PCB_BLOCK_NUMBER) != _block)
+        {
+            if (retries >= MaxRetries)
+                return Result::PN532(PN532_STATUS_TIMEOUT);
+
+            retries++;
+            _retransmissions++;
+
+            result = SendBlock(_lastPCB, _tx.Data().data() + _lastOffset, _lastSize);
+            if (!result)
+                return result;
+            continue;
+        }
+
+        return Result();
+    }
+}
+
+ByteBuffer& IsoDep::BeginWrite()
+{
+    _tx.Clear();
+    return _tx;
+}
+
+Result IsoDep::EndWrite()
+{
+    // Timeout raised by S(WTX) only applied to the previous command
+    Result result = SetTimeout(_baseTimeout);
+    if (!result)
+        return result;
+
+    _pending = false;
+
+    size_t size = FrameSize() - ISO_DEP_BLOCK_OVERHEAD;
+    size_t offset = 0;
+
+    // Each chained block is acknowledged by the card with R(ACK)
+    while (_tx.Size() - offset > size)
+    {
+        _lastPCB = ISO_DEP_PCB_I_BLOCK | ISO_DEP_PCB_CHAINING | _block;
+        _lastOffset = offset;
+        _lastSize = size;
+
+        result = SendBlock(_lastPCB, _tx.Data().data() + offset, size);
+        if (!result)
+            return result;
+
+        uint8_t pcb;
+        BinaryView inf;
+        result = Receive(pcb, inf, false);
+        if (!result)
+            return result;
+
+        if (!ISO_DEP_IS_R_BLOCK(pcb) || (pcb & ISO_DEP_PCB_NAK))
+            return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+        _block ^= 1;
+        offset += size;
+    }
+
+    _lastPCB = ISO_DEP_PCB_I_BLOCK | _block;
+    _lastOffset = offset;
+    _lastSize = _tx.Size() - offset;
+
+    result = SendBlock(_lastPCB, _tx.Data().data() + offset, _lastSize);
+    if (result)
+        _pending = true;
+
+    return result;
+}
+
+Result IsoDep::Read(BinaryView& payload)
+{
+    if (!_pending)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    _pending = false;
+    _rx.Clear();
+
+    bool chaining = false;
+
+    for (;;)
+    {
+        uint8_t pcb;
+        BinaryView inf;
+        Result result = Receive(pcb, inf, chaining);
+        if (!result)
+            return result;
+
+        if (!ISO_DEP_IS_I_BLOCK(pcb) || (pcb & ISO_DEP_PCB_BLOCK_NUMBER) != _block)
+            return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+        _block ^= 1;
+
+        // Unchained answer is returned in place, without copy
+        if (!chaining && !(pcb & ISO_DEP_PCB_CHAINING))
+        {
+            payload = inf;
+            return Result();
+        }
+
+        _rx.Append(inf.Data, inf.Size);
+
+        if (!(pcb & ISO_DEP_PCB_CHAINING))
+        {
+            payload = BinaryView(_rx.Data());
+            return Result();
+        }
+
+        // Next block of the card is requested with R(ACK)
+        chaining = true;
+        result = SendBlock(ISO_DEP_PCB_R_ACK | _block, nullptr, 0);
+        if (!result)
+            return result;
+    }
+}
+
+Result IsoDep::Deselect()
+{
+    _pending = false;
+
+    Result result = SendBlock(ISO_DEP_PCB_S_DESELECT, nullptr, 0);
+    if (!result)
+        return result;
+
+    uint8_t pcb;
+    BinaryView inf;
+    result = ReceiveBlock(pcb, inf);
+    if (!result)
+        return result;
+
+    if (!ISO_DEP_IS_S_BLOCK(pcb) || (pcb & ISO_DEP_PCB_WTX))
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    return Result();
+}
+
+Result IsoDep::CheckPresence()
+{
+    Result result = SendBlock(ISO_DEP_PCB_R_NAK | _block, nullptr, 0);
+    if (!result)
+        return result;
+
+    uint8_t pcb;
+    BinaryView inf;
+    result = ReceiveBlock(pcb, inf);
+    if (!result)
+        return result;
+
+    // Card which has received the last I-block answers R(ACK) and keeps its state
+    if (!ISO_DEP_IS_R_BLOCK(pcb) || (pcb & ISO_DEP_PCB_NAK))
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    return Result();
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef __ISODEP_H__
+#define __ISODEP_H__
+
+#include <cstdint>
+#include "ByteBuffer.h"
+#include "PN532Config.h"
+#include "PN532Packets.h"
+#include "Result.h"
+
+// ISO14443-4 protocol control byte (PCB)
+enum IsoDepPCB_t : uint8_t
+{
+    ISO_DEP_PCB_I_BLOCK         = 0x02,
+    ISO_DEP_PCB_R_ACK           = 0xA2,
+    ISO_DEP_PCB_R_NAK           = 0xB2,
+    ISO_DEP_PCB_S_DESELECT      = 0xC2,
+    ISO_DEP_PCB_S_WTX           = 0xF2,
+    ISO_DEP_PCB_BLOCK_NUMBER    = 0x01,
+    ISO_DEP_PCB_CHAINING        = 0x10  // I-block, more blocks follow
+};
+
+// Flags of R- and S-blocks
+#define ISO_DEP_PCB_NAK 0x10            // R(NAK) when set, R(ACK) otherwise
+#define ISO_DEP_PCB_WTX 0x30            // S(WTX) when both bits are set, S(DESELECT) otherwise
+#define ISO_DEP_PCB_CID 0x08
+#define ISO_DEP_PCB_NAD 0x04
+
+// Block type is selected by the upper bits, CID, NAD and block number are masked out
+#define ISO_DEP_IS_I_BLOCK(pcb) (((pcb) & 0xE2) == ISO_DEP_PCB_I_BLOCK)
+#define ISO_DEP_IS_R_BLOCK(pcb) (((pcb) & 0xE6) == ISO_DEP_PCB_R_ACK)
+#define ISO_DEP_IS_S_BLOCK(pcb) (((pcb) & 0xC7) == ISO_DEP_PCB_S_DESELECT)
+
+// PCB and CRC around INF of each block
+#define ISO_DEP_BLOCK_OVERHEAD 3
+// Smallest frame size of ISO14443-4 (FSCI 0)
+#define ISO_DEP_MIN_FRAME_SIZE 16
+// Frame waiting time in microseconds (302 us * 2^FWI)
+#define ISO_DEP_FWT_MICROS(fwi) ((uint32_t)302 << (fwi))
+
+#if PN532_CONFIG_ISO_DEP
+
+class PN532Extended;
+
+// Retries of a block after a timeout or transmission error
+#define ISO_DEP_MAX_RETRIES 2
+
+// Host side ISO14443-4 (ISO-DEP) block protocol over InCommunicateThru. The
+// PN532 only adds CRC and applies the RF timeout, block numbers, chaining,
+// R(ACK)/R(NAK) recovery and S(WTX) are handled here. Bind a TagInterface to
+// it to use card drivers.
+//
+// The target is activated with InListPassiveTarget (RATS is sent by the
+// PN532). Afterwards it must not be used with InDataExchange or Diagnose
+// (PN532Extended::CheckPresence), which keep their own block number.
+class IsoDep
+{
+public:
+    IsoDep(PN532Extended& reader);
+
+    // Starts a session with the activated target. Frame size and waiting
+    // time are taken from ATS (without length byte), the RF timeout of the
+    // PN532 is set to cover the frame waiting time.
+    Result Begin(const BinaryData& ats);
+    // Sends S(DESELECT). Target has to be activated again
+    Result Deselect();
+    // Sends R(NAK), which a card in the field answers with R(ACK)
+    Result CheckPresence();
+
+    // Starts a command APDU (INF) in the transmit buffer
+    ByteBuffer& BeginWrite();
+    // Sends APDU built with BeginWrite. Chained blocks are acknowledged
+    // before return, the last block is answered in Read.
+    Result EndWrite();
+    // Receives response APDU. View is valid until the next Write or Read
+    Result Read(BinaryView& payload);
+
+    // Upper limit of transmitted frame size (PCB, INF and CRC), FSC of card
+    // applies if lower. Values below ISO_DEP_MIN_FRAME_SIZE are raised to it
+    uint16_t MaxFrameSize;
+    // Retries per block, see ISO_DEP_MAX_RETRIES
+    uint8_t MaxRetries;
+
+    uint16_t FrameSize() const
+    {
+        uint16_t size = _fsc < MaxFrameSize ? _fsc : MaxFrameSize;
+        return size < ISO_DEP_MIN_FRAME_SIZE ? ISO_DEP_MIN_FRAME_SIZE : size;
+    }
+
+    // Blocks sent to card including acknowledgements
+    uint32_t Blocks() const
+    {
+        return _blocks;
+    }
+
+    // Blocks sent again after a timeout or transmission error
+    uint32_t Retransmissions() const
+    {
+        return _retransmissions;
+    }
+
+    uint32_t WaitingTimeExtensions() const
+    {
+        return _extensions;
+    }
+
+private:
+    Result SendBlock(uint8_t pcb, const uint8_t* inf, size_t len);
+    // Receives answer to a block. Returns PN532 status, block in pcb and inf
+    Result ReceiveBlock(uint8_t& pcb, BinaryView& inf);
+    // Receives the next I- or R-block. Lost blocks are recovered, S(WTX) is
+    // answered and the last I-block is sent again if the card has missed it.
+    Result Receive(uint8_t& pcb, BinaryView& inf, bool chaining);
+    Result Recover(Result error, uint8_t& retries, bool chaining);
+    Result ExtendWaitingTime(const BinaryView& inf);
+    Result SetTimeout(PN532Packets::RFTimeout_t timeout);
+
+    PN532Extended& _reader;
+    ByteBuffer _tx;             // Command INF built with BeginWrite
+    ByteBuffer _rx;             // Chained response INF
+    uint16_t _fsc;              // Frame size of card
+    uint32_t _fwt;              // Frame waiting time in microseconds
+    PN532Packets::RFTimeout_t _timeout;     // Configured RF timeout
+    PN532Packets::RFTimeout_t _baseTimeout; // RF timeout covering FWT
+    uint8_t _block;             // Current block number of PCD
+    size_t _lastOffset;         // INF of last I-block in _tx, sent again on error
+    size_t _lastSize;
+    uint8_t _lastPCB;
+    bool _pending;              // Last I-block sent, answer not read yet
+    uint32_t _blocks;
+    uint32_t _retransmissions;
+    uint32_t _extensions;
+};
+
+#endif
+
+#endif
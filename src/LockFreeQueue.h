@@ -0,0 +1,91 @@
+#ifndef __LOCKFREEQUEUE_H__
+#define __LOCKFREEQUEUE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer multi-consumer queue (D. Vyukov). Push and Pop never
+// block or allocate; they fail when the queue is full or empty respectively.
+template<typename T, size_t Capacity>
+class LockFreeQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    LockFreeQueue() : _enqueuePos(0), _dequeuePos(0)
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+            _cells[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool Push(const T& data)
+    {
+        Cell* cell;
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            cell = &_cells[pos & (Capacity - 1)];
+            size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0)
+            {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // Full
+            else
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+
+        cell->Data = data;
+        cell->Sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool Pop(T& data)
+    {
+        Cell* cell;
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            cell = &_cells[pos & (Capacity - 1)];
+            size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+            if (diff == 0)
+            {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // Empty
+            else
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+        }
+
+        data = cell->Data;
+        cell->Sequence.store(pos + Capacity, std::memory_order_release);
+
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> Sequence;
+        T Data;
+    };
+
+    Cell _cells[Capacity];
+    // Separate cache lines to avoid false sharing between producers and consumers
+    alignas(64) std::atomic<size_t> _enqueuePos;
+    alignas(64) std::atomic<size_t> _dequeuePos;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "LowPowerPoller.h"
+
+LowPowerPoller::LowPowerPoller(PN532Extended& nfc, const RFProfile* profile) :
+    Types({AUTOPOLL_GENERIC_106KBPS}), WakeUpSources(WAKEUP_HSU | WAKEUP_RF), _nfc(nfc), _profile(profile), _restores(0)
+{
+
+}
+
+Result LowPowerPoller::Configure()
+{
+    Result result = _nfc.SAMConfig();
+    if (result && _profile)
+        result = _nfc.ApplyRFProfile(*_profile);
+
+    return result;
+}
+
+Result LowPowerPoller::Begin()
+{
+    _nfc.begin();
+
+    Result result = Configure();
+    if (!result)
+        return result;
+
+    return _nfc.PowerDown(WakeUpSources);
+}
+
+Result LowPowerPoller::Poll(InAutoPollResponse& resp)
+{
+    // Fast path: preamble and the poll itself
+    _nfc.WakeUp();
+
+    Result result = _nfc.InAutoPoll(resp, Types, 1, 0x01, LOW_POWER_POLLER_TIMEOUT);
+
+    // A PN532 which does not answer has lost its settings or missed the wake-up
+    if (!result && result.Origin == RESULT_ORIGIN_TRANSPORT)
+    {
+        _restores++;
+        _nfc.begin();
+
+        result = Configure();
+        if (!result)
+            return result;
+
+        result = _nfc.InAutoPoll(resp, Types, 1, 0x01, LOW_POWER_POLLER_TIMEOUT);
+    }
+
+    if (!result)
+        return result;
+
+    if (!resp.NbTg)
+        return _nfc.PowerDown(WakeUpSources);
+
+    return Result();
+}
+
+Result LowPowerPoller::Sleep()
+{
+    // PowerDown releases all targets
+    _nfc.WakeUp();
+
+    return _nfc.PowerDown(WakeUpSources);
+}
@@ -0,0 +1,54 @@
+#ifndef __LOWPOWERPOLLER_H__
+#define __LOWPOWERPOLLER_H__
+
+#include <cstdint>
+#include "PN532Extended.h"
+#include "RFProfile.h"
+#include "Result.h"
+
+// Response timeout of a single InAutoPoll round
+#define LOW_POWER_POLLER_TIMEOUT 500 // ms
+
+// Duty cycled polling for battery powered readers. The PN532 sleeps in
+// PowerDown between polls, Poll wakes it with the wake-up preamble and runs a
+// single InAutoPoll round. SAMConfig and RF settings survive PowerDown, so they
+// are only sent again when the PN532 stopped answering (after a brown-out it
+// restarts in LowVbat mode and drops them).
+//
+// The host sleeps between calls to Poll. Detection latency is about half the
+// host sleep interval plus the wake-to-first-response time of Poll.
+class LowPowerPoller
+{
+public:
+    // Profile is applied by Begin and after restarts (nullptr keeps PN532 defaults)
+    LowPowerPoller(PN532Extended& nfc, const RFProfile* profile = nullptr);
+
+    // Wakes and configures PN532, then puts it into PowerDown
+    Result Begin();
+    // Wakes PN532 and polls all Types once. Without targets the PN532 is put
+    // back into PowerDown, found targets stay activated until Sleep is called.
+    Result Poll(InAutoPollResponse& resp);
+    // Releases targets and enters PowerDown
+    Result Sleep();
+
+    // AutoPollType_t polled by Poll, ISO14443 Type A by default
+    BinaryData Types;
+    // WakeUpSource_t bits of PowerDown. WAKEUP_RF wakes up on the field of a
+    // phone or another reader (passive cards have no field and need Poll).
+    uint8_t WakeUpSources;
+
+    // Number of times SAMConfig and the profile had to be sent again
+    uint32_t Restores() const
+    {
+        return _restores;
+    }
+
+private:
+    Result Configure();
+
+    PN532Extended& _nfc;
+    const RFProfile* _profile;
+    uint32_t _restores;
+};
+
+#endif
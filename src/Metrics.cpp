@@ -0,0 +1,195 @@
+#include "Metrics.h"
+
+#if PN532_METRICS
+
+#include <cstdarg>
+#include <cstdio>
+
+uint32_t LatencyHistogramSnapshot::PercentileMicros(float fraction) const
+{
+    if (!Count)
+        return 0;
+
+    uint32_t target = fraction * Count;
+    uint32_t seen = 0;
+
+    for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; ++i)
+    {
+        seen += Buckets[i];
+        // Bucket bound can exceed the largest recorded sample
+        if (seen > target)
+            return ((uint32_t)1 << i) < MaxMicros ? ((uint32_t)1 << i) : MaxMicros;
+    }
+
+    return MaxMicros;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+void LatencyHistogram::Record(uint32_t micros)
+{
+    // Index of the highest set bit + 1, so bucket i holds [2^(i-1), 2^i)
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_HISTOGRAM_BUCKETS - 1 && (micros >> bucket))
+        bucket++;
+
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+
+    // Low word wrapped when the result is smaller than the added value
+    uint32_t sum = _sum.fetch_add(micros, std::memory_order_relaxed) + micros;
+    if (sum < micros)
+        _sumWraps.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t max = _max.load(std::memory_order_relaxed);
+    while (micros > max && !_max.compare_exchange_weak(max, micros, std::memory_order_relaxed));
+}
+
+void LatencyHistogram::Snapshot(LatencyHistogramSnapshot& out) const
+{
+    // Counters are read independently, so a snapshot taken under load may be off by in-flight samples
+    for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i)
+        out.Buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+
+    out.Count = _count.load(std::memory_order_relaxed);
+    out.MaxMicros = _max.load(std::memory_order_relaxed);
+
+    // Sum is read again if it has wrapped in between
+    uint32_t wraps, sum;
+    do
+    {
+        wraps = _sumWraps.load(std::memory_order_relaxed);
+        sum = _sum.load(std::memory_order_relaxed);
+    }
+    while (wraps != _sumWraps.load(std::memory_order_relaxed));
+
+    out.SumMicros = ((uint64_t)wraps << 32) | sum;
+}
+
+void LatencyHistogram::Reset()
+{
+    for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i)
+        _buckets[i].store(0, std::memory_order_relaxed);
+
+    _count.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _sumWraps.store(0, std::memory_order_relaxed);
+}
+
+PN532Metrics::PN532Metrics()
+{
+    HSUBytesSent.store(0, std::memory_order_relaxed);
+    HSUBytesReceived.store(0, std::memory_order_relaxed);
+    HSUNacks.store(0, std::memory_order_relaxed);
+    HSUAckResends.store(0, std::memory_order_relaxed);
+
+    for (uint16_t i = 0; i < 256; ++i)
+        DesfireStatus[i].store(0, std::memory_order_relaxed);
+}
+
+void PN532Metrics::Reset()
+{
+    HSUWrite.Reset();
+    HSUAckWait.Reset();
+    HSUResponse.Reset();
+    HSUBytesSent.store(0, std::memory_order_relaxed);
+    HSUBytesReceived.store(0, std::memory_order_relaxed);
+    HSUNacks.store(0, std::memory_order_relaxed);
+    HSUAckResends.store(0, std::memory_order_relaxed);
+    Commands.Reset();
+    Instructions.Reset();
+
+    for (uint16_t i = 0; i < 256; ++i)
+        DesfireStatus[i].store(0, std::memory_order_relaxed);
+}
+
+// Appends formatted text and advances pos, never past size
+static void Append(char *buf, size_t size, size_t& pos, const char *fmt, ...)
+{
+    if (pos >= size)
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + pos, size - pos, fmt, ap);
+    va_end(ap);
+
+    if (n > 0)
+        pos = (pos + n < size) ? pos + n : size - 1;
+}
+
+// Key of -1 means histogram is not keyed
+static void AppendSnapshot(char *buf, size_t size, size_t& pos, const char *name, int key, const LatencyHistogramSnapshot& s)
+{
+    if (!s.Count)
+        return;
+
+    if (key >= 0)
+        Append(buf, size, pos, "%s{code=0x%02X} ", name, key);
+    else
+        Append(buf, size, pos, "%s ", name);
+
+    // uint32_t is unsigned long on some toolchains, so values are cast for printf
+    Append(buf, size, pos, "count=%lu mean=%lu p50=%lu p99=%lu max=%lu\n", (unsigned long)s.Count,
+        (unsigned long)s.MeanMicros(), (unsigned long)s.PercentileMicros(0.5f),
+        (unsigned long)s.PercentileMicros(0.99f), (unsigned long)s.MaxMicros);
+}
+
+size_t PN532Metrics::Format(char *buf, size_t size) const
+{
+    size_t pos = 0;
+    uint8_t key;
+    LatencyHistogramSnapshot s;
+
+    if (!size)
+        return 0;
+
+    buf[0] = 0;
+
+    HSUWrite.Snapshot(s);
+    AppendSnapshot(buf, size, pos, "hsu_write_us", -1, s);
+    HSUAckWait.Snapshot(s);
+    AppendSnapshot(buf, size, pos, "hsu_ack_wait_us", -1, s);
+    HSUResponse.Snapshot(s);
+    AppendSnapshot(buf, size, pos, "hsu_response_us", -1, s);
+
+    Append(buf, size, pos, "hsu_bytes_sent %lu\nhsu_bytes_received %lu\n",
+        (unsigned long)HSUBytesSent.load(std::memory_order_relaxed),
+        (unsigned long)HSUBytesReceived.load(std::memory_order_relaxed));
+    Append(buf, size, pos, "hsu_nacks %lu\nhsu_ack_resends %lu\n",
+        (unsigned long)HSUNacks.load(std::memory_order_relaxed),
+        (unsigned long)HSUAckResends.load(std::memory_order_relaxed));
+
+    for (size_t i = 0; i < Commands.Capacity(); ++i)
+    {
+        if (Commands.Snapshot(i, key, s))
+            AppendSnapshot(buf, size, pos, "pn532_command_us", key, s);
+    }
+
+    for (size_t i = 0; i < Instructions.Capacity(); ++i)
+    {
+        if (Instructions.Snapshot(i, key, s))
+            AppendSnapshot(buf, size, pos, "desfire_instruction_us", key, s);
+    }
+
+    for (uint16_t i = 0; i < 256; ++i)
+    {
+        uint32_t count = DesfireStatus[i].load(std::memory_order_relaxed);
+        if (count)
+            Append(buf, size, pos, "desfire_status{code=0x%02X} %lu\n", i, (unsigned long)count);
+    }
+
+    return pos;
+}
+
+PN532Metrics& GetMetrics()
+{
+    static PN532Metrics metrics;
+    return metrics;
+}
+
+#endif
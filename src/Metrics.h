@@ -0,0 +1,184 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include "PN532Config.h"
+
+// Latency instrumentation. Enable with -DPN532_METRICS=1, otherwise all hooks compile to nothing
+
+#if PN532_METRICS
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "Platform.h"
+
+// Bucket i holds samples in [2^(i-1), 2^i) microseconds, last bucket holds everything longer
+#define LATENCY_HISTOGRAM_BUCKETS 24
+#define METRICS_MAX_COMMANDS 16
+#define METRICS_MAX_INSTRUCTIONS 32
+
+struct LatencyHistogramSnapshot
+{
+    uint32_t Count;
+    uint32_t MaxMicros;
+    uint64_t SumMicros;
+    uint32_t Buckets[LATENCY_HISTOGRAM_BUCKETS];
+
+    uint32_t MeanMicros() const
+    {
+        return Count ? SumMicros / Count : 0;
+    }
+
+    // Upper bound of the bucket containing given fraction (0..1) of samples
+    uint32_t PercentileMicros(float fraction) const;
+};
+
+// Fixed bucket histogram. Record is wait-free and can be called from any thread
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Record(uint32_t micros);
+    void Snapshot(LatencyHistogramSnapshot& out) const;
+    void Reset();
+
+private:
+    std::atomic<uint32_t> _buckets[LATENCY_HISTOGRAM_BUCKETS];
+    std::atomic<uint32_t> _count;
+    std::atomic<uint32_t> _max;
+    // 64-bit atomics are not lock-free on 32-bit targets (Xtensa), so the
+    // sum is kept as low word and count of its overflows
+    std::atomic<uint32_t> _sum;
+    std::atomic<uint32_t> _sumWraps;
+};
+
+// Histograms keyed by command or instruction code. Slots are claimed on first use
+template<size_t N>
+class KeyedLatencyHistograms
+{
+public:
+    KeyedLatencyHistograms()
+    {
+        for (size_t i = 0; i < N; ++i)
+            _keys[i].store(0, std::memory_order_relaxed);
+    }
+
+    // Returns nullptr when all slots are taken by other keys
+    LatencyHistogram* Get(uint8_t key)
+    {
+        // Stored keys are offset by one, 0 marks a free slot
+        uint16_t stored = key + 1;
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            uint16_t current = _keys[i].load(std::memory_order_acquire);
+
+            if (current == 0)
+            {
+                uint16_t expected = 0;
+                if (_keys[i].compare_exchange_strong(expected, stored, std::memory_order_acq_rel))
+                    return &_histograms[i];
+                current = expected;
+            }
+
+            if (current == stored)
+                return &_histograms[i];
+        }
+
+        return nullptr;
+    }
+
+    size_t Capacity() const
+    {
+        return N;
+    }
+
+    // Snapshot of slot i. Returns false if slot is unused
+    bool Snapshot(size_t i, uint8_t& key, LatencyHistogramSnapshot& out) const
+    {
+        uint16_t stored = _keys[i].load(std::memory_order_acquire);
+        if (!stored)
+            return false;
+
+        key = stored - 1;
+        _histograms[i].Snapshot(out);
+
+        return true;
+    }
+
+    void Reset()
+    {
+        for (size_t i = 0; i < N; ++i)
+            _histograms[i].Reset();
+    }
+
+private:
+    std::atomic<uint16_t> _keys[N];
+    LatencyHistogram _histograms[N];
+};
+
+// Global instrumentation of all layers
+struct PN532Metrics
+{
+    PN532Metrics();
+
+    // HSU transport
+    LatencyHistogram HSUWrite;      // Writing command frame
+    LatencyHistogram HSUAckWait;    // End of write to received ACK
+    LatencyHistogram HSUResponse;   // Waiting for and receiving response frame
+    std::atomic<uint32_t> HSUBytesSent;
+    std::atomic<uint32_t> HSUBytesReceived;
+    std::atomic<uint32_t> HSUNacks;        // Corrupted responses requested again
+    std::atomic<uint32_t> HSUAckResends;   // Commands sent again after missing ACK
+
+    // PN532Extended: command sent to response received, keyed by Commands
+    KeyedLatencyHistograms<METRICS_MAX_COMMANDS> Commands;
+
+    // Desfire command latency keyed by DesfireInstruction_t, and count of each DesfireStatus_t.
+    // Recorded by Desfire::Transceive and DesfireAuthenticateJob
+    KeyedLatencyHistograms<METRICS_MAX_INSTRUCTIONS> Instructions;
+    std::atomic<uint32_t> DesfireStatus[256];
+
+    void Reset();
+    // Writes snapshot of all non-empty metrics as text lines. Returns length (truncated to size)
+    size_t Format(char *buf, size_t size) const;
+};
+
+PN532Metrics& GetMetrics();
+
+// Records elapsed time into histogram when leaving the scope
+class ScopedLatency
+{
+public:
+    ScopedLatency(LatencyHistogram* histogram) : _histogram(histogram), _start(PlatformMicros()) {}
+
+    ~ScopedLatency()
+    {
+        if (_histogram)
+            _histogram->Record(PlatformMicros() - _start);
+    }
+
+private:
+    LatencyHistogram* _histogram;
+    uint32_t _start;
+};
+
+#define METRICS_START(var) uint32_t var = PlatformMicros()
+#define METRICS_RECORD(histogram, start) GetMetrics().histogram.Record(PlatformMicros() - (start))
+#define METRICS_RECORD_KEYED(table, key, start) \
+    do { LatencyHistogram* h_ = GetMetrics().table.Get(key); if (h_) h_->Record(PlatformMicros() - (start)); } while (0)
+#define METRICS_SCOPE_KEYED(table, key) ScopedLatency metricsScope_(GetMetrics().table.Get(key))
+#define METRICS_COUNT(counter, n) GetMetrics().counter.fetch_add(n, std::memory_order_relaxed)
+
+#else
+
+#define METRICS_START(var)
+#define METRICS_RECORD(histogram, start) ((void)0)
+#define METRICS_RECORD_KEYED(table, key, start) ((void)0)
+#define METRICS_SCOPE_KEYED(table, key)
+#define METRICS_COUNT(counter, n) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,216 @@
+#include "MifareClassic.h"
+
+#if PN532_CONFIG_MIFARE_CLASSIC
+
+#include <algorithm>
+#include <cstring>
+
+const MifareKey MIFARE_DEFAULT_KEY = { MIFARE_KEY_A, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } };
+
+bool MifareKey::operator==(const MifareKey& other) const
+{
+    return Type == other.Type && !memcmp(Key, other.Key, MIFARE_KEY_SIZE);
+}
+
+MifareClassic::MifareClassic(TagInterface& interface, const BinaryData& uid, CardType_t type) :
+    _interface(interface), _sectors(SectorCount(type)), _authSector(-1), _authentications(0)
+{
+    memset(_uid, 0, sizeof(_uid));
+    if (uid.size() >= 4)
+        memcpy(_uid, uid.data() + uid.size() - 4, 4);
+
+    SetKey(MIFARE_DEFAULT_KEY);
+}
+
+uint8_t MifareClassic::SectorCount(CardType_t type)
+{
+    switch (type)
+    {
+        case CARD_TYPE_MIFARE_MINI:         return 5;
+        case CARD_TYPE_MIFARE_CLASSIC_1K:   return 16;
+        case CARD_TYPE_SMARTMX_CLASSIC_1K:  return 16;
+        case CARD_TYPE_MIFARE_CLASSIC_2K:   return 32;
+        case CARD_TYPE_MIFARE_CLASSIC_4K:   return 40;
+        case CARD_TYPE_SMARTMX_CLASSIC_4K:  return 40;
+        default:                            return 0;
+    }
+}
+
+uint8_t MifareClassic::SectorOfBlock(uint8_t block)
+{
+    return block < 128 ? block / 4 : 32 + (block - 128) / 16;
+}
+
+uint8_t MifareClassic::FirstBlockOfSector(uint8_t sector)
+{
+    return sector < 32 ? sector * 4 : 128 + (sector - 32) * 16;
+}
+
+uint8_t MifareClassic::BlocksInSector(uint8_t sector)
+{
+    return sector < 32 ? 4 : 16;
+}
+
+bool MifareClassic::IsTrailerBlock(uint8_t block)
+{
+    uint8_t sector = SectorOfBlock(block);
+    return block == FirstBlockOfSector(sector) + BlocksInSector(sector) - 1;
+}
+
+void MifareClassic::SetKey(uint8_t sector, const MifareKey& key)
+{
+    if (sector < MIFARE_MAX_SECTORS)
+        _keys[sector] = key;
+}
+
+void MifareClassic::SetKey(const MifareKey& key)
+{
+    for (uint8_t i = 0; i < MIFARE_MAX_SECTORS; ++i)
+        _keys[i] = key;
+}
+
+void MifareClassic::ClearAuthentication()
+{
+    _authSector = -1;
+}
+
+Result MifareClassic::Authenticate(uint8_t sector)
+{
+    if (sector >= _sectors)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    const MifareKey& key = _keys[sector];
+
+    if (_authSector == sector && _authKey == key)
+        return Result();
+
+    // Any block of the sector selects it, trailer is used by convention
+    ByteBuffer& buf = _interface.BeginWrite();
+    buf << key.Type;
+    buf << (uint8_t)(FirstBlockOfSector(sector) + BlocksInSector(sector) - 1);
+    buf.Append(key.Key, MIFARE_KEY_SIZE);
+    buf.Append(_uid, sizeof(_uid));
+
+    _authSector = -1;
+    _authentications++;
+
+    Result result = _interface.EndWrite();
+    if (!result)
+        return result;
+
+    BinaryView response;
+    result = _interface.Read(response);
+    if (!result)
+        return result;
+
+    _authSector = sector;
+    _authKey = key;
+
+    return Result();
+}
+
+Result MifareClassic::ReadBlock(uint8_t block, uint8_t data[MIFARE_BLOCK_SIZE])
+{
+    Result result = Authenticate(SectorOfBlock(block));
+    if (!result)
+        return result;
+
+    _interface.BeginWrite() << MIFARE_CMD_READ << block;
+
+    result = _interface.EndWrite();
+    if (result)
+    {
+        BinaryView response;
+        result = _interface.Read(response);
+
+        if (result && response.Size != MIFARE_BLOCK_SIZE)
+            result = Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+        if (result)
+            memcpy(data, response.Data, MIFARE_BLOCK_SIZE);
+    }
+
+    // Card halts on errors and loses its authentication
+    if (!result)
+        _authSector = -1;
+
+    return result;
+}
+
+Result MifareClassic::WriteBlock(uint8_t block, const uint8_t data[MIFARE_BLOCK_SIZE])
+{
+    Result result = Authenticate(SectorOfBlock(block));
+    if (!result)
+        return result;
+
+    // PN532 handles both phases of the write
+    ByteBuffer& buf = _interface.BeginWrite();
+    buf << MIFARE_CMD_WRITE << block;
+    buf.Append(data, MIFARE_BLOCK_SIZE);
+
+    result = _interface.EndWrite();
+    if (result)
+    {
+        BinaryView response;
+        result = _interface.Read(response);
+    }
+
+    if (!result)
+        _authSector = -1;
+
+    return result;
+}
+
+Result MifareClassic::ReadBlocks(const BinaryData& blocks, BinaryData& out)
+{
+    // Visit blocks grouped by sector, starting with the authenticated one
+    if (blocks.size() > MIFARE_MAX_BLOCKS)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    uint8_t order[MIFARE_MAX_BLOCKS];
+    uint16_t count = blocks.size();
+    int16_t current = _authSector;
+
+    for (uint16_t i = 0; i < count; ++i)
+        order[i] = i;
+
+    std::stable_sort(order, order + count, [&](uint8_t a, uint8_t b) {
+        uint8_t sa = SectorOfBlock(blocks[a]), sb = SectorOfBlock(blocks[b]);
+        if (sa == sb)
+            return false;
+        if (sa == current || sb == current)
+            return sa == current;
+        return sa < sb;
+    });
+
+    size_t offset = out.size();
+    out.resize(offset + count * MIFARE_BLOCK_SIZE);
+
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        Result result = ReadBlock(blocks[order[i]], out.data() + offset + order[i] * MIFARE_BLOCK_SIZE);
+        if (!result)
+        {
+            out.resize(offset);
+            return result;
+        }
+    }
+
+    return Result();
+}
+
+Result MifareClassic::Dump(BinaryData& out)
+{
+    if (!_sectors)
+        return Result::Library(RESULT_ERROR_UNSUPPORTED);
+
+    uint8_t last = FirstBlockOfSector(_sectors - 1) + BlocksInSector(_sectors - 1) - 1;
+
+    BinaryData blocks(last + 1);
+    for (uint16_t i = 0; i <= last; ++i)
+        blocks[i] = i;
+
+    return ReadBlocks(blocks, out);
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef __MIFARECLASSIC_H__
+#define __MIFARECLASSIC_H__
+
+#include "TagInterface.h"
+#include "ByteBuffer.h"
+#include "Result.h"
+#include "PN532Extended.h"
+#include "PN532Config.h"
+
+#define MIFARE_BLOCK_SIZE 16
+#define MIFARE_KEY_SIZE 6
+// Mifare Classic 4K has 32 sectors of 4 blocks and 8 sectors of 16 blocks
+#define MIFARE_MAX_SECTORS 40
+#define MIFARE_MAX_BLOCKS 256
+
+// Key type is sent as authentication command
+enum MifareKeyType_t : uint8_t
+{
+    MIFARE_KEY_A = 0x60,
+    MIFARE_KEY_B = 0x61
+};
+
+enum MifareCommand_t : uint8_t
+{
+    MIFARE_CMD_READ     = 0x30,
+    MIFARE_CMD_WRITE    = 0xA0
+};
+
+struct MifareKey
+{
+    MifareKeyType_t Type;
+    uint8_t Key[MIFARE_KEY_SIZE];
+
+    bool operator==(const MifareKey& other) const;
+};
+
+// Transport key of new cards (key A FF FF FF FF FF FF)
+extern const MifareKey MIFARE_DEFAULT_KEY;
+
+#if PN532_CONFIG_MIFARE_CLASSIC
+
+// Mifare Mini, Classic 1K and 4K driver. Crypto1 is handled by PN532, the
+// driver remembers which sector is authenticated with which key and skips
+// authentication while consecutive commands stay in that sector. Multi block
+// reads are reordered by sector, so each sector is authenticated once.
+//
+// Failed commands leave the card halted. Authentication state is then
+// cleared and the card has to be activated again (InListPassiveTarget).
+class MifareClassic
+{
+public:
+    // UID and card type come from target data of InListPassiveTarget
+    MifareClassic(TagInterface& interface, const BinaryData& uid, CardType_t type);
+
+    static uint8_t SectorCount(CardType_t type);
+    static uint8_t SectorOfBlock(uint8_t block);
+    static uint8_t FirstBlockOfSector(uint8_t sector);
+    static uint8_t BlocksInSector(uint8_t sector);
+    static bool IsTrailerBlock(uint8_t block);
+
+    // Key used for sector (all sectors use MIFARE_DEFAULT_KEY initially)
+    void SetKey(uint8_t sector, const MifareKey& key);
+    void SetKey(const MifareKey& key);
+
+    // Authenticates sector with its key unless it is already authenticated with it
+    Result Authenticate(uint8_t sector);
+    // Forgets authentication state, next command authenticates again
+    void ClearAuthentication();
+
+    Result ReadBlock(uint8_t block, uint8_t data[MIFARE_BLOCK_SIZE]);
+    Result WriteBlock(uint8_t block, const uint8_t data[MIFARE_BLOCK_SIZE]);
+
+    // Reads blocks in sector order. Data is stored in order of blocks (16 bytes each)
+    Result ReadBlocks(const BinaryData& blocks, BinaryData& out);
+    // Reads all blocks of the card
+    Result Dump(BinaryData& out);
+
+    // Authentications sent to the card since construction
+    uint32_t Authentications() const
+    {
+        return _authentications;
+    }
+
+private:
+    TagInterface& _interface;
+    uint8_t _uid[4];        // UID bytes used by Crypto1 (last 4 bytes of 7 byte UIDs)
+    uint8_t _sectors;
+    MifareKey _keys[MIFARE_MAX_SECTORS];
+    int16_t _authSector;    // -1 if none
+    MifareKey _authKey;
+    uint32_t _authentications;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,316 @@
+#include "Ndef.h"
+
+#if PN532_CONFIG_NDEF
+
+#include <cstring>
+
+static const char* const uriPrefixes[] = {
+    "", "http://www.", "https://www.", "http://", "https://", "tel:", "mailto:",
+    "ftp://anonymous:anonymous@", "ftp://ftp.", "ftps://", "sftp://", "smb://",
+    "nfs://", "ftp://", "dav://", "news:", "telnet://", "imap:", "rtsp://", "urn:",
+    "pop:", "sip:", "sips:", "tftp:", "btspp://", "btl2cap://", "btgoep://",
+    "tcpobex://", "irdaobex://", "file://", "urn:epc:id:", "urn:epc:tag:",
+    "urn:epc:pat:", "urn:epc:raw:", "urn:epc:", "urn:nfc:"
+};
+
+const char* NdefURIPrefix(uint8_t code)
+{
+    return code < sizeof(uriPrefixes) / sizeof(uriPrefixes[0]) ? uriPrefixes[code] : "";
+}
+
+NdefParser::NdefParser(NdefContainer_t container) : _container(container)
+{
+    Reset();
+}
+
+void NdefParser::Reset()
+{
+    _data = BinaryView();
+    _offset = 0;
+    _end = SIZE_MAX;
+    _missing = 0;
+    _inMessage = false;
+    _done = false;
+}
+
+void NdefParser::Update(const BinaryView& data)
+{
+    _data = data;
+}
+
+NdefStatus_t NdefParser::Require(size_t pos, size_t count)
+{
+    // Compared by subtraction, so huge lengths from a corrupted card cannot overflow
+    if (pos > _end || count > _end - pos)
+        return NDEF_INVALID;
+
+    if (pos > _data.Size || count > _data.Size - pos)
+    {
+        _missing = pos > _data.Size ? pos - _data.Size + count : count - (_data.Size - pos);
+        return NDEF_NEED_MORE;
+    }
+
+    return NDEF_OK;
+}
+
+#define NDEF_REQUIRE(pos, count) \
+    do { \
+        NdefStatus_t status = Require(pos, count); \
+        if (status != NDEF_OK) \
+            return status; \
+    } while (0)
+
+NdefStatus_t NdefParser::FindMessage()
+{
+    if (_container == NDEF_CONTAINER_NONE)
+    {
+        _inMessage = true;
+        return NDEF_OK;
+    }
+
+    if (_container == NDEF_CONTAINER_NLEN)
+    {
+        NDEF_REQUIRE(0, 2);
+
+        _offset = 2;
+        _end = 2 + ((_data[0] << 8) | _data[1]);
+        _inMessage = true;
+        return NDEF_OK;
+    }
+
+    // Walk TLV blocks until NDEF message TLV
+    while (true)
+    {
+        NDEF_REQUIRE(_offset, 1);
+
+        uint8_t type = _data[_offset];
+
+        if (type == NDEF_TLV_NULL)
+        {
+            _offset++;
+            continue;
+        }
+
+        if (type == NDEF_TLV_TERMINATOR)
+        {
+            _done = true;
+            return NDEF_END;
+        }
+
+        NDEF_REQUIRE(_offset, 2);
+
+        size_t header = 2;
+        size_t length = _data[_offset + 1];
+
+        if (length == 0xFF)
+        {
+            NDEF_REQUIRE(_offset, 4);
+            header = 4;
+            length = (_data[_offset + 2] << 8) | _data[_offset + 3];
+        }
+
+        if (type == NDEF_TLV_MESSAGE)
+        {
+            _offset += header;
+            _end = _offset + length;
+            _inMessage = true;
+            return NDEF_OK;
+        }
+
+        // Lock and memory control TLVs are skipped
+        _offset += header + length;
+    }
+}
+
+NdefStatus_t NdefParser::Next(NdefRecord& record)
+{
+    if (_done)
+        return NDEF_END;
+
+    _missing = 0;
+
+    if (!_inMessage)
+    {
+        NdefStatus_t status = FindMessage();
+        if (status != NDEF_OK)
+            return status;
+    }
+
+    if (_offset >= _end)
+    {
+        _done = true;
+        return NDEF_END;
+    }
+
+    // Flags and type length
+    size_t pos = _offset;
+    NDEF_REQUIRE(pos, 2);
+
+    uint8_t flags = _data[pos];
+    uint8_t typeLength = _data[pos + 1];
+    pos += 2;
+
+    uint32_t payloadLength;
+    if (flags & NDEF_FLAG_SR)
+    {
+        NDEF_REQUIRE(pos, 1);
+        payloadLength = _data[pos];
+        pos += 1;
+    }
+    else
+    {
+        NDEF_REQUIRE(pos, 4);
+        payloadLength = ((uint32_t)_data[pos] << 24) | ((uint32_t)_data[pos + 1] << 16) | (_data[pos + 2] << 8) | _data[pos + 3];
+        pos += 4;
+    }
+
+    uint8_t idLength = 0;
+    if (flags & NDEF_FLAG_IL)
+    {
+        NDEF_REQUIRE(pos, 1);
+        idLength = _data[pos];
+        pos += 1;
+    }
+
+    // Summed in 64 bits, payload length alone can exceed a 32-bit size_t
+    uint64_t length = (uint64_t)typeLength + idLength + payloadLength;
+    if (length > SIZE_MAX - pos)
+        return NDEF_INVALID;
+
+    NDEF_REQUIRE(pos, (size_t)length);
+
+    record.Flags = flags & ~NDEF_TNF_MASK;
+    record.TNF = (NdefTNF_t)(flags & NDEF_TNF_MASK);
+    record.Type = _data.Sub(pos, typeLength);
+    record.Id = _data.Sub(pos + typeLength, idLength);
+    record.Payload = _data.Sub(pos + typeLength + idLength, payloadLength);
+
+    _offset = pos + typeLength + idLength + payloadLength;
+
+    // Anything after the last record belongs to the container
+    if (flags & NDEF_FLAG_ME)
+        _end = _offset;
+
+    return NDEF_OK;
+}
+
+NdefWriter::NdefWriter(ByteBuffer& buf, NdefContainer_t container) : _buf(buf), _container(container), _start(buf.Size()), _first(true)
+{
+
+}
+
+void NdefWriter::BeginMessage()
+{
+    _start = _buf.Size();
+    _first = true;
+
+    // Length is not known yet, 3 byte TLV length is shortened by EndMessage if possible
+    if (_container == NDEF_CONTAINER_TLV)
+        _buf << (uint8_t)NDEF_TLV_MESSAGE << (uint8_t)0xFF << (uint8_t)0x00 << (uint8_t)0x00;
+    else if (_container == NDEF_CONTAINER_NLEN)
+        _buf << (uint8_t)0x00 << (uint8_t)0x00;
+}
+
+void NdefWriter::WriteHeader(NdefTNF_t tnf, const BinaryView& type, uint32_t payloadLength, bool last, const BinaryView& id)
+{
+    uint8_t flags = tnf;
+    if (_first)
+        flags |= NDEF_FLAG_MB;
+    if (last)
+        flags |= NDEF_FLAG_ME;
+    if (payloadLength < 0x100)
+        flags |= NDEF_FLAG_SR;
+    if (id.Size)
+        flags |= NDEF_FLAG_IL;
+
+    _first = false;
+
+    _buf << flags;
+    _buf << (uint8_t)type.Size;
+
+    if (flags & NDEF_FLAG_SR)
+        _buf << (uint8_t)payloadLength;
+    else
+        _buf << (uint8_t)(payloadLength >> 24) << (uint8_t)(payloadLength >> 16) << (uint8_t)(payloadLength >> 8) << (uint8_t)payloadLength;
+
+    if (id.Size)
+        _buf << (uint8_t)id.Size;
+
+    _buf.Append(type.Data, type.Size);
+    _buf.Append(id.Data, id.Size);
+}
+
+void NdefWriter::AddRecord(NdefTNF_t tnf, const BinaryView& type, const BinaryView& payload, bool last, const BinaryView& id)
+{
+    WriteHeader(tnf, type, payload.Size, last, id);
+    _buf.Append(payload.Data, payload.Size);
+}
+
+void NdefWriter::AddURI(const char *uri, bool last)
+{
+    // Longest matching prefix is abbreviated to its identifier code
+    uint8_t code = 0;
+    size_t prefixLength = 0;
+
+    for (uint8_t i = 1; i < sizeof(uriPrefixes) / sizeof(uriPrefixes[0]); ++i)
+    {
+        size_t length = strlen(uriPrefixes[i]);
+        if (length > prefixLength && !strncmp(uri, uriPrefixes[i], length))
+        {
+            code = i;
+            prefixLength = length;
+        }
+    }
+
+    const uint8_t type = 'U';
+    size_t length = strlen(uri) - prefixLength;
+
+    WriteHeader(NDEF_TNF_WELL_KNOWN, BinaryView(&type, 1), 1 + length, last, BinaryView());
+    _buf << code;
+    _buf.Append((const uint8_t*)uri + prefixLength, length);
+}
+
+void NdefWriter::AddText(const char *text, const char *language, bool last)
+{
+    const uint8_t type = 'T';
+    size_t languageLength = strlen(language) & 0x3F;
+    size_t length = strlen(text);
+
+    // Status byte: UTF-8 (bit 7 clear) and language code length
+    WriteHeader(NDEF_TNF_WELL_KNOWN, BinaryView(&type, 1), 1 + languageLength + length, last, BinaryView());
+    _buf << (uint8_t)languageLength;
+    _buf.Append((const uint8_t*)language, languageLength);
+    _buf.Append((const uint8_t*)text, length);
+}
+
+void NdefWriter::EndMessage()
+{
+    BinaryData& data = _buf.Data();
+
+    if (_container == NDEF_CONTAINER_TLV)
+    {
+        size_t length = data.size() - _start - 4;
+
+        if (length < 0xFF)
+        {
+            data[_start + 1] = length;
+            data.erase(data.begin() + _start + 2, data.begin() + _start + 4);
+        }
+        else
+        {
+            data[_start + 2] = length >> 8;
+            data[_start + 3] = length;
+        }
+
+        _buf << (uint8_t)NDEF_TLV_TERMINATOR;
+    }
+    else if (_container == NDEF_CONTAINER_NLEN)
+    {
+        size_t length = data.size() - _start - 2;
+
+        data[_start] = length >> 8;
+        data[_start + 1] = length;
+    }
+}
+
+#endif
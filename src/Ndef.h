@@ -0,0 +1,131 @@
+#ifndef __NDEF_H__
+#define __NDEF_H__
+
+#include <cstdint>
+#include "ByteBuffer.h"
+#include "PN532Config.h"
+
+// Record header flags
+#define NDEF_FLAG_MB 0x80   // Message begin
+#define NDEF_FLAG_ME 0x40   // Message end
+#define NDEF_FLAG_CF 0x20   // Chunk
+#define NDEF_FLAG_SR 0x10   // Short record (1 byte payload length)
+#define NDEF_FLAG_IL 0x08   // ID length present
+#define NDEF_TNF_MASK 0x07
+
+// TLV blocks of Type 2 tags
+#define NDEF_TLV_NULL 0x00
+#define NDEF_TLV_MESSAGE 0x03
+#define NDEF_TLV_TERMINATOR 0xFE
+
+enum NdefTNF_t : uint8_t
+{
+    NDEF_TNF_EMPTY          = 0x00,
+    NDEF_TNF_WELL_KNOWN     = 0x01, // NFC Forum RTD (i.e. "U" URI, "T" text)
+    NDEF_TNF_MIME           = 0x02,
+    NDEF_TNF_ABSOLUTE_URI   = 0x03,
+    NDEF_TNF_EXTERNAL       = 0x04,
+    NDEF_TNF_UNKNOWN        = 0x05,
+    NDEF_TNF_UNCHANGED      = 0x06  // Following chunks of a chunked record
+};
+
+// How the message is stored on the card
+enum NdefContainer_t : uint8_t
+{
+    NDEF_CONTAINER_NONE,    // Raw message
+    NDEF_CONTAINER_TLV,     // Type 2 tag data area (Ultralight, NTAG, Mifare Classic)
+    NDEF_CONTAINER_NLEN     // Type 4 tag NDEF file, 2 byte big endian length (Desfire)
+};
+
+enum NdefStatus_t : uint8_t
+{
+    NDEF_OK,            // Record returned
+    NDEF_END,           // No more records
+    NDEF_NEED_MORE,     // Record is not complete yet, call Update with more data
+    NDEF_INVALID        // Malformed data
+};
+
+// Parsed record. Views point into the data passed to NdefParser::Update
+struct NdefRecord
+{
+    uint8_t Flags;
+    NdefTNF_t TNF;
+    BinaryView Type;
+    BinaryView Id;
+    BinaryView Payload;
+};
+
+#if PN532_CONFIG_NDEF
+
+#include <functional>
+
+// Called for each parsed record. Returns false to stop reading
+typedef std::function<bool(const NdefRecord& record)> NdefRecordHandler_t;
+
+// Incremental NDEF parser. Data is fed as it arrives from the card (each
+// Update passes everything received so far, i.e. a growing BinaryData) and
+// records are returned as soon as they are complete, without copying.
+// Reader can stop at the record it needs and skip reading the rest.
+class NdefParser
+{
+public:
+    NdefParser(NdefContainer_t container = NDEF_CONTAINER_NONE);
+
+    // Data received so far, starting at beginning of the data area or file
+    void Update(const BinaryView& data);
+    NdefStatus_t Next(NdefRecord& record);
+    void Reset();
+
+    // Bytes needed to finish current step (0 if unknown). Lets reader size the next read
+    size_t Missing() const
+    {
+        return _missing;
+    }
+
+private:
+    NdefStatus_t FindMessage();
+    // Checks that count bytes at pos are received and inside the message
+    NdefStatus_t Require(size_t pos, size_t count);
+
+    BinaryView _data;
+    NdefContainer_t _container;
+    size_t _offset;     // Next record or TLV
+    size_t _end;        // End of message (SIZE_MAX until known)
+    size_t _missing;
+    bool _inMessage;
+    bool _done;
+};
+
+// Writes records into any ByteBuffer, such as the transmit buffer returned by
+// TagInterface::BeginWrite. Message begin and end flags are set from the
+// position of the record.
+class NdefWriter
+{
+public:
+    NdefWriter(ByteBuffer& buf, NdefContainer_t container = NDEF_CONTAINER_NONE);
+
+    // Writes container header. Length is filled in by EndMessage
+    void BeginMessage();
+    void AddRecord(NdefTNF_t tnf, const BinaryView& type, const BinaryView& payload, bool last, const BinaryView& id = BinaryView());
+    // URI record, known prefixes (i.e. "https://www.") are abbreviated
+    void AddURI(const char *uri, bool last);
+    // Text record with UTF-8 encoding
+    void AddText(const char *text, const char *language, bool last);
+    // Patches container length and writes TLV terminator
+    void EndMessage();
+
+private:
+    void WriteHeader(NdefTNF_t tnf, const BinaryView& type, uint32_t payloadLength, bool last, const BinaryView& id);
+
+    ByteBuffer& _buf;
+    NdefContainer_t _container;
+    size_t _start;      // Offset of container header
+    bool _first;
+};
+
+// Prefix of URI record identifier code (empty string if unknown)
+const char* NdefURIPrefix(uint8_t code);
+
+#endif
+
+#endif
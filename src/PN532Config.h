@@ -0,0 +1,106 @@
+#ifndef __PN532CONFIG_H__
+#define __PN532CONFIG_H__
+
+// Compile time feature selection. Override any option with a -D build flag
+// (PlatformIO build_flags, Arduino build_opt.h). Sources of a disabled feature
+// compile to empty translation units and its classes are not declared, so
+// unused drivers cost neither flash nor static RAM. See extras/footprint.
+
+// Transports
+#ifndef PN532_CONFIG_HSU
+#define PN532_CONFIG_HSU 1              // PN532_HSU over Arduino HardwareSerial
+#endif
+#ifndef PN532_CONFIG_STREAM
+#define PN532_CONFIG_STREAM 1           // PN532_Stream and ReaderDaemon over Linux descriptors
+#endif
+#ifndef PN532_CONFIG_SIMULATOR
+#define PN532_CONFIG_SIMULATOR 1        // PN532Simulator and simulated cards
+#endif
+#ifndef PN532_CONFIG_ISO_DEP
+#define PN532_CONFIG_ISO_DEP 1          // Host side ISO14443-4 over InCommunicateThru (IsoDep)
+#endif
+
+// Card drivers
+#ifndef PN532_CONFIG_DESFIRE
+#define PN532_CONFIG_DESFIRE 1          // Desfire, key store and key diversification
+#endif
+#ifndef PN532_CONFIG_DESFIRE_EV2
+#define PN532_CONFIG_DESFIRE_EV2 PN532_CONFIG_DESFIRE // EV2 authentication and secure messaging
+#endif
+#ifndef PN532_CONFIG_MIFARE_CLASSIC
+#define PN532_CONFIG_MIFARE_CLASSIC 1
+#endif
+#ifndef PN532_CONFIG_ULTRALIGHT
+#define PN532_CONFIG_ULTRALIGHT 1       // Ultralight and NTAG
+#endif
+#ifndef PN532_CONFIG_FELICA
+#define PN532_CONFIG_FELICA 1
+#endif
+#ifndef PN532_CONFIG_TYPE_B
+#define PN532_CONFIG_TYPE_B 1
+#endif
+#ifndef PN532_CONFIG_NDEF
+#define PN532_CONFIG_NDEF 1
+#endif
+
+// Key types. AES keys are always supported by the Desfire driver
+#ifndef PN532_CONFIG_LEGACY_KEYS
+#define PN532_CONFIG_LEGACY_KEYS 1      // DES, 2K3DES and 3K3DES key handling
+#endif
+
+// Crypto backend for AES
+#define PN532_CRYPTO_NONE       0
+#define PN532_CRYPTO_ESP_AES    1       // ESP32 hardware AES (esp_aes_*)
+#define PN532_CRYPTO_MBEDTLS    2       // mbedTLS software AES (any ESP-IDF target)
+#define PN532_CRYPTO_OPENSSL    3       // OpenSSL libcrypto, link with -lcrypto
+
+#ifndef PN532_CONFIG_CRYPTO
+#if !PN532_CONFIG_DESFIRE
+#define PN532_CONFIG_CRYPTO PN532_CRYPTO_NONE
+#elif defined(ESP32)
+#define PN532_CONFIG_CRYPTO PN532_CRYPTO_ESP_AES
+#elif defined(__linux__)
+#define PN532_CONFIG_CRYPTO PN532_CRYPTO_OPENSSL
+#else
+#define PN532_CONFIG_CRYPTO PN532_CRYPTO_NONE
+#endif
+#endif
+
+// Default source of RandomPool (Desfire challenges). Without it Desfire
+// authentication fails until a source is set with RandomPool::SetSource
+#ifndef PN532_CONFIG_SYSTEM_RANDOM
+#if PN532_CONFIG_DESFIRE && (defined(ESP32) || defined(__linux__))
+#define PN532_CONFIG_SYSTEM_RANDOM 1    // SystemRandom: esp_fill_random or getrandom
+#else
+#define PN532_CONFIG_SYSTEM_RANDOM 0
+#endif
+#endif
+
+// Instrumentation
+#ifndef PN532_METRICS
+#define PN532_METRICS 0                 // Latency histograms (Metrics.h)
+#endif
+#ifndef PN532_CONFIG_TRACE
+#define PN532_CONFIG_TRACE 1            // WireTrace recording and PN532Replay
+#endif
+#ifndef PN532_CONFIG_DEBUG
+#define PN532_CONFIG_DEBUG 0            // Frame dumps over Serial (Arduino only)
+#endif
+#ifndef PN532_CONFIG_RESULT_MESSAGES
+#define PN532_CONFIG_RESULT_MESSAGES 1  // Result::Message texts, otherwise only "Error"
+#endif
+#ifndef PN532_CONFIG_TAG_ADAPTER
+#define PN532_CONFIG_TAG_ADAPTER 1      // std::function transports for TagInterface
+#endif
+
+#if PN532_CONFIG_DESFIRE_EV2 && !PN532_CONFIG_DESFIRE
+#error "PN532_CONFIG_DESFIRE_EV2 requires PN532_CONFIG_DESFIRE"
+#endif
+#if PN532_CONFIG_SYSTEM_RANDOM && !PN532_CONFIG_DESFIRE
+#error "PN532_CONFIG_SYSTEM_RANDOM requires PN532_CONFIG_DESFIRE"
+#endif
+#if PN532_CONFIG_SYSTEM_RANDOM && !defined(ESP32) && !defined(__linux__)
+#error "PN532_CONFIG_SYSTEM_RANDOM requires ESP32 or Linux"
+#endif
+
+#endif
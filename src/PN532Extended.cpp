@@ -1,106 +1,140 @@
 #include "PN532Extended.h"
+#include "CardIdentifier.h"
 #include "Utils.h"
 
 CardType_t PN532Extended::IdentifyTypeACard(const TargetDataTypeA& tgdata)
 {
-    if (tgdata.SAK == 0x09 && tgdata.ATQA[0] == 0x00 && tgdata.ATQA[1] == 0x04)
-        return CARD_TYPE_MIFARE_MINI;
-    else if (tgdata.SAK == 0x08 && tgdata.ATQA[0] == 0x00 && tgdata.ATQA[1] == 0x04)
-        return CARD_TYPE_MIFARE_CLASSIC_1K;
-    else if (tgdata.SAK == 0x18 && tgdata.ATQA[0] == 0x00 && tgdata.ATQA[1] == 0x02)
-        return CARD_TYPE_MIFARE_CLASSIC_4K;
-    else if (tgdata.SAK == 0x00 && tgdata.ATQA[0] == 0x00 && tgdata.ATQA[1] == 0x44)
-        return CARD_TYPE_MIFARE_ULTRALIGHT;
-    else if (tgdata.SAK == 0x20 && tgdata.ATQA[0] == 0x03 && tgdata.ATQA[1] == 0x44)
-        return CARD_TYPE_MIFARE_DESFIRE;
-    else
-        return CARD_TYPE_MAX;
+    return CardIdentifier::Identify(tgdata);
 }
 
-PN532Extended::PN532Extended(PN532Interface& interface): _interface(interface)
+PN532Extended::PN532Extended(PN532Interface& interface): _interface(interface), _poweredDown(false), _atrTimeout(RF_TIMEOUT_102_4MS)
 {
-
+    // Buffers are allocated once and reused by all commands
+    _tx.Data().reserve(PN532_TX_BUFFER_SIZE);
+    _rx.Data().reserve(PN532_RX_BUFFER_SIZE);
 }
 
 void PN532Extended::begin()
 {
     // Initialize HAL
     _interface.wakeup();
+    _poweredDown = false;
+}
+
+ByteBuffer& PN532Extended::BeginCommand(Commands cmd)
+{
+    // Leave space for frame header
+    _tx.Clear();
+    _tx.Data().resize(PN532_FRAME_HEADROOM);
+    _tx << cmd;
+
+    return _tx;
 }
 
-int16_t PN532Extended::WriteCommand(const BinaryData& packet)
+Result PN532Extended::WriteCommand()
 {
-    #if PN532EXTENDED_DEBUG
+    uint16_t len = _tx.Size() - PN532_FRAME_HEADROOM;
+
+    if (_tx.Size() <= PN532_FRAME_HEADROOM || len > PN532_MAX_EXTENDED_PACKET_SIZE)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    #if PN532_CONFIG_DEBUG && defined(ARDUINO)
     Serial.print("PN532Extended Write: ");
-    PrintBin(packet);
+    PrintBin(BinaryView(_tx.Data()).Sub(PN532_FRAME_HEADROOM));
     #endif
 
+    // Space for frame trailer
+    _tx.Data().resize(_tx.Size() + PN532_FRAME_TAILROOM);
+
+#if PN532_METRICS
+    _commandStart = PlatformMicros();
+#endif
+
     // Call HAL
-    return _interface.writeCommand(packet.data(), packet.size());
+    return Result::Transport(_interface.writeFrame(_tx.Data().data(), len));
 }
 
-int16_t PN532Extended::ReadResponse(BinaryData& packet, uint16_t timeout)
+Result PN532Extended::ReadResponse(uint16_t timeout)
 {
-    // Allocate space for data
-    packet.resize(PN532_MAX_PACKET_SIZE);
+    // Does not allocate, capacity is reserved in constructor
+    _rx.Clear();
+    _rx.Data().resize(PN532_RX_BUFFER_SIZE);
 
     // Call HAL
-    int16_t status = _interface.readResponse(packet.data(), PN532_MAX_PACKET_SIZE, timeout);
+    int16_t status = _interface.readResponse(_rx.Data().data(), PN532_RX_BUFFER_SIZE, timeout);
+
+    if (status < 0)
+    {
+        _rx.Clear();
+        return Result::Transport(status);
+    }
+
+    // Resize vector to real size
+    _rx.Data().resize(status);
+
+    // Command code is still in transmit buffer
+    METRICS_RECORD_KEYED(Commands, _tx.Data()[PN532_FRAME_HEADROOM], _commandStart);
 
-    #if PN532EXTENDED_DEBUG
+    #if PN532_CONFIG_DEBUG && defined(ARDUINO)
     Serial.print("PN532Extended Read: ");
-    PrintBin(packet);
+    PrintBin(_rx.Data());
     #endif
 
-    // If successful, resize vector to real size
-    if (status > 0)
-        packet.resize(status);
+    return Result();
+}
+
+Result PN532Extended::Exchange(uint16_t timeout)
+{
+    Result result = WriteCommand();
+    if (!result)
+        return result;
 
-    return status;
+    return ReadResponse(timeout);
 }
 
-// Creates external tag interface for communications
-TagInterface PN532Extended::CreateTagInterface(uint8_t tg)
+Result PN532Extended::WriteCommand(const BinaryData& packet)
 {
-    return TagInterface(
-        [tg, this](const BinaryData& packet) {
-            // Build data exchange packet
-            ByteBuffer buf;
-            buf << COMMAND_INDATAEXCHANGE;
-            buf << tg; // Target id
-            buf << packet;
-            return WriteCommand(buf.Data());
-        },
-        [tg, this](BinaryData& packet) {
-            int16_t status = ReadResponse(packet);
-            packet.erase(packet.begin()); // Remove status field. Inefficient. Need better way.
-            return status; 
-        }
-    );
-}
-
-bool PN532Extended::GetFirmwareVersion(GetFirmwareVersionResponse& resp)
+    if (packet.empty())
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    BeginCommand((Commands)packet[0]);
+    _tx.Append(packet.data()+1, packet.size()-1);
+
+    return WriteCommand();
+}
+
+Result PN532Extended::ReadResponse(BinaryData& packet, uint16_t timeout)
 {
-    // Serialize request
-    ByteBuffer buf;
-    buf << COMMAND_GETFIRMWAREVERSION;
+    Result result = ReadResponse(timeout);
+    if (!result)
+        return result;
+
+    packet = _rx.Data();
+
+    return Result();
+}
 
-    if (WriteCommand(buf.Data()))
-        return false;
+// Creates external tag interface for communications
+TagInterface PN532Extended::CreateTagInterface(uint8_t tg)
+{
+    return TagInterface(*this, tg);
+}
 
-    // Reuse request buffer for response
-    buf.Clear();
+Result PN532Extended::GetFirmwareVersion(GetFirmwareVersionResponse& resp)
+{
+    BeginCommand(COMMAND_GETFIRMWAREVERSION);
 
-    if (ReadResponse(buf.Data()) < 0)
-        return false;
+    Result result = Exchange();
+    if (!result)
+        return result;
 
     // Deserialize data
-    buf >> resp;
+    _rx >> resp;
 
-    return true;
+    return Result();
 }
 
-bool PN532Extended::SAMConfig(SAMModes mode, uint8_t timeout, uint8_t IRQ)
+Result PN532Extended::SAMConfig(SAMModes mode, uint8_t timeout, uint8_t IRQ)
 {
     SAMConfiguration req;
     req.Mode = mode;
@@ -108,48 +142,98 @@ bool PN532Extended::SAMConfig(SAMModes mode, uint8_t timeout, uint8_t IRQ)
     req.IRQ = IRQ;
 
     // Serialize request
-    ByteBuffer buf;
-    buf << COMMAND_SAMCONFIGURATION;
-    buf << req;
+    BeginCommand(COMMAND_SAMCONFIGURATION) << req;
+
+    return Exchange();
+}
 
-    if (WriteCommand(buf.Data()))
-        return false;
+Result PN532Extended::SetPassiveActivationRetries(uint8_t maxRetries)
+{
+    // Keep ATR and PSL retries at their defaults
+    RFConfiguration_MaxRetries req = RF_PROFILE_DEFAULT.MaxRetries;
+    req.MxRtyPassiveActivation = maxRetries;
+
+    return SetMaxRetries(req);
+}
 
-    // Reuse request buffer for response
-    buf.Clear();
+Result PN532Extended::RFField(bool on, bool autoRFCA)
+{
+    RFConfiguration_Field req;
+    req.RF = on;
+    req.AutoRFCA = autoRFCA;
 
-    if (ReadResponse(buf.Data()) < 0)
-        return false;
+    BeginCommand(COMMAND_RFCONFIGURATION) << req;
 
-    return true;
+    return Exchange();
 }
 
-bool PN532Extended::SetPassiveActivationRetries(uint8_t maxRetries)
+Result PN532Extended::SetRFTimings(RFTimeout_t atrRes, RFTimeout_t retry)
 {
-    // Max retries options
-    RFConfiguration_MaxRetries req;
-    req.MxRtyATR = 0xFF;
-    req.MxRtyPSL = 0x01;
-    req.MxRtyPassiveActivation = maxRetries;
+    RFConfiguration_Timings req;
+    req.ATR_RES_Timeout = atrRes;
+    req.RetryTimeout = retry;
 
-    // Serialize request
-    ByteBuffer buf;
-    buf << COMMAND_RFCONFIGURATION;
-    buf << req;
+    BeginCommand(COMMAND_RFCONFIGURATION) << req;
+
+    Result result = Exchange();
+    if (result)
+        _atrTimeout = atrRes;
+
+    return result;
+}
+
+Result PN532Extended::SetRetryTimeout(RFTimeout_t retry)
+{
+    return SetRFTimings(_atrTimeout, retry);
+}
+
+Result PN532Extended::SetCommunicationRetries(uint8_t maxRetries)
+{
+    RFConfiguration_MaxRetryCOM req;
+    req.MaxRtyCOM = maxRetries;
+
+    BeginCommand(COMMAND_RFCONFIGURATION) << req;
 
-    if (WriteCommand(buf.Data()))
-        return false;
+    return Exchange();
+}
+
+Result PN532Extended::SetMaxRetries(const RFConfiguration_MaxRetries& retries)
+{
+    BeginCommand(COMMAND_RFCONFIGURATION) << retries;
+
+    return Exchange();
+}
+
+Result PN532Extended::SetAnalogSettings(const RFConfiguration_AnalogTypeA& settings)
+{
+    BeginCommand(COMMAND_RFCONFIGURATION) << settings;
+
+    return Exchange();
+}
 
-    // Reuse request buffer for response
-    buf.Clear();
+Result PN532Extended::SetAnalogSettings(const RFConfiguration_Analog212_424& settings)
+{
+    BeginCommand(COMMAND_RFCONFIGURATION) << settings;
 
-    if (ReadResponse(buf.Data()) < 0)
-        return false;
+    return Exchange();
+}
 
-    return true;
+Result PN532Extended::ApplyRFProfile(const RFProfile& profile)
+{
+    Result result = SetRFTimings(profile.Timings.ATR_RES_Timeout, profile.Timings.RetryTimeout);
+    if (result)
+        result = SetCommunicationRetries(profile.MaxRetryCOM.MaxRtyCOM);
+    if (result)
+        result = SetMaxRetries(profile.MaxRetries);
+    if (result)
+        result = SetAnalogSettings(profile.AnalogTypeA);
+    if (result)
+        result = SetAnalogSettings(profile.Analog212_424);
+
+    return result;
 }
 
-bool PN532Extended::InListPassiveTarget(InListPassiveTargetResponse &resp, uint8_t maxTargets, BrTy_t brty)
+Result PN532Extended::InListPassiveTarget(InListPassiveTargetResponse &resp, uint8_t maxTargets, BrTy_t brty, const BinaryData& initiatorData)
 {
     // Initialise response struct
     resp.NbTg = 0;
@@ -158,49 +242,195 @@ bool PN532Extended::InListPassiveTarget(InListPassiveTargetResponse &resp, uint8
     InListPassiveTargetRequest req;
     req.MaxTg = maxTargets;
     req.BrTy = brty;
+    req.InitiatorData = initiatorData;
 
     // Serialize request
-    ByteBuffer buf;
-    buf << COMMAND_INLISTPASSIVETARGET;
-    buf << req;
-    
-    if (WriteCommand(buf.Data()))
-        return false;
+    BeginCommand(COMMAND_INLISTPASSIVETARGET) << req;
 
-    // Reuse request buffer for response
-    buf.Clear();
+    Result result = Exchange();
+    if (!result)
+        return result;
 
-    if (ReadResponse(buf.Data()) < 0)
-        return false;
+    // Deserialize data
+    _rx >> resp;
+
+    return Result();
+}
+
+Result PN532Extended::InListPassiveTarget(TargetListTypeA& list, uint8_t maxTargets)
+{
+    // Initialise response struct
+    list.NbTg = 0;
+
+    if (maxTargets == 0 || maxTargets > 2)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    InListPassiveTargetRequest req;
+    req.MaxTg = maxTargets;
+    req.BrTy = BRTY_106KBPS_TYPE_A;
+
+    BeginCommand(COMMAND_INLISTPASSIVETARGET) << req;
+
+    Result result = Exchange();
+    if (!result)
+        return result;
 
     // Deserialize data
-    buf >> resp;
+    _rx >> list;
+
+    return Result();
+}
+
+Result PN532Extended::InListPassiveTarget(TargetListTypeB& list, uint8_t maxTargets, const InitiatorDataTypeB& initiator)
+{
+    list.NbTg = 0;
+
+    if (maxTargets == 0 || maxTargets > 2)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    BeginCommand(COMMAND_INLISTPASSIVETARGET) << maxTargets << BRTY_106KBPS_TYPE_B << initiator;
+
+    Result result = Exchange();
+    if (!result)
+        return result;
+
+    _rx >> list;
 
-    return true;
+    return Result();
 }
 
-uint8_t PN532Extended::InRelease(uint8_t tg)
+Result PN532Extended::InListPassiveTarget(TargetListFeliCa& list, uint8_t maxTargets, const InitiatorDataFeliCa& initiator, BrTy_t brty)
+{
+    list.NbTg = 0;
+
+    if (maxTargets == 0 || maxTargets > 2 || (brty != BRTY_212KBPS && brty != BRTY_424KBPS))
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    BeginCommand(COMMAND_INLISTPASSIVETARGET) << maxTargets << brty << initiator;
+
+    Result result = Exchange();
+    if (!result)
+        return result;
+
+    _rx >> list;
+
+    return Result();
+}
+
+Result PN532Extended::InRelease(uint8_t tg)
 {
     InReleaseRequest req;
     req.Tg = tg;
 
     InReleaseResponse resp;
 
-    ByteBuffer buf;
-    buf << COMMAND_INRELEASE;
-    buf << req;
+    BeginCommand(COMMAND_INRELEASE) << req;
 
-    if (WriteCommand(buf.Data()))
-        return false;
+    Result result = Exchange();
+    if (!result)
+        return result;
 
-    // Reuse request buffer for response
-    buf.Clear();
+    // Deserialize data
+    _rx >> resp;
+
+    return Result::PN532(resp.Status);
+}
+
+Result PN532Extended::CheckPresence()
+{
+    BeginCommand(COMMAND_DIAGNOSE) << DIAGNOSE_ATTENTION_REQUEST;
+
+    Result result = Exchange();
+    if (!result)
+        return result;
 
-    if (ReadResponse(buf.Data()) < 0)
-        return false;
+    if (!_rx.Size())
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    uint8_t status = 0;
+    _rx >> status;
+
+    return Result::PN532(status);
+}
+
+Result PN532Extended::CheckPresence(uint8_t tg, const BinaryData& probe)
+{
+    BeginCommand(COMMAND_INDATAEXCHANGE) << tg << probe;
+
+    Result result = Exchange();
+    if (!result)
+        return result;
+
+    if (!_rx.Size())
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    uint8_t status = 0;
+    _rx >> status;
+
+    return Result::PN532(status);
+}
+
+Result PN532Extended::InAutoPoll(InAutoPollResponse& resp, const BinaryData& types, uint8_t pollNr, uint8_t period, uint16_t timeout)
+{
+    // Initialise response struct
+    resp.NbTg = 0;
+
+    if (types.empty() || types.size() > PN532_AUTOPOLL_MAX_TYPES || pollNr == 0 || period == 0 || period > 0x0F)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    InAutoPollRequest req;
+    req.PollNr = pollNr;
+    req.Period = period;
+    req.Types = types;
+
+    BeginCommand(COMMAND_INAUTOPOLL) << req;
+
+    // Response only arrives once polling has finished
+    Result result = WriteCommand();
+    if (!result)
+        return result;
+
+    result = ReadResponse(timeout);
+    if (!result)
+        return result;
 
     // Deserialize data
-    buf >> resp;
+    _rx >> resp;
+
+    return Result();
+}
+
+Result PN532Extended::PowerDown(uint8_t wakeUpEnable, bool generateIRQ)
+{
+    PowerDownRequest req;
+    req.WakeUpEnable = wakeUpEnable;
+    req.GenerateIRQ = generateIRQ;
+
+    BeginCommand(COMMAND_POWERDOWN) << req;
+
+    // Status is sent before the PN532 goes to sleep
+    Result result = Exchange();
+    if (!result)
+        return result;
+
+    if (!_rx.Size())
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
 
-    return resp.Status;
+    uint8_t status = 0;
+    _rx >> status;
+
+    result = Result::PN532(status);
+    if (result)
+        _poweredDown = true;
+
+    return result;
+}
+
+void PN532Extended::WakeUp()
+{
+    if (!_poweredDown)
+        return;
+
+    _interface.wakeup();
+    _poweredDown = false;
 }
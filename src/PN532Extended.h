@@ -4,9 +4,10 @@
 #include <cstdint>
 #include "PN532Interface.h"
 #include "PN532Packets.h"
+#include "RFProfile.h"
 #include "TagInterface.h"
-
-#define PN532EXTENDED_DEBUG 0
+#include "Result.h"
+#include "Metrics.h"
 
 using namespace PN532Packets;
 
@@ -16,33 +17,124 @@ enum CardType_t : uint8_t
     CARD_TYPE_MIFARE_CLASSIC_1K,
     CARD_TYPE_MIFARE_CLASSIC_4K,
     CARD_TYPE_MIFARE_ULTRALIGHT,
-    CARD_TYPE_MIFARE_DESFIRE,
-    CARD_TYPE_MAX
+    CARD_TYPE_MIFARE_DESFIRE,           // DESFire EV1 or any DESFire until refined with GetVersion
+    CARD_TYPE_MIFARE_CLASSIC_2K,
+    CARD_TYPE_MIFARE_PLUS_2K_SL2,
+    CARD_TYPE_MIFARE_PLUS_4K_SL2,
+    CARD_TYPE_MIFARE_PLUS_SL3,          // Any MIFARE Plus in security level 3 until refined
+    CARD_TYPE_MIFARE_PLUS_EV1,
+    CARD_TYPE_MIFARE_PLUS_EV2,
+    CARD_TYPE_MIFARE_ULTRALIGHT_EV1,
+    CARD_TYPE_NTAG213,
+    CARD_TYPE_NTAG215,
+    CARD_TYPE_NTAG216,
+    CARD_TYPE_NTAG,                     // Other NTAG with Type 2 GET_VERSION
+    CARD_TYPE_NTAG424_DNA,
+    CARD_TYPE_MIFARE_DESFIRE_EV2,
+    CARD_TYPE_MIFARE_DESFIRE_EV3,
+    CARD_TYPE_MIFARE_DESFIRE_LIGHT,
+    CARD_TYPE_SMARTMX_CLASSIC_1K,       // SmartMX / JCOP with MIFARE Classic 1K emulation
+    CARD_TYPE_SMARTMX_CLASSIC_4K,       // SmartMX / JCOP with MIFARE Classic 4K emulation
+    CARD_TYPE_JCOP,
+    CARD_TYPE_ISO14443_4,               // Other ISO14443-4 card
+    CARD_TYPE_MAX                       // Unknown
 };
 
 #define PN532_MAX_PACKET_SIZE 255
+// Transmit buffer holds frame header and trailer around command data
+#define PN532_TX_BUFFER_SIZE (PN532_FRAME_HEADROOM + PN532_MAX_EXTENDED_PACKET_SIZE + PN532_FRAME_TAILROOM)
+#define PN532_RX_BUFFER_SIZE PN532_MAX_EXTENDED_PACKET_SIZE
 #define PN532_DEFAULT_TIMEOUT 1000
 
 class PN532Extended
 {
 public:
+    // Identifies card from activation data without RF traffic (see CardIdentifier)
     static CardType_t IdentifyTypeACard(const TargetDataTypeA& tgdata);
 
     PN532Extended(PN532Interface& interface);
     void begin();
 
-    int16_t WriteCommand(const BinaryData& packet);
-    int16_t ReadResponse(BinaryData& packet, uint16_t timeout = PN532_DEFAULT_TIMEOUT);
+    // Starts a new command in the reused transmit buffer. Arguments are appended to returned buffer
+    ByteBuffer& BeginCommand(Commands cmd);
+    // Sends command built with BeginCommand
+    Result WriteCommand();
+    // Receives response into the reused receive buffer (see Response())
+    Result ReadResponse(uint16_t timeout = PN532_DEFAULT_TIMEOUT);
+    // WriteCommand followed by ReadResponse
+    Result Exchange(uint16_t timeout = PN532_DEFAULT_TIMEOUT);
+
+    // Response data of the last ReadResponse (without TFI and command code)
+    ByteBuffer& Response()
+    {
+        return _rx;
+    }
+
+    // Copying variants for raw packets
+    Result WriteCommand(const BinaryData& packet);
+    Result ReadResponse(BinaryData& packet, uint16_t timeout = PN532_DEFAULT_TIMEOUT);
 
     TagInterface CreateTagInterface(uint8_t tg);
-    bool SetPassiveActivationRetries(uint8_t maxRetries);
-    bool SAMConfig(SAMModes mode = SAM_MODE_NORMAL, uint8_t timeout = 20, uint8_t IRQ = 0x01);
-    bool GetFirmwareVersion(GetFirmwareVersionResponse& resp);
-    bool InListPassiveTarget(InListPassiveTargetResponse& resp, uint8_t maxTargets = 1, BrTy_t brty = BRTY_106KBPS_TYPE_A);
-    uint8_t InRelease(uint8_t tg);
+    Result SetPassiveActivationRetries(uint8_t maxRetries);
+
+    // RFConfiguration items
+    Result RFField(bool on, bool autoRFCA = true);
+    Result SetRFTimings(RFTimeout_t atrRes, RFTimeout_t retry);
+    // Timings item with the ATR_RES timeout last set (PN532 default 102.4 ms)
+    Result SetRetryTimeout(RFTimeout_t retry);
+    Result SetCommunicationRetries(uint8_t maxRetries);
+    Result SetMaxRetries(const RFConfiguration_MaxRetries& retries);
+    Result SetAnalogSettings(const RFConfiguration_AnalogTypeA& settings);
+    Result SetAnalogSettings(const RFConfiguration_Analog212_424& settings);
+    // Applies all items of a profile. Stops at first failing item
+    Result ApplyRFProfile(const RFProfile& profile);
+
+    Result SAMConfig(SAMModes mode = SAM_MODE_NORMAL, uint8_t timeout = 20, uint8_t IRQ = 0x01);
+    Result GetFirmwareVersion(GetFirmwareVersionResponse& resp);
+    Result InListPassiveTarget(InListPassiveTargetResponse& resp, uint8_t maxTargets = 1, BrTy_t brty = BRTY_106KBPS_TYPE_A, const BinaryData& initiatorData = BinaryData());
+    // Activates up to 2 ISO14443 Type A targets and parses their target data
+    Result InListPassiveTarget(TargetListTypeA& list, uint8_t maxTargets = 2);
+    // Activates ISO14443 Type B targets of the given application family
+    Result InListPassiveTarget(TargetListTypeB& list, uint8_t maxTargets = 1, const InitiatorDataTypeB& initiator = InitiatorDataTypeB{0x00});
+    // Polls FeliCa targets at 212 or 424 kbps
+    Result InListPassiveTarget(TargetListFeliCa& list, uint8_t maxTargets = 1, const InitiatorDataFeliCa& initiator = InitiatorDataFeliCa{0xFFFF, 0x01, 0x00}, BrTy_t brty = BRTY_212KBPS);
+    Result InRelease(uint8_t tg);
+
+    // Checks that the current ISO14443-4 target is still in the field with
+    // Diagnose attention request (R(NAK)/S(WTX) exchange). Costs one short
+    // RF round trip and keeps the session established. Fails with
+    // PN532_STATUS_TIMEOUT when the card has left.
+    Result CheckPresence();
+    // Presence check for targets without ISO14443-4 (i.e. Mifare Ultralight READ).
+    // Sends probe with InDataExchange and discards the answer.
+    Result CheckPresence(uint8_t tg, const BinaryData& probe);
+
+    // Lets PN532 poll for any of the given target types (AutoPollType_t) without host round trips.
+    // Blocks until a target is found or polling ends. Timeout of 0 waits indefinitely.
+    Result InAutoPoll(InAutoPollResponse& resp, const BinaryData& types, uint8_t pollNr = PN532_AUTOPOLL_ENDLESS, uint8_t period = 0x01, uint16_t timeout = 0);
+
+    // Puts PN532 into PowerDown until one of the WakeUpSource_t sources in
+    // wakeUpEnable is triggered. Targets are released and the RF field is
+    // switched off. Include the host interface to be able to call WakeUp.
+    Result PowerDown(uint8_t wakeUpEnable = WAKEUP_HSU, bool generateIRQ = false);
+    // Sends wake-up preamble after PowerDown, no-op when awake. SAMConfig and
+    // RFConfiguration settings are kept during PowerDown and need not be sent again.
+    void WakeUp();
+
+    bool PoweredDown() const
+    {
+        return _poweredDown;
+    }
 
 private:
     PN532Interface& _interface;
+    bool _poweredDown;
+    RFTimeout_t _atrTimeout; // Sent again when only the retry timeout changes
+    ByteBuffer _tx; // Frame being sent. Command data starts at PN532_FRAME_HEADROOM
+    ByteBuffer _rx; // Last received response
+#if PN532_METRICS
+    uint32_t _commandStart; // Command latency is measured from WriteCommand to ReadResponse
+#endif
 };
 
 #endif
@@ -0,0 +1,264 @@
+#include "PN532Frame.h"
+
+uint8_t* PN532EncodeFrame(uint8_t *frame, uint16_t len, uint16_t& size, uint8_t tfi)
+{
+    uint8_t *data = frame + PN532_FRAME_HEADROOM;
+
+    // Header is built backwards from data
+    uint8_t *header = data;
+    *--header = tfi; // TFI
+
+    uint16_t frameLen = len + 1; // Data length + TFI
+    if (frameLen <= 0xFF)
+    {
+        *--header = ~frameLen + 1;  // LCS (Satisfies LOW_BYTE(LEN + LCS) = 0x00)
+        *--header = frameLen;       // LEN
+    }
+    else
+    {
+        // Extended information frame
+        *--header = ~((frameLen >> 8) + frameLen) + 1;  // LCS (Satisfies LOW_BYTE(LENM + LENL + LCS) = 0x00)
+        *--header = frameLen;       // LENL
+        *--header = frameLen >> 8;  // LENM
+        *--header = 0xFF;
+        *--header = 0xFF;
+    }
+
+    *--header = 0xFF; // Start Code 1
+    *--header = 0x00; // Start Code 0
+    *--header = 0x00; // Preamble
+
+    // calculate checksum
+    uint8_t checksum = tfi;
+    for (uint16_t i = 0; i < len; i++)
+        checksum += data[i];
+
+    data[len] = ~checksum + 1; // DCS (TFI + data)
+    data[len+1] = 0x00; // Postamble
+
+    size = data + len + PN532_FRAME_TAILROOM - header;
+
+    return header;
+}
+
+PN532FrameDecoder::PN532FrameDecoder(uint8_t tfi) : _tfi(tfi)
+{
+    Reset();
+}
+
+void PN532FrameDecoder::Reset()
+{
+    _state = STATE_START_0;
+    _pending = EVENT_NONE;
+    _frameLen = 0;
+    _length = 0;
+    _checksum = 0;
+}
+
+PN532FrameDecoder::Event_t PN532FrameDecoder::Fail()
+{
+    Reset();
+    return EVENT_INVALID;
+}
+
+PN532FrameDecoder::Event_t PN532FrameDecoder::Feed(uint8_t byte)
+{
+    switch (_state)
+    {
+    case STATE_START_0:
+        if (byte == 0x00)
+            _state = STATE_START_1;
+        break;
+    case STATE_START_1:
+        // Preamble may repeat
+        if (byte == 0xFF)
+            _state = STATE_LEN;
+        else if (byte != 0x00)
+            _state = STATE_START_0;
+        break;
+    case STATE_LEN:
+        _frameLen = byte;
+        _state = byte == 0xFF ? STATE_NACK_OR_EXTENDED : STATE_LCS;
+        break;
+    case STATE_LCS:
+        if (_frameLen == 0 && byte == 0xFF)
+        {
+            // ACK: 00 FF 00 FF 00
+            _pending = EVENT_ACK;
+            _state = STATE_POSTAMBLE;
+        }
+        else if ((uint8_t)(_frameLen + byte) || _frameLen == 0)
+            return Fail();
+        else
+            _state = STATE_TFI;
+        break;
+    case STATE_NACK_OR_EXTENDED:
+        if (byte == 0x00)
+        {
+            // NACK: 00 FF FF 00 00
+            _pending = EVENT_NACK;
+            _state = STATE_POSTAMBLE;
+        }
+        else if (byte == 0xFF)
+            _state = STATE_LENM;
+        else if (byte == 0x01)
+        {
+            // Normal frame with LEN 0xFF (254 data bytes), byte is its LCS
+            _state = STATE_TFI;
+        }
+        else
+            return Fail();
+        break;
+    case STATE_LENM:
+        _frameLen = byte << 8;
+        _state = STATE_LENL;
+        break;
+    case STATE_LENL:
+        _frameLen |= byte;
+        _state = STATE_EXTENDED_LCS;
+        break;
+    case STATE_EXTENDED_LCS:
+        if ((uint8_t)((_frameLen >> 8) + _frameLen + byte) || _frameLen == 0)
+            return Fail();
+        _state = STATE_TFI;
+        break;
+    case STATE_TFI:
+        if (_frameLen - 1 > PN532_MAX_EXTENDED_PACKET_SIZE)
+            return Fail();
+
+        // Application level error frame: 00 FF 01 FF 7F 81 00
+        if (byte == 0x7F && _frameLen == 1)
+            _pending = EVENT_ERROR_FRAME;
+        else if (byte != _tfi)
+            return Fail();
+        else
+            _pending = EVENT_FRAME;
+
+        _checksum = byte;
+        _length = 0;
+        _state = _frameLen > 1 ? STATE_DATA : STATE_DCS;
+        break;
+    case STATE_DATA:
+        _data[_length++] = byte;
+        _checksum += byte;
+        if (_length == _frameLen - 1)
+            _state = STATE_DCS;
+        break;
+    case STATE_DCS:
+        if ((uint8_t)(_checksum + byte))
+            return Fail();
+        _state = STATE_POSTAMBLE;
+        break;
+    case STATE_POSTAMBLE:
+    {
+        Event_t event = _pending;
+        _state = STATE_START_0;
+        _pending = EVENT_NONE;
+        // Missing postamble is tolerated, data is already verified
+        return event;
+    }
+    }
+
+    return EVENT_NONE;
+}
+
+PN532LinkRecovery::PN532LinkRecovery() : _writeTime(0), _lastByte(0), _maxRetries(0), _resends(0), _nacks(0),
+    _active(false), _heard(false), _partial(false)
+{
+}
+
+void PN532LinkRecovery::Begin(uint32_t now, uint8_t maxRetries)
+{
+    _decoder.Reset();
+    _writeTime = now;
+    _maxRetries = maxRetries;
+    _resends = 0;
+    _nacks = 0;
+    _active = true;
+    _heard = false;
+    _partial = false;
+}
+
+void PN532LinkRecovery::End()
+{
+    _active = false;
+    _partial = false;
+}
+
+PN532FrameDecoder::Event_t PN532LinkRecovery::Feed(uint8_t byte, uint32_t now)
+{
+    _heard = true;
+    _lastByte = now;
+
+    PN532FrameDecoder::Event_t event = _decoder.Feed(byte);
+
+    switch (event)
+    {
+    case PN532FrameDecoder::EVENT_NONE:
+        // A start code which is corrupted later leaves the decoder idle again, so any progress counts
+        if (!_decoder.Idle())
+            _partial = true;
+        break;
+    case PN532FrameDecoder::EVENT_INVALID:
+        // Rest of the frame is skipped as noise, NACK follows once the line is silent
+        _partial = true;
+        event = PN532FrameDecoder::EVENT_NONE;
+        break;
+    default:
+        _partial = false;
+        break;
+    }
+
+    return event;
+}
+
+PN532LinkRecovery::Action_t PN532LinkRecovery::Poll(uint32_t now)
+{
+    if (!_active)
+        return LINK_NONE;
+
+    if (_partial && now - _lastByte >= PN532_LINK_IDLE_TIME)
+    {
+        _partial = false;
+        _decoder.Reset();
+
+        if (_nacks >= _maxRetries)
+            return LINK_FAIL;
+
+        _nacks++;
+        return LINK_NACK;
+    }
+
+    // PN532 silently drops frames with bad checksum, so silence means the command was lost
+    if (!_heard && now - _writeTime >= PN532_ACK_WAIT_TIME)
+    {
+        if (_resends >= _maxRetries)
+            return LINK_TIMEOUT;
+
+        _resends++;
+        _writeTime = now;
+        return LINK_RESEND;
+    }
+
+    return LINK_NONE;
+}
+
+int32_t PN532LinkRecovery::Timeout(uint32_t now) const
+{
+    if (!_active)
+        return -1;
+
+    if (_partial)
+    {
+        uint32_t idle = now - _lastByte;
+        return idle < PN532_LINK_IDLE_TIME ? PN532_LINK_IDLE_TIME - idle : 0;
+    }
+
+    if (!_heard)
+    {
+        uint32_t elapsed = now - _writeTime;
+        return elapsed < PN532_ACK_WAIT_TIME ? PN532_ACK_WAIT_TIME - elapsed : 0;
+    }
+
+    return -1;
+}
@@ -0,0 +1,139 @@
+#ifndef __PN532FRAME_H__
+#define __PN532FRAME_H__
+
+#include <cstdint>
+#include "PN532Interface.h"
+#include "ByteBuffer.h"
+
+#define PN532_ACK_FRAME  {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00}
+// Requests retransmission of the last response
+#define PN532_NACK_FRAME {0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00}
+// Silence which ends a corrupted or truncated frame before NACK is sent
+#define PN532_LINK_IDLE_TIME 5 // ms
+
+// Builds information frame in place around len bytes of data located at frame + PN532_FRAME_HEADROOM.
+// Returns start of the frame and its size in size.
+uint8_t* PN532EncodeFrame(uint8_t *frame, uint16_t len, uint16_t& size, uint8_t tfi = PN532_FRAME_DIR_TO_PN532);
+
+// Incremental decoder of frames sent by PN532. Bytes can be fed as they
+// arrive, so it suits non-blocking transports. Garbage between frames
+// (i.e. line noise or wakeup echo) is skipped until the next start code.
+class PN532FrameDecoder
+{
+public:
+    enum Event_t : uint8_t
+    {
+        EVENT_NONE,         // More bytes needed
+        EVENT_ACK,
+        EVENT_NACK,
+        EVENT_FRAME,        // Information frame is available in Frame()
+        EVENT_ERROR_FRAME,  // PN532 reported syntax error
+        EVENT_INVALID       // Checksum or format error, frame is dropped
+    };
+
+    // Accepts frames with given direction (TFI). Hosts decode PN532_FRAME_DIR_TO_HOST
+    PN532FrameDecoder(uint8_t tfi = PN532_FRAME_DIR_TO_HOST);
+
+    Event_t Feed(uint8_t byte);
+    void Reset();
+
+    // Data of the last information frame without TFI (response code first)
+    BinaryView Frame() const
+    {
+        return BinaryView(_data, _length);
+    }
+
+    // Waiting for a start code, no frame is in progress
+    bool Idle() const
+    {
+        return _state == STATE_START_0;
+    }
+
+private:
+    enum State_t : uint8_t
+    {
+        STATE_START_0,      // Waiting for 0x00 of start code
+        STATE_START_1,      // Waiting for 0xFF of start code
+        STATE_LEN,
+        STATE_LCS,
+        STATE_NACK_OR_EXTENDED,
+        STATE_LENM,
+        STATE_LENL,
+        STATE_EXTENDED_LCS,
+        STATE_TFI,
+        STATE_DATA,
+        STATE_DCS,
+        STATE_POSTAMBLE
+    };
+
+    Event_t Fail();
+
+    uint8_t _tfi;
+    State_t _state;
+    Event_t _pending;   // Reported once postamble is received
+    uint16_t _frameLen; // LEN field (TFI + data)
+    uint16_t _length;   // Received data bytes
+    uint8_t _checksum;
+    uint8_t _data[PN532_MAX_EXTENDED_PACKET_SIZE];
+};
+
+// Link level recovery of HSU transports (PN532_HSU, PN532_Stream). Decodes
+// received bytes and tells the transport when to send the command again
+// (nothing heard within PN532_ACK_WAIT_TIME) or NACK (frame corrupted or cut
+// off, line silent for PN532_LINK_IDLE_TIME). Does no I/O and never blocks,
+// time is passed in by the transport.
+class PN532LinkRecovery
+{
+public:
+    enum Action_t : uint8_t
+    {
+        LINK_NONE,      // Keep waiting
+        LINK_RESEND,    // Write command frame again
+        LINK_NACK,      // Write NACK frame
+        LINK_FAIL,      // Response stays corrupted after all NACKs
+        LINK_TIMEOUT    // No answer after all resends
+    };
+
+    PN532LinkRecovery();
+
+    // Command frame was written at now. Resends and NACKs are bounded by maxRetries each
+    void Begin(uint32_t now, uint8_t maxRetries);
+    // Response was taken, later bytes are only decoded
+    void End();
+
+    // Decodes received byte. Corrupted frames are reported by Poll, not here
+    PN532FrameDecoder::Event_t Feed(uint8_t byte, uint32_t now);
+    // Action due at now. Call after all available bytes were fed
+    Action_t Poll(uint32_t now);
+    // Milliseconds until Poll has an action, -1 if none is scheduled
+    int32_t Timeout(uint32_t now) const;
+
+    // Anything was received since the command was written
+    bool Heard() const
+    {
+        return _heard;
+    }
+
+    uint32_t SinceWrite(uint32_t now) const
+    {
+        return now - _writeTime;
+    }
+
+    const PN532FrameDecoder& Decoder() const
+    {
+        return _decoder;
+    }
+
+private:
+    PN532FrameDecoder _decoder;
+    uint32_t _writeTime;
+    uint32_t _lastByte;
+    uint8_t _maxRetries;
+    uint8_t _resends;
+    uint8_t _nacks;
+    bool _active;   // Command written, response not taken yet
+    bool _heard;
+    bool _partial;  // Bytes of an incomplete or corrupted frame were received
+};
+
+#endif
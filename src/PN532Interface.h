@@ -2,6 +2,11 @@
 #define _PN532INTERFACE_H_
 
 #include <stdint.h>
+#include "PN532Config.h"
+
+#if PN532_CONFIG_TRACE
+#include "WireTrace.h"
+#endif
 
 enum PN532FrameDirection
 {
@@ -18,15 +23,72 @@ enum PN532Error
 };
 
 #define PN532_ACK_WAIT_TIME 10 // ms
+// Retransmissions of a command without ACK or of a corrupted response (NACK)
+#define PN532_MAX_RETRIES 3
+
+// Longest command or response data (command code included) of an extended information frame
+#define PN532_MAX_EXTENDED_PACKET_SIZE 264
+// Bytes reserved before command data for frame header (extended frame: preamble, start code, 0xFFFF, LENM, LENL, LCS, TFI)
+#define PN532_FRAME_HEADROOM 9
+// Bytes reserved after command data (DCS, postamble)
+#define PN532_FRAME_TAILROOM 2
 
 class PN532Interface
 {
 public:
+#if PN532_CONFIG_TRACE
+    PN532Interface() : _trace(nullptr) {}
+#endif
+    virtual ~PN532Interface() {}
+
     virtual void begin() = 0;
     virtual void wakeup() = 0;
 
-    virtual int8_t writeCommand(const uint8_t *data, uint8_t len) = 0;
-    virtual int16_t readResponse(uint8_t buf[], uint8_t len, uint16_t timeout = 1000) = 0;
+    virtual int8_t writeCommand(const uint8_t *data, uint16_t len) = 0;
+    virtual int16_t readResponse(uint8_t buf[], uint16_t len, uint16_t timeout = 1000) = 0;
+
+    // Writes len bytes of command data located at frame + PN532_FRAME_HEADROOM.
+    // Buffer has PN532_FRAME_HEADROOM bytes before and PN532_FRAME_TAILROOM bytes
+    // after data, so transports can build the frame in place and send it at once.
+    virtual int8_t writeFrame(uint8_t *frame, uint16_t len)
+    {
+        return writeCommand(frame + PN532_FRAME_HEADROOM, len);
+    }
+
+#if PN532_CONFIG_TRACE
+    // Records all commands and responses into trace (nullptr disables tracing)
+    void setTrace(WireTrace *trace)
+    {
+        _trace = trace;
+    }
+#endif
+
+protected:
+#if PN532_CONFIG_TRACE
+    // Called by implementations with every command sent and response received
+    void traceCommand(const uint8_t *data, uint16_t len)
+    {
+        if (_trace)
+            _trace->Record(TRACE_COMMAND, data, len);
+    }
+
+    void traceResponse(const uint8_t *buf, int16_t status)
+    {
+        if (!_trace)
+            return;
+
+        if (status < 0)
+            _trace->RecordError(status);
+        else
+            _trace->Record(TRACE_RESPONSE, buf, status);
+    }
+
+    WireTrace *_trace;
+#else
+    // Hooks compile to nothing
+    void traceCommand(const uint8_t * /* data */, uint16_t /* len */) {}
+    void traceResponse(const uint8_t * /* buf */, int16_t /* status */) {}
+#endif
 };
 
 #endif
@@ -21,9 +21,46 @@ ByteBuffer& operator<<(ByteBuffer& a, const SAMConfiguration& b)
     return a;
 }
 
+ByteBuffer& operator<<(ByteBuffer& a, const PowerDownRequest& b)
+{
+    a << b.WakeUpEnable;
+    a << (uint8_t)(b.GenerateIRQ ? 0x01 : 0x00);
+
+    return a;
+}
+
+ByteBuffer& operator<<(ByteBuffer& a, const RFConfiguration_Field& b)
+{
+    a << RF_CONFIG_FIELD;
+
+    a << (uint8_t)((b.RF ? 0x01 : 0x00) | (b.AutoRFCA ? 0x02 : 0x00));
+
+    return a;
+}
+
+ByteBuffer& operator<<(ByteBuffer& a, const RFConfiguration_Timings& b)
+{
+    a << RF_CONFIG_TIMINGS;
+
+    a << (uint8_t)0x00; // RFU
+    a << b.ATR_RES_Timeout;
+    a << b.RetryTimeout;
+
+    return a;
+}
+
+ByteBuffer& operator<<(ByteBuffer& a, const RFConfiguration_MaxRetryCOM& b)
+{
+    a << RF_CONFIG_MAX_RETRY_COM;
+
+    a << b.MaxRtyCOM;
+
+    return a;
+}
+
 ByteBuffer& operator<<(ByteBuffer& a, const RFConfiguration_MaxRetries& b)
 {
-    a << (uint8_t)0x05; // Max Retries Cfg
+    a << RF_CONFIG_MAX_RETRIES;
 
     a << b.MxRtyATR;
     a << b.MxRtyPSL;
@@ -32,6 +69,41 @@ ByteBuffer& operator<<(ByteBuffer& a, const RFConfiguration_MaxRetries& b)
     return a;
 }
 
+ByteBuffer& operator<<(ByteBuffer& a, const RFConfiguration_AnalogTypeA& b)
+{
+    a << RF_CONFIG_ANALOG_TYPE_A;
+
+    a << b.RFCfg;
+    a << b.GsNOn;
+    a << b.CWGsP;
+    a << b.ModGsP;
+    a << b.DemodWhenRfOn;
+    a << b.RxThreshold;
+    a << b.DemodWhenRfOff;
+    a << b.GsNOff;
+    a << b.ModWidth;
+    a << b.MifNFC;
+    a << b.TxBitPhase;
+
+    return a;
+}
+
+ByteBuffer& operator<<(ByteBuffer& a, const RFConfiguration_Analog212_424& b)
+{
+    a << RF_CONFIG_ANALOG_212_424;
+
+    a << b.RFCfg;
+    a << b.GsNOn;
+    a << b.CWGsP;
+    a << b.ModGsP;
+    a << b.DemodWhenRfOn;
+    a << b.RxThreshold;
+    a << b.DemodWhenRfOff;
+    a << b.GsNOff;
+
+    return a;
+}
+
 ByteBuffer& operator>>(ByteBuffer& a, TargetDataTypeA& b)
 {
     a >> b.Tg;
@@ -44,10 +116,69 @@ ByteBuffer& operator>>(ByteBuffer& a, TargetDataTypeA& b)
     a >> UIDLen;
     b.UID = a.ReadBinary(UIDLen);
 
-    uint8_t ATSLen = 0;
-    a >> ATSLen;
-    if (ATSLen > 1)
-        b.ATS = a.ReadBinary(ATSLen-1); // ATS len includes "ATSLen" byte
+    // ATS is only present for ISO14443-4 compliant targets. Without this check
+    // Tg of the second target would be parsed as ATS length.
+    b.ATS.clear();
+    if (b.SAK & 0x20)
+    {
+        uint8_t ATSLen = 0;
+        a >> ATSLen;
+        if (ATSLen > 1)
+            b.ATS = a.ReadBinary(ATSLen-1); // ATS len includes "ATSLen" byte
+    }
+
+    return a;
+}
+
+ByteBuffer& operator>>(ByteBuffer& a, TargetDataTypeB& b)
+{
+    a >> b.Tg;
+
+    for (uint8_t i = 0; i < sizeof(b.ATQB); ++i)
+        a >> b.ATQB[i];
+
+    uint8_t ATTRIBLen = 0;
+    a >> ATTRIBLen;
+    b.ATTRIB_RES = a.ReadBinary(ATTRIBLen);
+
+    return a;
+}
+
+ByteBuffer& operator>>(ByteBuffer& a, TargetDataFeliCa& b)
+{
+    a >> b.Tg;
+
+    uint8_t POLRESLen = 0;
+    a >> POLRESLen; // Includes length byte itself
+    a >> b.ResponseCode;
+
+    for (uint8_t i = 0; i < sizeof(b.NFCID2); ++i)
+        a >> b.NFCID2[i];
+
+    for (uint8_t i = 0; i < sizeof(b.Pad); ++i)
+        a >> b.Pad[i];
+
+    // System code is sent MSB first
+    b.SystemCode = 0xFFFF;
+    if (POLRESLen >= 20)
+    {
+        uint8_t hi = 0, lo = 0;
+        a >> hi;
+        a >> lo;
+        b.SystemCode = (hi << 8) | lo;
+    }
+
+    return a;
+}
+
+ByteBuffer& operator>>(ByteBuffer& a, TargetDataJewel& b)
+{
+    a >> b.Tg;
+    a >> b.SENS_RES[0];
+    a >> b.SENS_RES[1];
+
+    for (uint8_t i = 0; i < sizeof(b.JewelID); ++i)
+        a >> b.JewelID[i];
 
     return a;
 }
@@ -69,6 +200,63 @@ ByteBuffer& operator>>(ByteBuffer& a, InListPassiveTargetResponse& b)
     return a;
 }
 
+ByteBuffer& operator>>(ByteBuffer& a, TargetListTypeA& b)
+{
+    a >> b.NbTg;
+
+    if (b.NbTg > 2)
+        b.NbTg = 2;
+
+    for (uint8_t i = 0; i < b.NbTg; ++i)
+        a >> b.Targets[i];
+
+    return a;
+}
+
+ByteBuffer& operator<<(ByteBuffer& a, const InitiatorDataTypeB& b)
+{
+    a << b.AFI;
+
+    return a;
+}
+
+ByteBuffer& operator<<(ByteBuffer& a, const InitiatorDataFeliCa& b)
+{
+    a << (uint8_t)0x00; // Polling command code
+    a << (uint8_t)(b.SystemCode >> 8); // Sent MSB first
+    a << (uint8_t)b.SystemCode;
+    a << b.RequestCode;
+    a << b.TimeSlot;
+
+    return a;
+}
+
+ByteBuffer& operator>>(ByteBuffer& a, TargetListTypeB& b)
+{
+    a >> b.NbTg;
+
+    if (b.NbTg > 2)
+        b.NbTg = 2;
+
+    for (uint8_t i = 0; i < b.NbTg; ++i)
+        a >> b.Targets[i];
+
+    return a;
+}
+
+ByteBuffer& operator>>(ByteBuffer& a, TargetListFeliCa& b)
+{
+    a >> b.NbTg;
+
+    if (b.NbTg > 2)
+        b.NbTg = 2;
+
+    for (uint8_t i = 0; i < b.NbTg; ++i)
+        a >> b.Targets[i];
+
+    return a;
+}
+
 ByteBuffer& operator<<(ByteBuffer& a, const InReleaseRequest& b)
 {
     a << b.Tg;
@@ -83,3 +271,89 @@ ByteBuffer& operator>>(ByteBuffer& a, InReleaseResponse& b)
     return a;
 }
 
+
+ByteBuffer& operator<<(ByteBuffer& a, const InAutoPollRequest& b)
+{
+    a << b.PollNr;
+    a << b.Period;
+    a << b.Types;
+
+    return a;
+}
+
+// Modulation of autopoll target type. Returns false for DEP targets
+static bool AutoPollBrTy(AutoPollType_t type, BrTy_t& brty)
+{
+    switch (type)
+    {
+        case AUTOPOLL_GENERIC_106KBPS:
+        case AUTOPOLL_MIFARE:
+        case AUTOPOLL_ISO14443_4A_106KBPS:
+            brty = BRTY_106KBPS_TYPE_A;
+            return true;
+        case AUTOPOLL_GENERIC_212KBPS:
+        case AUTOPOLL_FELICA_212KBPS:
+            brty = BRTY_212KBPS;
+            return true;
+        case AUTOPOLL_GENERIC_424KBPS:
+        case AUTOPOLL_FELICA_424KBPS:
+            brty = BRTY_424KBPS;
+            return true;
+        case AUTOPOLL_TYPE_B_106KBPS:
+        case AUTOPOLL_ISO14443_4B_106KBPS:
+            brty = BRTY_106KBPS_TYPE_B;
+            return true;
+        case AUTOPOLL_JEWEL_106KBPS:
+            brty = BRTY_106KBPS_JEWEL;
+            return true;
+        default:
+            brty = BRTY_UNKNOWN;
+            return false;
+    }
+}
+
+ByteBuffer& operator>>(ByteBuffer& a, InAutoPollResponse& b)
+{
+    a >> b.NbTg;
+
+    if (b.NbTg > 2)
+        b.NbTg = 2;
+
+    for (uint8_t i = 0; i < b.NbTg; ++i)
+    {
+        AutoPollTarget& target = b.Targets[i];
+
+        uint8_t type = 0, len = 0;
+        a >> type;
+        a >> len;
+        target.Type = (AutoPollType_t)type;
+        target.Data = a.ReadBinary(len);
+        target.Tg = target.Data.empty() ? 0 : target.Data[0];
+
+        // Target data format depends on modulation type
+        if (!AutoPollBrTy(target.Type, target.BrTy))
+            continue;
+
+        ByteBuffer data(target.Data);
+        switch (target.BrTy)
+        {
+            case BRTY_106KBPS_TYPE_A:
+                data >> target.TypeA;
+                break;
+            case BRTY_212KBPS:
+            case BRTY_424KBPS:
+                data >> target.FeliCa;
+                break;
+            case BRTY_106KBPS_TYPE_B:
+                data >> target.TypeB;
+                break;
+            case BRTY_106KBPS_JEWEL:
+                data >> target.Jewel;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return a;
+}
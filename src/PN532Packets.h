@@ -5,16 +5,68 @@
 #include <vector>
 #include "ByteBuffer.h"
 
+// Maximum number of types polled in a single InAutoPoll
+#define PN532_AUTOPOLL_MAX_TYPES 15
+// Polls endlessly until a target is found
+#define PN532_AUTOPOLL_ENDLESS 0xFF
+
 namespace PN532Packets
 {
     enum Commands : uint8_t
     {
+        COMMAND_DIAGNOSE                = 0x00,
         COMMAND_GETFIRMWAREVERSION      = 0x02,
         COMMAND_SAMCONFIGURATION        = 0x14,
+        COMMAND_POWERDOWN               = 0x16,
         COMMAND_RFCONFIGURATION         = 0x32,
         COMMAND_INDATAEXCHANGE          = 0x40,
+        COMMAND_INCOMMUNICATETHRU       = 0x42,
         COMMAND_INLISTPASSIVETARGET     = 0x4A,
-        COMMAND_INRELEASE               = 0x52
+        COMMAND_INRELEASE               = 0x52,
+        COMMAND_INAUTOPOLL              = 0x60
+    };
+
+    // Error codes returned in status byte of InDataExchange, InRelease, etc.
+    enum PN532Status_t : uint8_t
+    {
+        PN532_STATUS_OK                     = 0x00,
+        PN532_STATUS_TIMEOUT                = 0x01, // Target has not answered
+        PN532_STATUS_CRC_ERROR              = 0x02,
+        PN532_STATUS_PARITY_ERROR           = 0x03,
+        PN532_STATUS_ANTICOLLISION_ERROR    = 0x04, // Erroneous bit count during anticollision/select
+        PN532_STATUS_FRAMING_ERROR          = 0x05, // Mifare framing error
+        PN532_STATUS_BIT_COLLISION          = 0x06, // Abnormal bit collision
+        PN532_STATUS_BUFFER_TOO_SMALL       = 0x07, // Communication buffer size insufficient
+        PN532_STATUS_RF_BUFFER_OVERFLOW     = 0x09,
+        PN532_STATUS_RF_FIELD_TIMEOUT       = 0x0A, // RF field has not been switched on in time
+        PN532_STATUS_RF_PROTOCOL_ERROR      = 0x0B,
+        PN532_STATUS_OVERHEATING            = 0x0D,
+        PN532_STATUS_INTERNAL_OVERFLOW      = 0x0E, // Internal buffer overflow
+        PN532_STATUS_INVALID_PARAMETER      = 0x10,
+        PN532_STATUS_DEP_UNSUPPORTED        = 0x12,
+        PN532_STATUS_DEP_INVALID_FORMAT     = 0x13,
+        PN532_STATUS_AUTHENTICATION_ERROR   = 0x14, // Mifare authentication error
+        PN532_STATUS_UID_CHECK_ERROR        = 0x23,
+        PN532_STATUS_DEP_INVALID_STATE      = 0x25,
+        PN532_STATUS_NOT_ALLOWED            = 0x26,
+        PN532_STATUS_WRONG_CONTEXT          = 0x27,
+        PN532_STATUS_TARGET_RELEASED        = 0x29,
+        PN532_STATUS_CARD_ID_MISMATCH       = 0x2A, // Card has been exchanged
+        PN532_STATUS_CARD_DISAPPEARED       = 0x2B,
+        PN532_STATUS_NFCID3_MISMATCH        = 0x2C,
+        PN532_STATUS_OVER_CURRENT           = 0x2D,
+        PN532_STATUS_NAD_MISSING            = 0x2E
+    };
+
+    enum DiagnoseTest_t : uint8_t
+    {
+        DIAGNOSE_COMMUNICATION_LINE     = 0x00, // Echoes parameters back to host
+        DIAGNOSE_ROM                    = 0x01,
+        DIAGNOSE_RAM                    = 0x02,
+        DIAGNOSE_POLLING                = 0x04, // Counts failed polls of the current target
+        DIAGNOSE_ECHO_BACK              = 0x05,
+        DIAGNOSE_ATTENTION_REQUEST      = 0x06, // ISO14443-4 card presence check of the current target
+        DIAGNOSE_SELF_ANTENNA           = 0x07
     };
 
     struct GetFirmwareVersionResponse
@@ -45,6 +97,73 @@ namespace PN532Packets
         uint8_t IRQ;
     };
 
+    // WakeUpEnable bits of PowerDown
+    enum WakeUpSource_t : uint8_t
+    {
+        WAKEUP_INT0         = 0x01, // P32 pin
+        WAKEUP_INT1         = 0x02, // P33 pin
+        WAKEUP_RF           = 0x08, // RF level detector (external field of another reader or phone)
+        WAKEUP_HSU          = 0x10,
+        WAKEUP_SPI          = 0x20,
+        WAKEUP_GPIO         = 0x40, // P34 and P35 pins
+        WAKEUP_I2C          = 0x80
+    };
+
+    struct PowerDownRequest
+    {
+        uint8_t WakeUpEnable;   // WakeUpSource_t bits
+        bool GenerateIRQ;       // Pulse P70_IRQ when woken up by RF or INT pins
+    };
+
+    enum RFConfigItem_t : uint8_t
+    {
+        RF_CONFIG_FIELD                 = 0x01, // RF field on/off
+        RF_CONFIG_TIMINGS               = 0x02, // ATR_RES and retry timeouts
+        RF_CONFIG_MAX_RETRY_COM         = 0x04, // Retries of InDataExchange and InCommunicateThru
+        RF_CONFIG_MAX_RETRIES           = 0x05, // Retries of ATR_REQ, PSL_REQ and passive activation
+        RF_CONFIG_ANALOG_TYPE_A         = 0x0A, // Analog settings for 106 kbps type A
+        RF_CONFIG_ANALOG_212_424        = 0x0B  // Analog settings for 212/424 kbps
+    };
+
+    // Timeout codes of RF_CONFIG_TIMINGS. Each step doubles the timeout
+    enum RFTimeout_t : uint8_t
+    {
+        RF_TIMEOUT_NONE     = 0x00,
+        RF_TIMEOUT_100US    = 0x01,
+        RF_TIMEOUT_200US    = 0x02,
+        RF_TIMEOUT_400US    = 0x03,
+        RF_TIMEOUT_800US    = 0x04,
+        RF_TIMEOUT_1_6MS    = 0x05,
+        RF_TIMEOUT_3_2MS    = 0x06,
+        RF_TIMEOUT_6_4MS    = 0x07,
+        RF_TIMEOUT_12_8MS   = 0x08,
+        RF_TIMEOUT_25_6MS   = 0x09,
+        RF_TIMEOUT_51_2MS   = 0x0A, // Default retry timeout
+        RF_TIMEOUT_102_4MS  = 0x0B, // Default ATR_RES timeout
+        RF_TIMEOUT_204_8MS  = 0x0C,
+        RF_TIMEOUT_409_6MS  = 0x0D,
+        RF_TIMEOUT_819_2MS  = 0x0E,
+        RF_TIMEOUT_1_64S    = 0x0F,
+        RF_TIMEOUT_3_28S    = 0x10
+    };
+
+    struct RFConfiguration_Field
+    {
+        bool RF;                    // Switch RF field on
+        bool AutoRFCA;              // Check for external field before switching on
+    };
+
+    struct RFConfiguration_Timings
+    {
+        RFTimeout_t ATR_RES_Timeout;    // Timeout of ATR_RES (DEP targets)
+        RFTimeout_t RetryTimeout;       // Timeout of any other exchange with target
+    };
+
+    struct RFConfiguration_MaxRetryCOM
+    {
+        uint8_t MaxRtyCOM;          // 0x00 disables retries, 0xFF retries endlessly
+    };
+
     struct RFConfiguration_MaxRetries
     {
         uint8_t MxRtyATR;
@@ -52,13 +171,42 @@ namespace PN532Packets
         uint8_t MxRtyPassiveActivation;
     };
 
+    // CIU register values (see PN532 user manual for bit meanings)
+    struct RFConfiguration_AnalogTypeA
+    {
+        uint8_t RFCfg;              // Receiver gain and RF level detector
+        uint8_t GsNOn;              // N driver conductance when field is on
+        uint8_t CWGsP;              // P driver conductance for continuous wave
+        uint8_t ModGsP;             // P driver conductance during modulation
+        uint8_t DemodWhenRfOn;
+        uint8_t RxThreshold;        // Minimum signal and collision levels of decoder
+        uint8_t DemodWhenRfOff;
+        uint8_t GsNOff;
+        uint8_t ModWidth;
+        uint8_t MifNFC;
+        uint8_t TxBitPhase;
+    };
+
+    struct RFConfiguration_Analog212_424
+    {
+        uint8_t RFCfg;
+        uint8_t GsNOn;
+        uint8_t CWGsP;
+        uint8_t ModGsP;
+        uint8_t DemodWhenRfOn;
+        uint8_t RxThreshold;
+        uint8_t DemodWhenRfOff;
+        uint8_t GsNOff;
+    };
+
     enum BrTy_t : uint8_t // Baud rate and modulation type
     {
         BRTY_106KBPS_TYPE_A     = 0x00, // ISO/IEC14443 Type A
         BRTY_212KBPS            = 0x01, // FeliCa polling
         BRTY_424KBPS            = 0x02, // FeliCa polling
         BRTY_106KBPS_TYPE_B     = 0x03, // ISO/IEC14443-3B
-        BRTY_106KBPS_JEWEL      = 0x04  // Innovision Jewel tag
+        BRTY_106KBPS_JEWEL      = 0x04, // Innovision Jewel tag
+        BRTY_UNKNOWN            = 0xFF  // Not a passive target (i.e. DEP)
     };
 
     struct TargetDataTypeA
@@ -70,6 +218,29 @@ namespace PN532Packets
         BinaryData ATS;
     };
 
+    struct TargetDataTypeB
+    {
+        uint8_t Tg;
+        uint8_t ATQB[12];
+        BinaryData ATTRIB_RES;
+    };
+
+    struct TargetDataFeliCa
+    {
+        uint8_t Tg;
+        uint8_t ResponseCode;       // Always 0x01
+        uint8_t NFCID2[8];
+        uint8_t Pad[8];
+        uint16_t SystemCode;        // Only present if requested in polling (0xFFFF otherwise)
+    };
+
+    struct TargetDataJewel
+    {
+        uint8_t Tg;
+        uint8_t SENS_RES[2];
+        uint8_t JewelID[4];
+    };
+
     struct InListPassiveTargetRequest
     {
         uint8_t MaxTg;              // Maximum number of targets to be initialized by the PN532 (limit 2)
@@ -83,6 +254,84 @@ namespace PN532Packets
         BinaryData TgData; // Target Data
     };
 
+    enum AutoPollType_t : uint8_t
+    {
+        AUTOPOLL_GENERIC_106KBPS        = 0x00, // Generic passive 106 kbps (ISO/IEC14443-4A, Mifare and DEP)
+        AUTOPOLL_GENERIC_212KBPS        = 0x01, // Generic passive 212 kbps (FeliCa and DEP)
+        AUTOPOLL_GENERIC_424KBPS        = 0x02, // Generic passive 424 kbps (FeliCa and DEP)
+        AUTOPOLL_TYPE_B_106KBPS         = 0x03, // Passive 106 kbps ISO/IEC14443-4B
+        AUTOPOLL_JEWEL_106KBPS          = 0x04, // Innovision Jewel tag
+        AUTOPOLL_MIFARE                 = 0x10, // Mifare card
+        AUTOPOLL_FELICA_212KBPS         = 0x11, // FeliCa 212 kbps card
+        AUTOPOLL_FELICA_424KBPS         = 0x12, // FeliCa 424 kbps card
+        AUTOPOLL_ISO14443_4A_106KBPS    = 0x20, // Passive 106 kbps ISO/IEC14443-4A
+        AUTOPOLL_ISO14443_4B_106KBPS    = 0x23, // Passive 106 kbps ISO/IEC14443-4B
+        AUTOPOLL_DEP_PASSIVE_106KBPS    = 0x40,
+        AUTOPOLL_DEP_PASSIVE_212KBPS    = 0x41,
+        AUTOPOLL_DEP_PASSIVE_424KBPS    = 0x42,
+        AUTOPOLL_DEP_ACTIVE_106KBPS     = 0x80,
+        AUTOPOLL_DEP_ACTIVE_212KBPS     = 0x81,
+        AUTOPOLL_DEP_ACTIVE_424KBPS     = 0x82
+    };
+
+    struct InAutoPollRequest
+    {
+        uint8_t PollNr;             // Number of polling rounds (0x01-0xFE, 0xFF for endless polling)
+        uint8_t Period;             // Polling period in units of 150 ms (0x01-0x0F)
+        BinaryData Types;           // Target types to poll (AutoPollType_t, up to 15)
+    };
+
+    struct AutoPollTarget
+    {
+        AutoPollType_t Type;
+        uint8_t Tg;
+        BrTy_t BrTy;                // Modulation of target, selects valid target data member
+        TargetDataTypeA TypeA;
+        TargetDataTypeB TypeB;
+        TargetDataFeliCa FeliCa;
+        TargetDataJewel Jewel;
+        BinaryData Data;            // Raw target data (DEP targets are only available here)
+    };
+
+    struct InAutoPollResponse
+    {
+        uint8_t NbTg;               // Number of detected targets
+        AutoPollTarget Targets[2];
+    };
+
+    // InListPassiveTarget response parsed as ISO14443 Type A targets
+    struct TargetListTypeA
+    {
+        uint8_t NbTg;
+        TargetDataTypeA Targets[2];
+    };
+
+    // InitiatorData of BRTY_106KBPS_TYPE_B
+    struct InitiatorDataTypeB
+    {
+        uint8_t AFI;                // Application family identifier, 0x00 polls all families
+    };
+
+    // InitiatorData of BRTY_212KBPS and BRTY_424KBPS (FeliCa polling command)
+    struct InitiatorDataFeliCa
+    {
+        uint16_t SystemCode;        // 0xFFFF polls any system
+        uint8_t RequestCode;        // 0x01 requests system code in response
+        uint8_t TimeSlot;           // Number of time slots - 1 (0x00, 0x01, 0x03, 0x07 or 0x0F)
+    };
+
+    struct TargetListTypeB
+    {
+        uint8_t NbTg;
+        TargetDataTypeB Targets[2];
+    };
+
+    struct TargetListFeliCa
+    {
+        uint8_t NbTg;
+        TargetDataFeliCa Targets[2];
+    };
+
     struct InReleaseRequest
     {
         uint8_t Tg;
@@ -96,11 +345,27 @@ namespace PN532Packets
 
 ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::GetFirmwareVersionResponse& b);
 ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::SAMConfiguration& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::PowerDownRequest& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::RFConfiguration_Field& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::RFConfiguration_Timings& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::RFConfiguration_MaxRetryCOM& b);
 ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::RFConfiguration_MaxRetries& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::RFConfiguration_AnalogTypeA& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::RFConfiguration_Analog212_424& b);
 ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::TargetDataTypeA& b);
+ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::TargetDataTypeB& b);
+ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::TargetDataFeliCa& b);
+ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::TargetDataJewel& b);
 ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::InListPassiveTargetRequest& b);
 ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::InListPassiveTargetResponse& b);
+ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::TargetListTypeA& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::InitiatorDataTypeB& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::InitiatorDataFeliCa& b);
+ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::TargetListTypeB& b);
+ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::TargetListFeliCa& b);
 ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::InReleaseRequest& b);
 ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::InReleaseResponse& b);
+ByteBuffer& operator<<(ByteBuffer& a, const PN532Packets::InAutoPollRequest& b);
+ByteBuffer& operator>>(ByteBuffer& a, PN532Packets::InAutoPollResponse& b);
 
 #endif
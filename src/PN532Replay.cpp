@@ -0,0 +1,101 @@
+#include "PN532Replay.h"
+
+#if PN532_CONFIG_TRACE
+
+#include "Platform.h"
+#include <cstring>
+
+PN532Replay::PN532Replay(const BinaryData& trace) :
+    RealTime(false), Strict(false), _trace(trace), _offset(0), _commandTimestamp(0), _mismatches(0), _pending(false)
+{
+
+}
+
+void PN532Replay::Rewind()
+{
+    _offset = 0;
+    _mismatches = 0;
+    _pending = false;
+}
+
+bool PN532Replay::Finished() const
+{
+    size_t offset = _offset;
+    WireTraceRecord record;
+
+    while (WireTrace::Next(_trace, offset, record))
+    {
+        if (record.Type == TRACE_COMMAND)
+            return false;
+    }
+
+    return true;
+}
+
+bool PN532Replay::SeekCommand(WireTraceRecord& record)
+{
+    // Responses which were not read during recording are skipped
+    while (WireTrace::Next(_trace, _offset, record))
+    {
+        if (record.Type == TRACE_COMMAND)
+            return true;
+    }
+
+    return false;
+}
+
+int8_t PN532Replay::writeCommand(const uint8_t *data, uint16_t len)
+{
+    traceCommand(data, len);
+    _pending = false;
+
+    WireTraceRecord record;
+    if (!SeekCommand(record))
+        return PN532_ERROR_TIMEOUT;
+
+    if (record.Data.Size != len || memcmp(record.Data.Data, data, len))
+    {
+        _mismatches++;
+
+        if (Strict)
+            return PN532_ERROR_INVALID_ACK;
+    }
+
+    _commandTimestamp = record.Timestamp;
+    _pending = true;
+
+    return 0;
+}
+
+int16_t PN532Replay::readResponse(uint8_t buf[], uint16_t len, uint16_t /* timeout */)
+{
+    int16_t status = PN532_ERROR_TIMEOUT;
+    WireTraceRecord record;
+    size_t offset = _offset;
+
+    // Response is either data or a recorded transport error
+    if (_pending && WireTrace::Next(_trace, offset, record) && record.Type != TRACE_COMMAND)
+    {
+        _offset = offset;
+
+        if (RealTime)
+            PlatformSleepMicros(record.Timestamp - _commandTimestamp);
+
+        if (record.Type == TRACE_ERROR)
+            status = record.Error();
+        else if (record.Data.Size > len)
+            status = PN532_ERROR_NO_SPACE;
+        else
+        {
+            memcpy(buf, record.Data.Data, record.Data.Size);
+            status = record.Data.Size;
+        }
+    }
+
+    _pending = false;
+    traceResponse(buf, status);
+
+    return status;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __PN532REPLAY_H__
+#define __PN532REPLAY_H__
+
+#include "PN532Interface.h"
+#include "WireTrace.h"
+#include "PN532Config.h"
+
+#if PN532_CONFIG_TRACE
+
+// PN532Interface which answers commands with responses from an exported
+// WireTrace. Responses are returned in recorded order, so a field session can
+// be reproduced offline. Commands which differ from the recording (i.e.
+// random authentication challenges) are counted as mismatches.
+class PN532Replay : public PN532Interface
+{
+public:
+    // Trace data must outlive the replay
+    PN532Replay(const BinaryData& trace);
+
+    void begin() {}
+    void wakeup() {}
+
+    int8_t writeCommand(const uint8_t *data, uint16_t len);
+    int16_t readResponse(uint8_t buf[], uint16_t len, uint16_t timeout = 1000);
+
+    // Starts from the first record
+    void Rewind();
+
+    // All recorded commands have been replayed
+    bool Finished() const;
+
+    uint32_t Mismatches() const
+    {
+        return _mismatches;
+    }
+
+    // Sleep for recorded time between command and response instead of running at full speed
+    bool RealTime;
+    // Fail commands which differ from the recording
+    bool Strict;
+
+private:
+    // Advances past the next command record
+    bool SeekCommand(WireTraceRecord& record);
+
+    BinaryView _trace;
+    size_t _offset;
+    uint32_t _commandTimestamp; // Of the last replayed command
+    uint32_t _mismatches;
+    bool _pending;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,665 @@
+#include "PN532Simulator.h"
+
+#if PN532_CONFIG_SIMULATOR
+
+#include "IsoDep.h"
+#include "PN532Packets.h"
+#include "Platform.h"
+#include <cstring>
+
+using namespace PN532Packets;
+
+PN532Simulator::PN532Simulator() : RealTime(false), DropInterval(0), _rfOn(true), _fieldCold(false), _poweredDown(false), _lowVbat(false),
+    _wakeUpEnable(0), _current(0), _rfTimeout(51200), _answers(0), _pending(false), _valid(false), _elapsed(0)
+{
+    Timing.Baudrate = 115200;
+    Timing.CommandMicros = 100;
+    Timing.RFByteMicros = 85;
+    Timing.RFFrameMicros = 300;
+    Timing.ActivationMicros = 4000;
+    Timing.PollMicros = 5000;
+    Timing.WakeUpMicros = 1000;
+    Timing.FieldOnMicros = 5000;
+
+    for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS; ++i)
+    {
+        _cards[i] = nullptr;
+        _tg[i] = 0;
+    }
+
+    _response.Data().reserve(PN532_MAX_EXTENDED_PACKET_SIZE);
+    _payload.Data().reserve(PN532_MAX_EXTENDED_PACKET_SIZE);
+}
+
+void PN532Simulator::SetCard(uint8_t slot, SimulatedCard* card)
+{
+    if (slot >= PN532_SIMULATOR_MAX_CARDS)
+        return;
+
+    _cards[slot] = card;
+    _tg[slot] = 0;
+}
+
+void PN532Simulator::wakeup()
+{
+    // 0x55 0x55 0x00 0x00 0x00
+    Spend(UARTMicros(5));
+
+    if (_poweredDown && (_wakeUpEnable & WAKEUP_HSU))
+    {
+        Spend(Timing.WakeUpMicros);
+        _poweredDown = false;
+    }
+
+    _pending = false;
+}
+
+bool PN532Simulator::ExternalField()
+{
+    if (!_poweredDown || !(_wakeUpEnable & WAKEUP_RF))
+        return false;
+
+    Spend(Timing.WakeUpMicros);
+    _poweredDown = false;
+
+    return true;
+}
+
+void PN532Simulator::PowerCycle()
+{
+    ReleaseAll();
+
+    _rfOn = true;
+    _fieldCold = true;
+    _poweredDown = true;
+    _lowVbat = true;
+    _wakeUpEnable = WAKEUP_HSU;
+    _current = 0;
+    _pending = false;
+}
+
+void PN532Simulator::Spend(uint32_t us)
+{
+    _elapsed += us;
+
+    if (RealTime)
+        PlatformSleepMicros(us);
+}
+
+uint32_t PN532Simulator::UARTMicros(uint16_t bytes) const
+{
+    // Start, 8 data and stop bits
+    return (uint32_t)((uint64_t)bytes * 10 * 1000000 / Timing.Baudrate);
+}
+
+int8_t PN532Simulator::writeCommand(const uint8_t *data, uint16_t len)
+{
+    if (!len)
+        return PN532_ERROR_INVALID_FRAME;
+
+    traceCommand(data, len);
+
+    // Without preamble the frame only wakes the PN532 and is lost
+    if (_poweredDown)
+    {
+        Spend(UARTMicros(len + (len > 254 ? 11 : 8)) + PN532_ACK_WAIT_TIME * 1000);
+        if (_wakeUpEnable & WAKEUP_HSU)
+        {
+            Spend(Timing.WakeUpMicros);
+            _poweredDown = false;
+        }
+
+        _pending = false;
+        return PN532_ERROR_INVALID_ACK;
+    }
+
+    // Frame (preamble, start code, length, TFI, DCS, postamble) and ACK
+    Spend(UARTMicros(len + (len > 254 ? 11 : 8)) + UARTMicros(6));
+
+    Process(BinaryView(data, len));
+    _pending = true;
+
+    return 0;
+}
+
+int16_t PN532Simulator::readResponse(uint8_t buf[], uint16_t len, uint16_t /* timeout */)
+{
+    int16_t status = Respond(buf, len);
+    traceResponse(buf, status);
+
+    return status;
+}
+
+int16_t PN532Simulator::Respond(uint8_t buf[], uint16_t len)
+{
+    if (!_pending)
+        return PN532_ERROR_TIMEOUT;
+
+    _pending = false;
+
+    if (!_valid)
+        return PN532_ERROR_INVALID_FRAME;
+
+    uint16_t size = _response.Size();
+    Spend(Timing.CommandMicros + UARTMicros(size + (size > 252 ? 12 : 9)));
+
+    if (size > len)
+        return PN532_ERROR_NO_SPACE;
+
+    memcpy(buf, _response.Data().data(), size);
+
+    return size;
+}
+
+void PN532Simulator::Process(const BinaryView& cmd)
+{
+    _response.Clear();
+    _valid = true;
+
+    BinaryView params = cmd.Sub(1);
+
+    // After restart only configuration commands are served
+    if (_lowVbat && cmd[0] != COMMAND_SAMCONFIGURATION && cmd[0] != COMMAND_GETFIRMWAREVERSION)
+    {
+        _valid = false;
+        return;
+    }
+
+    switch (cmd[0])
+    {
+    case COMMAND_DIAGNOSE:
+        Diagnose(params);
+        break;
+    case COMMAND_GETFIRMWAREVERSION:
+        // PN532 v1.6, all protocols supported
+        _response << (uint8_t)0x32 << (uint8_t)0x01 << (uint8_t)0x06 << (uint8_t)0x07;
+        break;
+    case COMMAND_SAMCONFIGURATION:
+        _lowVbat = false;
+        break;
+    case COMMAND_POWERDOWN:
+        PowerDown(params);
+        break;
+    case COMMAND_RFCONFIGURATION:
+        RFConfiguration(params);
+        break;
+    case COMMAND_INLISTPASSIVETARGET:
+        InListPassiveTarget(params);
+        break;
+    case COMMAND_INDATAEXCHANGE:
+        InDataExchange(params);
+        break;
+    case COMMAND_INCOMMUNICATETHRU:
+        InCommunicateThru(params);
+        break;
+    case COMMAND_INRELEASE:
+        InRelease(params);
+        break;
+    case COMMAND_INAUTOPOLL:
+        InAutoPoll(params);
+        break;
+    default:
+        // Real chip answers with syntax error frame
+        _valid = false;
+        break;
+    }
+}
+
+void PN532Simulator::RFConfiguration(const BinaryView& params)
+{
+    // Retry timeout applies to InCommunicateThru, 0 disables it
+    if (params.Size >= 4 && params[0] == RF_CONFIG_TIMINGS)
+    {
+        _rfTimeout = params[3] ? (uint32_t)100 << (params[3] - 1) : UINT32_MAX;
+        return;
+    }
+
+    // Only the RF field and timings are emulated, other items are accepted and ignored
+    if (params.Size < 2 || params[0] != RF_CONFIG_FIELD)
+        return;
+
+    _rfOn = params[1] & 0x01;
+
+    // Cards lose power and state with the field
+    if (!_rfOn)
+    {
+        for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS; ++i)
+            _tg[i] = 0;
+        _fieldCold = true;
+    }
+}
+
+void PN532Simulator::Diagnose(const BinaryView& params)
+{
+    // Only card presence check is emulated
+    if (params.Size < 1 || params[0] != DIAGNOSE_ATTENTION_REQUEST)
+    {
+        _valid = false;
+        return;
+    }
+
+    bool present = false;
+    for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS; ++i)
+    {
+        if (_current && _tg[i] == _current && _cards[i])
+            present = true;
+    }
+
+    _response << (uint8_t)(present ? PN532_STATUS_OK : PN532_STATUS_TIMEOUT);
+
+    // R(NAK) and R(ACK) are a single byte with CRC each
+    Spend(Timing.RFFrameMicros + 6 * Timing.RFByteMicros);
+}
+
+void PN532Simulator::InListPassiveTarget(const BinaryView& params)
+{
+    if (params.Size < 2 || !_rfOn)
+    {
+        _response << (uint8_t)0;
+        Spend(Timing.PollMicros);
+        return;
+    }
+
+    StartField();
+
+    uint8_t maxTg = params[0];
+    uint8_t nbTg = 0;
+
+    // Reserve space for NbTg
+    _response << nbTg;
+
+    for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS && nbTg < maxTg; ++i)
+    {
+        _tg[i] = 0;
+
+        // Cards only answer polls of their own modulation
+        if (!_cards[i] || _cards[i]->Modulation() != params[1] || !_cards[i]->Selected(params.Sub(2)))
+            continue;
+
+        ActivateCard(i, ++nbTg);
+
+        _response << _tg[i];
+        _cards[i]->TargetData(_response);
+    }
+
+    _response.Data()[0] = nbTg;
+
+    if (!nbTg)
+        Spend(Timing.PollMicros);
+}
+
+void PN532Simulator::InDataExchange(const BinaryView& params)
+{
+    if (params.Size < 1)
+    {
+        _response << (uint8_t)PN532_STATUS_INVALID_PARAMETER;
+        return;
+    }
+
+    SimulatedCard* card = nullptr;
+    for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS; ++i)
+    {
+        if (_tg[i] && _tg[i] == (params[0] & 0x0F))
+            card = _cards[i];
+    }
+
+    if (!card)
+    {
+        _response << (uint8_t)PN532_STATUS_WRONG_CONTEXT;
+        return;
+    }
+
+    _current = params[0] & 0x0F;
+
+    BinaryView data = params.Sub(1);
+
+    _payload.Clear();
+    uint8_t status = card->Exchange(data, _payload);
+
+    _response << status;
+    _response.Append(_payload.Data().data(), _payload.Size());
+
+    // Firmware runs the ISO14443-4 block protocol for cards which support it
+    ATSParameters ats;
+    if (card->IsoDepParameters(ats))
+        Spend(IsoDepMicros(ats, data.Size, _payload.Size(), card->ProcessingMicros()));
+    else
+        Spend(Timing.RFFrameMicros + (data.Size + _payload.Size()) * Timing.RFByteMicros + card->ProcessingMicros());
+}
+
+uint32_t PN532Simulator::IsoDepMicros(const ATSParameters& ats, size_t in, size_t out, uint32_t processing) const
+{
+    // Commands are split by FSC of card, answers by FSD of PN532
+    size_t txInf = ats.MaxFrameSize - ISO_DEP_BLOCK_OVERHEAD;
+    size_t rxInf = PN532_SIMULATOR_FSD - ISO_DEP_BLOCK_OVERHEAD;
+    uint32_t blocks = (in ? (in + txInf - 1) / txInf : 1) + (out ? (out + rxInf - 1) / rxInf : 1);
+
+    // Every chained block is acknowledged with R(ACK)
+    uint32_t frames = blocks - 1;
+    uint32_t bytes = in + out + (blocks + frames - 1) * ISO_DEP_BLOCK_OVERHEAD;
+
+    // S(WTX) request and response with WTXM
+    if (processing > ISO_DEP_FWT_MICROS(ats.FWI))
+    {
+        frames++;
+        bytes += 2 * (ISO_DEP_BLOCK_OVERHEAD + 1);
+    }
+
+    return frames * Timing.RFFrameMicros + bytes * Timing.RFByteMicros + processing;
+}
+
+void PN532Simulator::NextIsoDepBlock(PN532SimulatorIsoDep& picc)
+{
+    // Answer is chained in blocks up to FSD
+    size_t size = picc.Answer.Size() - picc.Sent;
+    bool chaining = size > PN532_SIMULATOR_FSD - ISO_DEP_BLOCK_OVERHEAD;
+    if (chaining)
+        size = PN532_SIMULATOR_FSD - ISO_DEP_BLOCK_OVERHEAD;
+
+    picc.Last.Clear();
+    picc.Last << (uint8_t)(ISO_DEP_PCB_I_BLOCK | (chaining ? ISO_DEP_PCB_CHAINING : 0) | picc.Block);
+    picc.Last.Append(picc.Answer.Data().data() + picc.Sent, size);
+    picc.Sent += size;
+}
+
+void PN532Simulator::InCommunicateThru(const BinaryView& params)
+{
+    if (params.Size < 1)
+    {
+        _response << (uint8_t)PN532_STATUS_INVALID_PARAMETER;
+        return;
+    }
+
+    // Block of the reader with CRC
+    Spend(Timing.RFFrameMicros + (params.Size + 2) * Timing.RFByteMicros);
+
+    uint8_t slot = PN532_SIMULATOR_MAX_CARDS;
+    for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS; ++i)
+    {
+        if (_current && _tg[i] == _current && _cards[i])
+            slot = i;
+    }
+
+    ATSParameters ats;
+    if (slot == PN532_SIMULATOR_MAX_CARDS || !_cards[slot]->IsoDepParameters(ats))
+    {
+        // Nobody answers, PN532 waits for the RF timeout
+        Spend(_rfTimeout);
+        _response << (uint8_t)PN532_STATUS_TIMEOUT;
+        return;
+    }
+
+    SimulatedCard* card = _cards[slot];
+    PN532SimulatorIsoDep& picc = _isoDep[slot];
+    uint8_t pcb = params[0];
+    uint32_t processing = 0;
+    uint32_t fwt = ISO_DEP_FWT_MICROS(ats.FWI);
+
+    if (ISO_DEP_IS_I_BLOCK(pcb))
+    {
+        // Card toggles its block number for every I-block
+        picc.Block ^= ISO_DEP_PCB_BLOCK_NUMBER;
+        picc.Command.Append(params.Data + 1, params.Size - 1);
+        picc.Last.Clear();
+
+        if (pcb & ISO_DEP_PCB_CHAINING)
+            picc.Last << (uint8_t)(ISO_DEP_PCB_R_ACK | picc.Block);
+        else
+        {
+            picc.Answer.Clear();
+            picc.Sent = 0;
+
+            uint8_t status = card->Exchange(BinaryView(picc.Command.Data()), picc.Answer);
+            picc.Command.Clear();
+            processing = card->ProcessingMicros();
+
+            if (status != PN532_STATUS_OK)
+            {
+                Spend(_rfTimeout);
+                _response << status;
+                return;
+            }
+
+            // Card asks for more time than FWT with S(WTX)
+            if (processing > fwt)
+            {
+                uint32_t wtxm = (processing - 1) / fwt + 1;
+                picc.Remaining = processing - fwt;
+                processing = fwt;
+                picc.Last << (uint8_t)ISO_DEP_PCB_S_WTX << (uint8_t)(wtxm < 59 ? wtxm : 59);
+            }
+            else
+                NextIsoDepBlock(picc);
+        }
+    }
+    else if (ISO_DEP_IS_R_BLOCK(pcb))
+    {
+        if ((pcb & ISO_DEP_PCB_BLOCK_NUMBER) != picc.Block)
+        {
+            if (pcb & ISO_DEP_PCB_NAK)
+            {
+                // Card has missed the last I-block of the reader, answer is not stored
+                Spend(ISO_DEP_BLOCK_OVERHEAD * Timing.RFByteMicros);
+                _response << (uint8_t)PN532_STATUS_OK << (uint8_t)(ISO_DEP_PCB_R_ACK | picc.Block);
+                return;
+            }
+
+            // R(ACK) requests the next block of a chained answer
+            if (picc.Sent >= picc.Answer.Size())
+            {
+                Spend(_rfTimeout);
+                _response << (uint8_t)PN532_STATUS_TIMEOUT;
+                return;
+            }
+
+            picc.Block ^= ISO_DEP_PCB_BLOCK_NUMBER;
+            NextIsoDepBlock(picc);
+        }
+
+        // Same block number repeats the last block
+    }
+    else if (ISO_DEP_IS_S_BLOCK(pcb) && (pcb & ISO_DEP_PCB_WTX) == ISO_DEP_PCB_WTX)
+    {
+        // Card continues processing, PN532 gives up after the RF timeout
+        processing = picc.Remaining;
+        picc.Remaining = 0;
+        NextIsoDepBlock(picc);
+
+        if (processing > _rfTimeout)
+        {
+            Spend(_rfTimeout);
+            _response << (uint8_t)PN532_STATUS_TIMEOUT;
+            return;
+        }
+    }
+    else if (ISO_DEP_IS_S_BLOCK(pcb))
+    {
+        // S(DESELECT) puts card into halt state
+        picc.Last.Clear();
+        picc.Last << (uint8_t)ISO_DEP_PCB_S_DESELECT;
+        card->Reset();
+        _tg[slot] = 0;
+    }
+    else
+    {
+        Spend(_rfTimeout);
+        _response << (uint8_t)PN532_STATUS_TIMEOUT;
+        return;
+    }
+
+    // Lost answer, reader has to recover with R-blocks
+    if (DropInterval && ++_answers % DropInterval == 0)
+    {
+        Spend(processing + _rfTimeout);
+        _response << (uint8_t)PN532_STATUS_TIMEOUT;
+        return;
+    }
+
+    Spend(processing + (picc.Last.Size() + 2) * Timing.RFByteMicros);
+
+    _response << (uint8_t)PN532_STATUS_OK;
+    _response.Append(picc.Last.Data().data(), picc.Last.Size());
+}
+
+void PN532Simulator::InRelease(const BinaryView& params)
+{
+    uint8_t tg = params.Size ? params[0] : 0;
+
+    for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS; ++i)
+    {
+        if (_tg[i] && (!tg || _tg[i] == tg))
+        {
+            if (_cards[i])
+                _cards[i]->Reset();
+            _tg[i] = 0;
+        }
+    }
+
+    _response << (uint8_t)PN532_STATUS_OK;
+}
+
+void PN532Simulator::ActivateCard(uint8_t slot, uint8_t tg)
+{
+    _cards[slot]->Reset();
+    _tg[slot] = tg;
+
+    // Block number of card starts with 1 after RATS
+    PN532SimulatorIsoDep& picc = _isoDep[slot];
+    picc.Block = 1;
+    picc.Command.Clear();
+    picc.Answer.Clear();
+    picc.Sent = 0;
+    picc.Last.Clear();
+    picc.Remaining = 0;
+
+    if (tg == 1)
+        _current = tg;
+
+    Spend(Timing.ActivationMicros);
+}
+
+void PN532Simulator::ReleaseAll()
+{
+    for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS; ++i)
+    {
+        if (_tg[i] && _cards[i])
+            _cards[i]->Reset();
+        _tg[i] = 0;
+    }
+}
+
+void PN532Simulator::StartField()
+{
+    // Cards need an unmodulated carrier to power up before the first request
+    if (_fieldCold)
+    {
+        Spend(Timing.FieldOnMicros);
+        _fieldCold = false;
+    }
+}
+
+// Modulation polled for an InAutoPoll type, false for DEP and unknown types
+static bool AutoPollModulation(uint8_t type, uint8_t& brty)
+{
+    switch (type)
+    {
+    case AUTOPOLL_GENERIC_106KBPS:
+    case AUTOPOLL_MIFARE:
+    case AUTOPOLL_ISO14443_4A_106KBPS:
+        brty = BRTY_106KBPS_TYPE_A;
+        return true;
+    case AUTOPOLL_GENERIC_212KBPS:
+    case AUTOPOLL_FELICA_212KBPS:
+        brty = BRTY_212KBPS;
+        return true;
+    case AUTOPOLL_GENERIC_424KBPS:
+    case AUTOPOLL_FELICA_424KBPS:
+        brty = BRTY_424KBPS;
+        return true;
+    case AUTOPOLL_TYPE_B_106KBPS:
+    case AUTOPOLL_ISO14443_4B_106KBPS:
+        brty = BRTY_106KBPS_TYPE_B;
+        return true;
+    case AUTOPOLL_JEWEL_106KBPS:
+        brty = BRTY_106KBPS_JEWEL;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void PN532Simulator::InAutoPoll(const BinaryView& params)
+{
+    if (params.Size < 3 || params[0] == 0 || params[1] == 0 || params[1] > 0x0F)
+    {
+        _valid = false;
+        return;
+    }
+
+    // Endless polling would never answer without a card, a single round is emulated
+    uint8_t rounds = params[0] == PN532_AUTOPOLL_ENDLESS ? 1 : params[0];
+    uint8_t nbTg = 0;
+
+    _response << nbTg;
+
+    if (!_rfOn)
+        return;
+
+    StartField();
+    ReleaseAll();
+
+    for (uint8_t round = 0; round < rounds && !nbTg; ++round)
+    {
+        if (round)
+            Spend(params[1] * 150000U);
+
+        // Polling stops at the first type with targets
+        for (uint16_t t = 2; t < params.Size && !nbTg; ++t)
+        {
+            uint8_t brty = 0;
+            if (!AutoPollModulation(params[t], brty))
+                continue;
+
+            for (uint8_t i = 0; i < PN532_SIMULATOR_MAX_CARDS && nbTg < 2; ++i)
+            {
+                if (!_cards[i] || _cards[i]->Modulation() != brty)
+                    continue;
+
+                ActivateCard(i, ++nbTg);
+
+                // Type, length and target data including Tg
+                _payload.Clear();
+                _payload << _tg[i];
+                _cards[i]->TargetData(_payload);
+
+                _response << params[t] << (uint8_t)_payload.Size();
+                _response.Append(_payload.Data().data(), _payload.Size());
+            }
+
+            if (!nbTg)
+                Spend(Timing.PollMicros);
+        }
+    }
+
+    _response.Data()[0] = nbTg;
+}
+
+void PN532Simulator::PowerDown(const BinaryView& params)
+{
+    if (params.Size < 1)
+    {
+        _response << (uint8_t)PN532_STATUS_INVALID_PARAMETER;
+        return;
+    }
+
+    // Status is sent before the chip goes to sleep, field and targets are lost
+    _response << (uint8_t)PN532_STATUS_OK;
+
+    ReleaseAll();
+    _current = 0;
+    _fieldCold = true;
+    _poweredDown = true;
+    _wakeUpEnable = params[0];
+}
+
+#endif
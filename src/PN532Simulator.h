@@ -0,0 +1,120 @@
+#ifndef __PN532SIMULATOR_H__
+#define __PN532SIMULATOR_H__
+
+#include "PN532Interface.h"
+#include "ByteBuffer.h"
+#include "SimulatedCard.h"
+#include "PN532Config.h"
+
+#if PN532_CONFIG_SIMULATOR
+
+// Number of cards which can be placed in the field at once
+#define PN532_SIMULATOR_MAX_CARDS 2
+// Reader frame size (FSD) assumed for the RATS sent by the PN532
+#define PN532_SIMULATOR_FSD 64
+
+// Timing model of the simulated link. All values are in microseconds
+struct PN532SimulatorTiming
+{
+    uint32_t Baudrate;          // Host UART speed
+    uint16_t CommandMicros;     // PN532 firmware overhead per command
+    uint16_t RFByteMicros;      // Air time per byte at 106 kbps (9 bits)
+    uint16_t RFFrameMicros;     // Frame delay and turnaround per exchange
+    uint32_t ActivationMicros;  // Anticollision, select and RATS per target
+    uint32_t PollMicros;        // Time to report that no target is present
+    uint32_t WakeUpMicros;      // Oscillator start-up after leaving PowerDown
+    uint32_t FieldOnMicros;     // Carrier before the first poll after the field was off (card power up)
+};
+
+// Card side of the ISO14443-4 block protocol, used by InCommunicateThru
+struct PN532SimulatorIsoDep
+{
+    uint8_t Block;          // Block number of card
+    ByteBuffer Command;     // INF of chained command blocks
+    ByteBuffer Answer;      // Response APDU
+    size_t Sent;            // Bytes of Answer already sent
+    ByteBuffer Last;        // Last block sent (PCB and INF), repeated on request
+    uint32_t Remaining;     // Processing time left after S(WTX)
+};
+
+// PN532Interface implementation which emulates the chip and cards in software.
+// Used to test and benchmark host code without hardware.
+class PN532Simulator : public PN532Interface
+{
+public:
+    PN532Simulator();
+
+    void begin() {}
+    void wakeup();
+
+    int8_t writeCommand(const uint8_t *data, uint16_t len);
+    int16_t readResponse(uint8_t buf[], uint16_t len, uint16_t timeout = 1000);
+
+    // Places card in the field (nullptr removes it). Card is not owned
+    void SetCard(uint8_t slot, SimulatedCard* card);
+
+    // Brings an external RF field (phone, other reader) near the antenna.
+    // Wakes the PN532 if it is in PowerDown with WAKEUP_RF enabled.
+    bool ExternalField();
+    // Simulates loss of supply. PN532 restarts in LowVbat mode and only answers
+    // after a wake-up preamble, polls fail until SAMConfiguration is sent again.
+    void PowerCycle();
+
+    bool PoweredDown() const
+    {
+        return _poweredDown;
+    }
+
+    // Total simulated time in microseconds
+    uint64_t Elapsed() const
+    {
+        return _elapsed;
+    }
+
+    PN532SimulatorTiming Timing;
+    // Sleep for simulated time instead of only accounting it
+    bool RealTime;
+    // Every n-th card answer to InCommunicateThru is lost on air (0 - none)
+    uint16_t DropInterval;
+
+private:
+    int16_t Respond(uint8_t buf[], uint16_t len);
+    void Spend(uint32_t us);
+    uint32_t UARTMicros(uint16_t bytes) const;
+    void Process(const BinaryView& cmd);
+    void RFConfiguration(const BinaryView& params);
+    void Diagnose(const BinaryView& params);
+    void InListPassiveTarget(const BinaryView& params);
+    void InDataExchange(const BinaryView& params);
+    void InCommunicateThru(const BinaryView& params);
+    void NextIsoDepBlock(PN532SimulatorIsoDep& picc);
+    uint32_t IsoDepMicros(const ATSParameters& ats, size_t in, size_t out, uint32_t processing) const;
+    void InRelease(const BinaryView& params);
+    void InAutoPoll(const BinaryView& params);
+    void PowerDown(const BinaryView& params);
+    void ActivateCard(uint8_t slot, uint8_t tg);
+    void ReleaseAll();
+    void StartField();
+
+    SimulatedCard* _cards[PN532_SIMULATOR_MAX_CARDS];
+    // Logical target number assigned to each card (0 - not activated)
+    uint8_t _tg[PN532_SIMULATOR_MAX_CARDS];
+    PN532SimulatorIsoDep _isoDep[PN532_SIMULATOR_MAX_CARDS];
+    ByteBuffer _response;
+    ByteBuffer _payload;
+    bool _rfOn;
+    bool _fieldCold;        // Field was off, cards have to power up before the next poll
+    bool _poweredDown;
+    bool _lowVbat;          // Restarted, waiting for SAMConfiguration
+    uint8_t _wakeUpEnable;  // WakeUpSource_t bits of last PowerDown
+    uint8_t _current; // Target of the last exchange, used by presence check and InCommunicateThru
+    uint32_t _rfTimeout;    // Retry timeout of RFConfiguration in microseconds
+    uint32_t _answers;      // Card answers to InCommunicateThru, see DropInterval
+    bool _pending;
+    bool _valid;
+    uint64_t _elapsed;
+};
+
+#endif
+
+#endif
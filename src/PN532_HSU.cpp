@@ -1,6 +1,12 @@
+#include "PN532Config.h"
+
+// Needs Arduino HardwareSerial
+#if defined(ARDUINO) && PN532_CONFIG_HSU
+
 #include "PN532_HSU.h"
 
-PN532_HSU::PN532_HSU(HardwareSerial &serial): _serial(&serial), command(0)
+PN532_HSU::PN532_HSU(HardwareSerial &serial): MaxRetries(PN532_MAX_RETRIES), _serial(&serial), command(0),
+    _frame(nullptr), _frameSize(0), _responseReady(false)
 {
 }
 
@@ -22,132 +28,183 @@ void PN532_HSU::wakeup()
     cleanReceiveBuffer();
 }
 
-int8_t PN532_HSU::writeCommand(const uint8_t *data, uint8_t len)
+int8_t PN532_HSU::writeCommand(const uint8_t *data, uint16_t len)
 {
+    if (len > PN532_MAX_EXTENDED_PACKET_SIZE)
+        return PN532_ERROR_NO_SPACE;
+
+    // Copy into a buffer with room for frame header
+    uint8_t frame[PN532_FRAME_HEADROOM + PN532_MAX_EXTENDED_PACKET_SIZE + PN532_FRAME_TAILROOM];
+    memcpy(frame + PN532_FRAME_HEADROOM, data, len);
+
+    return writeFrame(frame, len);
+}
+
+int8_t PN532_HSU::writeFrame(uint8_t *frame, uint16_t len)
+{
+    if (len == 0 || len > PN532_MAX_EXTENDED_PACKET_SIZE)
+        return PN532_ERROR_NO_SPACE;
+
     // In case something is stuck
     cleanReceiveBuffer();
+    _responseReady = false;
 
     // For checking response
-    command = data[0];
+    command = frame[PN532_FRAME_HEADROOM];
+    traceCommand(frame + PN532_FRAME_HEADROOM, len);
 
-    _serial->write(0x00); // Preamble
-    _serial->write(0x00); // Start Code 0
-    _serial->write(0xFF); // Start Code 1
+    _frame = PN532EncodeFrame(frame, len, _frameSize);
 
-    _serial->write(len+1); // LEN (Data length + TFI)
-    _serial->write(~len);  // LCS (Checksum for LEN. Satisfies LOW_BYTE(LEN + LCS) = 0x00)
+    METRICS_START(writeStart);
+    _serial->write(_frame, _frameSize);
+    METRICS_RECORD(HSUWrite, writeStart);
+    METRICS_COUNT(HSUBytesSent, _frameSize);
 
-    _serial->write(PN532_FRAME_DIR_TO_PN532); // TFI
+    _link.Begin(millis(), MaxRetries);
 
-    uint8_t checksum = PN532_FRAME_DIR_TO_PN532;
+    METRICS_START(ackStart);
+    int8_t result = readAckFrame();
+    METRICS_RECORD(HSUAckWait, ackStart);
 
-    // Write data
-    _serial->write(data, len);
+    // Frame lives in the caller's buffer
+    _frame = nullptr;
 
-    // calculate checksum
-    for (uint8_t i = 0; i < len; i++)
-        checksum += data[i];
+    return result;
+}
 
-    _serial->write(~checksum + 1); // DCS (TFI + data)
-    _serial->write(0x00); // Postamble
+int16_t PN532_HSU::readResponse(uint8_t buf[], uint16_t len, uint16_t timeout)
+{
+    int16_t status = receiveResponse(buf, len, timeout);
+    traceResponse(buf, status);
 
-    return readAckFrame();
+    return status;
 }
 
-int16_t PN532_HSU::readResponse(uint8_t buf[], uint8_t len, uint16_t timeout)
+int16_t PN532_HSU::receiveResponse(uint8_t buf[], uint16_t len, uint16_t timeout)
 {
-    uint8_t tmp[3];
+    METRICS_START(start);
+    unsigned long begin = millis();
 
-    // Read preamble and start code
-    if (receive(tmp, 3, timeout) < 3)
-        return PN532_ERROR_TIMEOUT;
+    while (!_responseReady)
+    {
+        switch (receiveAvailable())
+        {
+        case PN532FrameDecoder::EVENT_FRAME:
+            _responseReady = true;
+            continue;
+        case PN532FrameDecoder::EVENT_ERROR_FRAME:
+            _link.End();
+            return PN532_ERROR_INVALID_FRAME;
+        default:
+            break;
+        }
 
-    if (tmp[0] != 0x00 || tmp[1] != 0x00 || tmp[2] != 0xFF)
-        return PN532_ERROR_INVALID_FRAME;
+        int8_t error = recoverLink();
+        if (error)
+            return error;
 
-    // Receive LEN and LCS
-    uint8_t length[2];
-    if (receive(length, 2, timeout) < 2)
-        return PN532_ERROR_TIMEOUT;
+        // Check if timeouted
+        if (timeout && (millis() - begin) > timeout)
+        {
+            _link.End();
+            return PN532_ERROR_TIMEOUT;
+        }
 
-    if ((uint8_t)(length[0] + length[1]) != 0)
-        return PN532_ERROR_INVALID_FRAME;
+        delay(1); // Yield to kernel
+    }
 
-    length[0] -= 2; // Substract TFI and CMD
+    _responseReady = false;
+    _link.End();
 
-    // Check if buffer is big enough
-    if (length[0] > len)
+    // Strip response code
+    BinaryView data = _link.Decoder().Frame().Sub(1);
+    if (data.Size > len)
         return PN532_ERROR_NO_SPACE;
 
-    // Receive TFI and CMD
-    if (receive(tmp, 2, timeout) < 2)
-        return PN532_ERROR_TIMEOUT;
-
-    // Check TFI and CMD (response CMD is increased by 1)
-    if (tmp[0] != PN532_FRAME_DIR_TO_HOST || tmp[1] != command + 1)
-        return PN532_ERROR_INVALID_FRAME;
-
-    // Receive data
-    if (receive(buf, length[0], timeout) != length[0])
-        return PN532_ERROR_TIMEOUT;
-
-    // Calculate checksum
-    uint8_t checksum = PN532_FRAME_DIR_TO_HOST + command + 1;
-    for (uint8_t i=0; i < length[0]; i++)
-        checksum += buf[i];
+    memcpy(buf, data.Data, data.Size);
 
-    // Receive DCS and postamble
-    if (receive(tmp, 2, timeout) < 2)
-        return PN532_ERROR_TIMEOUT;
-
-    if ((uint8_t)(checksum + tmp[0]) || tmp[1] != 0x00)
-        return PN532_ERROR_INVALID_FRAME;
+    METRICS_RECORD(HSUResponse, start);
+    // Data, preamble, start code, length, TFI, CMD, DCS and postamble
+    METRICS_COUNT(HSUBytesReceived, data.Size + (data.Size + 2 > 0xFF ? 11 : 8));
 
-    return length[0];
+    return data.Size;
 }
 
 int8_t PN532_HSU::readAckFrame()
 {
-    const uint8_t PN532_ACK[] = {0, 0, 0xFF, 0, 0xFF, 0};
-    uint8_t ackBuf[sizeof(PN532_ACK)];
+    while (true)
+    {
+        switch (receiveAvailable())
+        {
+        case PN532FrameDecoder::EVENT_ACK:
+            return 0;
+        case PN532FrameDecoder::EVENT_FRAME:
+            // ACK was lost, but response already arrived
+            _responseReady = true;
+            return 0;
+        default:
+            break;
+        }
 
-    // Receive ACK
-    if (receive(ackBuf, sizeof(PN532_ACK), PN532_ACK_WAIT_TIME) <= 0 )
-        return PN532_ERROR_TIMEOUT;
+        int8_t error = recoverLink();
+        if (error)
+            return error;
 
-    // Compare ACK
-    if (memcmp(ackBuf, PN532_ACK, sizeof(PN532_ACK)))
-        return PN532_ERROR_INVALID_ACK;
+        // Something arrived, most likely a corrupted ACK. Recovery goes on while reading the response
+        if (_link.Heard() && _link.SinceWrite(millis()) > PN532_ACK_WAIT_TIME)
+            return 0;
 
-    return 0;
+        delay(1); // Yield to kernel
+    }
 }
 
-int16_t PN532_HSU::receive(uint8_t *buf, int len, uint16_t timeout)
+PN532FrameDecoder::Event_t PN532_HSU::receiveAvailable()
 {
-    int i = 0;
-    unsigned long start = millis();
-
-    while (i < len)
+    int res;
+    while ((res = _serial->read()) >= 0)
     {
-        int res = _serial->read();
+        PN532FrameDecoder::Event_t event = _link.Feed(res, millis());
 
-        // Check if read is successful
-        if (res >= 0)
-            buf[i++] = (uint8_t)res;
-        else
-            delay(1); // Yield to kernel
-
-        // Check if timeouted
-        if (timeout && (millis() - start) > timeout)
+        // Check response code (command is increased by 1), stale responses are skipped
+        if (event == PN532FrameDecoder::EVENT_FRAME)
         {
-            if (i)
-                return i;
-            else
-                return PN532_ERROR_TIMEOUT;
+            BinaryView frame = _link.Decoder().Frame();
+            if (frame.Size && frame[0] == (uint8_t)(command + 1))
+                return event;
         }
+        else if (event != PN532FrameDecoder::EVENT_NONE)
+            return event;
     }
 
-    return i;
+    return PN532FrameDecoder::EVENT_NONE;
+}
+
+int8_t PN532_HSU::recoverLink()
+{
+    switch (_link.Poll(millis()))
+    {
+    case PN532LinkRecovery::LINK_RESEND:
+        // Only due before anything was heard, so the frame is still there
+        if (_frame)
+            _serial->write(_frame, _frameSize);
+        METRICS_COUNT(HSUAckResends, 1);
+        return 0;
+    case PN532LinkRecovery::LINK_NACK:
+    {
+        const uint8_t nack[] = PN532_NACK_FRAME;
+        _serial->write(nack, sizeof(nack));
+        METRICS_COUNT(HSUNacks, 1);
+        return 0;
+    }
+    case PN532LinkRecovery::LINK_FAIL:
+        _link.End();
+        return PN532_ERROR_INVALID_FRAME;
+    case PN532LinkRecovery::LINK_TIMEOUT:
+        _link.End();
+        return PN532_ERROR_TIMEOUT;
+    default:
+        return 0;
+    }
 }
 
 void PN532_HSU::cleanReceiveBuffer()
@@ -155,3 +212,5 @@ void PN532_HSU::cleanReceiveBuffer()
     while (_serial->available())
         _serial->read();
 }
+
+#endif
@@ -2,26 +2,46 @@
 #define _PN532HSU_H_
 
 #include "PN532Interface.h"
+#include "PN532Frame.h"
+#include "Metrics.h"
 #include "Arduino.h"
+#include "PN532Config.h"
 
 #define PN532_HSU_READ_TIMEOUT  1000
 #define PN532_HSU_SPEED         115200
 
+#if PN532_CONFIG_HSU
+
 class PN532_HSU : public PN532Interface {
 public:
     PN532_HSU(HardwareSerial &serial);
 
     void begin();
     void wakeup();
-    virtual int8_t writeCommand(const uint8_t *data, uint8_t len);
-    int16_t readResponse(uint8_t buf[], uint8_t len, uint16_t timeout);
+    virtual int8_t writeCommand(const uint8_t *data, uint16_t len);
+    virtual int8_t writeFrame(uint8_t *frame, uint16_t len);
+    int16_t readResponse(uint8_t buf[], uint16_t len, uint16_t timeout);
+
+    // Bound of command resends and NACKs per exchange
+    uint8_t MaxRetries;
 private:
     HardwareSerial* _serial;
     uint8_t command;
 
+    PN532LinkRecovery _link;
+    uint8_t *_frame;     // Command frame, kept for resending until ACK
+    uint16_t _frameSize;
+    bool _responseReady; // Response was decoded while waiting for ACK
+
     int8_t readAckFrame();
-    int16_t receive(uint8_t *buf, int len, uint16_t timeout=PN532_HSU_READ_TIMEOUT);
+    int16_t receiveResponse(uint8_t buf[], uint16_t len, uint16_t timeout);
+    // Feeds available bytes to the link. Returns decoder event which ends the wait, if any
+    PN532FrameDecoder::Event_t receiveAvailable();
+    // Performs resend or NACK due. Returns error once the link gives up, 0 otherwise
+    int8_t recoverLink();
     void cleanReceiveBuffer();
 };
 
 #endif
+
+#endif
@@ -0,0 +1,284 @@
+#include "PN532_Stream.h"
+
+#if defined(__linux__) && !defined(ARDUINO) && PN532_CONFIG_STREAM
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "Platform.h"
+
+PN532_Stream::PN532_Stream(int fd) :
+    MaxRetries(PN532_MAX_RETRIES), _fd(fd), _command(0), _status(PN532_ERROR_TIMEOUT), _ready(false), _closed(fd < 0),
+    _chunkPos(0), _chunkLen(0), _frameSize(0)
+{
+    if (_fd >= 0)
+        fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+}
+
+PN532_Stream::~PN532_Stream()
+{
+    if (_fd >= 0)
+        close(_fd);
+}
+
+int PN532_Stream::Open(const char *path, uint32_t baudrate)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    speed_t speed;
+    switch (baudrate)
+    {
+    case 9600: speed = B9600; break;
+    case 19200: speed = B19200; break;
+    case 38400: speed = B38400; break;
+    case 57600: speed = B57600; break;
+    case 230400: speed = B230400; break;
+    case 460800: speed = B460800; break;
+    case 921600: speed = B921600; break;
+    default: speed = B115200; break;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    return fd;
+}
+
+void PN532_Stream::wakeup()
+{
+    // PN532 wake up condition
+    const uint8_t wakeup[] = {0x55, 0x55, 0x00, 0x00, 0x00};
+    WriteAll(wakeup, sizeof(wakeup));
+
+    // Discard anything received so far
+    uint8_t tmp[PN532_STREAM_READ_CHUNK];
+    while (read(_fd, tmp, sizeof(tmp)) > 0);
+
+    _link.End();
+    _chunkPos = _chunkLen = 0;
+}
+
+int8_t PN532_Stream::WriteAll(const uint8_t *data, uint16_t len)
+{
+    while (len)
+    {
+        ssize_t n = write(_fd, data, len);
+
+        if (n > 0)
+        {
+            data += n;
+            len -= n;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            // Output buffer is full, frames are short so this is rare
+            struct pollfd pfd = {_fd, POLLOUT, 0};
+            if (poll(&pfd, 1, PN532_ACK_WAIT_TIME) <= 0)
+                return PN532_ERROR_TIMEOUT;
+        }
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else
+        {
+            _closed = true;
+            return PN532_ERROR_TIMEOUT;
+        }
+    }
+
+    return 0;
+}
+
+void PN532_Stream::Finish(int16_t status)
+{
+    _status = status;
+    _ready = true;
+    _link.End();
+}
+
+int8_t PN532_Stream::writeCommand(const uint8_t *data, uint16_t len)
+{
+    if (len > PN532_MAX_EXTENDED_PACKET_SIZE)
+        return PN532_ERROR_NO_SPACE;
+
+    // Copy into a buffer with room for frame header
+    uint8_t frame[PN532_FRAME_HEADROOM + PN532_MAX_EXTENDED_PACKET_SIZE + PN532_FRAME_TAILROOM];
+    memcpy(frame + PN532_FRAME_HEADROOM, data, len);
+
+    return writeFrame(frame, len);
+}
+
+int8_t PN532_Stream::writeFrame(uint8_t *frame, uint16_t len)
+{
+    if (len == 0 || len > PN532_MAX_EXTENDED_PACKET_SIZE)
+        return PN532_ERROR_NO_SPACE;
+
+    // Drop leftovers of earlier exchanges (i.e. duplicate responses after NACK)
+    uint8_t tmp[PN532_STREAM_READ_CHUNK];
+    while (read(_fd, tmp, sizeof(tmp)) > 0);
+    _chunkPos = _chunkLen = 0;
+
+    // For checking response
+    _command = frame[PN532_FRAME_HEADROOM];
+    _ready = false;
+    traceCommand(frame + PN532_FRAME_HEADROOM, len);
+
+    uint8_t *start = PN532EncodeFrame(frame, len, _frameSize);
+    memcpy(_frame, start, _frameSize);
+
+    METRICS_START(writeStart);
+    int8_t result = WriteAll(_frame, _frameSize);
+    METRICS_RECORD(HSUWrite, writeStart);
+    METRICS_COUNT(HSUBytesSent, _frameSize);
+    _link.Begin(PlatformMillis(), MaxRetries);
+
+#if PN532_METRICS
+    _writeEnd = PlatformMicros();
+#endif
+
+    // ACK is consumed by the decoder together with the response
+    return result;
+}
+
+bool PN532_Stream::Receive()
+{
+    uint32_t now = PlatformMillis();
+
+    while (!_ready)
+    {
+        if (_chunkPos == _chunkLen)
+        {
+            ssize_t n = read(_fd, _chunk, sizeof(_chunk));
+
+            if (n < 0 && (errno == EAGAIN || errno == EINTR))
+                break;
+
+            if (n <= 0)
+            {
+                // Device has gone away
+                _closed = true;
+                Finish(PN532_ERROR_TIMEOUT);
+                break;
+            }
+
+            _chunkPos = 0;
+            _chunkLen = n;
+            now = PlatformMillis();
+            METRICS_COUNT(HSUBytesReceived, n);
+        }
+
+        switch (_link.Feed(_chunk[_chunkPos++], now))
+        {
+        case PN532FrameDecoder::EVENT_FRAME:
+        {
+            BinaryView frame = _link.Decoder().Frame();
+
+            // Check response code (command is increased by 1), stale responses are skipped
+            if (!frame.Size || frame[0] != (uint8_t)(_command + 1))
+                break;
+
+            METRICS_RECORD(HSUResponse, _writeEnd);
+            Finish(frame.Size - 1);
+            break;
+        }
+        case PN532FrameDecoder::EVENT_ERROR_FRAME:
+            Finish(PN532_ERROR_INVALID_FRAME);
+            break;
+        case PN532FrameDecoder::EVENT_ACK:
+            METRICS_RECORD(HSUAckWait, _writeEnd);
+            break;
+        default:
+            // More bytes needed
+            break;
+        }
+    }
+
+    if (_ready)
+        return true;
+
+    // Input is drained, so the silence seen by the link is real
+    switch (_link.Poll(PlatformMillis()))
+    {
+    case PN532LinkRecovery::LINK_RESEND:
+        WriteAll(_frame, _frameSize);
+        METRICS_COUNT(HSUAckResends, 1);
+        break;
+    case PN532LinkRecovery::LINK_NACK:
+    {
+        const uint8_t nack[] = PN532_NACK_FRAME;
+        WriteAll(nack, sizeof(nack));
+        METRICS_COUNT(HSUNacks, 1);
+        break;
+    }
+    case PN532LinkRecovery::LINK_FAIL:
+        Finish(PN532_ERROR_INVALID_FRAME);
+        break;
+    case PN532LinkRecovery::LINK_TIMEOUT:
+        Finish(PN532_ERROR_TIMEOUT);
+        break;
+    default:
+        break;
+    }
+
+    return _ready;
+}
+
+int PN532_Stream::PollTimeout() const
+{
+    return _ready ? -1 : _link.Timeout(PlatformMillis());
+}
+
+int16_t PN532_Stream::readResponse(uint8_t buf[], uint16_t len, uint16_t timeout)
+{
+    uint32_t start = PlatformMillis();
+
+    while (!Receive())
+    {
+        int wait = -1;
+        if (timeout)
+        {
+            uint32_t elapsed = PlatformMillis() - start;
+            if (elapsed >= timeout)
+            {
+                traceResponse(buf, PN532_ERROR_TIMEOUT);
+                return PN532_ERROR_TIMEOUT;
+            }
+            wait = timeout - elapsed;
+        }
+
+        // Wake up for resend or NACK
+        int link = PollTimeout();
+        if (link >= 0 && (wait < 0 || link < wait))
+            wait = link;
+
+        struct pollfd pfd = {_fd, POLLIN, 0};
+        poll(&pfd, 1, wait);
+    }
+
+    // Response is consumed
+    _ready = false;
+
+    int16_t status = _status;
+    if (status > len)
+        status = PN532_ERROR_NO_SPACE;
+    else if (status > 0)
+        memcpy(buf, _link.Decoder().Frame().Data + 1, status);
+
+    traceResponse(buf, status);
+
+    return status;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _PN532STREAM_H_
+#define _PN532STREAM_H_
+
+#include "PN532Config.h"
+
+// POSIX file descriptor transport (serial devices and pseudo terminals on Linux)
+#if defined(__linux__) && !defined(ARDUINO) && PN532_CONFIG_STREAM
+
+#include "PN532Interface.h"
+#include "PN532Frame.h"
+#include "Metrics.h"
+
+#define PN532_STREAM_SPEED 115200
+#define PN532_STREAM_READ_CHUNK 64
+
+// HSU transport over a non-blocking file descriptor. Incoming bytes are decoded
+// incrementally, so Receive() can be driven by epoll, while readResponse()
+// still blocks for synchronous use by PN532Extended.
+class PN532_Stream : public PN532Interface
+{
+public:
+    // Takes ownership of fd, which is switched to non-blocking mode
+    PN532_Stream(int fd);
+    ~PN532_Stream();
+
+    // Opens serial device in raw 8N1 mode. Returns -1 on failure
+    static int Open(const char *path, uint32_t baudrate = PN532_STREAM_SPEED);
+
+    void begin() {}
+    void wakeup();
+    int8_t writeCommand(const uint8_t *data, uint16_t len);
+    int8_t writeFrame(uint8_t *frame, uint16_t len);
+    // Timeout of 0 waits indefinitely
+    int16_t readResponse(uint8_t buf[], uint16_t len, uint16_t timeout = 1000);
+
+    // Reads available bytes and resends command or NACK when due, without
+    // blocking. Returns true once response is complete
+    bool Receive();
+    // Milliseconds until Receive has to be called even without input, -1 if never
+    int PollTimeout() const;
+
+    bool ResponseReady() const
+    {
+        return _ready;
+    }
+
+    // Device was closed or failed
+    bool Closed() const
+    {
+        return _closed;
+    }
+
+    int Fd() const
+    {
+        return _fd;
+    }
+
+    // Bound of command resends and NACKs per exchange
+    uint8_t MaxRetries;
+
+private:
+    int8_t WriteAll(const uint8_t *data, uint16_t len);
+    // Completes exchange with given status
+    void Finish(int16_t status);
+
+    int _fd;
+    uint8_t _command;
+    PN532LinkRecovery _link;
+    int16_t _status; // Response length or PN532Error once ready
+    bool _ready;
+    bool _closed;
+    // Bytes read but not yet decoded
+    uint8_t _chunk[PN532_STREAM_READ_CHUNK];
+    uint8_t _chunkPos;
+    uint8_t _chunkLen;
+    // Last command frame, kept for resending when ACK does not arrive
+    uint8_t _frame[PN532_FRAME_HEADROOM + PN532_MAX_EXTENDED_PACKET_SIZE + PN532_FRAME_TAILROOM];
+    uint16_t _frameSize;
+#if PN532_METRICS
+    uint32_t _writeEnd; // For ACK and response latency
+#endif
+};
+
+#endif
+
+#endif
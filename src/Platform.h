@@ -0,0 +1,54 @@
+#ifndef __PLATFORM_H__
+#define __PLATFORM_H__
+
+#include <cstdint>
+
+// Timing primitives shared by Arduino and host (Linux) builds
+
+#ifdef ARDUINO
+
+#include "Arduino.h"
+
+inline uint32_t PlatformMicros()
+{
+    return micros();
+}
+
+inline uint32_t PlatformMillis()
+{
+    return millis();
+}
+
+inline void PlatformSleepMicros(uint32_t us)
+{
+    if (us >= 1000)
+        delay(us / 1000);
+
+    delayMicroseconds(us % 1000);
+}
+
+#else
+
+#include <chrono>
+#include <thread>
+
+inline uint32_t PlatformMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t PlatformMillis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void PlatformSleepMicros(uint32_t us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+#endif
+
+#endif
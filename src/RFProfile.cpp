@@ -0,0 +1,35 @@
+#include "RFProfile.h"
+
+// Analog register defaults of PN532
+#define RF_ANALOG_TYPE_A_DEFAULT        { 0x59, 0xF4, 0x3F, 0x11, 0x4D, 0x85, 0x61, 0x6F, 0x26, 0x62, 0x87 }
+#define RF_ANALOG_212_424_DEFAULT       { 0x69, 0xFF, 0x3F, 0x11, 0x41, 0x85, 0x61, 0x6F }
+
+const RFProfile RF_PROFILE_DEFAULT = {
+    "default",
+    { RF_TIMEOUT_102_4MS, RF_TIMEOUT_51_2MS },
+    { 0x00 },
+    { 0xFF, 0x01, 0xFF },
+    RF_ANALOG_TYPE_A_DEFAULT,
+    RF_ANALOG_212_424_DEFAULT
+};
+
+const RFProfile RF_PROFILE_FAST_TURNSTILE = {
+    "fast turnstile",
+    // Card answers within a few ms, anything slower has left the field
+    { RF_TIMEOUT_25_6MS, RF_TIMEOUT_12_8MS },
+    { 0x01 },
+    // Return to host after one activation attempt (no retry) instead of polling endlessly
+    { 0x02, 0x01, 0x00 },
+    RF_ANALOG_TYPE_A_DEFAULT,
+    RF_ANALOG_212_424_DEFAULT
+};
+
+const RFProfile RF_PROFILE_LONG_RANGE = {
+    "long range",
+    { RF_TIMEOUT_102_4MS, RF_TIMEOUT_204_8MS },
+    { 0x03 },
+    { 0xFF, 0x02, 0xFF },
+    // 48 dB receiver gain, full driver conductance, lower decoder threshold
+    { 0x79, 0xFF, 0x3F, 0x11, 0x4D, 0x55, 0x61, 0x6F, 0x26, 0x62, 0x87 },
+    { 0x79, 0xFF, 0x3F, 0x11, 0x41, 0x55, 0x61, 0x6F }
+};
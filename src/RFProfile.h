@@ -0,0 +1,28 @@
+#ifndef __RFPROFILE_H__
+#define __RFPROFILE_H__
+
+#include "PN532Packets.h"
+
+using namespace PN532Packets;
+
+// Set of RFConfiguration items applied together (see PN532Extended::ApplyRFProfile)
+struct RFProfile
+{
+    const char *Name;
+    RFConfiguration_Timings Timings;
+    RFConfiguration_MaxRetryCOM MaxRetryCOM;
+    RFConfiguration_MaxRetries MaxRetries;
+    RFConfiguration_AnalogTypeA AnalogTypeA;
+    RFConfiguration_Analog212_424 Analog212_424;
+};
+
+// PN532 power on settings
+extern const RFProfile RF_PROFILE_DEFAULT;
+// Short timeouts and a single activation attempt per poll. Lowest latency
+// from card detection to first exchange, for readers where cards are held close.
+extern const RFProfile RF_PROFILE_FAST_TURNSTILE;
+// Maximum receiver gain and driver strength with long timeouts and retries.
+// Larger read distance at cost of latency and power consumption.
+extern const RFProfile RF_PROFILE_LONG_RANGE;
+
+#endif
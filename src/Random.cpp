@@ -0,0 +1,118 @@
+#include "Random.h"
+
+#if PN532_CONFIG_DESFIRE
+
+#include <cstring>
+
+#if PN532_CONFIG_SYSTEM_RANDOM && defined(ESP32)
+
+#include "esp_system.h"
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include "esp_random.h"
+#endif
+
+bool SystemRandom(void* /* ctx */, uint8_t* buf, size_t len)
+{
+    esp_fill_random(buf, len);
+    return true;
+}
+
+#elif PN532_CONFIG_SYSTEM_RANDOM && defined(__linux__)
+
+#include <cerrno>
+#include <sys/random.h>
+
+bool SystemRandom(void* /* ctx */, uint8_t* buf, size_t len)
+{
+    // Large requests may return early, interrupted ones are repeated
+    while (len)
+    {
+        ssize_t n = getrandom(buf, len, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+#endif
+
+#if RANDOM_POOL_LOCKING
+#define RANDOM_POOL_LOCK() std::lock_guard<std::mutex> lock(_mutex)
+#else
+#define RANDOM_POOL_LOCK()
+#endif
+
+RandomPool::RandomPool(RandomSource_t source, void* ctx) : _source(source), _ctx(ctx), _available(0), _misses(0)
+{
+
+}
+
+void RandomPool::SetSource(RandomSource_t source, void* ctx)
+{
+    RANDOM_POOL_LOCK();
+
+    // Bytes of the old source are dropped
+    _source = source;
+    _ctx = ctx;
+    memset(_pool, 0, sizeof(_pool));
+    _available = 0;
+}
+
+bool RandomPool::RefillLocked()
+{
+    if (_available == RANDOM_POOL_SIZE)
+        return true;
+
+    if (!_source || !_source(_ctx, _pool + _available, RANDOM_POOL_SIZE - _available))
+        return false;
+
+    _available = RANDOM_POOL_SIZE;
+
+    return true;
+}
+
+bool RandomPool::Refill()
+{
+    RANDOM_POOL_LOCK();
+
+    return RefillLocked();
+}
+
+bool RandomPool::Take(uint8_t* out, size_t len)
+{
+    RANDOM_POOL_LOCK();
+
+    // Requests larger than the pool bypass it
+    if (len > RANDOM_POOL_SIZE)
+        return _source && _source(_ctx, out, len);
+
+    if (_available < len)
+    {
+        _misses++;
+        if (!RefillLocked())
+            return false;
+    }
+
+    // Bytes are taken from the end of the valid range and never handed out twice
+    _available -= len;
+    memcpy(out, _pool + _available, len);
+    memset(_pool + _available, 0, len);
+
+    return true;
+}
+
+RandomPool& GetRandomPool()
+{
+    static RandomPool pool;
+    return pool;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "PN532Config.h"
+
+// Challenges are only needed by Desfire authentication
+#if PN532_CONFIG_DESFIRE
+
+#if !defined(ARDUINO) || defined(ESP32)
+#include <mutex>
+#define RANDOM_POOL_LOCKING 1
+#else
+#define RANDOM_POOL_LOCKING 0
+#endif
+
+// Bytes kept ready for challenges (16 AES authentications of 32 bytes)
+#define RANDOM_POOL_SIZE 512
+
+// Fills buffer with cryptographically secure random bytes. Returns false on
+// failure. ctx is the pointer given along with the source
+typedef bool (*RandomSource_t)(void* ctx, uint8_t* buf, size_t len);
+
+#if PN532_CONFIG_SYSTEM_RANDOM
+// System CSPRNG: esp_fill_random on ESP32 (hardware RNG, only truly random
+// while WiFi/BT or the bootloader entropy source is enabled), getrandom on
+// Linux. Context is not used
+bool SystemRandom(void* ctx, uint8_t* buf, size_t len);
+#define RANDOM_DEFAULT_SOURCE SystemRandom
+#else
+// No default source, Take fails until one is set with SetSource
+#define RANDOM_DEFAULT_SOURCE nullptr
+#endif
+
+// Pool of random bytes filled from a RandomSource_t in large chunks. Take is a
+// copy out of the pool, the source is only called by Refill, which readers run
+// while idle between polls. Take refills synchronously only if the pool ran dry.
+// Thread safe where std::mutex is available.
+class RandomPool
+{
+public:
+    RandomPool(RandomSource_t source = RANDOM_DEFAULT_SOURCE, void* ctx = nullptr);
+
+    // Copies len bytes to out. Taken bytes are wiped from the pool
+    bool Take(uint8_t* out, size_t len);
+    // Tops up the pool with one source call. Cheap when pool is full
+    bool Refill();
+    void SetSource(RandomSource_t source, void* ctx = nullptr);
+
+    size_t Available() const
+    {
+        return _available;
+    }
+
+    // Takes which had to call the source on the critical path
+    uint32_t Misses() const
+    {
+        return _misses;
+    }
+
+private:
+    bool RefillLocked();
+
+    RandomSource_t _source;
+    void* _ctx;
+    uint8_t _pool[RANDOM_POOL_SIZE];
+    size_t _available;      // Valid bytes at start of pool
+    uint32_t _misses;
+#if RANDOM_POOL_LOCKING
+    std::mutex _mutex;
+#endif
+};
+
+// Pool shared by all card drivers
+RandomPool& GetRandomPool();
+
+#endif
+
+#endif
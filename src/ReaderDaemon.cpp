@@ -0,0 +1,444 @@
+#include "ReaderDaemon.h"
+#include "Random.h"
+
+#if defined(__linux__) && !defined(ARDUINO) && PN532_CONFIG_STREAM
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Platform.h"
+
+// Kind of descriptor stored in upper half of epoll user data
+#define DAEMON_EVENT_READER 1ULL
+#define DAEMON_EVENT_LISTEN 2ULL
+#define DAEMON_EVENT_CLIENT 3ULL
+#define DAEMON_EVENT_STOP   4ULL
+
+#define DAEMON_MAX_EPOLL_EVENTS 32
+
+ReaderDaemon::ReaderDaemon(TapHandler& handler) :
+    PollIntervalMillis(10), Profile(nullptr), DebounceMillis(0), PublishDebounced(false), _handler(handler), _listen(-1), _published(0), _dropped(0)
+{
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    _stop = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = DAEMON_EVENT_STOP << 32;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _stop, &ev);
+
+    _event.Data().reserve(TAP_EVENT_WIRE_SIZE);
+}
+
+ReaderDaemon::~ReaderDaemon()
+{
+    for (Reader* reader : _readers)
+        delete reader;
+
+    for (int fd : _clients)
+        close(fd);
+
+    if (_listen >= 0)
+        close(_listen);
+
+    close(_stop);
+    close(_epoll);
+}
+
+int ReaderDaemon::AddReader(const char *path, uint32_t baudrate)
+{
+    int fd = PN532_Stream::Open(path, baudrate);
+    if (fd < 0)
+        return -1;
+
+    return AddReader(fd);
+}
+
+int ReaderDaemon::AddReader(int fd)
+{
+    if (fd < 0 || _readers.size() >= READER_DAEMON_MAX_READERS)
+        return -1;
+
+    Reader* reader = new Reader(fd, _readers.size());
+
+    // Setup is synchronous, the event loop is not running yet
+    reader->NFC.begin();
+    Result result = reader->NFC.SAMConfig();
+
+    // Polling must return when no card is present, so endless retries are
+    // replaced. A finite count of the profile is kept.
+    if (result && Profile)
+    {
+        RFProfile profile = *Profile;
+        if (profile.MaxRetries.MxRtyPassiveActivation == 0xFF)
+            profile.MaxRetries.MxRtyPassiveActivation = READER_DAEMON_ACTIVATION_RETRIES;
+
+        result = reader->NFC.ApplyRFProfile(profile);
+    }
+    else if (result)
+        result = reader->NFC.SetPassiveActivationRetries(READER_DAEMON_ACTIVATION_RETRIES);
+
+    if (!result)
+    {
+        delete reader;
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = (DAEMON_EVENT_READER << 32) | reader->Index;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+
+    reader->Deadline = PlatformMillis();
+    _readers.push_back(reader);
+
+    return reader->Index;
+}
+
+bool ReaderDaemon::Listen(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return false;
+
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    _listen = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listen < 0)
+        return false;
+
+    if (bind(_listen, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(_listen, READER_DAEMON_MAX_CLIENTS) < 0)
+    {
+        close(_listen);
+        _listen = -1;
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = DAEMON_EVENT_LISTEN << 32;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _listen, &ev);
+
+    return true;
+}
+
+void ReaderDaemon::Stop()
+{
+    uint64_t one = 1;
+    (void)!write(_stop, &one, sizeof(one));
+}
+
+void ReaderDaemon::Run()
+{
+    struct epoll_event events[DAEMON_MAX_EPOLL_EVENTS];
+
+    while (true)
+    {
+        // Sleep until the nearest poll, response timeout, command resend or NACK
+        uint32_t now = PlatformMillis();
+        int timeout = -1;
+
+        for (Reader* reader : _readers)
+        {
+            if (reader->State == READER_CLOSED)
+                continue;
+
+            int32_t remaining = (int32_t)(reader->Deadline - now);
+            if (remaining < 0)
+                remaining = 0;
+            if (timeout < 0 || remaining < timeout)
+                timeout = remaining;
+
+            int link = reader->Stream.PollTimeout();
+            if (link >= 0 && link < timeout)
+                timeout = link;
+        }
+
+        int n = epoll_wait(_epoll, events, DAEMON_MAX_EPOLL_EVENTS, timeout);
+        if (n < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < n; ++i)
+        {
+            uint32_t kind = events[i].data.u64 >> 32;
+            uint32_t value = events[i].data.u64 & 0xFFFFFFFF;
+
+            if (kind == DAEMON_EVENT_STOP)
+            {
+                uint64_t count;
+                (void)!read(_stop, &count, sizeof(count));
+                return;
+            }
+            else if (kind == DAEMON_EVENT_LISTEN)
+                Accept();
+            else if (kind == DAEMON_EVENT_CLIENT)
+            {
+                // Clients only receive, anything else means hang up
+                _clients.erase(std::remove(_clients.begin(), _clients.end(), (int)value), _clients.end());
+                close(value);
+            }
+            else if (kind == DAEMON_EVENT_READER)
+            {
+                Reader& reader = *_readers[value];
+
+                if (reader.Stream.Receive())
+                    HandleResponse(reader);
+            }
+        }
+
+        // Link recovery of silent readers, then start polls and expire lost responses
+        now = PlatformMillis();
+        for (Reader* reader : _readers)
+        {
+            if (reader->State == READER_CLOSED)
+                continue;
+
+            if (reader->Stream.PollTimeout() == 0 && reader->Stream.Receive())
+                HandleResponse(*reader);
+            else if ((int32_t)(reader->Deadline - now) <= 0)
+                HandleTimeout(*reader);
+        }
+    }
+}
+
+void ReaderDaemon::StartPoll(Reader& reader)
+{
+    reader.Start = PlatformMicros();
+
+    InListPassiveTargetRequest req;
+    req.MaxTg = 1;
+    req.BrTy = BRTY_106KBPS_TYPE_A;
+
+    reader.NFC.BeginCommand(COMMAND_INLISTPASSIVETARGET) << req;
+
+    if (!reader.NFC.WriteCommand())
+    {
+        Idle(reader);
+        return;
+    }
+
+    reader.State = READER_LISTING;
+    reader.Deadline = PlatformMillis() + READER_DAEMON_RESPONSE_TIMEOUT;
+}
+
+void ReaderDaemon::HandleResponse(Reader& reader)
+{
+    if (reader.Stream.Closed())
+    {
+        Close(reader);
+        return;
+    }
+
+    switch (reader.State)
+    {
+    case READER_LISTING:
+    {
+        TargetListTypeA list;
+        list.NbTg = 0;
+
+        // Response is already decoded, so this does not block
+        if (reader.NFC.ReadResponse(0))
+            reader.NFC.Response() >> list;
+
+        if (!list.NbTg)
+        {
+            Idle(reader);
+            break;
+        }
+
+        const TargetDataTypeA& target = list.Targets[0];
+
+        InitTapEvent(reader.Event, reader.Index, target);
+        reader.Tag = TagInterface(reader.NFC, target.Tg);
+
+        _debounce.WindowMillis = DebounceMillis;
+        reader.Cached = _debounce.Lookup(reader.Event, reader.Event.Timestamp);
+        if (reader.Cached)
+        {
+            Release(reader);
+            break;
+        }
+
+        reader.Job = _handler.CreateJob(reader.Index, reader.Tag, target);
+
+        if (reader.Job)
+            StepJob(reader, Result(), BinaryView());
+        else
+            Release(reader);
+        break;
+    }
+    case READER_EXCHANGE:
+    {
+        BinaryView response;
+        Result result = reader.Tag.Read(response);
+        StepJob(reader, result, response);
+        break;
+    }
+    case READER_RELEASE:
+        reader.NFC.ReadResponse(0);
+        FinishTap(reader);
+        break;
+    default:
+        // Unexpected data, drop it
+        reader.NFC.ReadResponse(0);
+        break;
+    }
+}
+
+void ReaderDaemon::HandleTimeout(Reader& reader)
+{
+    switch (reader.State)
+    {
+    case READER_IDLE:
+        StartPoll(reader);
+        break;
+    case READER_EXCHANGE:
+        StepJob(reader, Result::Transport(PN532_ERROR_TIMEOUT), BinaryView());
+        break;
+    case READER_RELEASE:
+        // Report tap even if release was lost
+        FinishTap(reader);
+        break;
+    default:
+        Idle(reader);
+        break;
+    }
+}
+
+void ReaderDaemon::StepJob(Reader& reader, const Result& result, const BinaryView& response)
+{
+    // First step has no response
+    if (reader.State == READER_EXCHANGE)
+        reader.Job->HandleResponse(result, response);
+
+    if (reader.Job->NextCommand(reader.Tag.BeginWrite()))
+    {
+        Result sent = reader.Tag.EndWrite();
+
+        if (sent)
+        {
+            reader.State = READER_EXCHANGE;
+            reader.Deadline = PlatformMillis() + READER_DAEMON_RESPONSE_TIMEOUT;
+            return;
+        }
+
+        // Writing failed, abort the job
+        reader.Job->HandleResponse(sent, BinaryView());
+    }
+
+    reader.Event.Status = _handler.FinishJob(reader.Index, reader.Job);
+    reader.Job = nullptr;
+    Release(reader);
+}
+
+void ReaderDaemon::Release(Reader& reader)
+{
+    InReleaseRequest req;
+    req.Tg = reader.Tag.Tg();
+
+    reader.NFC.BeginCommand(COMMAND_INRELEASE) << req;
+    reader.NFC.WriteCommand();
+
+    reader.State = READER_RELEASE;
+    reader.Deadline = PlatformMillis() + READER_DAEMON_RESPONSE_TIMEOUT;
+}
+
+void ReaderDaemon::FinishTap(Reader& reader)
+{
+    reader.Event.DurationMicros = PlatformMicros() - reader.Start;
+
+    if (!reader.Cached)
+        _debounce.Store(reader.Event, PlatformMillis());
+
+    if (!reader.Cached || PublishDebounced)
+        Publish(reader.Event);
+
+    Idle(reader);
+}
+
+void ReaderDaemon::Idle(Reader& reader)
+{
+    if (reader.Stream.Closed())
+    {
+        Close(reader);
+        return;
+    }
+
+    reader.State = READER_IDLE;
+    reader.Deadline = PlatformMillis() + PollIntervalMillis;
+
+#if PN532_CONFIG_DESFIRE
+    // Refill random pool between taps, so authentication never waits for the RNG
+    GetRandomPool().Refill();
+#endif
+}
+
+void ReaderDaemon::Close(Reader& reader)
+{
+    if (reader.Job)
+    {
+        reader.Job->HandleResponse(Result::Transport(PN532_ERROR_TIMEOUT), BinaryView());
+        _handler.FinishJob(reader.Index, reader.Job);
+        reader.Job = nullptr;
+    }
+
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, reader.Stream.Fd(), nullptr);
+    reader.State = READER_CLOSED;
+}
+
+void ReaderDaemon::Accept()
+{
+    while (true)
+    {
+        int fd = accept4(_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            break;
+
+        if (_clients.size() >= READER_DAEMON_MAX_CLIENTS)
+        {
+            close(fd);
+            continue;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u64 = (DAEMON_EVENT_CLIENT << 32) | (uint32_t)fd;
+        epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+
+        _clients.push_back(fd);
+    }
+}
+
+void ReaderDaemon::Publish(const TapEvent& event)
+{
+    _event.Clear();
+    _event << event;
+    _published++;
+
+    for (size_t i = 0; i < _clients.size(); )
+    {
+        ssize_t n = send(_clients[i], _event.Data().data(), _event.Size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            _dropped++; // Slow consumer
+        else if (n < 0)
+        {
+            close(_clients[i]);
+            _clients.erase(_clients.begin() + i);
+            continue;
+        }
+
+        ++i;
+    }
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef __READERDAEMON_H__
+#define __READERDAEMON_H__
+
+#include "PN532Config.h"
+
+// Uses epoll and Unix domain sockets
+#if defined(__linux__) && !defined(ARDUINO) && PN532_CONFIG_STREAM
+
+#include <cstdint>
+#include <vector>
+#include "PN532_Stream.h"
+#include "PN532Extended.h"
+#include "TapCache.h"
+#include "TapEvent.h"
+
+#define READER_DAEMON_MAX_READERS 16
+#define READER_DAEMON_MAX_CLIENTS 16
+#define READER_DAEMON_RESPONSE_TIMEOUT 1000 // ms
+// Passive activation retries, so InListPassiveTarget returns when no card is present.
+// Used unless Profile sets a finite count
+#define READER_DAEMON_ACTIVATION_RETRIES 0x02
+
+// Single threaded event loop serving many PN532 serial endpoints. Every reader
+// is a state machine advanced by epoll readiness of its descriptor, so slow
+// readers never block the others. Taps are published as TAP_EVENT_WIRE_SIZE
+// byte messages to all clients of a Unix SOCK_SEQPACKET socket.
+//
+// TapHandler runs on the event loop and must not block. Jobs are advanced one
+// command at a time, so CreateJob must not exchange with the tag itself.
+class ReaderDaemon
+{
+public:
+    ReaderDaemon(TapHandler& handler);
+    ~ReaderDaemon();
+
+    // Opens serial device and initializes PN532. Returns reader index or -1
+    int AddReader(const char *path, uint32_t baudrate = PN532_STREAM_SPEED);
+    // Takes ownership of an open descriptor (i.e. pseudo terminal)
+    int AddReader(int fd);
+    // Creates listening socket at path (existing socket file is replaced)
+    bool Listen(const char *path);
+
+    // Runs event loop until Stop is called
+    void Run();
+    // Can be called from any thread or signal handler
+    void Stop();
+
+    uint32_t PublishedEvents() const
+    {
+        return _published;
+    }
+
+    // Events not delivered because a client socket was full
+    uint32_t DroppedEvents() const
+    {
+        return _dropped;
+    }
+
+    // Delay between polls of a reader
+    uint16_t PollIntervalMillis;
+    // RF settings applied by AddReader (nullptr keeps PN532 defaults). Endless
+    // passive activation retries (0xFF) are replaced by READER_DAEMON_ACTIVATION_RETRIES.
+    const RFProfile* Profile;
+    // A card seen again on the same reader within this time (since it was last
+    // detected) is answered from cache without running the job. 0 disables.
+    uint32_t DebounceMillis;
+    // Publish cached taps again instead of suppressing them
+    bool PublishDebounced;
+
+private:
+    enum ReaderState_t : uint8_t
+    {
+        READER_IDLE,        // Waiting for next poll
+        READER_LISTING,     // InListPassiveTarget sent
+        READER_EXCHANGE,    // Job command sent
+        READER_RELEASE,     // InRelease sent
+        READER_CLOSED
+    };
+
+    struct Reader
+    {
+        Reader(int fd, uint8_t index) : Stream(fd), NFC(Stream), Tag(NFC, 0), Index(index), State(READER_IDLE), Deadline(0), Start(0), Job(nullptr), Cached(false) {}
+
+        PN532_Stream Stream;
+        PN532Extended NFC;
+        TagInterface Tag;
+        uint8_t Index;
+        ReaderState_t State;
+        uint32_t Deadline;  // PlatformMillis() of the next poll or response timeout
+        uint32_t Start;     // PlatformMicros() at poll start
+        TagJob* Job;
+        TapEvent Event;
+        bool Cached;        // Event was answered from debounce cache
+    };
+
+    void StartPoll(Reader& reader);
+    void HandleResponse(Reader& reader);
+    void HandleTimeout(Reader& reader);
+    // Handles job response (if any) and sends next command or releases target
+    void StepJob(Reader& reader, const Result& result, const BinaryView& response);
+    void Release(Reader& reader);
+    // Publishes event of the released target (unless suppressed by debounce)
+    void FinishTap(Reader& reader);
+    void Idle(Reader& reader);
+    void Close(Reader& reader);
+
+    void Accept();
+    void Publish(const TapEvent& event);
+
+    TapHandler& _handler;
+    std::vector<Reader*> _readers;
+    std::vector<int> _clients;
+    int _epoll;
+    int _listen;
+    int _stop;  // eventfd
+    uint32_t _published;
+    uint32_t _dropped;
+    ByteBuffer _event; // Serialized event, reused
+    TapCache _debounce;
+};
+
+#endif
+
+#endif
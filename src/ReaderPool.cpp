@@ -0,0 +1,234 @@
+#include "ReaderPool.h"
+#include "Random.h"
+
+#if !defined(ARDUINO) || defined(ESP32)
+
+#include "Platform.h"
+
+ReaderPool::ReaderPool(TapHandler& handler, uint8_t workers) :
+    PollIntervalMillis(10), DebounceMillis(0), PublishDebounced(false), _handler(handler), _workerCount(workers), _running(false), _stopWorkers(false), _pending(0), _dropped(0)
+{
+    if (!_workerCount)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        _workerCount = cores ? (cores > 255 ? 255 : cores) : 1;
+    }
+}
+
+ReaderPool::~ReaderPool()
+{
+    Stop();
+
+    for (ReaderContext* ctx : _readers)
+        delete ctx;
+}
+
+bool ReaderPool::AddReader(PN532Extended& reader)
+{
+    if (_running || _readers.size() >= READER_POOL_MAX_READERS)
+        return false;
+
+    ReaderContext* ctx = new ReaderContext();
+    ctx->Reader = &reader;
+    ctx->Index = _readers.size();
+    ctx->Tag = nullptr;
+    ctx->Job = nullptr;
+    ctx->HasResponse = false;
+    ctx->HasCommand = false;
+    ctx->StepDone = false;
+
+    _readers.push_back(ctx);
+
+    return true;
+}
+
+void ReaderPool::Start()
+{
+    if (_running)
+        return;
+
+    _running = true;
+    _stopWorkers = false;
+
+    for (uint8_t i = 0; i < _workerCount; ++i)
+        _workers.push_back(std::thread(&ReaderPool::RunWorker, this));
+
+    for (ReaderContext* ctx : _readers)
+    {
+        ctx->Debounce.WindowMillis = DebounceMillis;
+        ctx->Thread = std::thread(&ReaderPool::RunReader, this, std::ref(*ctx));
+    }
+}
+
+void ReaderPool::Stop()
+{
+    if (!_running)
+        return;
+
+    // Readers finish their current tap first, which still needs workers
+    _running = false;
+
+    for (ReaderContext* ctx : _readers)
+        ctx->Thread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(_idleMutex);
+        _stopWorkers = true;
+        _idle.notify_all();
+    }
+
+    for (std::thread& worker : _workers)
+        worker.join();
+
+    _workers.clear();
+}
+
+void ReaderPool::RunReader(ReaderContext& ctx)
+{
+    TargetListTypeA list;
+
+    while (_running)
+    {
+        uint32_t start = PlatformMicros();
+
+        Result result = ctx.Reader->InListPassiveTarget(list, 1);
+        if (!result || !list.NbTg)
+        {
+#if PN532_CONFIG_DESFIRE
+            // Challenges of the next tap are taken from the pool without waiting for the RNG
+            GetRandomPool().Refill();
+#endif
+
+            if (PollIntervalMillis)
+                PlatformSleepMicros(PollIntervalMillis * 1000);
+            continue;
+        }
+
+        const TargetDataTypeA& target = list.Targets[0];
+
+        TapEvent event;
+        InitTapEvent(event, ctx.Index, target);
+
+        if (ctx.Debounce.Lookup(event, event.Timestamp))
+        {
+            ctx.Reader->InRelease(target.Tg);
+
+            event.DurationMicros = PlatformMicros() - start;
+            if (PublishDebounced)
+                Publish(event);
+
+            if (PollIntervalMillis)
+                PlatformSleepMicros(PollIntervalMillis * 1000);
+            continue;
+        }
+
+        TagInterface tag(*ctx.Reader, target.Tg);
+        ctx.Tag = &tag;
+        ctx.Job = _handler.CreateJob(ctx.Index, tag, target);
+
+        if (ctx.Job)
+            event.Status = RunJob(ctx);
+
+        ctx.Reader->InRelease(target.Tg);
+        ctx.Tag = nullptr;
+        ctx.Job = nullptr;
+
+        event.DurationMicros = PlatformMicros() - start;
+        ctx.Debounce.Store(event, PlatformMillis());
+        Publish(event);
+    }
+}
+
+Result ReaderPool::RunJob(ReaderContext& ctx)
+{
+    ctx.HasResponse = false;
+
+    while (true)
+    {
+        // Worker handles previous response and builds the next command
+        Dispatch(ctx);
+
+        if (!ctx.HasCommand)
+            return ctx.Status;
+
+        Result result = ctx.Tag->EndWrite();
+        if (result)
+            result = ctx.Tag->Read(ctx.Response);
+        else
+            ctx.Response = BinaryView();
+
+        ctx.StepResult = result;
+        ctx.HasResponse = true;
+    }
+}
+
+void ReaderPool::Dispatch(ReaderContext& ctx)
+{
+    ctx.StepDone = false;
+
+    // Counted before Push, a worker may pop and finish the task right away
+    _pending.fetch_add(1, std::memory_order_release);
+
+    // Task queue is sized for one task per reader, so Push only fails on a bug.
+    // The step then runs on the reader thread instead of being lost.
+    if (!_tasks.Push(&ctx))
+    {
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        RunStep(ctx);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_idleMutex);
+        _idle.notify_one();
+    }
+
+    std::unique_lock<std::mutex> lock(ctx.Mutex);
+    ctx.Done.wait(lock, [&ctx] { return ctx.StepDone; });
+}
+
+void ReaderPool::RunStep(ReaderContext& ctx)
+{
+    if (ctx.HasResponse)
+        ctx.Job->HandleResponse(ctx.StepResult, ctx.Response);
+
+    // Reader thread is blocked in Dispatch, so its transmit buffer is free
+    ctx.HasCommand = ctx.Job->NextCommand(ctx.Tag->BeginWrite());
+
+    if (!ctx.HasCommand)
+        ctx.Status = _handler.FinishJob(ctx.Index, ctx.Job);
+
+    std::lock_guard<std::mutex> lock(ctx.Mutex);
+    ctx.StepDone = true;
+    ctx.Done.notify_one();
+}
+
+void ReaderPool::RunWorker()
+{
+    while (true)
+    {
+        ReaderContext* ctx;
+
+        if (_tasks.Pop(ctx))
+        {
+            _pending.fetch_sub(1, std::memory_order_relaxed);
+            RunStep(*ctx);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_idleMutex);
+        _idle.wait(lock, [this] { return _stopWorkers || _pending.load(std::memory_order_acquire); });
+
+        // Readers are joined before workers are stopped, so no tasks are left behind
+        if (_stopWorkers)
+            return;
+    }
+}
+
+void ReaderPool::Publish(const TapEvent& event)
+{
+    if (!_events.Push(event))
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef __READERPOOL_H__
+#define __READERPOOL_H__
+
+// Needs std::thread, available on hosts and ESP32
+#if !defined(ARDUINO) || defined(ESP32)
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "LockFreeQueue.h"
+#include "PN532Extended.h"
+#include "TapCache.h"
+#include "TapEvent.h"
+
+#define READER_POOL_MAX_READERS 16
+// Must be a power of 2
+#define READER_POOL_EVENT_QUEUE_SIZE 256
+// Each reader has at most one pending task
+#define READER_POOL_TASK_QUEUE_SIZE 16
+
+static_assert(READER_POOL_TASK_QUEUE_SIZE >= READER_POOL_MAX_READERS, "Task queue must hold one task per reader");
+
+// Serves many readers at once. Every reader gets an I/O thread which blocks on
+// its transport, while job steps (crypto and application logic) are executed by
+// a shared pool of workers. Ready steps of all readers go through a single
+// queue, so any idle worker picks up the next one.
+class ReaderPool
+{
+public:
+    // Worker count of 0 uses one worker per hardware thread
+    ReaderPool(TapHandler& handler, uint8_t workers = 0);
+    ~ReaderPool();
+
+    // Readers can only be added while the pool is stopped
+    bool AddReader(PN532Extended& reader);
+    void Start();
+    void Stop();
+
+    // Takes next completed tap. Safe to call from any number of consumer threads
+    bool PopEvent(TapEvent& event)
+    {
+        return _events.Pop(event);
+    }
+
+    // Taps lost because consumers did not keep up
+    uint32_t DroppedEvents() const
+    {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+    uint8_t WorkerCount() const
+    {
+        return _workerCount;
+    }
+
+    // Delay between polls when no card is present
+    uint16_t PollIntervalMillis;
+    // A card seen again on the same reader within this time (since it was last
+    // detected) is answered from cache without running the job. 0 disables.
+    // Set before Start.
+    uint32_t DebounceMillis;
+    // Publish cached taps again instead of suppressing them
+    bool PublishDebounced;
+
+private:
+    struct ReaderContext
+    {
+        PN532Extended* Reader;
+        uint8_t Index;
+        std::thread Thread;
+
+        // Step handed over to a worker
+        TagInterface* Tag;
+        TagJob* Job;
+        Result StepResult;
+        BinaryView Response;
+        bool HasResponse;
+        bool HasCommand;    // Set by worker when next command is built
+        Result Status;      // Set by worker when job has finished
+
+        std::mutex Mutex;
+        std::condition_variable Done;
+        bool StepDone;
+
+        TapCache Debounce;  // Only used by I/O thread
+    };
+
+    void RunReader(ReaderContext& ctx);
+    Result RunJob(ReaderContext& ctx);
+    // Hands step over to workers and waits for it to complete
+    void Dispatch(ReaderContext& ctx);
+    void RunStep(ReaderContext& ctx);
+    void RunWorker();
+    void Publish(const TapEvent& event);
+
+    TapHandler& _handler;
+    uint8_t _workerCount;
+    std::vector<ReaderContext*> _readers;
+    std::vector<std::thread> _workers;
+    std::atomic<bool> _running;
+    std::atomic<bool> _stopWorkers;
+
+    LockFreeQueue<ReaderContext*, READER_POOL_TASK_QUEUE_SIZE> _tasks;
+    // Idle workers sleep until tasks are pending
+    std::atomic<uint32_t> _pending;
+    std::mutex _idleMutex;
+    std::condition_variable _idle;
+
+    LockFreeQueue<TapEvent, READER_POOL_EVENT_QUEUE_SIZE> _events;
+    std::atomic<uint32_t> _dropped;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+#include "Result.h"
+#include "PN532Interface.h"
+#include "PN532Packets.h"
+#include "Desfire.h"
+
+using namespace PN532Packets;
+
+#if PN532_CONFIG_RESULT_MESSAGES
+
+static const char* TransportMessage(uint16_t code)
+{
+    switch (-(int16_t)code)
+    {
+        case PN532_ERROR_INVALID_ACK:   return "Transport: invalid ACK";
+        case PN532_ERROR_TIMEOUT:       return "Transport: timeout";
+        case PN532_ERROR_INVALID_FRAME: return "Transport: invalid frame";
+        case PN532_ERROR_NO_SPACE:      return "Transport: buffer too small";
+        default:                        return "Transport: unknown error";
+    }
+}
+
+static const char* PN532Message(uint16_t code)
+{
+    switch (code)
+    {
+        case PN532_STATUS_TIMEOUT:              return "PN532: target timeout";
+        case PN532_STATUS_CRC_ERROR:            return "PN532: CRC error";
+        case PN532_STATUS_PARITY_ERROR:         return "PN532: parity error";
+        case PN532_STATUS_ANTICOLLISION_ERROR:  return "PN532: anticollision bit count error";
+        case PN532_STATUS_FRAMING_ERROR:        return "PN532: framing error";
+        case PN532_STATUS_BIT_COLLISION:        return "PN532: abnormal bit collision";
+        case PN532_STATUS_BUFFER_TOO_SMALL:     return "PN532: buffer too small";
+        case PN532_STATUS_RF_BUFFER_OVERFLOW:   return "PN532: RF buffer overflow";
+        case PN532_STATUS_RF_FIELD_TIMEOUT:     return "PN532: RF field timeout";
+        case PN532_STATUS_RF_PROTOCOL_ERROR:    return "PN532: RF protocol error";
+        case PN532_STATUS_OVERHEATING:          return "PN532: overheating";
+        case PN532_STATUS_INTERNAL_OVERFLOW:    return "PN532: internal buffer overflow";
+        case PN532_STATUS_INVALID_PARAMETER:    return "PN532: invalid parameter";
+        case PN532_STATUS_DEP_UNSUPPORTED:      return "PN532: DEP command not supported";
+        case PN532_STATUS_DEP_INVALID_FORMAT:   return "PN532: DEP invalid data format";
+        case PN532_STATUS_AUTHENTICATION_ERROR: return "PN532: Mifare authentication error";
+        case PN532_STATUS_UID_CHECK_ERROR:      return "PN532: UID check byte error";
+        case PN532_STATUS_DEP_INVALID_STATE:    return "PN532: DEP invalid device state";
+        case PN532_STATUS_NOT_ALLOWED:          return "PN532: operation not allowed";
+        case PN532_STATUS_WRONG_CONTEXT:        return "PN532: command not acceptable in context";
+        case PN532_STATUS_TARGET_RELEASED:      return "PN532: target released";
+        case PN532_STATUS_CARD_ID_MISMATCH:     return "PN532: card ID mismatch";
+        case PN532_STATUS_CARD_DISAPPEARED:     return "PN532: card disappeared";
+        case PN532_STATUS_NFCID3_MISMATCH:      return "PN532: NFCID3 mismatch";
+        case PN532_STATUS_OVER_CURRENT:         return "PN532: over current";
+        case PN532_STATUS_NAD_MISSING:          return "PN532: NAD missing";
+        default:                                return "PN532: unknown error";
+    }
+}
+
+static const char* DesfireMessage(uint16_t code)
+{
+    switch (code)
+    {
+        case DF_STATUS_NO_CHANGES:              return "Desfire: no changes";
+        case DF_STATUS_OUT_OF_EEPROM_ERROR:     return "Desfire: out of EEPROM";
+        case DF_STATUS_ILLEGAL_COMMAND_CODE:    return "Desfire: illegal command code";
+        case DF_STATUS_INTEGRITY_ERROR:         return "Desfire: integrity error";
+        case DF_STATUS_NO_SUCH_KEY:             return "Desfire: no such key";
+        case DF_STATUS_LENGTH_ERROR:            return "Desfire: length error";
+        case DF_STATUS_PERMISSION_ERROR:        return "Desfire: permission denied";
+        case DF_STATUS_PARAMETER_ERROR:         return "Desfire: parameter error";
+        case DF_STATUS_APPLICATION_NOT_FOUND:   return "Desfire: application not found";
+        case DF_STATUS_APPL_INTEGRITY_ERROR:    return "Desfire: application integrity error";
+        case DF_STATUS_AUTHENTICATION_ERROR:    return "Desfire: authentication error";
+        case DF_STATUS_BOUNDARY_ERROR:          return "Desfire: boundary error";
+        case DF_STATUS_PICC_INTEGRITY_ERROR:    return "Desfire: PICC integrity error";
+        case DF_STATUS_COMMAND_ABORTED:         return "Desfire: command aborted";
+        case DF_STATUS_PICC_DISABLED_ERROR:     return "Desfire: PICC disabled";
+        case DF_STATUS_COUNT_ERROR:             return "Desfire: count error";
+        case DF_STATUS_DUPLICATE_ERROR:         return "Desfire: duplicate";
+        case DF_STATUS_EEPROM_ERROR:            return "Desfire: EEPROM error";
+        case DF_STATUS_FILE_NOT_FOUND:          return "Desfire: file not found";
+        case DF_STATUS_FILE_INTEGRITY_ERROR:    return "Desfire: file integrity error";
+        default:                                return "Desfire: unknown error";
+    }
+}
+
+static const char* LibraryMessage(uint16_t code)
+{
+    switch (code)
+    {
+        case RESULT_ERROR_INVALID_ARGUMENT:     return "Invalid argument";
+        case RESULT_ERROR_UNSUPPORTED:          return "Not supported";
+        case RESULT_ERROR_INVALID_RESPONSE:     return "Invalid response";
+        case RESULT_ERROR_AUTHENTICATION:       return "Authentication failed";
+        case RESULT_ERROR_NOT_AUTHENTICATED:    return "Not authenticated";
+        case RESULT_ERROR_KEY_NOT_FOUND:        return "Key not found";
+        case RESULT_ERROR_RANDOM_SOURCE:        return "Random source failed";
+        default:                                return "Unknown error";
+    }
+}
+
+const char* Result::Message() const
+{
+    switch (Origin)
+    {
+        case RESULT_ORIGIN_NONE:
+            return "OK";
+        case RESULT_ORIGIN_TRANSPORT:
+            return TransportMessage(Code);
+        case RESULT_ORIGIN_PN532:
+            return PN532Message(Code);
+        case RESULT_ORIGIN_ISO7816:
+            return "ISO7816: command failed";
+        case RESULT_ORIGIN_DESFIRE:
+            return DesfireMessage(Code);
+        case RESULT_ORIGIN_LIBRARY:
+            return LibraryMessage(Code);
+        case RESULT_ORIGIN_FELICA:
+            return "FeliCa: command failed";
+        default:
+            return "Unknown error";
+    }
+}
+
+#else
+
+const char* Result::Message() const
+{
+    return Ok() ? "OK" : "Error";
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __RESULT_H__
+#define __RESULT_H__
+
+#include <cstdint>
+
+// Layer which reported the failure
+enum ResultOrigin_t : uint8_t
+{
+    RESULT_ORIGIN_NONE          = 0x00, // Success
+    RESULT_ORIGIN_TRANSPORT     = 0x01, // PN532Interface error (PN532Error, stored positive)
+    RESULT_ORIGIN_PN532         = 0x02, // PN532 status byte (PN532Status_t)
+    RESULT_ORIGIN_ISO7816       = 0x03, // ISO7816-4 status word (SW1 << 8 | SW2)
+    RESULT_ORIGIN_DESFIRE       = 0x04, // Desfire status (DesfireStatus_t)
+    RESULT_ORIGIN_LIBRARY       = 0x05, // Library error (ResultError_t)
+    RESULT_ORIGIN_FELICA        = 0x06  // FeliCa status flags (Flag1 << 8 | Flag2)
+};
+
+// Errors detected by the library itself
+enum ResultError_t : uint8_t
+{
+    RESULT_ERROR_INVALID_ARGUMENT   = 0x01,
+    RESULT_ERROR_UNSUPPORTED        = 0x02, // Key type or feature not implemented
+    RESULT_ERROR_INVALID_RESPONSE   = 0x03, // Malformed or unexpected response
+    RESULT_ERROR_AUTHENTICATION     = 0x04, // Card failed mutual authentication
+    RESULT_ERROR_NOT_AUTHENTICATED  = 0x05,
+    RESULT_ERROR_KEY_NOT_FOUND      = 0x06,
+    RESULT_ERROR_RANDOM_SOURCE      = 0x07  // CSPRNG failed to deliver bytes
+};
+
+// Compact error code propagated by value through all layers.
+// Evaluates to true on success. Text is only produced on request by Message().
+struct Result
+{
+    Result() : Origin(RESULT_ORIGIN_NONE), Code(0) {}
+    Result(ResultOrigin_t origin, uint16_t code) : Origin(origin), Code(code) {}
+
+    static Result Transport(int16_t error)
+    {
+        return error < 0 ? Result(RESULT_ORIGIN_TRANSPORT, -error) : Result();
+    }
+
+    // Lower 6 bits of PN532 status byte hold error code
+    static Result PN532(uint8_t status)
+    {
+        return (status & 0x3F) ? Result(RESULT_ORIGIN_PN532, status & 0x3F) : Result();
+    }
+
+    static Result ISO7816(uint8_t SW1, uint8_t SW2)
+    {
+        return (SW1 == 0x90 && SW2 == 0x00) ? Result() : Result(RESULT_ORIGIN_ISO7816, (SW1 << 8) | SW2);
+    }
+
+    static Result FeliCa(uint8_t flag1, uint8_t flag2)
+    {
+        return flag1 ? Result(RESULT_ORIGIN_FELICA, (flag1 << 8) | flag2) : Result();
+    }
+
+    static Result Library(ResultError_t error)
+    {
+        return Result(RESULT_ORIGIN_LIBRARY, error);
+    }
+
+    bool Ok() const
+    {
+        return Origin == RESULT_ORIGIN_NONE;
+    }
+
+    explicit operator bool() const
+    {
+        return Ok();
+    }
+
+    bool operator==(const Result& other) const
+    {
+        return Origin == other.Origin && Code == other.Code;
+    }
+
+    bool operator!=(const Result& other) const
+    {
+        return !(*this == other);
+    }
+
+    // Static description of the error. Never allocates. Only "OK" or "Error"
+    // when built without PN532_CONFIG_RESULT_MESSAGES
+    const char* Message() const;
+
+    ResultOrigin_t Origin;
+    uint16_t Code;
+};
+
+#endif
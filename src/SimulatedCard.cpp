@@ -0,0 +1,692 @@
+#include "SimulatedCard.h"
+
+#if PN532_CONFIG_SIMULATOR
+
+#include "Crypto.h"
+#include "Desfire.h"
+#include "FeliCa.h"
+#include "PN532Packets.h"
+#include "Ultralight.h"
+#include <cstring>
+
+// Data bytes per ReadData frame, frame fills a 64 byte FSC with status and ISO wrapping
+#define SIMULATED_DESFIRE_FRAME_SIZE 59
+
+SimulatedTypeACard::SimulatedTypeACard(const BinaryData& uid, uint8_t atqa0, uint8_t atqa1, uint8_t sak, const BinaryData& ats) :
+    UID(uid), SAK(sak), ATS(ats)
+{
+    ATQA[0] = atqa0;
+    ATQA[1] = atqa1;
+}
+
+void SimulatedTypeACard::TargetData(ByteBuffer& buf) const
+{
+    buf << ATQA[0];
+    buf << ATQA[1];
+    buf << SAK;
+    buf << (uint8_t)UID.size();
+    buf << UID;
+
+    // ATS is only sent by ISO14443-4 targets
+    if (SAK & 0x20)
+    {
+        buf << (uint8_t)(ATS.size() + 1);
+        buf << ATS;
+    }
+}
+
+uint8_t SimulatedTypeACard::Exchange(const BinaryView& /* in */, ByteBuffer& /* out */)
+{
+    // Plain card does not answer
+    return PN532Packets::PN532_STATUS_TIMEOUT;
+}
+
+bool SimulatedTypeACard::IsoDepParameters(ATSParameters& params) const
+{
+    return (SAK & 0x20) && CardIdentifier::DecodeATS(ATS, params);
+}
+
+bool SimulatedTypeACard::Selected(const BinaryView& initiator) const
+{
+    return !initiator.Size || (initiator.Size == UID.size() && !memcmp(initiator.Data, UID.data(), UID.size()));
+}
+
+#if PN532_CONFIG_DESFIRE_EV2
+SimulatedDesfireCard::SimulatedDesfireCard(const BinaryData& uid, const DesfireKey& key) :
+    SimulatedTypeACard(uid, 0x03, 0x44, 0x20, {0x75, 0x77, 0x81, 0x02, 0x80}),
+    Key(key), CommandMicros(1000), HardwareMajor(0x01), _authIns(0), _readOffset(0), _readEnd(0)
+{
+    // Deterministic file contents keep simulation reproducible
+    File.resize(1024);
+    for (size_t i = 0; i < File.size(); ++i)
+        File[i] = i * 7;
+}
+
+uint32_t SimulatedDesfireCard::ProcessingMicros() const
+{
+    return CommandMicros;
+}
+
+void SimulatedDesfireCard::Reset()
+{
+    _authIns = 0;
+    _readOffset = 0;
+    _readEnd = 0;
+    _ev2.Clear();
+}
+
+uint8_t SimulatedDesfireCard::Exchange(const BinaryView& in, ByteBuffer& out)
+{
+    if (in.Size < 5)
+        return PN532Packets::PN532_STATUS_RF_PROTOCOL_ERROR;
+
+    // ISO7816-4 select file
+    if (in[0] == ISO7816_4_CLA_WITHOUT_SM_LAST && in[1] == 0xA4)
+    {
+        out << (uint8_t)0x90 << (uint8_t)0x00;
+        return PN532Packets::PN532_STATUS_OK;
+    }
+
+    if (in[0] == ISO7816_4_CLA_WITHOUT_SM_LAST && in[1] == 0xB0)
+    {
+        ReadBinary(in, out);
+        return PN532Packets::PN532_STATUS_OK;
+    }
+
+    // Wrapped native command: 90 INS 00 00 Lc Data 00
+    if (in[0] != 0x90)
+    {
+        out << (uint8_t)0x6E << (uint8_t)0x00; // Class not supported
+        return PN532Packets::PN532_STATUS_OK;
+    }
+
+    uint8_t ins = in[1];
+    BinaryView data = in.Sub(5, in[4]);
+    uint8_t authIns = _authIns;
+    _authIns = 0;
+
+    // Any other command ends a pending ReadData
+    bool reading = _readOffset < _readEnd;
+    if (ins != DF_INS_ADDITIONAL_FRAME)
+        _readOffset = _readEnd = 0;
+
+    if ((ins == DFEV1_INS_AUTHENTICATE_AES && data.Size == 1) ||
+        (ins == DFEV2_INS_AUTHENTICATE_EV2_FIRST && data.Size >= 2) ||
+        (ins == DFEV2_INS_AUTHENTICATE_EV2_NONFIRST && data.Size == 1 && _ev2.Active()))
+    {
+        // Deterministic RndB keeps simulation reproducible
+        _RndB.resize(16);
+        for (uint8_t i = 0; i < 16; ++i)
+            _RndB[i] = i * 0x11 + data[0] + ins;
+
+        // EV1 chains IV through the whole handshake, EV2 restarts with zero IV
+        _IV.assign(16, 0x00);
+        out << AES_CBC_Encrypt(_RndB, Key.Key, _IV);
+        out << (uint8_t)0x91 << (uint8_t)DF_STATUS_ADDITIONAL_FRAME;
+        _authIns = ins;
+
+        // Starting a new authentication ends EV2 transaction
+        if (ins != DFEV2_INS_AUTHENTICATE_EV2_NONFIRST)
+            _ev2.Clear();
+    }
+    else if (ins == DF_INS_ADDITIONAL_FRAME && authIns && data.Size == 32)
+    {
+        if (authIns != DFEV1_INS_AUTHENTICATE_AES)
+            _IV.assign(16, 0x00);
+
+        BinaryData token = AES_CBC_Decrypt(data.ToBinary(), Key.Key, _IV);
+
+        // Second half is RndB rotated left
+        for (uint8_t i = 0; i < 16; ++i)
+        {
+            if (token[16+i] != _RndB[(i+1) % 16])
+            {
+                _ev2.Clear();
+                out << (uint8_t)0x91 << (uint8_t)DF_STATUS_AUTHENTICATION_ERROR;
+                return PN532Packets::PN532_STATUS_OK;
+            }
+        }
+
+        // Respond with RndA rotated left
+        BinaryData RndA(token.begin(), token.begin()+16);
+        BinaryData RndARot(token.begin()+1, token.begin()+16);
+        RndARot.push_back(token[0]);
+
+        if (authIns == DFEV2_INS_AUTHENTICATE_EV2_FIRST)
+        {
+            // TI || RndA' || PDcap2 || PCDcap2
+            uint8_t TI[DESFIRE_EV2_TI_SIZE] = { _RndB[3], _RndB[7], _RndB[11], _RndB[15] };
+            ByteBuffer response;
+            response.Append(TI, sizeof(TI));
+            response << RndARot;
+            response.Append(BinaryData(12, 0x00));
+
+            _IV.assign(16, 0x00);
+            out << AES_CBC_Encrypt(response.Data(), Key.Key, _IV);
+            _ev2.Begin(Key, RndA, _RndB, TI);
+        }
+        else if (authIns == DFEV2_INS_AUTHENTICATE_EV2_NONFIRST)
+        {
+            _IV.assign(16, 0x00);
+            out << AES_CBC_Encrypt(RndARot, Key.Key, _IV);
+            _ev2.Rekey(Key, RndA, _RndB);
+        }
+        else
+        {
+            out << AES_CBC_Encrypt(RndARot, Key.Key, _IV);
+        }
+
+        out << (uint8_t)0x91 << (uint8_t)DF_STATUS_OPERATION_OK;
+    }
+    else if (_ev2.Active() && (ins == DFEV1_INS_GET_CARD_UID || ins == DF_INS_GET_KEY_VERSION || ins == DF_INS_CHANGE_KEY))
+        ExchangeEV2(ins, data, out);
+    else if (ins == DF_INS_READ_DATA && data.Size == 7)
+    {
+        // File number, offset and length (LSB first), length 0 reads up to the end
+        uint32_t offset = data[1] | data[2] << 8 | data[3] << 16;
+        uint32_t length = data[4] | data[5] << 8 | data[6] << 16;
+
+        if (!length && offset < File.size())
+            length = File.size() - offset;
+
+        if (!length || offset + length > File.size())
+            out << (uint8_t)0x91 << (uint8_t)DF_STATUS_BOUNDARY_ERROR;
+        else
+        {
+            _readOffset = offset;
+            _readEnd = offset + length;
+            ReadFrame(out);
+        }
+    }
+    else if (ins == DF_INS_ADDITIONAL_FRAME && reading)
+        ReadFrame(out);
+    else if (ins == DF_INS_SELECT_APPLICATION)
+        out << (uint8_t)0x91 << (uint8_t)DF_STATUS_OPERATION_OK;
+    else if (ins == DF_INS_GET_VERSION)
+    {
+        // Hardware information only, software and production frames are not emulated
+        out << (uint8_t)0x04 << (uint8_t)0x01 << (uint8_t)0x01 << HardwareMajor
+            << (uint8_t)0x00 << (uint8_t)0x18 << (uint8_t)0x05;
+        out << (uint8_t)0x91 << (uint8_t)DF_STATUS_ADDITIONAL_FRAME;
+    }
+    else
+        out << (uint8_t)0x91 << (uint8_t)DF_STATUS_ILLEGAL_COMMAND_CODE;
+
+    return PN532Packets::PN532_STATUS_OK;
+}
+
+void SimulatedDesfireCard::ReadFrame(ByteBuffer& out)
+{
+    uint32_t size = _readEnd - _readOffset;
+    if (size > SIMULATED_DESFIRE_FRAME_SIZE)
+        size = SIMULATED_DESFIRE_FRAME_SIZE;
+
+    out.Append(File.data() + _readOffset, size);
+    _readOffset += size;
+
+    out << (uint8_t)0x91 << (uint8_t)(_readOffset < _readEnd ? DF_STATUS_ADDITIONAL_FRAME : DF_STATUS_OPERATION_OK);
+}
+
+void SimulatedDesfireCard::ReadBinary(const BinaryView& in, ByteBuffer& out)
+{
+    // 00 B0 P1 P2 Le, offset in P1 (bit 7 clear) and P2, Le 0 requests 256 bytes
+    uint32_t offset = (in[2] & 0x7F) << 8 | in[3];
+    uint32_t length = in[4] ? in[4] : 256;
+
+    if (offset >= File.size())
+    {
+        out << (uint8_t)0x6B << (uint8_t)0x00; // Wrong parameters
+        return;
+    }
+
+    // End of file reached before Le bytes
+    bool end = offset + length > File.size();
+    if (end)
+        length = File.size() - offset;
+
+    out.Append(File.data() + offset, length);
+    out << (uint8_t)(end ? 0x62 : 0x90) << (uint8_t)(end ? 0x82 : 0x00);
+}
+
+void SimulatedDesfireCard::ExchangeEV2(uint8_t ins, const BinaryView& data, ByteBuffer& out)
+{
+    // Command header length: none for GetCardUID, key number otherwise
+    uint8_t headerSize = ins == DFEV1_INS_GET_CARD_UID ? 0 : 1;
+
+    if (data.Size < (size_t)(headerSize + DESFIRE_EV2_MAC_SIZE))
+    {
+        _ev2.Clear();
+        out << (uint8_t)0x91 << (uint8_t)DF_STATUS_LENGTH_ERROR;
+        return;
+    }
+
+    BinaryView header = data.Sub(0, headerSize);
+    BinaryView payload = data.Sub(headerSize, data.Size - headerSize - DESFIRE_EV2_MAC_SIZE);
+    BinaryData mac = _ev2.MAC(ins, header, payload, false);
+
+    if (memcmp(mac.data(), data.Data + data.Size - DESFIRE_EV2_MAC_SIZE, DESFIRE_EV2_MAC_SIZE))
+    {
+        _ev2.Clear();
+        out << (uint8_t)0x91 << (uint8_t)DF_STATUS_INTEGRITY_ERROR;
+        return;
+    }
+
+    BinaryData response;
+
+    if (ins == DFEV1_INS_GET_CARD_UID)
+    {
+        // Full mode, UID is encrypted
+        response = _ev2.Encrypt(UID, true);
+    }
+    else if (ins == DF_INS_GET_KEY_VERSION)
+    {
+        // MAC mode, all keys have version 0
+        response.push_back(0x00);
+    }
+    else
+    {
+        // Full mode change of the authenticated key: new key and version
+        BinaryData plain;
+        if (!_ev2.Decrypt(payload, false, plain) || plain.size() != 17)
+        {
+            _ev2.Clear();
+            out << (uint8_t)0x91 << (uint8_t)DF_STATUS_INTEGRITY_ERROR;
+            return;
+        }
+
+        Key = CreateDesfireKeyAES(BinaryData(plain.begin(), plain.begin() + 16));
+
+        // Session ends, response carries no MAC
+        _ev2.Clear();
+        out << (uint8_t)0x91 << (uint8_t)DF_STATUS_OPERATION_OK;
+        return;
+    }
+
+    out << response << _ev2.MAC(DF_STATUS_OPERATION_OK, BinaryView(), response, true);
+    out << (uint8_t)0x91 << (uint8_t)DF_STATUS_OPERATION_OK;
+    _ev2.Advance();
+}
+#endif
+
+SimulatedNtagCard::SimulatedNtagCard(const BinaryData& uid, uint8_t storageSize) :
+    SimulatedTypeACard(uid, 0x00, 0x44, 0x00), Auth0(0xFF), ReadMicros(500),
+    _storageSize(storageSize), _processing(0), _authenticated(false), _halted(false)
+{
+    uint16_t pages = !storageSize ? 16 : storageSize == 0x0F ? 45 : storageSize == 0x11 ? 135 : 231;
+
+    // Deterministic user memory keeps simulation reproducible
+    Memory.resize(pages * ULTRALIGHT_PAGE_SIZE);
+    for (size_t i = 0; i < Memory.size(); ++i)
+        Memory[i] = i;
+
+    // UID0-2, BCC0, UID3-6, BCC1
+    if (uid.size() == 7)
+    {
+        const uint8_t serial[] = { uid[0], uid[1], uid[2], (uint8_t)(0x88 ^ uid[0] ^ uid[1] ^ uid[2]),
+            uid[3], uid[4], uid[5], uid[6], (uint8_t)(uid[3] ^ uid[4] ^ uid[5] ^ uid[6]) };
+        memcpy(Memory.data(), serial, sizeof(serial));
+    }
+    else
+        memcpy(Memory.data(), uid.data(), uid.size() < 9 ? uid.size() : 9);
+
+    Signature.resize(ULTRALIGHT_SIGNATURE_SIZE);
+    for (uint8_t i = 0; i < ULTRALIGHT_SIGNATURE_SIZE; ++i)
+        Signature[i] = 0xA0 ^ i;
+
+    memset(Password, 0xFF, sizeof(Password));
+    PACK[0] = 0x00;
+    PACK[1] = 0x00;
+}
+
+uint32_t SimulatedNtagCard::ProcessingMicros() const
+{
+    return _processing;
+}
+
+void SimulatedNtagCard::Reset()
+{
+    _authenticated = false;
+    _halted = false;
+}
+
+uint8_t SimulatedNtagCard::Exchange(const BinaryView& in, ByteBuffer& out)
+{
+    uint16_t pages = Memory.size() / ULTRALIGHT_PAGE_SIZE;
+    _processing = 0;
+
+    if (!in.Size || _halted)
+        return PN532Packets::PN532_STATUS_TIMEOUT;
+
+    switch (in[0])
+    {
+    case UL_CMD_GET_VERSION:
+        if (!_storageSize)
+            break;
+
+        out << (uint8_t)0x00 << (uint8_t)0x04 << (uint8_t)0x04 << (uint8_t)0x02
+            << (uint8_t)0x01 << (uint8_t)0x00 << _storageSize << (uint8_t)0x03;
+        return PN532Packets::PN532_STATUS_OK;
+
+    case UL_CMD_READ:
+        if (in.Size < 2 || in[1] >= pages)
+            break;
+
+        // Rolls over to page 0 at end of memory
+        for (uint8_t i = 0; i < ULTRALIGHT_READ_PAGES * ULTRALIGHT_PAGE_SIZE; ++i)
+            out << Memory[(in[1] * ULTRALIGHT_PAGE_SIZE + i) % Memory.size()];
+
+        _processing = ReadMicros;
+        return PN532Packets::PN532_STATUS_OK;
+
+    case UL_CMD_FAST_READ:
+        if (!_storageSize || in.Size < 3 || in[1] > in[2] || in[2] >= pages)
+            break;
+
+        out.Append(Memory.data() + in[1] * ULTRALIGHT_PAGE_SIZE, (in[2] - in[1] + 1) * ULTRALIGHT_PAGE_SIZE);
+
+        _processing = ReadMicros;
+        return PN532Packets::PN532_STATUS_OK;
+
+    case UL_CMD_WRITE:
+        if (in.Size < 6 || in[1] < 2 || in[1] >= pages || (in[1] >= Auth0 && !_authenticated))
+            break;
+
+        memcpy(Memory.data() + in[1] * ULTRALIGHT_PAGE_SIZE, in.Data + 2, ULTRALIGHT_PAGE_SIZE);
+
+        // EEPROM programming time
+        _processing = 4100;
+        return PN532Packets::PN532_STATUS_OK;
+
+    case UL_CMD_READ_SIG:
+        if (!_storageSize)
+            break;
+
+        out << Signature;
+        return PN532Packets::PN532_STATUS_OK;
+
+    case UL_CMD_PWD_AUTH:
+        if (in.Size < 5 || memcmp(in.Data + 1, Password, sizeof(Password)))
+            break;
+
+        _authenticated = true;
+        out << PACK[0] << PACK[1];
+        return PN532Packets::PN532_STATUS_OK;
+
+    default:
+        break;
+    }
+
+    // NAK is not a complete byte, PN532 reports it as a failed exchange.
+    // Card falls back to idle state
+    _halted = true;
+    return PN532Packets::PN532_STATUS_TIMEOUT;
+}
+
+#if PN532_CONFIG_MIFARE_CLASSIC
+SimulatedClassicCard::SimulatedClassicCard(const BinaryData& uid, CardType_t type) :
+    SimulatedTypeACard(uid, 0x00, type == CARD_TYPE_MIFARE_CLASSIC_4K ? 0x02 : 0x04,
+        type == CARD_TYPE_MIFARE_CLASSIC_4K ? 0x18 : type == CARD_TYPE_MIFARE_MINI ? 0x09 : 0x08),
+    AuthMicros(1500), _authSector(-1), _halted(false), _processing(0)
+{
+    uint8_t sectors = MifareClassic::SectorCount(type);
+    uint16_t blocks = MifareClassic::FirstBlockOfSector(sectors - 1) + MifareClassic::BlocksInSector(sectors - 1);
+    _lastBlock = blocks - 1;
+
+    Memory.resize(blocks * MIFARE_BLOCK_SIZE);
+    for (size_t i = 0; i < Memory.size(); ++i)
+        Memory[i] = i ^ (i >> 8);
+
+    // Manufacturer block starts with UID
+    memcpy(Memory.data(), uid.data(), uid.size());
+
+    // Transport configuration: default keys, key A readable access bits
+    for (uint8_t sector = 0; sector < sectors; ++sector)
+    {
+        uint8_t *trailer = Memory.data() + (MifareClassic::FirstBlockOfSector(sector) + MifareClassic::BlocksInSector(sector) - 1) * MIFARE_BLOCK_SIZE;
+        const uint8_t access[4] = { 0xFF, 0x07, 0x80, 0x69 };
+
+        memcpy(trailer, MIFARE_DEFAULT_KEY.Key, MIFARE_KEY_SIZE);
+        memcpy(trailer + 6, access, sizeof(access));
+        memcpy(trailer + 10, MIFARE_DEFAULT_KEY.Key, MIFARE_KEY_SIZE);
+    }
+}
+
+uint32_t SimulatedClassicCard::ProcessingMicros() const
+{
+    return _processing;
+}
+
+void SimulatedClassicCard::Reset()
+{
+    _authSector = -1;
+    _halted = false;
+}
+
+uint8_t SimulatedClassicCard::Exchange(const BinaryView& in, ByteBuffer& out)
+{
+    _processing = 0;
+
+    if (_halted || in.Size < 2 || in[1] > _lastBlock)
+    {
+        _halted = true;
+        return PN532Packets::PN532_STATUS_TIMEOUT;
+    }
+
+    uint8_t block = in[1];
+    uint8_t sector = MifareClassic::SectorOfBlock(block);
+    uint8_t *data = Memory.data() + block * MIFARE_BLOCK_SIZE;
+
+    switch (in[0])
+    {
+    case MIFARE_KEY_A:
+    case MIFARE_KEY_B:
+    {
+        _processing = AuthMicros;
+
+        const uint8_t *trailer = Memory.data() + (MifareClassic::FirstBlockOfSector(sector) + MifareClassic::BlocksInSector(sector) - 1) * MIFARE_BLOCK_SIZE;
+        const uint8_t *key = in[0] == MIFARE_KEY_A ? trailer : trailer + 10;
+
+        if (in.Size < 12 || memcmp(in.Data + 2, key, MIFARE_KEY_SIZE) ||
+            memcmp(in.Data + 8, UID.data() + UID.size() - 4, 4))
+            break;
+
+        _authSector = sector;
+        return PN532Packets::PN532_STATUS_OK;
+    }
+    case MIFARE_CMD_READ:
+        if (_authSector != sector)
+            break;
+
+        out.Append(data, MIFARE_BLOCK_SIZE);
+        return PN532Packets::PN532_STATUS_OK;
+
+    case MIFARE_CMD_WRITE:
+        if (_authSector != sector || in.Size < 2 + MIFARE_BLOCK_SIZE || block == 0)
+            break;
+
+        memcpy(data, in.Data + 2, MIFARE_BLOCK_SIZE);
+        _processing = 5000;
+        return PN532Packets::PN532_STATUS_OK;
+
+    default:
+        break;
+    }
+
+    _halted = true;
+    _authSector = -1;
+
+    return in[0] == MIFARE_KEY_A || in[0] == MIFARE_KEY_B ? PN532Packets::PN532_STATUS_AUTHENTICATION_ERROR : PN532Packets::PN532_STATUS_TIMEOUT;
+}
+#endif
+
+SimulatedFeliCaCard::SimulatedFeliCaCard(const BinaryData& idm, uint16_t systemCode, uint16_t serviceCode, uint16_t blocks) :
+    SystemCode(systemCode), ServiceCode(serviceCode), MaxReadBlocks(12), MaxWriteBlocks(8), HighSpeed(false),
+    CommandMicros(1000), BlockMicros(200), _processing(0)
+{
+    memset(IDm, 0, sizeof(IDm));
+    memcpy(IDm, idm.data(), idm.size() < sizeof(IDm) ? idm.size() : sizeof(IDm));
+
+    // Timing parameters of a typical transit card
+    const uint8_t pmm[] = { 0x01, 0x20, 0x22, 0x04, 0x27, 0x67, 0x4E, 0xFF };
+    memcpy(PMm, pmm, sizeof(PMm));
+
+    // Deterministic memory keeps simulation reproducible
+    Memory.resize(blocks * FELICA_BLOCK_SIZE);
+    for (size_t i = 0; i < Memory.size(); ++i)
+        Memory[i] = i;
+}
+
+void SimulatedFeliCaCard::TargetData(ByteBuffer& buf) const
+{
+    buf << (uint8_t)20 << (uint8_t)0x01;
+    buf.Append(IDm, sizeof(IDm));
+    buf.Append(PMm, sizeof(PMm));
+    buf << (uint8_t)(SystemCode >> 8) << (uint8_t)(SystemCode & 0xFF);
+}
+
+PN532Packets::BrTy_t SimulatedFeliCaCard::Modulation() const
+{
+    return HighSpeed ? PN532Packets::BRTY_424KBPS : PN532Packets::BRTY_212KBPS;
+}
+
+uint32_t SimulatedFeliCaCard::ProcessingMicros() const
+{
+    return _processing;
+}
+
+uint8_t SimulatedFeliCaCard::Exchange(const BinaryView& in, ByteBuffer& out)
+{
+    _processing = CommandMicros;
+
+    // Frames with wrong length byte are dropped by the card
+    if (in.Size < 2 || in[0] != in.Size)
+        return PN532Packets::PN532_STATUS_TIMEOUT;
+
+    if (in[1] == FELICA_CMD_POLLING)
+    {
+        uint16_t sc = in.Size >= 6 ? (in[2] << 8) | in[3] : 0xFFFF;
+
+        // 0xFF bytes in requested system code are wildcards
+        if (in.Size < 6 || ((sc >> 8) != 0xFF && (sc >> 8) != (SystemCode >> 8)) ||
+            ((sc & 0xFF) != 0xFF && (sc & 0xFF) != (SystemCode & 0xFF)))
+            return PN532Packets::PN532_STATUS_TIMEOUT;
+
+        out << (uint8_t)(in[4] == 0x01 ? 20 : 18) << (uint8_t)0x01;
+        out.Append(IDm, sizeof(IDm));
+        out.Append(PMm, sizeof(PMm));
+        if (in[4] == 0x01)
+            out << (uint8_t)(SystemCode >> 8) << (uint8_t)(SystemCode & 0xFF);
+
+        return PN532Packets::PN532_STATUS_OK;
+    }
+
+    // All other commands address the card by IDm
+    if (in.Size < 14 || memcmp(in.Data + 2, IDm, sizeof(IDm)))
+        return PN532Packets::PN532_STATUS_TIMEOUT;
+
+    switch (in[1])
+    {
+    case FELICA_CMD_READ_WITHOUT_ENCRYPTION:
+        return ReadBlocks(in, out);
+    case FELICA_CMD_WRITE_WITHOUT_ENCRYPTION:
+        return WriteBlocks(in, out);
+    default:
+        return PN532Packets::PN532_STATUS_TIMEOUT;
+    }
+}
+
+// Parses service and block list of read and write commands. Returns status
+// flag 2 (0 on success) and number of bytes consumed.
+static uint8_t ParseBlockList(const BinaryView& in, uint16_t serviceCode, uint16_t memoryBlocks, uint8_t maxBlocks,
+    uint16_t* blocks, uint8_t& count, uint16_t& offset)
+{
+    if (in[10] != 1)
+        return 0xA1; // Illegal number of services
+
+    if ((in[11] | (in[12] << 8)) != serviceCode)
+        return 0xA6; // Illegal service code
+
+    count = in[13];
+    if (count == 0 || count > maxBlocks || count > FELICA_MAX_BLOCKS)
+        return 0xA2; // Illegal number of blocks
+
+    offset = 14;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (offset + 2U > in.Size)
+            return 0xA8;
+
+        if (in[offset] & 0x80)
+        {
+            blocks[i] = in[offset + 1];
+            offset += 2;
+        }
+        else
+        {
+            if (offset + 3U > in.Size)
+                return 0xA8;
+
+            blocks[i] = in[offset + 1] | (in[offset + 2] << 8);
+            offset += 3;
+        }
+
+        if (blocks[i] >= memoryBlocks)
+            return 0xA8; // Illegal block number
+    }
+
+    return 0x00;
+}
+
+uint8_t SimulatedFeliCaCard::ReadBlocks(const BinaryView& in, ByteBuffer& out)
+{
+    uint16_t blocks[FELICA_MAX_BLOCKS];
+    uint8_t count = 0;
+    uint16_t offset = 0;
+
+    uint8_t flag2 = ParseBlockList(in, ServiceCode, Memory.size() / FELICA_BLOCK_SIZE, MaxReadBlocks, blocks, count, offset);
+
+    out << (uint8_t)(flag2 ? 12 : 13 + count * FELICA_BLOCK_SIZE) << (uint8_t)(FELICA_CMD_READ_WITHOUT_ENCRYPTION + 1);
+    out.Append(IDm, sizeof(IDm));
+    out << (uint8_t)(flag2 ? 0x01 : 0x00) << flag2;
+
+    if (flag2)
+        return PN532Packets::PN532_STATUS_OK;
+
+    out << count;
+    for (uint8_t i = 0; i < count; ++i)
+        out.Append(Memory.data() + blocks[i] * FELICA_BLOCK_SIZE, FELICA_BLOCK_SIZE);
+
+    _processing += count * BlockMicros;
+
+    return PN532Packets::PN532_STATUS_OK;
+}
+
+uint8_t SimulatedFeliCaCard::WriteBlocks(const BinaryView& in, ByteBuffer& out)
+{
+    uint16_t blocks[FELICA_MAX_BLOCKS];
+    uint8_t count = 0;
+    uint16_t offset = 0;
+
+    uint8_t flag2 = ParseBlockList(in, ServiceCode, Memory.size() / FELICA_BLOCK_SIZE, MaxWriteBlocks, blocks, count, offset);
+
+    if (!flag2 && (ServiceCode & 0x02))
+        flag2 = 0xA8; // Read only service
+    if (!flag2 && offset + count * FELICA_BLOCK_SIZE != (uint16_t)in.Size)
+        flag2 = 0xA8;
+
+    if (!flag2)
+    {
+        for (uint8_t i = 0; i < count; ++i)
+            memcpy(Memory.data() + blocks[i] * FELICA_BLOCK_SIZE, in.Data + offset + i * FELICA_BLOCK_SIZE, FELICA_BLOCK_SIZE);
+
+        _processing += count * BlockMicros * 4;
+    }
+
+    out << (uint8_t)12 << (uint8_t)(FELICA_CMD_WRITE_WITHOUT_ENCRYPTION + 1);
+    out.Append(IDm, sizeof(IDm));
+    out << (uint8_t)(flag2 ? 0x01 : 0x00) << flag2;
+
+    return PN532Packets::PN532_STATUS_OK;
+}
+
+#endif
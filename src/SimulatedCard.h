@@ -0,0 +1,183 @@
+#ifndef __SIMULATEDCARD_H__
+#define __SIMULATEDCARD_H__
+
+#include <cstdint>
+#include "ByteBuffer.h"
+#include "CardIdentifier.h"
+#include "Desfire.h"
+#include "MifareClassic.h"
+#include "PN532Packets.h"
+#include "PN532Config.h"
+
+#if PN532_CONFIG_SIMULATOR
+
+// Virtual card placed in the field of PN532Simulator
+class SimulatedCard
+{
+public:
+    virtual ~SimulatedCard() {}
+
+    // Serializes target data (without Tg) as returned by InListPassiveTarget
+    virtual void TargetData(ByteBuffer& buf) const = 0;
+    // Only polls with matching baud rate and modulation find the card
+    virtual PN532Packets::BrTy_t Modulation() const
+    {
+        return PN532Packets::BRTY_106KBPS_TYPE_A;
+    }
+    // Handles frame sent by reader. Returns PN532 status byte
+    virtual uint8_t Exchange(const BinaryView& in, ByteBuffer& out) = 0;
+    // Card processing time of the last exchange
+    virtual uint32_t ProcessingMicros() const
+    {
+        return 0;
+    }
+    // ISO14443-4 parameters, false if card does not support the block protocol
+    virtual bool IsoDepParameters(ATSParameters& /* params */) const
+    {
+        return false;
+    }
+    // Called when card is activated or released
+    virtual void Reset() {}
+    // Initiator data of InListPassiveTarget selects this card
+    virtual bool Selected(const BinaryView& /* initiator */) const
+    {
+        return true;
+    }
+};
+
+class SimulatedTypeACard : public SimulatedCard
+{
+public:
+    SimulatedTypeACard(const BinaryData& uid, uint8_t atqa0, uint8_t atqa1, uint8_t sak, const BinaryData& ats = BinaryData());
+
+    void TargetData(ByteBuffer& buf) const;
+    uint8_t Exchange(const BinaryView& in, ByteBuffer& out);
+    // Decoded from ATS when SAK announces ISO14443-4
+    bool IsoDepParameters(ATSParameters& params) const;
+    // Initiator data is the UID of the card to activate, empty selects any
+    bool Selected(const BinaryView& initiator) const;
+
+    BinaryData UID;
+    uint8_t ATQA[2];
+    uint8_t SAK;
+    BinaryData ATS; // Without length byte
+};
+
+#if PN532_CONFIG_DESFIRE_EV2
+// Desfire with a single AES key, enough for authentication flows. Supports EV1
+// and EV2 authentication. GetCardUID, GetKeyVersion and ChangeKey are
+// emulated with EV2 secure messaging. A single standard data file in plain
+// communication mode is served by ReadData and ISO READ BINARY. Needs
+// PN532_CONFIG_DESFIRE_EV2.
+class SimulatedDesfireCard : public SimulatedTypeACard
+{
+public:
+    SimulatedDesfireCard(const BinaryData& uid, const DesfireKey& key);
+
+    uint8_t Exchange(const BinaryView& in, ByteBuffer& out);
+    uint32_t ProcessingMicros() const;
+    void Reset();
+
+    DesfireKey Key;
+    BinaryData File;        // Contents of the data file, any file number reads it
+    uint32_t CommandMicros; // Card processing time per command
+    uint8_t HardwareMajor;  // Reported by GetVersion: 0x01 EV1, 0x12 EV2, 0x33 EV3
+
+private:
+    void ExchangeEV2(uint8_t ins, const BinaryView& data, ByteBuffer& out);
+    void ReadFrame(ByteBuffer& out);
+    void ReadBinary(const BinaryView& in, ByteBuffer& out);
+
+    BinaryData _RndB;
+    BinaryData _IV;
+    uint8_t _authIns;       // Authentication waiting for additional frame
+    uint32_t _readOffset;   // ReadData waiting for additional frames
+    uint32_t _readEnd;
+    DesfireEV2Session _ev2;
+};
+#endif
+
+// NTAG21x with password protected writes. Unsupported commands and out of
+// range pages are answered with NAK (timeout status on PN532), after which
+// the card ignores everything until it is activated again.
+class SimulatedNtagCard : public SimulatedTypeACard
+{
+public:
+    // Storage size as reported by GET_VERSION: 0x0F NTAG213, 0x11 NTAG215, 0x13 NTAG216.
+    // 0 emulates plain Ultralight (16 pages, no GET_VERSION, FAST_READ or READ_SIG)
+    SimulatedNtagCard(const BinaryData& uid, uint8_t storageSize = 0x11);
+
+    uint8_t Exchange(const BinaryView& in, ByteBuffer& out);
+    uint32_t ProcessingMicros() const;
+    void Reset();
+
+    BinaryData Memory;      // All pages
+    BinaryData Signature;
+    uint8_t Password[4];
+    uint8_t PACK[2];
+    uint8_t Auth0;          // First page protected by password
+    uint32_t ReadMicros;    // Card processing time of a read command
+
+private:
+    uint8_t _storageSize;
+    uint32_t _processing;
+    bool _authenticated;
+    bool _halted;
+};
+
+#if PN532_CONFIG_MIFARE_CLASSIC
+// Mifare Classic with keys taken from sector trailers. Access bits are not
+// evaluated, both keys grant read and write. Failed commands halt the card.
+class SimulatedClassicCard : public SimulatedTypeACard
+{
+public:
+    SimulatedClassicCard(const BinaryData& uid, CardType_t type = CARD_TYPE_MIFARE_CLASSIC_1K);
+
+    uint8_t Exchange(const BinaryView& in, ByteBuffer& out);
+    uint32_t ProcessingMicros() const;
+    void Reset();
+
+    BinaryData Memory;      // All blocks, trailers hold key A (bytes 0-5) and key B (10-15)
+    uint32_t AuthMicros;    // Three pass authentication time
+
+private:
+    uint8_t _lastBlock;
+    int16_t _authSector;
+    bool _halted;
+    uint32_t _processing;
+};
+#endif
+
+// FeliCa card with a single system and a single service without encryption.
+// System code is always reported in polling response.
+class SimulatedFeliCaCard : public SimulatedCard
+{
+public:
+    SimulatedFeliCaCard(const BinaryData& idm, uint16_t systemCode = 0x0003, uint16_t serviceCode = 0x0009, uint16_t blocks = 32);
+
+    void TargetData(ByteBuffer& buf) const;
+    PN532Packets::BrTy_t Modulation() const;
+    uint8_t Exchange(const BinaryView& in, ByteBuffer& out);
+    uint32_t ProcessingMicros() const;
+
+    uint8_t IDm[8];
+    uint8_t PMm[8];
+    uint16_t SystemCode;
+    uint16_t ServiceCode;       // Service attribute 0x0B (bit 1 set) makes it read only
+    BinaryData Memory;          // 16 bytes per block
+    uint8_t MaxReadBlocks;      // Blocks accepted per read command
+    uint8_t MaxWriteBlocks;     // Blocks accepted per write command
+    bool HighSpeed;             // Answers 424 kbps instead of 212 kbps polling
+    uint32_t CommandMicros;     // Card processing time per command
+    uint32_t BlockMicros;       // Additional time per block, writes take 4 times as long
+
+private:
+    uint8_t ReadBlocks(const BinaryView& in, ByteBuffer& out);
+    uint8_t WriteBlocks(const BinaryView& in, ByteBuffer& out);
+
+    uint32_t _processing;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,133 @@
+#include "TagInterface.h"
+#include "PN532Extended.h"
+#include "IsoDep.h"
+
+TagInterface::TagInterface(PN532Extended& reader, uint8_t tg) : _reader(&reader), _tg(tg)
+{
+#if PN532_CONFIG_ISO_DEP
+    _isoDep = nullptr;
+#endif
+}
+
+#if PN532_CONFIG_ISO_DEP
+TagInterface::TagInterface(IsoDep& isoDep) : _reader(nullptr), _tg(0), _isoDep(&isoDep)
+{
+
+}
+#endif
+
+#if PN532_CONFIG_TAG_ADAPTER
+TagInterface::TagInterface(const TagWriteInterface_t& wif, const TagReadInterface_t& rif) : _reader(nullptr), _tg(0), _write(wif), _read(rif)
+{
+#if PN532_CONFIG_ISO_DEP
+    _isoDep = nullptr;
+#endif
+}
+#endif
+
+ByteBuffer& TagInterface::BeginWrite()
+{
+#if PN532_CONFIG_ISO_DEP
+    if (_isoDep)
+        return _isoDep->BeginWrite();
+#endif
+
+#if PN532_CONFIG_TAG_ADAPTER
+    if (!_reader)
+    {
+        _txBuffer.Clear();
+        return _txBuffer;
+    }
+#endif
+
+    // Build data exchange packet
+    ByteBuffer& buf = _reader->BeginCommand(COMMAND_INDATAEXCHANGE);
+    buf << _tg; // Target id
+
+    return buf;
+}
+
+Result TagInterface::EndWrite()
+{
+#if PN532_CONFIG_ISO_DEP
+    if (_isoDep)
+        return _isoDep->EndWrite();
+#endif
+
+#if PN532_CONFIG_TAG_ADAPTER
+    if (!_reader)
+        return _write(_txBuffer.Data());
+#endif
+
+    return _reader->WriteCommand();
+}
+
+Result TagInterface::Write(const BinaryData& packet)
+{
+#if PN532_CONFIG_ISO_DEP
+    if (_isoDep)
+    {
+        _isoDep->BeginWrite() << packet;
+        return _isoDep->EndWrite();
+    }
+#endif
+
+#if PN532_CONFIG_TAG_ADAPTER
+    if (!_reader)
+        return _write(packet);
+#endif
+
+    BeginWrite() << packet;
+
+    return EndWrite();
+}
+
+Result TagInterface::Read(BinaryView& payload)
+{
+#if PN532_CONFIG_ISO_DEP
+    if (_isoDep)
+        return _isoDep->Read(payload);
+#endif
+
+#if PN532_CONFIG_TAG_ADAPTER
+    if (!_reader)
+    {
+        Result result = _read(_rxBuffer);
+        payload = BinaryView(_rxBuffer);
+        return result;
+    }
+#endif
+
+    Result result = _reader->ReadResponse();
+    if (!result)
+        return result;
+
+    const BinaryData& response = _reader->Response().Data();
+    if (response.empty())
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    // Skip InDataExchange status byte
+    payload = BinaryView(response).Sub(1);
+
+    return Result::PN532(response[0]);
+}
+
+Result TagInterface::Reactivate(const BinaryData& uid)
+{
+    if (!_reader)
+        return Result::Library(RESULT_ERROR_UNSUPPORTED);
+
+    // UID as initiator data selects only this card
+    InListPassiveTargetResponse resp;
+    Result result = _reader->InListPassiveTarget(resp, 1, BRTY_106KBPS_TYPE_A, uid);
+    if (!result)
+        return result;
+
+    // Card has left the field
+    if (!resp.NbTg || resp.TgData.empty())
+        return Result::PN532(PN532_STATUS_TIMEOUT);
+
+    _tg = resp.TgData[0];
+
+    return Result();
+}
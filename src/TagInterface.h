@@ -2,19 +2,69 @@
 #define __TAGINTERFACE_H__
 
 #include "ByteBuffer.h"
-#include <functional>
+#include "Result.h"
+#include "PN532Config.h"
 #include <cstdint>
 
-typedef std::function<int16_t(const BinaryData& packet)> TagWriteInterface_t;
-typedef std::function<int16_t(BinaryData& packet)> TagReadInterface_t;
+#if PN532_CONFIG_TAG_ADAPTER
+#include <functional>
+
+typedef std::function<Result(const BinaryData& packet)> TagWriteInterface_t;
+typedef std::function<Result(BinaryData& packet)> TagReadInterface_t;
+#endif
+
+class PN532Extended;
+class IsoDep;
 
+// Transport used by card drivers to exchange frames with a single target.
+// Bound directly to a PN532Extended reader and target number, or to an
+// IsoDep session for ISO14443-4 targets. Custom transports can be plugged in
+// with the std::function adapter constructor.
 class TagInterface
 {
 public:
-    TagInterface(const TagWriteInterface_t& wif, const TagReadInterface_t rif) : Write(wif), Read(rif) { }
+    // Exchanges data with target tg using InDataExchange
+    TagInterface(PN532Extended& reader, uint8_t tg);
+#if PN532_CONFIG_ISO_DEP
+    // Exchanges data with the activated target using InCommunicateThru and
+    // host side ISO14443-4 block handling
+    TagInterface(IsoDep& isoDep);
+#endif
+#if PN532_CONFIG_TAG_ADAPTER
+    // Adapter for user supplied transport
+    TagInterface(const TagWriteInterface_t& wif, const TagReadInterface_t& rif);
+#endif
+
+    Result Write(const BinaryData& packet);
+    // Starts building a frame directly in transmit buffer of the reader
+    ByteBuffer& BeginWrite();
+    // Sends frame built with BeginWrite
+    Result EndWrite();
+    // Returns view of the received payload (without PN532 status byte).
+    // View is valid until the next Write or Read.
+    Result Read(BinaryView& payload);
+    // Activates Type A target with given UID again, i.e. after a NAK has sent
+    // it back to idle state. Other targets of the reader are deselected and
+    // Tg is updated. Only supported for interfaces bound to a reader.
+    Result Reactivate(const BinaryData& uid);
+
+    uint8_t Tg() const
+    {
+        return _tg;
+    }
 
-    TagWriteInterface_t Write;
-    TagReadInterface_t Read;
+private:
+    PN532Extended* _reader;
+    uint8_t _tg;
+#if PN532_CONFIG_ISO_DEP
+    IsoDep* _isoDep;
+#endif
+#if PN532_CONFIG_TAG_ADAPTER
+    TagWriteInterface_t _write;
+    TagReadInterface_t _read;
+    ByteBuffer _txBuffer; // Adapter transmit buffer
+    BinaryData _rxBuffer; // Adapter receive buffer
+#endif
 };
 
 #endif
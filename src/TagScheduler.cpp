@@ -0,0 +1,113 @@
+#include "TagScheduler.h"
+
+TagScheduler::TagScheduler() : _count(0), _next(0)
+{
+
+}
+
+bool TagScheduler::Add(TagInterface& tag, TagJob& job)
+{
+    if (_count >= TAG_SCHEDULER_MAX_JOBS)
+        return false;
+
+    _slots[_count].Tag = &tag;
+    _slots[_count].Job = &job;
+    _slots[_count].State = SLOT_IDLE;
+    _count++;
+
+    return true;
+}
+
+void TagScheduler::Clear()
+{
+    _count = 0;
+    _next = 0;
+}
+
+int8_t TagScheduler::Prepare()
+{
+    for (uint8_t n = 0; n < _count; ++n)
+    {
+        uint8_t i = (_next + n) % _count;
+        Slot& slot = _slots[i];
+
+        if (slot.State != SLOT_IDLE)
+            continue;
+
+        // All targets share the transmit buffer of the reader
+        if (!slot.Job->NextCommand(slot.Tag->BeginWrite()))
+        {
+            slot.State = SLOT_DONE;
+            continue;
+        }
+
+        slot.State = SLOT_PREPARED;
+        _next = (i + 1) % _count;
+
+        return i;
+    }
+
+    return -1;
+}
+
+bool TagScheduler::Send(int8_t i)
+{
+    Slot& slot = _slots[i];
+
+    Result result = slot.Tag->EndWrite();
+    if (!result)
+    {
+        slot.State = SLOT_IDLE;
+        slot.Job->HandleResponse(result, BinaryView());
+        return false;
+    }
+
+    slot.State = SLOT_INFLIGHT;
+
+    return true;
+}
+
+void TagScheduler::Run()
+{
+    int8_t inflight = -1;
+    int8_t prepared = -1;
+
+    while (true)
+    {
+        // Transmit buffer is free once the previous command is sent
+        if (prepared < 0)
+            prepared = Prepare();
+
+        if (inflight < 0)
+        {
+            // Nothing left to do
+            if (prepared < 0)
+                break;
+
+            if (Send(prepared))
+                inflight = prepared;
+
+            prepared = -1;
+            continue;
+        }
+
+        // Wait for the response of the target in RF exchange
+        BinaryView response;
+        Result result = _slots[inflight].Tag->Read(response);
+        int8_t received = inflight;
+        inflight = -1;
+
+        // Keep RF busy with the other target while the response is processed.
+        // Receive buffer is not touched until the next Read.
+        if (prepared >= 0)
+        {
+            if (Send(prepared))
+                inflight = prepared;
+
+            prepared = -1;
+        }
+
+        _slots[received].State = SLOT_IDLE;
+        _slots[received].Job->HandleResponse(result, response);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef __TAGSCHEDULER_H__
+#define __TAGSCHEDULER_H__
+
+#include <cstdint>
+#include "ByteBuffer.h"
+#include "Result.h"
+#include "TagInterface.h"
+
+// PN532 can activate at most 2 targets at once
+#define TAG_SCHEDULER_MAX_JOBS 2
+
+// Card operation split into command/response steps, so it can be interleaved with other targets
+class TagJob
+{
+public:
+    virtual ~TagJob() {}
+
+    // Serializes next command into buf. Returns false when job is finished
+    virtual bool NextCommand(ByteBuffer& buf) = 0;
+    // Handles response of the last command. Response view is only valid during this call
+    virtual void HandleResponse(const Result& result, const BinaryView& response) = 0;
+};
+
+// Runs jobs of multiple targets on a single reader. While PN532 exchanges a
+// frame with one target over RF, host processes the response of the other one.
+class TagScheduler
+{
+public:
+    TagScheduler();
+
+    bool Add(TagInterface& tag, TagJob& job);
+    // Runs all jobs until they are finished
+    void Run();
+    void Clear();
+
+private:
+    enum SlotState_t : uint8_t
+    {
+        SLOT_IDLE,      // Waiting for next command to be built
+        SLOT_PREPARED,  // Command is built in transmit buffer
+        SLOT_INFLIGHT,  // Command is sent, waiting for response
+        SLOT_DONE
+    };
+
+    struct Slot
+    {
+        TagInterface* Tag;
+        TagJob* Job;
+        SlotState_t State;
+    };
+
+    // Builds command of an idle slot. Returns slot index or -1
+    int8_t Prepare();
+    // Sends prepared command. Returns false if sending failed
+    bool Send(int8_t slot);
+
+    Slot _slots[TAG_SCHEDULER_MAX_JOBS];
+    uint8_t _count;
+    uint8_t _next; // Round robin start for Prepare
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "TapCache.h"
+#include <cstring>
+#include "Utils.h"
+
+TapCache::TapCache(uint32_t windowMillis) : WindowMillis(windowMillis)
+{
+    Clear();
+}
+
+void TapCache::Clear()
+{
+    for (uint16_t i = 0; i < TAP_CACHE_SIZE; ++i)
+        _entries[i] = Entry();
+
+    _hits = 0;
+}
+
+uint32_t TapCache::Hash(const TapEvent& event)
+{
+    uint32_t hash = Fnv1a(&event.Reader, 1);
+
+    return Fnv1a(event.UID, event.UIDLength, hash);
+}
+
+bool TapCache::Matches(const Entry& entry, const TapEvent& event)
+{
+    return entry.UIDLength == event.UIDLength && entry.Reader == event.Reader &&
+        !memcmp(entry.UID, event.UID, event.UIDLength);
+}
+
+bool TapCache::Lookup(TapEvent& event, uint32_t now)
+{
+    if (!WindowMillis || !event.UIDLength)
+        return false;
+
+    // Entries are never removed, so an unused slot ends the chain
+    Entry* found = ProbeSlots(_entries, Hash(event), TAP_CACHE_MAX_PROBE, [&](const Entry& entry) {
+        return !entry.UIDLength || Matches(entry, event);
+    });
+
+    if (!found || !found->UIDLength || (int32_t)(found->Expires - now) <= 0)
+        return false;
+
+    event.CardType = found->CardType;
+    event.Status = found->Status;
+    found->Expires = now + WindowMillis;
+    _hits++;
+
+    return true;
+}
+
+void TapCache::Store(const TapEvent& event, uint32_t now)
+{
+    if (!WindowMillis || !event.UIDLength)
+        return;
+
+    if (event.Status.Origin == RESULT_ORIGIN_TRANSPORT || event.Status.Origin == RESULT_ORIGIN_PN532)
+        return;
+
+    Entry* evict = nullptr;
+
+    Entry* target = ProbeSlots(_entries, Hash(event), TAP_CACHE_MAX_PROBE, [&](Entry& entry) {
+        if (!entry.UIDLength || Matches(entry, event))
+            return true;
+
+        // Reuse expired slot, otherwise evict the one expiring first
+        if (!evict || (int32_t)(entry.Expires - evict->Expires) < 0)
+            evict = &entry;
+
+        return false;
+    });
+
+    if (!target)
+        target = evict;
+
+    target->Expires = now + WindowMillis;
+    target->Reader = event.Reader;
+    target->UIDLength = event.UIDLength;
+    memcpy(target->UID, event.UID, event.UIDLength);
+    target->CardType = event.CardType;
+    target->Status = event.Status;
+}
@@ -0,0 +1,55 @@
+#ifndef __TAPCACHE_H__
+#define __TAPCACHE_H__
+
+#include <cstdint>
+#include "TapEvent.h"
+
+// Number of slots, must be a power of two
+#define TAP_CACHE_SIZE 64
+// Slots searched from the home slot. Bounds lookup cost when table is crowded
+#define TAP_CACHE_MAX_PROBE 8
+
+// Recently seen cards and outcome of their last tap, keyed by reader and UID.
+// Fixed size open addressing table with linear probing, no allocation.
+// A card resting on the reader is re-detected by every poll, lookup lets
+// the caller answer it from cache instead of running the card job again.
+// Not thread safe.
+class TapCache
+{
+public:
+    TapCache(uint32_t windowMillis = 0);
+
+    // On hit copies card type and status into event, extends expiry and returns true
+    bool Lookup(TapEvent& event, uint32_t now);
+    // Stores outcome of a completed tap. Evicts the entry expiring first if probe range is full.
+    // Taps which failed on the link or RF layer are not stored, so the next detection retries.
+    void Store(const TapEvent& event, uint32_t now);
+    void Clear();
+
+    uint32_t Hits() const
+    {
+        return _hits;
+    }
+
+    // Entry lifetime since the card was last seen. 0 disables the cache
+    uint32_t WindowMillis;
+
+private:
+    struct Entry
+    {
+        uint32_t Expires;   // PlatformMillis()
+        uint8_t Reader;
+        uint8_t UIDLength;  // 0 - slot never used
+        uint8_t UID[TAP_EVENT_MAX_UID];
+        CardType_t CardType;
+        Result Status;
+    };
+
+    static uint32_t Hash(const TapEvent& event);
+    static bool Matches(const Entry& entry, const TapEvent& event);
+
+    Entry _entries[TAP_CACHE_SIZE];
+    uint32_t _hits;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "TapEvent.h"
+#include "Platform.h"
+#include <cstring>
+
+void InitTapEvent(TapEvent& event, uint8_t reader, const TargetDataTypeA& target)
+{
+    event = TapEvent();
+    event.Reader = reader;
+    event.UIDLength = target.UID.size() > TAP_EVENT_MAX_UID ? TAP_EVENT_MAX_UID : target.UID.size();
+    memcpy(event.UID, target.UID.data(), event.UIDLength);
+    event.CardType = PN532Extended::IdentifyTypeACard(target);
+    event.Timestamp = PlatformMillis();
+}
+
+ByteBuffer& operator<<(ByteBuffer& a, const TapEvent& b)
+{
+    a << b.Reader;
+    a << b.UIDLength;
+    a.Append(b.UID, TAP_EVENT_MAX_UID);
+    a << (uint8_t)(b.CardType < CARD_TYPE_MAX ? b.CardType : TAP_EVENT_CARD_UNKNOWN);
+    a << (uint8_t)b.Status.Origin;
+    a << b.Status.Code;
+    a << b.Timestamp;
+    a << b.DurationMicros;
+
+    return a;
+}
+
+ByteBuffer& operator>>(ByteBuffer& a, TapEvent& b)
+{
+    uint8_t cardType, origin;
+
+    a >> b.Reader;
+    a >> b.UIDLength;
+    for (uint8_t i = 0; i < TAP_EVENT_MAX_UID; ++i)
+        a >> b.UID[i];
+    a >> cardType;
+    a >> origin;
+    // Types newer than this build are reported as unknown as well
+    b.CardType = cardType < CARD_TYPE_MAX ? (CardType_t)cardType : CARD_TYPE_MAX;
+    b.Status.Origin = (ResultOrigin_t)origin;
+    a >> b.Status.Code;
+    a >> b.Timestamp;
+    a >> b.DurationMicros;
+
+    if (b.UIDLength > TAP_EVENT_MAX_UID)
+        b.UIDLength = TAP_EVENT_MAX_UID;
+
+    return a;
+}
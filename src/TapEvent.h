@@ -0,0 +1,49 @@
+#ifndef __TAPEVENT_H__
+#define __TAPEVENT_H__
+
+#include <cstdint>
+#include "ByteBuffer.h"
+#include "PN532Extended.h"
+#include "TagScheduler.h"
+#include "Result.h"
+
+#define TAP_EVENT_MAX_UID 10
+// Serialized size: Reader, UIDLength, UID, CardType, Status (origin, code), Timestamp, DurationMicros
+#define TAP_EVENT_WIRE_SIZE 24
+// Wire value of an unknown card type (CARD_TYPE_MAX). Fixed, so that new card
+// types can be added without changing the meaning of existing values
+#define TAP_EVENT_CARD_UNKNOWN 0xFF
+
+// Completed card tap. Trivially copyable, so it can be passed through lock-free queues
+struct TapEvent
+{
+    uint8_t Reader;
+    uint8_t UIDLength;
+    uint8_t UID[TAP_EVENT_MAX_UID];
+    CardType_t CardType;
+    Result Status;              // Result of the job (OK if no job was run)
+    uint32_t Timestamp;         // PlatformMillis() when card was activated
+    uint32_t DurationMicros;    // Poll start to release
+};
+
+// Application logic run for every tap
+class TapHandler
+{
+public:
+    virtual ~TapHandler() {}
+
+    // Creates job for an activated card or returns nullptr to only report the tap.
+    // Tag stays valid until FinishJob.
+    virtual TagJob* CreateJob(uint8_t reader, TagInterface& tag, const TargetDataTypeA& target) = 0;
+    // Called after the job has finished. Returns status of the tap
+    virtual Result FinishJob(uint8_t reader, TagJob* job) = 0;
+};
+
+// Fills reader, UID, card type and timestamp from activated target
+void InitTapEvent(TapEvent& event, uint8_t reader, const TargetDataTypeA& target);
+
+// Fixed size little endian wire format for consumers in other processes
+ByteBuffer& operator<<(ByteBuffer& a, const TapEvent& b);
+ByteBuffer& operator>>(ByteBuffer& a, TapEvent& b);
+
+#endif
@@ -0,0 +1,81 @@
+#include "TypeB.h"
+
+#if PN532_CONFIG_TYPE_B
+
+#include <cstring>
+#include "Utils.h"
+
+using namespace PN532Packets;
+
+TypeB::TypeB(TagInterface& interface) : _interface(interface)
+{
+    memset(&_params, 0, sizeof(_params));
+}
+
+Result TypeB::Parse(const TargetDataTypeB& target, TypeBParameters& params)
+{
+    const uint8_t* atqb = target.ATQB;
+
+    if (atqb[0] != TYPEB_ATQB_CODE)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    memcpy(params.PUPI, atqb + 1, TYPEB_PUPI_SIZE);
+    memcpy(params.ApplicationData, atqb + 5, TYPEB_APPLICATION_DATA_SIZE);
+
+    params.BitRates = atqb[9];
+
+    // FSCI (ISO14443-3 7.9.4.2)
+    params.MaxFrameSize = FrameSizeFromIndex(atqb[10] >> 4);
+    params.ISO14443_4 = atqb[10] & 0x01;
+
+    // FWT = 256 * 16 / fc * 2^FWI, FWI 15 is reserved and means 4
+    params.FWI = atqb[11] >> 4;
+    if (params.FWI == 15)
+        params.FWI = 4;
+    params.FrameWaitMicros = (uint32_t)((4096ULL << params.FWI) * 1000000 / 13560000);
+
+    params.ADC = (atqb[11] >> 2) & 0x03;
+    params.NAD = atqb[11] & 0x02;
+    params.CID = atqb[11] & 0x01;
+
+    params.MBLI = 0;
+    params.AssignedCID = 0;
+    if (!target.ATTRIB_RES.empty())
+    {
+        params.MBLI = target.ATTRIB_RES[0] >> 4;
+        params.AssignedCID = target.ATTRIB_RES[0] & 0x0F;
+    }
+
+    return Result();
+}
+
+Result TypeB::Begin(const TargetDataTypeB& target)
+{
+    return Parse(target, _params);
+}
+
+Result TypeB::Transceive(const BinaryData& capdu, BinaryData& response)
+{
+    if (!_params.ISO14443_4)
+        return Result::Library(RESULT_ERROR_UNSUPPORTED);
+
+    _interface.BeginWrite().Append(capdu.data(), capdu.size());
+
+    Result result = _interface.EndWrite();
+    if (!result)
+        return result;
+
+    BinaryView payload;
+    result = _interface.Read(payload);
+    if (!result)
+        return result;
+
+    if (payload.Size < 2)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    response.assign(payload.begin(), payload.end() - 2);
+
+    return Result::ISO7816(payload[payload.Size - 2], payload[payload.Size - 1]);
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __TYPEB_H__
+#define __TYPEB_H__
+
+#include "TagInterface.h"
+#include "PN532Packets.h"
+#include "Result.h"
+#include "PN532Config.h"
+
+#define TYPEB_ATQB_CODE 0x50
+#define TYPEB_PUPI_SIZE 4
+#define TYPEB_APPLICATION_DATA_SIZE 4
+
+// ATQB and ATTRIB parameters of an ISO14443-3 Type B target
+struct TypeBParameters
+{
+    uint8_t PUPI[TYPEB_PUPI_SIZE];      // Pseudo-unique PICC identifier
+    uint8_t ApplicationData[TYPEB_APPLICATION_DATA_SIZE];
+    uint8_t BitRates;                   // Bit rate capability (first protocol info byte)
+    uint16_t MaxFrameSize;              // Maximum frame size accepted by card (from FSCI)
+    bool ISO14443_4;                    // Card is compliant with ISO14443-4
+    uint8_t FWI;                        // Frame waiting time integer
+    uint32_t FrameWaitMicros;           // Frame waiting time derived from FWI
+    uint8_t ADC;                        // Application data coding
+    bool NAD;                           // Card supports NAD
+    bool CID;                           // Card supports CID
+    uint8_t MBLI;                       // Maximum buffer length index from ATTRIB response
+    uint8_t AssignedCID;                // CID from ATTRIB response
+};
+
+#if PN532_CONFIG_TYPE_B
+
+// Minimal ISO14443 Type B driver. PN532 handles ATTRIB and ISO14443-4 block
+// framing, the driver decodes activation parameters and exchanges APDUs.
+class TypeB
+{
+public:
+    TypeB(TagInterface& interface);
+
+    // Decodes ATQB and ATTRIB response of target returned by InListPassiveTarget
+    static Result Parse(const PN532Packets::TargetDataTypeB& target, TypeBParameters& params);
+
+    Result Begin(const PN532Packets::TargetDataTypeB& target);
+
+    // Exchanges ISO7816-4 APDU. Status word is removed from response and
+    // returned as result.
+    Result Transceive(const BinaryData& capdu, BinaryData& response);
+
+    const TypeBParameters& Parameters() const
+    {
+        return _params;
+    }
+
+private:
+    TagInterface& _interface;
+    TypeBParameters _params;
+};
+
+#endif
+
+#endif
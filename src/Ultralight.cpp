@@ -0,0 +1,321 @@
+#include "Ultralight.h"
+
+// GET_VERSION parsing is shared with CardIdentifier, so it is built without the driver
+
+ByteBuffer& operator>>(ByteBuffer& a, UltralightVersion& b)
+{
+    a >> b.Header;
+    a >> b.Vendor;
+    a >> b.ProductType;
+    a >> b.ProductSubtype;
+    a >> b.MajorVersion;
+    a >> b.MinorVersion;
+    a >> b.StorageSize;
+    a >> b.Protocol;
+
+    return a;
+}
+
+bool ParseUltralightVersion(const BinaryView& response, UltralightVersion& version)
+{
+    if (response.Size != sizeof(UltralightVersion))
+        return false;
+
+    ByteBuffer buf(BinaryData(response.begin(), response.end()));
+    buf >> version;
+
+    return true;
+}
+
+Result GetUltralightVersion(TagInterface& tag, const BinaryData& uid, UltralightVersion& version, bool& supported)
+{
+    tag.BeginWrite() << UL_CMD_GET_VERSION;
+
+    BinaryView response;
+    Result result = tag.EndWrite();
+    if (result)
+        result = tag.Read(response);
+
+    supported = result && ParseUltralightVersion(response, version);
+    if (supported)
+        return Result();
+
+    // Only transport errors are fatal, plain Ultralight just does not answer
+    if (!result && result.Origin == RESULT_ORIGIN_TRANSPORT)
+        return result;
+
+    // NAK has sent the card back to idle state
+    return tag.Reactivate(uid);
+}
+
+#if PN532_CONFIG_ULTRALIGHT
+
+// Memory layout per type: total pages and user pages
+struct UltralightLayout
+{
+    UltralightType_t Type;
+    uint8_t ProductType;
+    uint8_t StorageSize;
+    uint16_t Pages;
+    uint16_t UserPages;
+};
+
+static const UltralightLayout layouts[] = {
+    { ULTRALIGHT_TYPE_EV1_MF0UL11,  0x03, 0x0B,  20,  12 },
+    { ULTRALIGHT_TYPE_EV1_MF0UL21,  0x03, 0x0E,  41,  32 },
+    { ULTRALIGHT_TYPE_NTAG213,      0x04, 0x0F,  45,  36 },
+    { ULTRALIGHT_TYPE_NTAG215,      0x04, 0x11, 135, 126 },
+    { ULTRALIGHT_TYPE_NTAG216,      0x04, 0x13, 231, 222 }
+};
+
+Ultralight::Ultralight(TagInterface& interface) : _interface(interface), _type(ULTRALIGHT_TYPE_UNKNOWN), _pages(0), _userPages(0)
+{
+
+}
+
+Result Ultralight::Exchange(BinaryView& response, uint16_t expected)
+{
+    Result result = _interface.EndWrite();
+    if (!result)
+        return result;
+
+    result = _interface.Read(response);
+    if (!result)
+        return result;
+
+    // Card answers NAK (4 bits) on errors, which is not a valid response
+    if (response.Size != expected)
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    return Result();
+}
+
+Result Ultralight::GetVersion(UltralightVersion& version)
+{
+    _interface.BeginWrite() << UL_CMD_GET_VERSION;
+
+    BinaryView response;
+    Result result = Exchange(response, sizeof(UltralightVersion));
+    if (!result)
+        return result;
+
+    if (!ParseUltralightVersion(response, version))
+        return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+    return Result();
+}
+
+Result Ultralight::Identify()
+{
+    BinaryData page;
+    Result result = Read(0, page);
+    if (!result)
+        return result;
+
+    // UID0-2, BCC0, UID3-6
+    BinaryData uid = { page[0], page[1], page[2], page[4], page[5], page[6], page[7] };
+
+    return Identify(uid);
+}
+
+Result Ultralight::Identify(const BinaryData& uid)
+{
+    UltralightVersion version;
+    bool supported;
+    Result result = GetUltralightVersion(_interface, uid, version, supported);
+    if (!result)
+        return result;
+
+    if (!supported)
+    {
+        _type = ULTRALIGHT_TYPE_ULTRALIGHT;
+        _pages = 16;
+        _userPages = 12;
+        return Result();
+    }
+
+    for (const UltralightLayout& layout : layouts)
+    {
+        if (layout.ProductType == version.ProductType && layout.StorageSize == version.StorageSize)
+        {
+            _type = layout.Type;
+            _pages = layout.Pages;
+            _userPages = layout.UserPages;
+            return Result();
+        }
+    }
+
+    _type = ULTRALIGHT_TYPE_UNKNOWN;
+    return Result::Library(RESULT_ERROR_UNSUPPORTED);
+}
+
+Result Ultralight::Read(uint8_t page, BinaryData& out)
+{
+    _interface.BeginWrite() << UL_CMD_READ << page;
+
+    BinaryView response;
+    Result result = Exchange(response, ULTRALIGHT_READ_PAGES * ULTRALIGHT_PAGE_SIZE);
+    if (!result)
+        return result;
+
+    out.insert(out.end(), response.begin(), response.end());
+
+    return Result();
+}
+
+Result Ultralight::FastRead(uint8_t start, uint8_t end, BinaryData& out)
+{
+    if (end < start)
+        return Result::Library(RESULT_ERROR_INVALID_ARGUMENT);
+
+    out.reserve(out.size() + (end - start + 1) * ULTRALIGHT_PAGE_SIZE);
+
+    for (uint16_t page = start; page <= end; page += ULTRALIGHT_FAST_READ_MAX_PAGES)
+    {
+        uint16_t last = page + ULTRALIGHT_FAST_READ_MAX_PAGES - 1;
+        if (last > end)
+            last = end;
+
+        _interface.BeginWrite() << UL_CMD_FAST_READ << (uint8_t)page << (uint8_t)last;
+
+        BinaryView response;
+        Result result = Exchange(response, (last - page + 1) * ULTRALIGHT_PAGE_SIZE);
+        if (!result)
+            return result;
+
+        out.insert(out.end(), response.begin(), response.end());
+    }
+
+    return Result();
+}
+
+Result Ultralight::ReadUserMemory(BinaryData& out)
+{
+    if (!_userPages)
+    {
+        Result result = Identify();
+        if (!result)
+            return result;
+    }
+
+    // Plain Ultralight has no FAST_READ
+    if (_type == ULTRALIGHT_TYPE_ULTRALIGHT)
+    {
+        for (uint16_t page = ULTRALIGHT_USER_PAGE; page < ULTRALIGHT_USER_PAGE + _userPages; page += ULTRALIGHT_READ_PAGES)
+        {
+            Result result = Read(page, out);
+            if (!result)
+                return result;
+        }
+
+        return Result();
+    }
+
+    return FastRead(ULTRALIGHT_USER_PAGE, ULTRALIGHT_USER_PAGE + _userPages - 1, out);
+}
+
+#if PN532_CONFIG_NDEF
+Result Ultralight::ReadNdef(const NdefRecordHandler_t& handler)
+{
+    if (!_userPages)
+    {
+        Result result = Identify();
+        if (!result)
+            return result;
+    }
+
+    // Reserved once, so record views stay valid while data grows
+    BinaryData data;
+    data.reserve(_userPages * ULTRALIGHT_PAGE_SIZE + ULTRALIGHT_READ_PAGES * ULTRALIGHT_PAGE_SIZE);
+
+    NdefParser parser(NDEF_CONTAINER_TLV);
+    uint16_t page = ULTRALIGHT_USER_PAGE;
+    uint16_t end = ULTRALIGHT_USER_PAGE + _userPages;
+
+    while (true)
+    {
+        NdefRecord record;
+        NdefStatus_t status;
+
+        while ((status = parser.Next(record)) == NDEF_OK)
+        {
+            if (!handler(record))
+                return Result();
+        }
+
+        if (status == NDEF_END)
+            return Result();
+
+        if (status == NDEF_INVALID || page >= end)
+            return Result::Library(RESULT_ERROR_INVALID_RESPONSE);
+
+        // Read what the parser is missing, at least as much as a READ returns
+        uint16_t pages = (parser.Missing() + ULTRALIGHT_PAGE_SIZE - 1) / ULTRALIGHT_PAGE_SIZE;
+        if (pages < ULTRALIGHT_READ_PAGES)
+            pages = ULTRALIGHT_READ_PAGES;
+        if (pages > ULTRALIGHT_FAST_READ_MAX_PAGES)
+            pages = ULTRALIGHT_FAST_READ_MAX_PAGES;
+        if (page + pages > end)
+            pages = end - page;
+
+        Result result;
+        if (_type == ULTRALIGHT_TYPE_ULTRALIGHT)
+        {
+            result = Read(page, data);
+            pages = ULTRALIGHT_READ_PAGES;
+        }
+        else
+            result = FastRead(page, page + pages - 1, data);
+
+        if (!result)
+            return result;
+
+        page += pages;
+        parser.Update(BinaryView(data));
+    }
+}
+#endif
+
+Result Ultralight::Write(uint8_t page, const uint8_t data[ULTRALIGHT_PAGE_SIZE])
+{
+    ByteBuffer& buf = _interface.BeginWrite();
+    buf << UL_CMD_WRITE << page;
+    buf.Append(data, ULTRALIGHT_PAGE_SIZE);
+
+    // PN532 consumes the 4 bit ACK
+    BinaryView response;
+    return Exchange(response, 0);
+}
+
+Result Ultralight::ReadSignature(BinaryData& signature)
+{
+    _interface.BeginWrite() << UL_CMD_READ_SIG << (uint8_t)0x00;
+
+    BinaryView response;
+    Result result = Exchange(response, ULTRALIGHT_SIGNATURE_SIZE);
+    if (!result)
+        return result;
+
+    signature.assign(response.begin(), response.end());
+
+    return Result();
+}
+
+Result Ultralight::PasswordAuth(const uint8_t password[ULTRALIGHT_PWD_SIZE], uint8_t pack[ULTRALIGHT_PACK_SIZE])
+{
+    ByteBuffer& buf = _interface.BeginWrite();
+    buf << UL_CMD_PWD_AUTH;
+    buf.Append(password, ULTRALIGHT_PWD_SIZE);
+
+    BinaryView response;
+    Result result = Exchange(response, ULTRALIGHT_PACK_SIZE);
+    if (!result)
+        return result;
+
+    pack[0] = response[0];
+    pack[1] = response[1];
+
+    return Result();
+}
+
+#endif
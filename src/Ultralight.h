@@ -0,0 +1,130 @@
+#ifndef __ULTRALIGHT_H__
+#define __ULTRALIGHT_H__
+
+#include "TagInterface.h"
+#include "ByteBuffer.h"
+#include "Ndef.h"
+#include "Result.h"
+#include "PN532Config.h"
+
+#define ULTRALIGHT_PAGE_SIZE 4
+// READ always returns 4 pages
+#define ULTRALIGHT_READ_PAGES 4
+// FAST_READ pages per frame. Response and PN532 status fit a normal frame
+#define ULTRALIGHT_FAST_READ_MAX_PAGES 60
+#define ULTRALIGHT_SIGNATURE_SIZE 32
+#define ULTRALIGHT_PWD_SIZE 4
+#define ULTRALIGHT_PACK_SIZE 2
+// First page of user memory on all types
+#define ULTRALIGHT_USER_PAGE 4
+
+enum UltralightCommand_t : uint8_t
+{
+    UL_CMD_GET_VERSION  = 0x60,
+    UL_CMD_READ         = 0x30,
+    UL_CMD_FAST_READ    = 0x3A,
+    UL_CMD_WRITE        = 0xA2,
+    UL_CMD_READ_CNT     = 0x39,
+    UL_CMD_PWD_AUTH     = 0x1B,
+    UL_CMD_READ_SIG     = 0x3C
+};
+
+enum UltralightType_t : uint8_t
+{
+    ULTRALIGHT_TYPE_UNKNOWN,
+    ULTRALIGHT_TYPE_ULTRALIGHT,     // No GET_VERSION support, 16 pages
+    ULTRALIGHT_TYPE_EV1_MF0UL11,
+    ULTRALIGHT_TYPE_EV1_MF0UL21,
+    ULTRALIGHT_TYPE_NTAG213,
+    ULTRALIGHT_TYPE_NTAG215,
+    ULTRALIGHT_TYPE_NTAG216
+};
+
+struct UltralightVersion
+{
+    uint8_t Header;         // Always 0x00
+    uint8_t Vendor;         // 0x04 for NXP
+    uint8_t ProductType;    // 0x03 Ultralight, 0x04 NTAG
+    uint8_t ProductSubtype;
+    uint8_t MajorVersion;
+    uint8_t MinorVersion;
+    uint8_t StorageSize;    // Identifies memory size within product type
+    uint8_t Protocol;
+};
+
+ByteBuffer& operator>>(ByteBuffer& a, UltralightVersion& b);
+// Decodes GET_VERSION response. Returns false if length does not match
+bool ParseUltralightVersion(const BinaryView& response, UltralightVersion& version);
+// Sends GET_VERSION to the tag with the given UID. A plain Ultralight answers
+// with NAK and falls back to idle state, so it is activated again and
+// supported is false. Only transport errors and a failed activation are returned.
+Result GetUltralightVersion(TagInterface& tag, const BinaryData& uid, UltralightVersion& version, bool& supported);
+
+#if PN532_CONFIG_ULTRALIGHT
+
+// Mifare Ultralight, Ultralight EV1 and NTAG21x driver (NFC Forum Type 2 tags).
+// Bulk reads use FAST_READ, which returns up to ULTRALIGHT_FAST_READ_MAX_PAGES
+// pages per frame instead of the 4 pages of READ.
+class Ultralight
+{
+public:
+    Ultralight(TagInterface& interface);
+
+    // Detects type and memory size with GET_VERSION. Plain Ultralight does not
+    // support it and is assumed when the card does not answer. Such a card
+    // falls back to idle state and is activated again with its UID (see
+    // TagInterface::Reactivate), so the tag stays usable.
+    Result Identify(const BinaryData& uid);
+    // Same, UID is read from page 0 first
+    Result Identify();
+    Result GetVersion(UltralightVersion& version);
+
+    // Reads 4 pages starting at page (16 bytes, wraps around end of memory)
+    Result Read(uint8_t page, BinaryData& out);
+    // Reads pages start to end (inclusive) with as few FAST_READ frames as possible
+    Result FastRead(uint8_t start, uint8_t end, BinaryData& out);
+    // Reads whole user memory. Calls Identify if type is not known yet
+    Result ReadUserMemory(BinaryData& out);
+    Result Write(uint8_t page, const uint8_t data[ULTRALIGHT_PAGE_SIZE]);
+#if PN532_CONFIG_NDEF
+    // Reads NDEF message from user memory, only as far as needed. Each frame
+    // requests the pages the parser is missing, records are passed to handler
+    // as soon as they are complete.
+    Result ReadNdef(const NdefRecordHandler_t& handler);
+#endif
+
+    // Reads 32 byte ECC originality signature (EV1 and NTAG)
+    Result ReadSignature(BinaryData& signature);
+    // Password authentication. Card answers with password acknowledge (PACK)
+    Result PasswordAuth(const uint8_t password[ULTRALIGHT_PWD_SIZE], uint8_t pack[ULTRALIGHT_PACK_SIZE]);
+
+    UltralightType_t Type() const
+    {
+        return _type;
+    }
+
+    // Total number of pages (0 until identified)
+    uint16_t Pages() const
+    {
+        return _pages;
+    }
+
+    // Number of pages in user memory (0 until identified)
+    uint16_t UserPages() const
+    {
+        return _userPages;
+    }
+
+private:
+    // Sends frame built with TagInterface::BeginWrite and checks response length
+    Result Exchange(BinaryView& response, uint16_t expected);
+
+    TagInterface& _interface;
+    UltralightType_t _type;
+    uint16_t _pages;
+    uint16_t _userPages;
+};
+
+#endif
+
+#endif
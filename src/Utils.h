@@ -2,9 +2,13 @@
 #define __UTILS_H__
 
 #include "ByteBuffer.h"
+#include "PN532Config.h"
+
+// Frame dumps of PN532_CONFIG_DEBUG
+#if defined(ARDUINO) && PN532_CONFIG_DEBUG
 #include "Arduino.h"
 
-inline void PrintBin(const BinaryData& in)
+inline void PrintBin(const BinaryView& in)
 {
     for (auto data : in)
     {
@@ -13,6 +17,7 @@ inline void PrintBin(const BinaryData& in)
     }
     Serial.print('\n');
 }
+#endif
 
 inline void iso14443b_crc(uint8_t *pbtData, size_t szLen, uint8_t *pbtCrc)
 {
@@ -30,6 +35,44 @@ inline void iso14443b_crc(uint8_t *pbtData, size_t szLen, uint8_t *pbtCrc)
     *pbtCrc = (uint8_t)((wCrc >> 8) & 0xFF);
 }
 
+// Maximum frame size per FSCI or FSDI (ISO14443-3 Type A ATS and Type B ATQB),
+// larger values are reserved and mean 256
+inline uint16_t FrameSizeFromIndex(uint8_t index)
+{
+    static const uint16_t frameSizes[] = { 16, 24, 32, 40, 48, 64, 96, 128, 256 };
+
+    return frameSizes[index < sizeof(frameSizes) / sizeof(frameSizes[0]) ? index : 8];
+}
+
+#define FNV1A_OFFSET_BASIS 2166136261u
+
+// FNV-1a hash. Pass the result of a previous call as hash to continue it
+inline uint32_t Fnv1a(const uint8_t *data, size_t len, uint32_t hash = FNV1A_OFFSET_BASIS)
+{
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+
+    return hash;
+}
+
+// Linear probing in an open addressing table of power of two size. Visits up
+// to maxProbe entries from the home slot of hash until stop returns true.
+// Returns that entry or nullptr when none stopped the probe.
+template <typename T, size_t N, typename F>
+T* ProbeSlots(T (&table)[N], uint32_t hash, uint8_t maxProbe, F stop)
+{
+    static_assert((N & (N - 1)) == 0, "Table size must be a power of two");
+
+    for (uint8_t i = 0; i < maxProbe; ++i)
+    {
+        T& entry = table[(hash + i) & (N - 1)];
+        if (stop(entry))
+            return &entry;
+    }
+
+    return nullptr;
+}
+
 inline void PadToBlocksize(BinaryData& data, size_t blocksize, uint8_t padding = 0x00)
 {
     size_t remainder = data.size() % blocksize;
@@ -0,0 +1,114 @@
+#include "WireTrace.h"
+
+#if PN532_CONFIG_TRACE
+
+#include "Platform.h"
+
+static const uint8_t traceMagic[] = WIRE_TRACE_MAGIC;
+
+WireTrace::WireTrace(size_t capacity) : _ring(capacity), _head(0), _used(0), _dropped(0)
+{
+
+}
+
+void WireTrace::Clear()
+{
+    _head = 0;
+    _used = 0;
+    _dropped = 0;
+}
+
+uint8_t WireTrace::At(size_t offset) const
+{
+    return _ring[(_head + offset) % _ring.size()];
+}
+
+void WireTrace::Write(uint8_t byte)
+{
+    _ring[(_head + _used) % _ring.size()] = byte;
+    _used++;
+}
+
+void WireTrace::DropOldest()
+{
+    uint16_t len = At(1) | (At(2) << 8);
+    size_t size = WIRE_TRACE_HEADER_SIZE + len;
+
+    _head = (_head + size) % _ring.size();
+    _used -= size;
+    _dropped++;
+}
+
+void WireTrace::Record(WireTraceType_t type, const uint8_t *data, uint16_t len)
+{
+    size_t size = WIRE_TRACE_HEADER_SIZE + len;
+
+    if (size > _ring.size())
+        return;
+
+    // Make room by overwriting oldest records
+    while (_ring.size() - _used < size)
+        DropOldest();
+
+    uint32_t timestamp = PlatformMicros();
+
+    Write(type);
+    Write(len);
+    Write(len >> 8);
+    for (uint8_t i = 0; i < 4; ++i)
+        Write(timestamp >> (i * 8));
+
+    for (uint16_t i = 0; i < len; ++i)
+        Write(data[i]);
+}
+
+void WireTrace::RecordError(int16_t error)
+{
+    uint8_t data[2] = {(uint8_t)error, (uint8_t)(error >> 8)};
+    Record(TRACE_ERROR, data, sizeof(data));
+}
+
+void WireTrace::Export(BinaryData& out) const
+{
+    out.assign(traceMagic, traceMagic + sizeof(traceMagic));
+    out.reserve(sizeof(traceMagic) + _used);
+
+    for (size_t i = 0; i < _used; ++i)
+        out.push_back(At(i));
+}
+
+bool WireTrace::Next(const BinaryView& trace, size_t& offset, WireTraceRecord& record)
+{
+    if (offset == 0)
+    {
+        if (trace.Size < sizeof(traceMagic))
+            return false;
+
+        for (uint8_t i = 0; i < sizeof(traceMagic); ++i)
+        {
+            if (trace[i] != traceMagic[i])
+                return false;
+        }
+
+        offset = sizeof(traceMagic);
+    }
+
+    if (offset + WIRE_TRACE_HEADER_SIZE > trace.Size)
+        return false;
+
+    uint16_t len = trace[offset+1] | (trace[offset+2] << 8);
+    if (offset + WIRE_TRACE_HEADER_SIZE + len > trace.Size)
+        return false;
+
+    record.Type = (WireTraceType_t)trace[offset];
+    record.Timestamp = 0;
+    for (uint8_t i = 0; i < 4; ++i)
+        record.Timestamp |= (uint32_t)trace[offset+3+i] << (i * 8);
+    record.Data = trace.Sub(offset + WIRE_TRACE_HEADER_SIZE, len);
+
+    offset += WIRE_TRACE_HEADER_SIZE + len;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __WIRETRACE_H__
+#define __WIRETRACE_H__
+
+#include <cstdint>
+#include <cstddef>
+#include "ByteBuffer.h"
+#include "PN532Config.h"
+
+#if PN532_CONFIG_TRACE
+
+// Record header: type, length (2), timestamp (4)
+#define WIRE_TRACE_HEADER_SIZE 7
+// Magic and version prefix of exported traces
+#define WIRE_TRACE_MAGIC {'P', 'N', 'T', '1'}
+
+enum WireTraceType_t : uint8_t
+{
+    TRACE_COMMAND   = 0x01, // Command packet sent to PN532 (command code first)
+    TRACE_RESPONSE  = 0x02, // Response packet without TFI and response code
+    TRACE_ERROR     = 0x03  // Transport error (PN532Error as int16_t)
+};
+
+struct WireTraceRecord
+{
+    WireTraceType_t Type;
+    uint32_t Timestamp;     // PlatformMicros()
+    BinaryView Data;
+
+    // Error code of TRACE_ERROR record
+    int16_t Error() const
+    {
+        return Data.Size >= 2 ? (int16_t)(Data[0] | (Data[1] << 8)) : 0;
+    }
+};
+
+// Binary recorder of PN532Interface traffic. Records go into a ring buffer
+// allocated once in the constructor, so recording never allocates and does not
+// touch the UART. When full, oldest records are overwritten.
+// Single writer; Export must not run concurrently with recording.
+class WireTrace
+{
+public:
+    WireTrace(size_t capacity);
+
+    void Record(WireTraceType_t type, const uint8_t *data, uint16_t len);
+    void RecordError(int16_t error);
+    void Clear();
+
+    // Bytes used by stored records
+    size_t Size() const
+    {
+        return _used;
+    }
+
+    // Records overwritten because buffer was full
+    uint32_t Dropped() const
+    {
+        return _dropped;
+    }
+
+    // Serializes stored records, oldest first
+    void Export(BinaryData& out) const;
+
+    // Iterates over exported trace. Offset starts at 0. Returns false at the end or on malformed data
+    static bool Next(const BinaryView& trace, size_t& offset, WireTraceRecord& record);
+
+private:
+    void Write(uint8_t byte);
+    uint8_t At(size_t offset) const;
+    void DropOldest();
+
+    BinaryData _ring;
+    size_t _head;   // Oldest record
+    size_t _used;
+    uint32_t _dropped;
+};
+
+#endif
+
+#endif